@@ -0,0 +1,158 @@
+/*
+ * Fixed-point activity filter pipeline for the LED monitor
+ * Integer arithmetic only, so the per-tick path avoids soft-float on ARMv6
+ *
+ * Stages (in order):
+ *   median-of-3 (optional) -> time-constant EMA -> peak-hold (optional) -> hysteresis
+ *
+ * Every stage takes the actual elapsed time since the previous sample, so the
+ * response no longer changes with CHECK_INTERVAL_MS or when the loop is delayed.
+ */
+
+#ifndef ACTIVITY_FILTER_H
+#define ACTIVITY_FILTER_H
+
+#include <stdint.h>
+
+// ============================================================================
+// FIXED-POINT LOAD - percent in Q16 (100% = 100 << 16)
+// ============================================================================
+
+typedef int32_t fixed_t;
+
+const int FIXED_SHIFT = 16;
+const fixed_t FIXED_ONE = 1 << FIXED_SHIFT;
+const fixed_t FIXED_100_PERCENT = 100 * FIXED_ONE;
+const uint32_t LN2_Q16 = 45426;
+
+// Compile-time conversion for configuration constants (no runtime float)
+constexpr fixed_t percentToFixed(double percent) {
+    return (fixed_t)(percent * FIXED_ONE + 0.5);
+}
+
+// Load in percent from busy/total counter deltas
+inline fixed_t fixedLoadFromCounters(uint64_t busy, uint64_t total) {
+    if (total == 0) {
+        return 0;
+    }
+    if (busy > total) {
+        busy = total;
+    }
+    return (fixed_t)((busy * (uint64_t)FIXED_100_PERCENT) / total);
+}
+
+// Fraction of the previous EMA value retained after elapsedMs:
+// exp(-dt / tau) = 2^(-dt / halfLife), via a 16-step table with interpolation
+inline uint32_t emaRetention(uint32_t elapsedMs, uint32_t halfLifeQ16) {
+    static const uint32_t EXP2_TABLE[17] = {
+        65536, 62757, 60097, 57549, 55109, 52773, 50535, 48393, 46341,
+        44376, 42495, 40693, 38968, 37316, 35734, 34219, 32768
+    };
+
+    uint64_t exponent = ((uint64_t)elapsedMs << (2 * FIXED_SHIFT)) / halfLifeQ16;
+    uint64_t whole = exponent >> FIXED_SHIFT;
+    if (whole >= FIXED_SHIFT) {
+        return 0;
+    }
+
+    uint32_t frac = (uint32_t)(exponent & (FIXED_ONE - 1));
+    uint32_t index = frac >> 12;
+    uint32_t weight = frac & 0xFFF;
+    uint32_t value = EXP2_TABLE[index] -
+                     (((EXP2_TABLE[index] - EXP2_TABLE[index + 1]) * weight) >> 12);
+    return value >> whole;
+}
+
+// ============================================================================
+// FILTER PIPELINE
+// ============================================================================
+
+struct ActivityFilterConfig {
+    uint32_t timeConstantMs;  // EMA time constant (0 = no smoothing)
+    bool medianEnabled;       // Reject single-sample spikes
+    uint32_t peakHoldMs;      // Hold peaks for this long (0 = disabled)
+    fixed_t threshold;        // Activity threshold
+    fixed_t hysteresis;       // Total hysteresis band around the threshold
+};
+
+class ActivityFilter {
+private:
+    ActivityFilterConfig config;
+    uint32_t halfLifeQ16;
+    fixed_t history[3];
+    int historyCount;
+    fixed_t ema;
+    fixed_t peak;
+    uint32_t peakAgeMs;
+    fixed_t output;
+    bool active;
+
+    static fixed_t medianOf3(fixed_t a, fixed_t b, fixed_t c) {
+        fixed_t lo = a < b ? a : b;
+        fixed_t hi = a < b ? b : a;
+        return c < lo ? lo : (c > hi ? hi : c);
+    }
+
+public:
+    ActivityFilter() : ActivityFilter(ActivityFilterConfig()) {}
+
+    explicit ActivityFilter(const ActivityFilterConfig& cfg)
+        : config(cfg), halfLifeQ16(cfg.timeConstantMs * LN2_Q16), historyCount(0),
+          ema(0), peak(0), peakAgeMs(0), output(0), active(false) {
+        history[0] = history[1] = history[2] = 0;
+    }
+
+    // Feed one raw sample taken elapsedMs after the previous one
+    fixed_t update(fixed_t sample, uint32_t elapsedMs) {
+        fixed_t value = sample;
+
+        // Median-of-3 over the last samples
+        if (config.medianEnabled) {
+            history[0] = history[1];
+            history[1] = history[2];
+            history[2] = sample;
+            if (historyCount < 3) {
+                historyCount++;
+            }
+            if (historyCount == 3) {
+                value = medianOf3(history[0], history[1], history[2]);
+            }
+        }
+
+        // EMA with alpha = 1 - exp(-dt / tau), exact for any sample spacing
+        // (halfLifeQ16 = tau * ln 2 in Q16)
+        if (config.timeConstantMs == 0) {
+            ema = value;
+        } else {
+            uint32_t alpha = FIXED_ONE - emaRetention(elapsedMs, halfLifeQ16);
+            ema += (fixed_t)(((int64_t)(value - ema) * alpha) >> FIXED_SHIFT);
+        }
+
+        // Peak-hold: keep the highest value until it is older than peakHoldMs
+        if (config.peakHoldMs > 0) {
+            peakAgeMs += elapsedMs;
+            if (ema >= peak || peakAgeMs > config.peakHoldMs) {
+                peak = ema;
+                peakAgeMs = 0;
+            }
+            output = peak;
+        } else {
+            output = ema;
+        }
+
+        // Hysteresis around the activity threshold
+        fixed_t halfBand = config.hysteresis / 2;
+        if (active) {
+            active = output > config.threshold - halfBand;
+        } else {
+            active = output > config.threshold + halfBand;
+        }
+
+        return output;
+    }
+
+    fixed_t value() const { return output; }
+    bool isActive() const { return active; }
+};
+
+#endif // ACTIVITY_FILTER_H
@@ -0,0 +1,264 @@
+/*
+ * Allocation guard for the hot paths
+ *
+ * The monitor tick, frame conversion and scan-out must never touch the heap:
+ * malloc can take a lock or fault in fresh pages at any time, which shows up
+ * as a late tick or a visible flicker. AllocScope marks such a region for
+ * the current thread:
+ *
+ *     AllocScope scope(ALLOC_SCOPE_TICK);
+ *
+ * Normal builds compile the scopes to nothing. Built with -DALLOC_GUARD,
+ * malloc/calloc/realloc/free, aligned_alloc/posix_memalign and operator
+ * new/delete are replaced by counting wrappers around glibc's allocator
+ * (the array, nothrow, sized and aligned operators end up in these).
+ * Heap calls are counted per thread and per innermost scope; any heap call
+ * inside a scope marked allocation-free is a violation, and aborts at the
+ * culprit when allocGuardAbort is set.
+ *
+ * The wrappers forward to __libc_malloc & co, so ALLOC_GUARD needs a dynamic
+ * glibc build and may be defined in one translation unit only.
+ */
+
+#ifndef ALLOC_GUARD_H
+#define ALLOC_GUARD_H
+
+enum AllocScopeId {
+    ALLOC_SCOPE_TICK,
+    ALLOC_SCOPE_FRAME_BUILD,
+    ALLOC_SCOPE_SCAN_OUT,
+    ALLOC_SCOPE_RENDER,
+    ALLOC_SCOPE_COUNT
+};
+
+struct AllocScopeInfo {
+    const char* name;
+    bool allocationFree;
+};
+
+const AllocScopeInfo ALLOC_SCOPES[ALLOC_SCOPE_COUNT] = {
+    { "tick", true },
+    { "frame build", true },
+    { "scan-out", true },
+    { "render", true }
+};
+
+#ifdef ALLOC_GUARD
+
+#include <atomic>
+#include <errno.h>
+#include <new>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* pointer);
+}
+
+const int ALLOC_GUARD_MAX_THREADS = 32;  // Later threads share the last slot
+
+struct AllocCounters {
+    std::atomic<unsigned long> allocations;
+    std::atomic<unsigned long> frees;
+    std::atomic<unsigned long> bytes;
+};
+
+struct AllocScopeCounters {
+    AllocCounters heap;
+    std::atomic<unsigned long> entries;
+};
+
+struct AllocThreadCounters {
+    AllocCounters heap;
+    long tid;
+    char name[16];
+};
+
+static AllocScopeCounters allocScopeCounters[ALLOC_SCOPE_COUNT];
+static AllocThreadCounters allocThreadCounters[ALLOC_GUARD_MAX_THREADS];
+static std::atomic<int> allocThreadSlots(0);
+static std::atomic<unsigned long> allocViolations(0);
+static bool allocGuardAbort = false;
+
+// Initial-exec TLS of the executable: reading it never allocates
+static __thread int allocCurrentScope = -1;
+static __thread AllocThreadCounters* allocThisThread = nullptr;
+
+inline AllocThreadCounters* allocThreadSlot() {
+    if (!allocThisThread) {
+        int slot = allocThreadSlots.fetch_add(1, std::memory_order_relaxed);
+        if (slot >= ALLOC_GUARD_MAX_THREADS) {
+            slot = ALLOC_GUARD_MAX_THREADS - 1;
+        } else {
+            allocThreadCounters[slot].tid = syscall(SYS_gettid);
+            prctl(PR_GET_NAME, allocThreadCounters[slot].name, 0, 0, 0);
+        }
+        allocThisThread = &allocThreadCounters[slot];
+    }
+    return allocThisThread;
+}
+
+inline void allocGuardCount(AllocCounters& counters, size_t allocatedBytes, bool freed) {
+    if (freed) {
+        counters.frees.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        counters.allocations.fetch_add(1, std::memory_order_relaxed);
+        counters.bytes.fetch_add(allocatedBytes, std::memory_order_relaxed);
+    }
+}
+
+inline void allocGuardRecord(size_t allocatedBytes, bool freed) {
+    int errnoSaved = errno;
+    allocGuardCount(allocThreadSlot()->heap, allocatedBytes, freed);
+    int scope = allocCurrentScope;
+    if (scope >= 0) {
+        allocGuardCount(allocScopeCounters[scope].heap, allocatedBytes, freed);
+        if (ALLOC_SCOPES[scope].allocationFree) {
+            allocViolations.fetch_add(1, std::memory_order_relaxed);
+            if (allocGuardAbort) {
+                abort();
+            }
+        }
+    }
+    errno = errnoSaved;
+}
+
+class AllocScope {
+private:
+    int previous;
+
+    AllocScope(const AllocScope&);
+    AllocScope& operator=(const AllocScope&);
+
+public:
+    explicit AllocScope(AllocScopeId scope) : previous(allocCurrentScope) {
+        allocCurrentScope = scope;
+        allocScopeCounters[scope].entries.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~AllocScope() { allocCurrentScope = previous; }
+};
+
+inline bool allocGuardEnabled() { return true; }
+
+inline unsigned long allocGuardViolations() {
+    return allocViolations.load(std::memory_order_relaxed);
+}
+
+inline unsigned long allocGuardScopeCalls(AllocScopeId scope) {
+    const AllocCounters& heap = allocScopeCounters[scope].heap;
+    return heap.allocations.load(std::memory_order_relaxed) + heap.frees.load(std::memory_order_relaxed);
+}
+
+// Counters of every scope entered and every thread that used the heap
+inline void allocGuardPrint() {
+    printf("allocations\n");
+    for (int i = 0; i < ALLOC_SCOPE_COUNT; i++) {
+        const AllocScopeCounters& scope = allocScopeCounters[i];
+        unsigned long entries = scope.entries.load(std::memory_order_relaxed);
+        if (entries == 0) {
+            continue;
+        }
+        printf("  scope  %-12s entries=%-9lu allocs=%-6lu frees=%-6lu bytes=%-9lu %s\n", ALLOC_SCOPES[i].name,
+               entries, scope.heap.allocations.load(std::memory_order_relaxed),
+               scope.heap.frees.load(std::memory_order_relaxed), scope.heap.bytes.load(std::memory_order_relaxed),
+               ALLOC_SCOPES[i].allocationFree ? "(allocation-free)" : "");
+    }
+    int threads = allocThreadSlots.load(std::memory_order_relaxed);
+    for (int i = 0; i < threads && i < ALLOC_GUARD_MAX_THREADS; i++) {
+        const AllocThreadCounters& thread = allocThreadCounters[i];
+        printf("  thread %-6ld %-15s allocs=%-6lu frees=%-6lu bytes=%lu\n", thread.tid, thread.name,
+               thread.heap.allocations.load(std::memory_order_relaxed),
+               thread.heap.frees.load(std::memory_order_relaxed), thread.heap.bytes.load(std::memory_order_relaxed));
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Replacement allocator entry points
+// ----------------------------------------------------------------------------
+
+extern "C" void* malloc(size_t size) noexcept {
+    allocGuardRecord(size, false);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) noexcept {
+    allocGuardRecord(count * size, false);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size) noexcept {
+    allocGuardRecord(size, pointer && size == 0);
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void* pointer) noexcept {
+    if (pointer) {
+        allocGuardRecord(0, true);
+    }
+    __libc_free(pointer);
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    allocGuardRecord(size, false);
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** pointer, size_t alignment, size_t size) noexcept {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    allocGuardRecord(size, false);
+    void* memory = __libc_memalign(alignment, size);
+    if (!memory) {
+        return ENOMEM;
+    }
+    *pointer = memory;
+    return 0;
+}
+
+// Out of memory ends the program either way; abort instead of throwing so
+// -fno-exceptions builds can use the guard too
+void* operator new(size_t size) {
+    allocGuardRecord(size, false);
+    void* memory = __libc_malloc(size ? size : 1);
+    if (!memory) {
+        abort();
+    }
+    return memory;
+}
+
+void operator delete(void* pointer) noexcept {
+    if (pointer) {
+        allocGuardRecord(0, true);
+    }
+    __libc_free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+#else
+
+class AllocScope {
+public:
+    explicit AllocScope(AllocScopeId) {}
+};
+
+inline bool allocGuardEnabled() { return false; }
+inline unsigned long allocGuardViolations() { return 0; }
+inline unsigned long allocGuardScopeCalls(AllocScopeId) { return 0; }
+inline void allocGuardPrint() {}
+
+#endif // ALLOC_GUARD
+
+#endif // ALLOC_GUARD_H
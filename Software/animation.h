@@ -0,0 +1,579 @@
+/*
+ * Animated GIF playback from pre-converted bitplane frames
+ *
+ * GifDecoder        - GIF87a/89a: LZW, local and global color tables,
+ *                     interlacing, transparency and the three disposal
+ *                     methods, composited onto a full-screen RGB image
+ * AnimationSequence - decodes the whole animation once, scales each frame to
+ *                     the canvas (nearest neighbour; author GIFs at panel
+ *                     size for best results) and converts it to bitplanes.
+ *                     Frames whose bitplanes are identical are stored once,
+ *                     and runs of the same frame become one longer step.
+ * AnimationPlayer   - picks the step for a time; called by the scan thread
+ *                     before every refresh, so a frame change lands on the
+ *                     first refresh boundary after its due time. The
+ *                     schedule is absolute, per-frame delays never drift.
+ *
+ * During playback nothing is decoded or converted: frameAt() is a compare
+ * and, at a boundary, a pointer change.
+ *
+ * GIF delays of 0 or 1 centiseconds are played as 100 ms, like browsers do.
+ */
+
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <stdint.h>
+#include <string.h>
+#include "assetCache.h"
+#include "hub75.h"
+
+const int ANIMATION_MAX_FRAMES = 1024;
+const int GIF_MAX_SIDE = 4096;
+const uint32_t GIF_DEFAULT_DELAY_MS = 100;
+
+// ============================================================================
+// GIF DECODER
+// ============================================================================
+
+class GifDecoder {
+private:
+    enum { GIF_MAX_CODES = 4096 };
+
+    const uint8_t* position;
+    const uint8_t* end;
+    int screenWidth;
+    int screenHeight;
+    uint8_t globalColors[256 * 3];
+    int globalColorCount;
+
+    uint8_t* screen;        // Composited RGB, screenWidth x screenHeight
+    uint8_t* previous;      // Saved screen for disposal method 3
+    uint8_t* indices;       // Color indices of the frame being decoded
+    uint8_t* packed;        // LZW data with the sub-block lengths removed
+    size_t packedSize;
+
+    // Disposal of the frame last returned, applied before the next one
+    int pendingDisposal;
+    int pendingX, pendingY, pendingW, pendingH;
+
+    uint16_t prefix[GIF_MAX_CODES];
+    uint8_t suffix[GIF_MAX_CODES];
+    uint8_t firstByte[GIF_MAX_CODES];
+    uint16_t lengths[GIF_MAX_CODES];
+
+    const char* failure;
+
+    GifDecoder(const GifDecoder&);
+    GifDecoder& operator=(const GifDecoder&);
+
+    bool fail(const char* what) {
+        failure = what;
+        return false;
+    }
+
+    bool has(size_t bytes) const { return (size_t)(end - position) >= bytes; }
+
+    static int le16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+
+    // Concatenate data sub-blocks into packed; false if truncated
+    bool readSubBlocks() {
+        packedSize = 0;
+        for (;;) {
+            if (!has(1)) {
+                return false;
+            }
+            size_t length = *position++;
+            if (length == 0) {
+                return true;
+            }
+            if (!has(length)) {
+                return false;
+            }
+            memcpy(packed + packedSize, position, length);
+            packedSize += length;
+            position += length;
+        }
+    }
+
+    bool skipSubBlocks() {
+        for (;;) {
+            if (!has(1)) {
+                return false;
+            }
+            size_t length = *position++;
+            if (length == 0) {
+                return true;
+            }
+            if (!has(length)) {
+                return false;
+            }
+            position += length;
+        }
+    }
+
+    // Variable-width LZW into indices[0, count); short data leaves the rest 0
+    bool decompress(int minCodeSize, size_t count) {
+        if (minCodeSize < 1 || minCodeSize > 8) {
+            return fail("bad LZW code size");
+        }
+        const int clear = 1 << minCodeSize;
+        const int endCode = clear + 1;
+        for (int i = 0; i < clear; i++) {
+            prefix[i] = 0;
+            suffix[i] = (uint8_t)i;
+            firstByte[i] = (uint8_t)i;
+            lengths[i] = 1;
+        }
+        int codeSize = minCodeSize + 1;
+        int next = clear + 2;
+        int previousCode = -1;
+        size_t out = 0;
+        uint32_t bits = 0;
+        int bitCount = 0;
+        size_t in = 0;
+
+        memset(indices, 0, count);
+        while (out < count) {
+            while (bitCount < codeSize && in < packedSize) {
+                bits |= (uint32_t)packed[in++] << bitCount;
+                bitCount += 8;
+            }
+            if (bitCount < codeSize) {
+                break;  // Ran out of data; tolerated like other decoders
+            }
+            int code = (int)(bits & ((1u << codeSize) - 1));
+            bits >>= codeSize;
+            bitCount -= codeSize;
+
+            if (code == clear) {
+                codeSize = minCodeSize + 1;
+                next = clear + 2;
+                previousCode = -1;
+                continue;
+            }
+            if (code == endCode) {
+                break;
+            }
+
+            int emit;
+            if (previousCode < 0) {
+                if (code >= clear) {
+                    return fail("bad first LZW code");
+                }
+                emit = code;
+            } else if (code < next) {
+                emit = code;
+                if (next < GIF_MAX_CODES) {
+                    prefix[next] = (uint16_t)previousCode;
+                    suffix[next] = firstByte[code];
+                    firstByte[next] = firstByte[previousCode];
+                    lengths[next] = (uint16_t)(lengths[previousCode] + 1);
+                    next++;
+                }
+                if (next == (1 << codeSize) && codeSize < 12) {
+                    codeSize++;
+                }
+            } else if (code == next && next < GIF_MAX_CODES) {
+                prefix[next] = (uint16_t)previousCode;
+                suffix[next] = firstByte[previousCode];
+                firstByte[next] = firstByte[previousCode];
+                lengths[next] = (uint16_t)(lengths[previousCode] + 1);
+                emit = next++;
+                if (next == (1 << codeSize) && codeSize < 12) {
+                    codeSize++;
+                }
+            } else {
+                return fail("bad LZW code");
+            }
+            previousCode = code;
+
+            // Strings are written back to front along the prefix chain
+            size_t length = lengths[emit];
+            size_t last = out + length - 1;
+            for (int c = emit; ; c = prefix[c]) {
+                if (last < count) {
+                    indices[last] = suffix[c];
+                }
+                if (last == out) {
+                    break;
+                }
+                last--;
+            }
+            out += length;
+        }
+        return true;
+    }
+
+    void dispose() {
+        if (pendingDisposal == 2) {
+            for (int y = pendingY; y < pendingY + pendingH; y++) {
+                memset(screen + ((size_t)y * screenWidth + pendingX) * 3, 0, (size_t)pendingW * 3);
+            }
+        } else if (pendingDisposal == 3) {
+            memcpy(screen, previous, (size_t)screenWidth * screenHeight * 3);
+        }
+        pendingDisposal = 0;
+    }
+
+public:
+    int loopCount;          // Plays; 0 = forever (NETSCAPE2.0 extension), 1 without one
+
+    GifDecoder() : position(nullptr), end(nullptr), screenWidth(0), screenHeight(0),
+                   globalColorCount(0), screen(nullptr), previous(nullptr), indices(nullptr), packed(nullptr),
+                   packedSize(0), pendingDisposal(0), pendingX(0), pendingY(0), pendingW(0), pendingH(0),
+                   failure(nullptr), loopCount(1) {}
+
+    ~GifDecoder() {
+        delete[] screen;
+        delete[] previous;
+        delete[] indices;
+        delete[] packed;
+    }
+
+    // Parse the header; the buffer must outlive the decoder
+    bool open(const uint8_t* gif, size_t size) {
+        position = gif;
+        end = gif + size;
+        if (!has(13) || (memcmp(gif, "GIF87a", 6) != 0 && memcmp(gif, "GIF89a", 6) != 0)) {
+            return fail("not a GIF");
+        }
+        screenWidth = le16(gif + 6);
+        screenHeight = le16(gif + 8);
+        if (screenWidth <= 0 || screenHeight <= 0 || screenWidth > GIF_MAX_SIDE || screenHeight > GIF_MAX_SIDE) {
+            return fail("bad screen size");
+        }
+        uint8_t flags = gif[10];
+        position += 13;
+        globalColorCount = 0;
+        if (flags & 0x80) {
+            globalColorCount = 2 << (flags & 7);
+            if (!has((size_t)globalColorCount * 3)) {
+                return fail("truncated color table");
+            }
+            memcpy(globalColors, position, (size_t)globalColorCount * 3);
+            position += globalColorCount * 3;
+        }
+
+        size_t pixels = (size_t)screenWidth * screenHeight;
+        delete[] screen;
+        delete[] previous;
+        delete[] indices;
+        delete[] packed;
+        screen = new uint8_t[pixels * 3];
+        previous = new uint8_t[pixels * 3];
+        indices = new uint8_t[pixels];
+        packed = new uint8_t[size];
+        memset(screen, 0, pixels * 3);
+        pendingDisposal = 0;
+        loopCount = 1;
+        return true;
+    }
+
+    int width() const { return screenWidth; }
+    int height() const { return screenHeight; }
+    const char* error() const { return failure; }
+
+    // Composite the next frame; false at the end of the file or on an error
+    // (error() is set then). rgb stays valid until the next call.
+    bool nextFrame(const uint8_t*& rgb, uint32_t& delayMs) {
+        dispose();
+        int disposal = 0;
+        int transparent = -1;
+        uint32_t delay = 0;
+
+        while (has(1)) {
+            uint8_t block = *position++;
+            if (block == 0x3B) {
+                return false;
+            }
+            if (block == 0x21) {
+                if (!has(1)) {
+                    return fail("truncated extension");
+                }
+                uint8_t label = *position++;
+                if (label == 0xF9 && has(6) && position[0] == 4) {
+                    uint8_t flags = position[1];
+                    disposal = (flags >> 2) & 7;
+                    delay = (uint32_t)le16(position + 2) * 10;
+                    transparent = (flags & 1) ? position[4] : -1;
+                    position += 5;
+                } else if (label == 0xFF && has(16) && position[0] == 11 && memcmp(position + 1, "NETSCAPE2.0", 11) == 0) {
+                    position += 12;
+                    if (position[0] == 3 && position[1] == 1) {
+                        int repeats = le16(position + 2);
+                        loopCount = repeats == 0 ? 0 : repeats + 1;  // Repeats after the first play
+                    }
+                }
+                if (!skipSubBlocks()) {
+                    return fail("truncated extension");
+                }
+                continue;
+            }
+            if (block != 0x2C) {
+                return fail("unknown block");
+            }
+
+            if (!has(9)) {
+                return fail("truncated image descriptor");
+            }
+            int x = le16(position);
+            int y = le16(position + 2);
+            int w = le16(position + 4);
+            int h = le16(position + 6);
+            uint8_t flags = position[8];
+            position += 9;
+            const uint8_t* colors = globalColors;
+            int colorCount = globalColorCount;
+            if (flags & 0x80) {
+                colorCount = 2 << (flags & 7);
+                if (!has((size_t)colorCount * 3)) {
+                    return fail("truncated color table");
+                }
+                colors = position;
+                position += colorCount * 3;
+            }
+            if (!has(1)) {
+                return fail("truncated image");
+            }
+            int minCodeSize = *position++;
+            if (!readSubBlocks()) {
+                return fail("truncated image");
+            }
+
+            // Clip to the screen; out-of-screen parts are decoded and dropped
+            size_t count = (size_t)w * h;
+            if (w <= 0 || h <= 0 || w > GIF_MAX_SIDE || h > GIF_MAX_SIDE) {
+                return fail("bad frame size");
+            }
+            if (count > (size_t)screenWidth * screenHeight) {
+                return fail("frame larger than the screen");
+            }
+            if (!decompress(minCodeSize, count)) {
+                return false;
+            }
+            if (disposal == 3) {
+                memcpy(previous, screen, (size_t)screenWidth * screenHeight * 3);
+            }
+
+            for (int row = 0; row < h; row++) {
+                // Interlaced rows arrive as every 8th from 0, 8th from 4, 4th from 2, 2nd from 1
+                int line = row;
+                if (flags & 0x40) {
+                    int pass1 = (h + 7) / 8, pass2 = (h + 3) / 8, pass3 = (h + 1) / 4;
+                    line = row < pass1 ? row * 8
+                         : row < pass1 + pass2 ? (row - pass1) * 8 + 4
+                         : row < pass1 + pass2 + pass3 ? (row - pass1 - pass2) * 4 + 2
+                         : (row - pass1 - pass2 - pass3) * 2 + 1;
+                }
+                int sy = y + line;
+                if (sy >= screenHeight) {
+                    continue;
+                }
+                const uint8_t* source = indices + (size_t)row * w;
+                uint8_t* target = screen + (size_t)sy * screenWidth * 3;
+                for (int col = 0; col < w && x + col < screenWidth; col++) {
+                    int index = source[col];
+                    if (index == transparent) {
+                        continue;
+                    }
+                    uint8_t* p = target + (size_t)(x + col) * 3;
+                    if (index < colorCount) {
+                        p[0] = colors[index * 3];
+                        p[1] = colors[index * 3 + 1];
+                        p[2] = colors[index * 3 + 2];
+                    } else {
+                        p[0] = p[1] = p[2] = 0;
+                    }
+                }
+            }
+
+            pendingDisposal = disposal;
+            pendingX = x < screenWidth ? x : screenWidth;
+            pendingY = y < screenHeight ? y : screenHeight;
+            pendingW = pendingX + w <= screenWidth ? w : screenWidth - pendingX;
+            pendingH = pendingY + h <= screenHeight ? h : screenHeight - pendingY;
+            rgb = screen;
+            delayMs = delay > 10 ? delay : GIF_DEFAULT_DELAY_MS;
+            return true;
+        }
+        return fail("missing trailer");
+    }
+};
+
+// ============================================================================
+// ANIMATION SEQUENCE - every frame converted once
+// ============================================================================
+
+class AnimationSequence {
+public:
+    struct Step {
+        int frame;          // Index into the unique frames
+        uint32_t delayMs;
+    };
+
+private:
+    MatrixConfig config;
+    BitplaneFrame* frames[ANIMATION_MAX_FRAMES];
+    uint64_t hashes[ANIMATION_MAX_FRAMES];
+    Step steps[ANIMATION_MAX_FRAMES];
+    int frameCount;
+    int stepCount;
+    uint32_t durationMs;
+
+    AnimationSequence(const AnimationSequence&);
+    AnimationSequence& operator=(const AnimationSequence&);
+
+    void clear() {
+        for (int i = 0; i < frameCount; i++) {
+            delete frames[i];
+        }
+        frameCount = 0;
+        stepCount = 0;
+        durationMs = 0;
+        decodedFrames = 0;
+    }
+
+    // Index of a stored frame with the same bitplanes, or -1
+    int findFrame(const BitplaneFrame& frame, uint64_t hash) const {
+        for (int i = 0; i < frameCount; i++) {
+            if (hashes[i] == hash && frames[i]->totalUnits == frame.totalUnits &&
+                memcmp(frames[i]->planeWords(0, 0), frame.planeWords(0, 0), frame.wordBytes()) == 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+public:
+    int decodedFrames;      // Frames in the file
+    int loopCount;          // Plays, 0 = forever
+    const char* error;
+
+    explicit AnimationSequence(const MatrixConfig& cfg)
+        : config(cfg), frameCount(0), stepCount(0), durationMs(0), decodedFrames(0), loopCount(0), error(nullptr) {}
+
+    ~AnimationSequence() { clear(); }
+
+    // Decode and convert the whole GIF; false (and error) if it is unusable
+    bool loadGif(const uint8_t* gif, size_t size, const GammaTable& gamma) {
+        clear();
+        GifDecoder decoder;
+        if (!decoder.open(gif, size)) {
+            error = decoder.error();
+            return false;
+        }
+        Canvas canvas(config.width(), config.height());
+        BitplaneFrame* scratch = new BitplaneFrame(config);
+        const uint8_t* rgb;
+        uint32_t delayMs;
+        error = nullptr;
+        while (decoder.nextFrame(rgb, delayMs)) {
+            if (decodedFrames >= ANIMATION_MAX_FRAMES) {
+                error = "too many frames";
+                break;
+            }
+            decodedFrames++;
+            for (int y = 0; y < canvas.height(); y++) {
+                const uint8_t* row = rgb + (size_t)(y * decoder.height() / canvas.height()) * decoder.width() * 3;
+                for (int x = 0; x < canvas.width(); x++) {
+                    const uint8_t* p = row + (size_t)(x * decoder.width() / canvas.width()) * 3;
+                    canvas.setPixel(x, y, p[0], p[1], p[2]);
+                }
+            }
+            scratch->build(canvas, gamma);
+
+            uint64_t hash = assetHash(scratch->planeWords(0, 0), scratch->wordBytes());
+            int index = findFrame(*scratch, hash);
+            if (index < 0) {
+                index = frameCount;
+                frames[frameCount] = scratch;
+                hashes[frameCount] = hash;
+                frameCount++;
+                scratch = new BitplaneFrame(config);
+            }
+            if (stepCount > 0 && steps[stepCount - 1].frame == index) {
+                steps[stepCount - 1].delayMs += delayMs;
+            } else {
+                steps[stepCount].frame = index;
+                steps[stepCount].delayMs = delayMs;
+                stepCount++;
+            }
+            durationMs += delayMs;
+        }
+        delete scratch;
+        if (!error) {
+            error = decoder.error();
+        }
+        loopCount = decoder.loopCount;
+        return stepCount > 0 && !error;
+    }
+
+    int uniqueFrames() const { return frameCount; }
+    int stepsPerLoop() const { return stepCount; }
+    uint32_t loopMs() const { return durationMs; }
+    const Step& step(int index) const { return steps[index]; }
+    const BitplaneFrame& frame(int index) const { return *frames[index]; }
+};
+
+// ============================================================================
+// ANIMATION PLAYER
+// ============================================================================
+
+class AnimationPlayer {
+private:
+    const AnimationSequence& sequence;
+    int current;
+    uint32_t dueMs;         // When the current step ends
+    bool started;
+    bool finished;
+
+public:
+    unsigned long framesShown;     // Steps put on screen
+    unsigned long framesSkipped;   // Steps whose whole delay passed between two calls
+    unsigned long loops;
+
+    explicit AnimationPlayer(const AnimationSequence& frames)
+        : sequence(frames), current(0), dueMs(0), started(false), finished(false), framesShown(0),
+          framesSkipped(0), loops(0) {}
+
+    // Frame to scan at nowMs; the first call starts playback
+    const BitplaneFrame& frameAt(uint32_t nowMs) {
+        if (!started) {
+            started = true;
+            dueMs = nowMs + sequence.step(0).delayMs;
+            framesShown++;
+        }
+        bool changed = false;
+        while (!finished && (int32_t)(nowMs - dueMs) >= 0) {
+            if (changed) {
+                framesSkipped++;
+            }
+            current++;
+            if (current == sequence.stepsPerLoop()) {
+                loops++;
+                if (sequence.loopCount != 0 && loops >= (unsigned long)sequence.loopCount) {
+                    current--;
+                    finished = true;
+                    break;
+                }
+                current = 0;
+                // A stall longer than a loop: skip whole loops, keep the phase
+                if ((uint32_t)(nowMs - dueMs) >= sequence.loopMs()) {
+                    dueMs += (nowMs - dueMs) / sequence.loopMs() * sequence.loopMs();
+                }
+            }
+            dueMs += sequence.step(current).delayMs;
+            changed = true;
+        }
+        if (changed) {
+            framesShown++;
+        }
+        return sequence.frame(sequence.step(current).frame);
+    }
+
+    int currentStep() const { return current; }
+    bool done() const { return finished; }
+};
+
+#endif // ANIMATION_H
@@ -0,0 +1,236 @@
+/*
+ * Cache of decoded assets in bitplane form
+ *
+ * Images and logos in a rotating playlist come back every few minutes;
+ * decoding, scaling, gamma correction and the transpose are done once and
+ * the finished BitplaneFrame is kept, keyed by the asset's content hash and
+ * the display settings it was converted for (geometry, depth, gamma). A hit
+ * hands out the cached frame itself, so redisplay is a pointer swap, or a
+ * memcpy with BitplaneFrame::copyFrom() when the frame must outlive the
+ * next fetch.
+ *
+ * Memory is bounded by a byte budget, split into frame-sized slots up
+ * front. The least recently used frame is evicted, optionally into a spill
+ * file mapped with mmap(): a spill hit is one memcpy back from the page
+ * cache instead of a full decode, into one extra scratch frame that then
+ * trades places with the evicted slot. The spill file is scratch for this
+ * process, it is rewritten on every start.
+ *
+ * Not thread safe: fetch from the one thread that prepares frames. Entry
+ * counts are small (tens), so lookups scan the key arrays.
+ */
+
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "hub75.h"
+#include "statsSocket.h"
+
+// FNV-1a over the encoded asset bytes; hash once when the asset is loaded
+inline uint64_t assetHash(const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint64_t hash = 1469598103934665603ull;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Everything that changes the bitplanes of the same asset
+inline uint64_t displaySettingsHash(const MatrixConfig& config, double gamma) {
+    uint64_t settings[6] = { (uint64_t)config.width(), (uint64_t)config.height(), (uint64_t)config.planes,
+                             (uint64_t)config.adaptiveDepth, (uint64_t)config.parallel,
+                             (uint64_t)(gamma * 1000.0 + 0.5) };
+    return assetHash(settings, sizeof(settings));
+}
+
+class AssetCache {
+private:
+    struct Key {
+        uint64_t asset;
+        uint64_t settings;
+        bool valid;
+    };
+
+    BitplaneFrame** frames;
+    Key* keys;
+    uint64_t* lastUse;
+    int slots;
+
+    // Spill file: spillSlots records of recordSize bytes
+    uint8_t* spill;
+    Key* spillKeys;
+    uint64_t* spillLastUse;
+    BitplaneFrame* scratch;  // Spill hits are restored here, then swapped into the slot
+    int spillSlots;
+    size_t recordSize;
+    size_t spillBytes;
+
+    uint64_t useCounter;
+
+    AssetCache(const AssetCache&);
+    AssetCache& operator=(const AssetCache&);
+
+    static bool matches(const Key& key, uint64_t asset, uint64_t settings) {
+        return key.valid && key.asset == asset && key.settings == settings;
+    }
+
+    static int leastRecent(const Key* table, const uint64_t* uses, int count) {
+        int victim = 0;
+        for (int i = 0; i < count; i++) {
+            if (!table[i].valid) {
+                return i;
+            }
+            if (uses[i] < uses[victim]) {
+                victim = i;
+            }
+        }
+        return victim;
+    }
+
+    // Free a memory slot, moving its frame to the spill file if there is one
+    void evict(int slot) {
+        if (keys[slot].valid) {
+            evictions++;
+            if (spillSlots > 0) {
+                int record = leastRecent(spillKeys, spillLastUse, spillSlots);
+                frames[slot]->store(spill + (size_t)record * recordSize);
+                spillKeys[record] = keys[slot];
+                spillLastUse[record] = lastUse[slot];
+                spilled++;
+            }
+            keys[slot].valid = false;
+        }
+    }
+
+public:
+    unsigned long lookups;
+    unsigned long hits;          // Frame was in memory
+    unsigned long spillHits;     // Copied back from the spill file
+    unsigned long misses;        // Decoded and converted
+    unsigned long evictions;
+    unsigned long spilled;
+    uint64_t bytesSaved;         // Asset bytes not decoded again thanks to hits
+
+    // memoryBudget bytes of frames; spillPath/spillBudget add a file-backed tier
+    AssetCache(const MatrixConfig& cfg, size_t memoryBudget, const char* spillPath = nullptr, size_t spillBudget = 0)
+        : spill(nullptr), spillKeys(nullptr), spillLastUse(nullptr), scratch(nullptr), spillSlots(0), spillBytes(0),
+          useCounter(0), lookups(0), hits(0), spillHits(0), misses(0), evictions(0), spilled(0), bytesSaved(0) {
+        BitplaneFrame probe(cfg);
+        recordSize = (probe.storageSize() + 63) & ~(size_t)63;
+        slots = (int)(memoryBudget / probe.storageSize());
+        slots = slots > 0 ? slots : 1;
+        frames = new BitplaneFrame*[(size_t)slots];
+        keys = new Key[(size_t)slots];
+        lastUse = new uint64_t[(size_t)slots];
+        for (int i = 0; i < slots; i++) {
+            frames[i] = new BitplaneFrame(cfg);
+            keys[i].valid = false;
+            lastUse[i] = 0;
+        }
+
+        if (spillPath && spillBudget >= recordSize) {
+            int count = (int)(spillBudget / recordSize);
+            int fd = open(spillPath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+            if (fd >= 0 && ftruncate(fd, (off_t)(count * recordSize)) == 0) {
+                void* mapped = mmap(nullptr, count * recordSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (mapped != MAP_FAILED) {
+                    spill = (uint8_t*)mapped;
+                    spillSlots = count;
+                    spillBytes = count * recordSize;
+                    spillKeys = new Key[(size_t)count];
+                    spillLastUse = new uint64_t[(size_t)count];
+                    scratch = new BitplaneFrame(cfg);
+                    for (int i = 0; i < count; i++) {
+                        spillKeys[i].valid = false;
+                        spillLastUse[i] = 0;
+                    }
+                }
+            }
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    ~AssetCache() {
+        for (int i = 0; i < slots; i++) {
+            delete frames[i];
+        }
+        delete[] frames;
+        delete[] keys;
+        delete[] lastUse;
+        if (spill) {
+            munmap(spill, spillBytes);
+        }
+        delete[] spillKeys;
+        delete[] spillLastUse;
+        delete scratch;
+    }
+
+    // Cached frame of the asset, or decode(frame) builds it on a miss.
+    // assetBytes (the encoded size) is what a hit saves from being decoded.
+    // The frame stays valid until a later fetch evicts it.
+    template <class Decode>
+    const BitplaneFrame& fetch(uint64_t asset, uint64_t settings, size_t assetBytes, Decode decode) {
+        lookups++;
+        useCounter++;
+        for (int i = 0; i < slots; i++) {
+            if (matches(keys[i], asset, settings)) {
+                hits++;
+                bytesSaved += assetBytes;
+                lastUse[i] = useCounter;
+                return *frames[i];
+            }
+        }
+
+        int record = -1;
+        for (int i = 0; i < spillSlots && record < 0; i++) {
+            if (matches(spillKeys[i], asset, settings)) {
+                record = i;
+            }
+        }
+
+        int slot = leastRecent(keys, lastUse, slots);
+        if (record >= 0) {
+            // Read the record out before the evicted frame may take its place
+            scratch->restore(spill + (size_t)record * recordSize);
+            spillKeys[record].valid = false;
+            evict(slot);
+            BitplaneFrame* restored = scratch;
+            scratch = frames[slot];
+            frames[slot] = restored;
+            spillHits++;
+            bytesSaved += assetBytes;
+        } else {
+            evict(slot);
+            decode(*frames[slot]);
+            misses++;
+        }
+        keys[slot].asset = asset;
+        keys[slot].settings = settings;
+        keys[slot].valid = true;
+        lastUse[slot] = useCounter;
+        return *frames[slot];
+    }
+
+    int memorySlots() const { return slots; }
+    int spillCapacity() const { return spillSlots; }
+    size_t frameBytes() const { return recordSize; }
+
+    void report(StatsReport& out, const char* name) const {
+        out.add(name, "lookups", lookups);
+        out.add(name, "hits", hits);
+        out.add(name, "spill_hits", spillHits);
+        out.add(name, "misses", misses);
+        out.add(name, "evictions", evictions);
+        out.add(name, "bytes_saved", (unsigned long)bytesSaved);
+    }
+};
+
+#endif // ASSET_CACHE_H
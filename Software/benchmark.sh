@@ -0,0 +1,129 @@
+#!/bin/bash
+#
+# Startup time and memory benchmark for the LED monitor
+# Builds the monitor with simulated GPIO (so GPIO init is excluded) as a normal
+# dynamic build and as the lean static build, then reports for each:
+#   - time from launch to the first LED update, median / max over RUNS
+#     (includes fork/exec, dynamic loading and static initialization)
+#   - time from entering main() to the first LED update, median
+#   - steady-state VmRSS and peak VmHWM after SETTLE_SECONDS
+#
+# A second table compares time-to-first-LED for serial GPIO start-up (the old
+# behaviour) and the threaded start-up, using a simulated backend whose init
+# takes SIM_INIT_MS. On a Pi, run as root to also measure the real backends.
+#
+# Usage: ./benchmark.sh [runs]
+#
+
+set -e
+
+RUNS=${1:-20}
+SETTLE_SECONDS=2
+SIM_INIT_MS=${SIM_INIT_MS:-150}
+CXX=${CXX:-g++}
+SRC_DIR=$(cd "$(dirname "$0")" && pwd)
+BUILD_DIR=$(mktemp -d)
+trap 'rm -rf "$BUILD_DIR"' EXIT
+
+"$CXX" -DGPIO_SIMULATED -O2 -o "$BUILD_DIR/led_monitor_dynamic" "$SRC_DIR/ledIndicator.cpp" -lpthread
+"$CXX" -DGPIO_SIMULATED -O2 -static -fno-exceptions -fno-rtti \
+    -o "$BUILD_DIR/led_monitor_static" "$SRC_DIR/ledIndicator.cpp" -lpthread
+
+# Real GPIO build when running on a Pi as root
+REAL_GPIO=0
+if [ "$(id -u)" = 0 ] && [ -e /dev/gpiomem ]; then
+    if "$CXX" -O2 -o "$BUILD_DIR/led_monitor_real" "$SRC_DIR/ledIndicator.cpp" \
+        -lpigpio -lrt -lpthread 2>/dev/null; then
+        REAL_GPIO=1
+    fi
+fi
+
+# Launch once and print "launch_us main_us" to the first LED update
+measure_startup() {
+    local binary=$1
+    shift
+    local out="$BUILD_DIR/startup.txt"
+    local start
+    local pid
+
+    rm -f "$out"
+    start=${EPOCHREALTIME/./}
+    "$binary" --background --bench-startup "$@" > "$out" &
+    pid=$!
+
+    # Wait without polling: the monitor runs at nice 19 and would be preempted
+    until [ -s "$out" ]; do
+        sleep 0.2
+    done
+    kill "$pid" 2>/dev/null
+    wait "$pid" 2>/dev/null || true
+
+    local first main
+    first=$(sed -n 's/^first_led_ns=\([0-9]*\).*/\1/p' "$out")
+    main=$(sed -n 's/.*main_ns=\([0-9]*\).*/\1/p' "$out")
+    echo "$(( first / 1000 - start )) $(( (first - main) / 1000 ))"
+}
+
+# Print "launch_p50 launch_max main_p50" in microseconds over RUNS launches
+startup_stats() {
+    local launch=()
+    local main=()
+    local l m
+    for ((i = 0; i < RUNS; i++)); do
+        read -r l m <<< "$(measure_startup "$@")"
+        launch+=("$l")
+        main+=("$m")
+    done
+    launch=($(printf "%s\n" "${launch[@]}" | sort -n))
+    main=($(printf "%s\n" "${main[@]}" | sort -n))
+    echo "${launch[$((RUNS / 2))]} ${launch[$((RUNS - 1))]} ${main[$((RUNS / 2))]}"
+}
+
+# Print "VmRSS VmHWM" in kB after the monitor has settled
+measure_memory() {
+    local binary=$1
+    local pid
+
+    "$binary" --background > /dev/null &
+    pid=$!
+    sleep "$SETTLE_SECONDS"
+    local rss hwm
+    rss=$(awk '/^VmRSS:/ { print $2 }' "/proc/$pid/status")
+    hwm=$(awk '/^VmHWM:/ { print $2 }' "/proc/$pid/status")
+    kill "$pid" 2>/dev/null
+    wait "$pid" 2>/dev/null || true
+    echo "$rss $hwm"
+}
+
+printf "%-10s %14s %14s %12s %10s %10s\n" \
+    "build" "launch_p50_us" "launch_max_us" "main_p50_us" "rss_kb" "hwm_kb"
+
+for variant in dynamic static; do
+    binary="$BUILD_DIR/led_monitor_$variant"
+    read -r launch_p50 launch_max main_p50 <<< "$(startup_stats "$binary")"
+    read -r rss hwm <<< "$(measure_memory "$binary")"
+    printf "%-10s %14s %14s %12s %10s %10s\n" "$variant" \
+        "$launch_p50" "$launch_max" "$main_p50" "$rss" "$hwm"
+done
+
+echo
+printf "%-24s %14s %14s %12s\n" "gpio start-up" "launch_p50_us" "launch_max_us" "main_p50_us"
+
+run_gpio_case() {
+    local label=$1
+    shift
+    read -r launch_p50 launch_max main_p50 <<< "$(startup_stats "$@")"
+    printf "%-24s %14s %14s %12s\n" "$label" "$launch_p50" "$launch_max" "$main_p50"
+}
+
+binary="$BUILD_DIR/led_monitor_static"
+run_gpio_case "sim ${SIM_INIT_MS}ms serial" "$binary" --sim-init-ms "$SIM_INIT_MS" --serial-init
+run_gpio_case "sim ${SIM_INIT_MS}ms threaded" "$binary" --sim-init-ms "$SIM_INIT_MS"
+
+if [ "$REAL_GPIO" = 1 ]; then
+    binary="$BUILD_DIR/led_monitor_real"
+    run_gpio_case "pigpio serial (before)" "$binary" --gpio pigpio --serial-init
+    run_gpio_case "pigpio threaded" "$binary" --gpio pigpio
+    run_gpio_case "gpiomem threaded" "$binary" --gpio gpiomem
+    run_gpio_case "cdev threaded" "$binary" --gpio cdev
+fi
@@ -0,0 +1,384 @@
+/*
+ * Cluster load aggregation over UDP multicast
+ *
+ * Agent:      every node publishes its total and per-core load once per tick
+ *             in a compact datagram (13 bytes + 1 byte per core).
+ * Aggregator: the node with the adapter drains all pending datagrams with
+ *             recvmmsg() once per tick, keeps per-node state in a flat array
+ *             and drives its LED with the cluster-wide activity. With the
+ *             array full, a new node takes the slot of the node silent the
+ *             longest once that one is silent for CLUSTER_EVICT_MS; until
+ *             then its datagrams are refused (and counted).
+ *
+ * Datagram (little endian):
+ *   0  "HUBL" magic        6  sequence (uint16)     12  total load
+ *   4  version (1)         8  node id (uint32)      13+ per-core loads
+ *   5  core count
+ * Loads are 0-200 in 0.5% steps.
+ */
+
+#ifndef CLUSTER_LOAD_H
+#define CLUSTER_LOAD_H
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "activityFilter.h"
+#include "cpuMonitor.h"
+#include "statsSocket.h"
+
+const char* const CLUSTER_DEFAULT_GROUP = "239.255.75.75";
+const int CLUSTER_DEFAULT_PORT = 7575;
+const int CLUSTER_MAX_NODES = 1024;
+const int CLUSTER_INDEX_SIZE = 2048;      // Power of two, > CLUSTER_MAX_NODES
+const uint32_t CLUSTER_EVICT_MS = 10000;  // Well past any clusterLoad() timeout
+const int CLUSTER_BATCH = 64;             // Datagrams per recvmmsg() call
+const int CLUSTER_HEADER_SIZE = 13;
+const int CLUSTER_MAX_DATAGRAM = CLUSTER_HEADER_SIZE + MAX_CPU_CORES;
+const int CLUSTER_RECEIVE_BUFFER = 4 * 1024 * 1024;
+
+inline uint8_t loadToWire(fixed_t load) {
+    if (load <= 0) {
+        return 0;
+    }
+    if (load >= FIXED_100_PERCENT) {
+        return 200;
+    }
+    return (uint8_t)((load * 2 + FIXED_ONE / 2) >> FIXED_SHIFT);
+}
+
+inline fixed_t loadFromWire(uint8_t value) {
+    return (fixed_t)value * (FIXED_ONE / 2);
+}
+
+// FNV-1a of the host name, used as node id unless one is configured
+inline uint32_t defaultNodeId() {
+    char name[256];
+    if (gethostname(name, sizeof(name)) != 0) {
+        return (uint32_t)getpid();
+    }
+    name[sizeof(name) - 1] = '\0';
+    uint32_t hash = 2166136261u;
+    for (const char* p = name; *p; p++) {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+    return hash;
+}
+
+// Destination or bind address; multicast groups are detected automatically
+inline bool clusterAddress(const char* group, int port, struct sockaddr_in& address) {
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    return inet_pton(AF_INET, group, &address.sin_addr) == 1;
+}
+
+// ============================================================================
+// AGENT
+// ============================================================================
+
+class ClusterAgent {
+private:
+    int fd;
+    struct sockaddr_in destination;
+    uint32_t nodeId;
+    uint16_t sequence;
+
+public:
+    ClusterAgent() : fd(-1), nodeId(0), sequence(0) {}
+    ~ClusterAgent() { close(); }
+
+    bool open(const char* group, int port, uint32_t id) {
+        if (!clusterAddress(group, port, destination)) {
+            return false;
+        }
+        fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if (fd < 0) {
+            return false;
+        }
+        // Stay on the local network, and let a local aggregator hear us too
+        unsigned char ttl = 1;
+        unsigned char loop = 1;
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        nodeId = id;
+        return true;
+    }
+
+    void close() {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    // Serialize into buffer (at least CLUSTER_MAX_DATAGRAM bytes), returns the size
+    static int encode(uint8_t* buffer, uint32_t id, uint16_t seq,
+                      fixed_t total, const fixed_t* cores, int coreCount) {
+        if (coreCount > MAX_CPU_CORES) {
+            coreCount = MAX_CPU_CORES;
+        }
+        memcpy(buffer, "HUBL", 4);
+        buffer[4] = 1;
+        buffer[5] = (uint8_t)coreCount;
+        buffer[6] = (uint8_t)(seq & 0xFF);
+        buffer[7] = (uint8_t)(seq >> 8);
+        buffer[8] = (uint8_t)(id & 0xFF);
+        buffer[9] = (uint8_t)((id >> 8) & 0xFF);
+        buffer[10] = (uint8_t)((id >> 16) & 0xFF);
+        buffer[11] = (uint8_t)(id >> 24);
+        buffer[12] = loadToWire(total);
+        for (int i = 0; i < coreCount; i++) {
+            buffer[CLUSTER_HEADER_SIZE + i] = loadToWire(cores[i]);
+        }
+        return CLUSTER_HEADER_SIZE + coreCount;
+    }
+
+    bool publish(fixed_t total, const fixed_t* cores, int coreCount) {
+        uint8_t buffer[CLUSTER_MAX_DATAGRAM];
+        int length = encode(buffer, nodeId, sequence++, total, cores, coreCount);
+        return sendto(fd, buffer, (size_t)length, 0,
+                      (const struct sockaddr*)&destination, sizeof(destination)) == length;
+    }
+};
+
+// ============================================================================
+// AGGREGATOR
+// ============================================================================
+
+struct ClusterNode {
+    uint32_t nodeId;
+    uint32_t lastSeenMs;
+    uint32_t received;
+    uint32_t lost;
+    uint16_t lastSequence;
+    uint8_t coreCount;
+    uint8_t totalLoad;
+    uint8_t coreLoads[MAX_CPU_CORES];
+};
+
+class ClusterAggregator {
+private:
+    int fd;
+    ClusterNode nodes[CLUSTER_MAX_NODES];
+    int usedNodes;
+    uint16_t index[CLUSTER_INDEX_SIZE];  // node + 1, 0 = empty slot
+
+    struct mmsghdr messages[CLUSTER_BATCH];
+    struct iovec vectors[CLUSTER_BATCH];
+    uint8_t buffers[CLUSTER_BATCH][CLUSTER_MAX_DATAGRAM + 1];
+
+    static uint32_t home(uint32_t nodeId) { return (nodeId * 2654435761u) & (CLUSTER_INDEX_SIZE - 1); }
+
+    // Index slot of nodeId, or the empty slot where it would go
+    uint32_t find(uint32_t nodeId) const {
+        uint32_t slot = home(nodeId);
+        while (index[slot] != 0 && nodes[index[slot] - 1].nodeId != nodeId) {
+            slot = (slot + 1) & (CLUSTER_INDEX_SIZE - 1);
+        }
+        return slot;
+    }
+
+    // Remove an entry and shift later ones of the probe run back into the hole
+    void unindex(uint32_t slot) {
+        index[slot] = 0;
+        uint32_t next = (slot + 1) & (CLUSTER_INDEX_SIZE - 1);
+        while (index[next] != 0) {
+            uint32_t wanted = home(nodes[index[next] - 1].nodeId);
+            if (((next - wanted) & (CLUSTER_INDEX_SIZE - 1)) >= ((next - slot) & (CLUSTER_INDEX_SIZE - 1))) {
+                index[slot] = index[next];
+                index[next] = 0;
+                slot = next;
+            }
+            next = (next + 1) & (CLUSTER_INDEX_SIZE - 1);
+        }
+    }
+
+    ClusterNode* findOrAdd(uint32_t nodeId, uint32_t nowMs) {
+        uint32_t slot = find(nodeId);
+        if (index[slot] != 0) {
+            return &nodes[index[slot] - 1];
+        }
+        int position = usedNodes;
+        if (usedNodes >= CLUSTER_MAX_NODES) {
+            // Full: reuse the node silent the longest, if it is gone for good
+            position = 0;
+            for (int i = 1; i < usedNodes; i++) {
+                if (nowMs - nodes[i].lastSeenMs > nowMs - nodes[position].lastSeenMs) {
+                    position = i;
+                }
+            }
+            if (nowMs - nodes[position].lastSeenMs < CLUSTER_EVICT_MS) {
+                refused++;
+                return nullptr;
+            }
+            unindex(find(nodes[position].nodeId));
+            slot = find(nodeId);
+            evicted++;
+        } else {
+            usedNodes++;
+        }
+        ClusterNode* node = &nodes[position];
+        memset(node, 0, sizeof(*node));
+        node->nodeId = nodeId;
+        index[slot] = (uint16_t)(position + 1);
+        return node;
+    }
+
+    void handle(const uint8_t* data, int length, uint32_t nowMs) {
+        if (length < CLUSTER_HEADER_SIZE || memcmp(data, "HUBL", 4) != 0 || data[4] != 1 ||
+            data[5] > MAX_CPU_CORES || length < CLUSTER_HEADER_SIZE + data[5]) {
+            malformed++;
+            return;
+        }
+
+        uint16_t sequence = (uint16_t)(data[6] | (data[7] << 8));
+        uint32_t nodeId = (uint32_t)data[8] | ((uint32_t)data[9] << 8) |
+                          ((uint32_t)data[10] << 16) | ((uint32_t)data[11] << 24);
+
+        ClusterNode* node = findOrAdd(nodeId, nowMs);
+        if (!node) {
+            return;
+        }
+        if (node->received > 0) {
+            uint16_t gap = (uint16_t)(sequence - node->lastSequence - 1);
+            if (gap < 0x8000) {
+                node->lost += gap;
+                lost += gap;
+            }
+        }
+        node->received++;
+        node->lastSequence = sequence;
+        node->lastSeenMs = nowMs;
+        node->coreCount = data[5];
+        node->totalLoad = data[12];
+        memcpy(node->coreLoads, data + CLUSTER_HEADER_SIZE, data[5]);
+        received++;
+    }
+
+public:
+    unsigned long received;
+    unsigned long lost;
+    unsigned long malformed;
+    unsigned long receiveCalls;
+    unsigned long evicted;     // Silent nodes whose slot went to a new one
+    unsigned long refused;     // Datagrams of new nodes with no slot free
+
+    ClusterAggregator()
+        : fd(-1), usedNodes(0), received(0), lost(0), malformed(0), receiveCalls(0), evicted(0), refused(0) {
+        memset(index, 0, sizeof(index));
+        for (int i = 0; i < CLUSTER_BATCH; i++) {
+            vectors[i].iov_base = buffers[i];
+            vectors[i].iov_len = sizeof(buffers[i]);
+        }
+    }
+
+    ~ClusterAggregator() { close(); }
+
+    bool open(const char* group, int port) {
+        struct sockaddr_in address;
+        if (!clusterAddress(group, port, address)) {
+            return false;
+        }
+        fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if (fd < 0) {
+            return false;
+        }
+
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        // Room for a whole tick of datagrams between two polls; FORCE needs root
+        int size = CLUSTER_RECEIVE_BUFFER;
+        if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) != 0) {
+            setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        }
+
+        bool multicast = IN_MULTICAST(ntohl(address.sin_addr.s_addr));
+        struct sockaddr_in bindAddress = address;
+        if (multicast) {
+            bindAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+        }
+        if (bind(fd, (const struct sockaddr*)&bindAddress, sizeof(bindAddress)) != 0) {
+            close();
+            return false;
+        }
+
+        if (multicast) {
+            struct ip_mreq membership;
+            membership.imr_multiaddr = address.sin_addr;
+            membership.imr_interface.s_addr = htonl(INADDR_ANY);
+            if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0) {
+                close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void close() {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    // Drain every pending datagram; returns the number processed
+    int poll(uint32_t nowMs) {
+        int total = 0;
+        for (;;) {
+            for (int i = 0; i < CLUSTER_BATCH; i++) {
+                memset(&messages[i].msg_hdr, 0, sizeof(messages[i].msg_hdr));
+                messages[i].msg_hdr.msg_iov = &vectors[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+            }
+            int count = recvmmsg(fd, messages, CLUSTER_BATCH, MSG_DONTWAIT, nullptr);
+            receiveCalls++;
+            if (count <= 0) {
+                break;
+            }
+            for (int i = 0; i < count; i++) {
+                handle(buffers[i], (int)messages[i].msg_len, nowMs);
+            }
+            total += count;
+            if (count < CLUSTER_BATCH) {
+                break;
+            }
+        }
+        return total;
+    }
+
+    // Mean total load of the nodes heard from within timeoutMs
+    fixed_t clusterLoad(uint32_t nowMs, uint32_t timeoutMs, int& activeNodes) const {
+        uint32_t sum = 0;
+        activeNodes = 0;
+        for (int i = 0; i < usedNodes; i++) {
+            if (nowMs - nodes[i].lastSeenMs <= timeoutMs) {
+                sum += nodes[i].totalLoad;
+                activeNodes++;
+            }
+        }
+        if (activeNodes == 0) {
+            return 0;
+        }
+        return (fixed_t)(((uint64_t)sum * (FIXED_ONE / 2)) / (uint32_t)activeNodes);
+    }
+
+    int nodeCount() const { return usedNodes; }
+
+    void report(StatsReport& out, const char* name) const {
+        out.add(name, "nodes", (unsigned long)usedNodes);
+        out.add(name, "received", received);
+        out.add(name, "lost", lost);
+        out.add(name, "malformed", malformed);
+        out.add(name, "evicted", evicted);
+        out.add(name, "refused", refused);
+    }
+    const ClusterNode& node(int i) const { return nodes[i]; }
+};
+
+#endif // CLUSTER_LOAD_H
@@ -0,0 +1,203 @@
+/*
+ * CPU, memory and temperature sampling from /proc and /sys for the monitors
+ * Files are kept open and re-read with pread() into stack buffers,
+ * so sampling never allocates
+ */
+
+#ifndef CPU_MONITOR_H
+#define CPU_MONITOR_H
+
+#include <string.h>
+#include "activityFilter.h"
+#include "leanIo.h"
+
+const int MAX_CPU_CORES = 8;
+
+// CPU stats structure
+struct CPUStats {
+    unsigned long long user;
+    unsigned long long nice;
+    unsigned long long system;
+    unsigned long long idle;
+    unsigned long long iowait;
+    unsigned long long irq;
+    unsigned long long softirq;
+};
+
+// Read the aggregate "cpu" line into stats[0] and up to maxCores "cpuN" lines
+// into stats[1..]; returns the number of entries read (0 on failure)
+inline int readCPUStats(CPUStats* stats, int maxCores) {
+    static int statFd = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+    if (statFd < 0) {
+        return 0;
+    }
+
+    // The cpu lines come first; the rest of /proc/stat is not needed
+    char buffer[1024];
+    size_t length;
+    if (!readFileAt(statFd, buffer, sizeof(buffer), length)) {
+        return 0;
+    }
+
+    int count = 0;
+    const char* p = buffer;
+    while (count <= maxCores && strncmp(p, "cpu", 3) == 0) {
+        p += 3;
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+
+        CPUStats& entry = stats[count];
+        p = parseUnsigned(p, entry.user);
+        p = parseUnsigned(p, entry.nice);
+        p = parseUnsigned(p, entry.system);
+        p = parseUnsigned(p, entry.idle);
+        p = parseUnsigned(p, entry.iowait);
+        p = parseUnsigned(p, entry.irq);
+        p = parseUnsigned(p, entry.softirq);
+
+        // Ignore a line cut off by the buffer end
+        if (*p == '\0') {
+            break;
+        }
+        count++;
+        p = nextLine(p);
+    }
+
+    return count;
+}
+
+// Load between two samples in fixed-point percent (false if no time passed)
+inline bool loadBetween(const CPUStats& last, const CPUStats& current, fixed_t& load) {
+    unsigned long long last_total = last.user + last.nice + last.system +
+                                    last.idle + last.iowait + last.irq + last.softirq;
+    unsigned long long curr_total = current.user + current.nice + current.system +
+                                    current.idle + current.iowait + current.irq + current.softirq;
+
+    unsigned long long total_diff = curr_total - last_total;
+    unsigned long long idle_diff = (current.idle + current.iowait) - (last.idle + last.iowait);
+
+    if (total_diff == 0) {
+        return false;
+    }
+
+    unsigned long long busy_diff = idle_diff < total_diff ? total_diff - idle_diff : 0;
+    load = fixedLoadFromCounters(busy_diff, total_diff);
+    return true;
+}
+
+// Memory in use (MemTotal - MemAvailable) in fixed-point percent
+inline bool readMemoryUse(fixed_t& used) {
+    static int meminfoFd = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+    if (meminfoFd < 0) {
+        return false;
+    }
+
+    char buffer[256];
+    size_t length;
+    if (!readFileAt(meminfoFd, buffer, sizeof(buffer), length)) {
+        return false;
+    }
+
+    unsigned long long total = 0;
+    unsigned long long available = 0;
+    for (const char* p = buffer; *p; p = nextLine(p)) {
+        if (strncmp(p, "MemTotal:", 9) == 0) {
+            parseUnsigned(p + 9, total);
+        } else if (strncmp(p, "MemAvailable:", 13) == 0) {
+            parseUnsigned(p + 13, available);
+        }
+    }
+
+    if (total == 0 || available > total) {
+        return false;
+    }
+    used = fixedLoadFromCounters(total - available, total);
+    return true;
+}
+
+// SoC temperature in millidegrees Celsius from the first thermal zone
+inline bool readTemperature(int& milliCelsius) {
+    static int thermalFd = open("/sys/class/thermal/thermal_zone0/temp", O_RDONLY | O_CLOEXEC);
+    if (thermalFd < 0) {
+        return false;
+    }
+
+    char buffer[32];
+    size_t length;
+    if (!readFileAt(thermalFd, buffer, sizeof(buffer), length)) {
+        return false;
+    }
+
+    const char* p = buffer;
+    bool negative = *p == '-';
+    unsigned long long value;
+    if (parseUnsigned(negative ? p + 1 : p, value) == (negative ? p + 1 : p)) {
+        return false;
+    }
+    milliCelsius = negative ? -(int)value : (int)value;
+    return true;
+}
+
+// CPU monitor class (optimized for minimal allocations)
+class CPUMonitor {
+private:
+    CPUStats lastStats[MAX_CPU_CORES + 1];
+    ActivityFilter filter;
+    ActivityFilter coreFilters[MAX_CPU_CORES];
+    int cores;
+    uint32_t lastSampleMs;
+    bool initialized;
+
+public:
+    // coreConfig smooths the per-core loads (threshold/hysteresis unused)
+    CPUMonitor(const ActivityFilterConfig& config, const ActivityFilterConfig& coreConfig)
+        : filter(config), cores(0), lastSampleMs(0), initialized(false) {
+        for (int i = 0; i < MAX_CPU_CORES; i++) {
+            coreFilters[i] = ActivityFilter(coreConfig);
+        }
+        int entries = readCPUStats(lastStats, MAX_CPU_CORES);
+        cores = entries > 1 ? entries - 1 : 0;
+    }
+
+    // Returns the filtered CPU load (fixed-point percent) at time nowMs
+    fixed_t getCPULoad(uint32_t nowMs) {
+        CPUStats currentStats[MAX_CPU_CORES + 1];
+        int entries = readCPUStats(currentStats, MAX_CPU_CORES);
+        if (entries == 0) {
+            return filter.value();
+        }
+
+        if (!initialized) {
+            initialized = true;
+            memcpy(lastStats, currentStats, sizeof(CPUStats) * entries);
+            cores = entries - 1;
+            lastSampleMs = nowMs;
+            return 0;
+        }
+
+        uint32_t elapsedMs = nowMs - lastSampleMs;
+
+        fixed_t load;
+        if (!loadBetween(lastStats[0], currentStats[0], load)) {
+            return filter.value();
+        }
+        lastSampleMs = nowMs;
+
+        for (int i = 0; i < cores && i + 1 < entries; i++) {
+            fixed_t coreLoad;
+            if (loadBetween(lastStats[i + 1], currentStats[i + 1], coreLoad)) {
+                coreFilters[i].update(coreLoad, elapsedMs);
+            }
+        }
+
+        memcpy(lastStats, currentStats, sizeof(CPUStats) * entries);
+        return filter.update(load, elapsedMs);
+    }
+
+    bool isActive() const { return filter.isActive(); }
+    int coreCount() const { return cores; }
+    fixed_t coreLoad(int core) const { return coreFilters[core].value(); }
+};
+
+#endif // CPU_MONITOR_H
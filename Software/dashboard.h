@@ -0,0 +1,349 @@
+/*
+ * System dashboard on the matrix
+ *
+ * Shows the total CPU load and the SoC temperature as text, one horizontal
+ * bar per core, and a load sparkline (plus a temperature sparkline when
+ * the panel is tall enough) with one column per DASHBOARD_STEP_MS:
+ *
+ *   CPU 37%           52C
+ *   ==========-------------     core 0
+ *   ====-------------------     core 1
+ *   ...
+ *   load history, newest column on the right
+ *   temperature history
+ *
+ * The canvas is kept between renders and only what changed is touched:
+ * a bar whose length moved draws or clears just the columns between the
+ * old and the new end (bar colors depend on the column, not the load), a
+ * header text is redrawn only when its string changes, and a sparkline
+ * step shifts its rows left by one pixel with memmove() and draws the new
+ * column. render() returns the touched rows as RowDamage for
+ * BitplaneFrame::update(), as SceneGraph does.
+ *
+ *   Dashboard dashboard(config, monitor.coreCount());
+ *   readDashboardSample(monitor, nowMs, sample);
+ *   dashboard.render(canvas, sample, nowMs, damage);
+ *   frame.update(canvas, gamma, damage);
+ */
+
+#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+#include <stdint.h>
+#include <string.h>
+#include "allocGuard.h"
+#include "cpuMonitor.h"
+#include "hub75.h"
+#include "sceneGraph.h"
+
+const uint32_t DASHBOARD_STEP_MS = 1000;     // Time per sparkline column
+const int DASHBOARD_HEADER_ROWS = FONT_HEIGHT + 1;
+const int DASHBOARD_BAR_PITCH = 4;           // Largest rows per core, gap included
+const int DASHBOARD_MIN_SPARK_ROWS = 8;      // Each, for a second sparkline
+const int DASHBOARD_TEMP_LOW = 30000;        // Sparkline bottom, millidegrees
+const int DASHBOARD_TEMP_HIGH = 85000;       // Sparkline top
+const int DASHBOARD_TEMP_WARM = 60000;       // Text turns yellow
+const int DASHBOARD_TEMP_HOT = 75000;        // Text turns red
+const int DASHBOARD_TEXT_SIZE = 16;
+
+struct DashboardSample {
+    fixed_t load;
+    int cores;
+    fixed_t coreLoads[MAX_CPU_CORES];
+    bool hasTemperature;
+    int milliCelsius;
+};
+
+// Sample the monitor and the thermal zone for one render
+inline void readDashboardSample(CPUMonitor& monitor, uint32_t nowMs, DashboardSample& sample) {
+    sample.load = monitor.getCPULoad(nowMs);
+    sample.cores = monitor.coreCount();
+    for (int i = 0; i < sample.cores; i++) {
+        sample.coreLoads[i] = monitor.coreLoad(i);
+    }
+    sample.hasTemperature = readTemperature(sample.milliCelsius);
+}
+
+class Dashboard {
+private:
+    struct Sparkline {
+        Rect area;
+        uint8_t* levels;      // Filled pixels per column, ring of area.w
+        int head;             // Oldest column
+        uint8_t color[3];
+    };
+
+    struct Text {
+        Rect area;
+        char shown[DASHBOARD_TEXT_SIZE];
+        bool rightAligned;
+    };
+
+    MatrixConfig config;
+    int cores;
+    int barTop;
+    int barPitch;
+    int barHeight;
+    int barLengths[MAX_CPU_CORES];   // Drawn columns, -1 before the first render
+    Sparkline sparks[2];
+    int sparkCount;
+    Text texts[2];
+    bool everything;
+    bool started;
+    uint32_t stepStartMs;
+    int64_t loadSum;
+    int64_t temperatureSum;
+    int stepSamples;
+
+    Dashboard(const Dashboard&);
+    Dashboard& operator=(const Dashboard&);
+
+    // Green through yellow to red across the bar width
+    void barColor(int x, uint8_t* color) const {
+        int width = config.width();
+        int along = x * 511 / (width > 1 ? width - 1 : 1);
+        color[0] = (uint8_t)(along < 256 ? along : 255);
+        color[1] = (uint8_t)(along < 256 ? 255 : 511 - along);
+        color[2] = 0;
+    }
+
+    void drawBarColumns(Canvas& canvas, int core, int from, int to) {
+        int top = barTop + core * barPitch;
+        for (int x = from; x < to; x++) {
+            uint8_t color[3];
+            barColor(x, color);
+            canvas.fillRect(x, top, 1, barHeight, color[0], color[1], color[2]);
+        }
+    }
+
+    void clearBarColumns(Canvas& canvas, int core, int from, int to) {
+        // A dim track shows the full scale
+        canvas.fillRect(from, barTop + core * barPitch, to - from, barHeight, 12, 12, 12);
+    }
+
+    void drawText(Canvas& canvas, Text& text, const char* content, const uint8_t* color, RowDamage& damage) {
+        if (!everything && strcmp(text.shown, content) == 0) {
+            return;
+        }
+        strncpy(text.shown, content, sizeof(text.shown) - 1);
+        text.shown[sizeof(text.shown) - 1] = '\0';
+        canvas.fillRect(text.area.x, text.area.y, text.area.w, text.area.h, 0, 0, 0);
+        int x = text.rightAligned ? text.area.x + text.area.w - textWidth(text.shown, 1) : text.area.x;
+        drawString(canvas, text.area, x, text.area.y, text.shown, 1, color);
+        damage.markRows(config, text.area.y, text.area.h);
+        textsDrawn++;
+    }
+
+    void drawSparkColumn(Canvas& canvas, const Sparkline& spark, int x, int level) const {
+        int bottom = spark.area.y + spark.area.h;
+        canvas.fillRect(x, spark.area.y, 1, spark.area.h - level, 0, 0, 0);
+        canvas.fillRect(x, bottom - level, 1, level, spark.color[0], spark.color[1], spark.color[2]);
+    }
+
+    // Shift the sparkline one column left and draw the new level on the right
+    void scroll(Canvas& canvas, Sparkline& spark, int level, RowDamage& damage) {
+        const Rect& area = spark.area;
+        spark.levels[spark.head] = (uint8_t)level;
+        spark.head = spark.head + 1 < area.w ? spark.head + 1 : 0;
+        for (int y = area.y; y < area.y + area.h; y++) {
+            uint8_t* row = canvas.row(y) + (size_t)area.x * 3;
+            memmove(row, row + 3, (size_t)(area.w - 1) * 3);
+        }
+        drawSparkColumn(canvas, spark, area.x + area.w - 1, level);
+        damage.markRows(config, area.y, area.h);
+        columnsScrolled++;
+    }
+
+    void drawSparkline(Canvas& canvas, const Sparkline& spark) const {
+        for (int c = 0; c < spark.area.w; c++) {
+            int index = spark.head + c < spark.area.w ? spark.head + c : spark.head + c - spark.area.w;
+            drawSparkColumn(canvas, spark, spark.area.x + c, spark.levels[index]);
+        }
+    }
+
+    static int levelOf(int64_t value, int64_t low, int64_t high, int rows) {
+        if (value <= low) {
+            return 0;
+        }
+        if (value >= high) {
+            return rows;
+        }
+        return (int)(((value - low) * rows + (high - low) / 2) / (high - low));
+    }
+
+    static char* appendNumber(char* out, int value) {
+        if (value < 0) {
+            *out++ = '-';
+            value = -value;
+        }
+        char digits[12];
+        int count = 0;
+        do {
+            digits[count++] = (char)('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (count > 0) {
+            *out++ = digits[--count];
+        }
+        return out;
+    }
+
+    void drawHeader(Canvas& canvas, const DashboardSample& sample, RowDamage& damage) {
+        static const uint8_t white[3] = { 255, 255, 255 };
+        static const uint8_t green[3] = { 0, 255, 0 };
+        static const uint8_t yellow[3] = { 255, 200, 0 };
+        static const uint8_t red[3] = { 255, 0, 0 };
+
+        char text[DASHBOARD_TEXT_SIZE];
+        char* p = text;
+        memcpy(p, "CPU ", 4);
+        p = appendNumber(p + 4, (int)((sample.load + FIXED_ONE / 2) >> FIXED_SHIFT));
+        *p++ = '%';
+        *p = '\0';
+        drawText(canvas, texts[0], text, white, damage);
+
+        const uint8_t* color = green;
+        if (sample.hasTemperature) {
+            p = appendNumber(text, (sample.milliCelsius + 500) / 1000);
+            color = sample.milliCelsius >= DASHBOARD_TEMP_HOT ? red
+                    : (sample.milliCelsius >= DASHBOARD_TEMP_WARM ? yellow : green);
+        } else {
+            p = text;
+            *p++ = '-';
+            *p++ = '-';
+        }
+        *p++ = 'C';
+        *p = '\0';
+        drawText(canvas, texts[1], text, color, damage);
+    }
+
+public:
+    unsigned long renders;          // render() calls that touched the canvas
+    unsigned long barsDrawn;        // Bar updates, one per changed bar
+    unsigned long columnsScrolled;  // Sparkline steps
+    unsigned long textsDrawn;
+
+    // Layout for config.width() x config.height() with coreCount bars
+    Dashboard(const MatrixConfig& cfg, int coreCount)
+        : config(cfg), cores(coreCount < MAX_CPU_CORES ? coreCount : MAX_CPU_CORES), sparkCount(0),
+          everything(true), started(false), stepStartMs(0), loadSum(0), temperatureSum(0), stepSamples(0), renders(0),
+          barsDrawn(0), columnsScrolled(0), textsDrawn(0) {
+        const int width = config.width();
+        const int height = config.height();
+        cores = cores > 0 ? cores : 0;
+
+        int half = width / 2;
+        texts[0] = { { 0, 0, half, FONT_HEIGHT }, "", false };
+        texts[1] = { { half, 0, width - half, FONT_HEIGHT }, "", true };
+
+        barTop = DASHBOARD_HEADER_ROWS;
+        barPitch = cores > 0 ? (height - barTop) / 2 / cores : 1;
+        barPitch = barPitch > DASHBOARD_BAR_PITCH ? DASHBOARD_BAR_PITCH : (barPitch < 1 ? 1 : barPitch);
+        barHeight = barPitch > 1 ? barPitch - 1 : 1;
+        for (int i = 0; i < MAX_CPU_CORES; i++) {
+            barLengths[i] = -1;
+        }
+
+        int sparkTop = barTop + cores * barPitch + (cores > 0 && barPitch == 1 ? 1 : 0);
+        int sparkRows = height - sparkTop;
+        static const uint8_t colors[2][3] = { { 0, 160, 255 }, { 255, 100, 0 } };
+        if (sparkRows >= 2 * DASHBOARD_MIN_SPARK_ROWS + 1) {
+            sparkCount = 2;
+            int first = (sparkRows - 1) / 2;
+            sparks[0].area = { 0, sparkTop, width, first };
+            sparks[1].area = { 0, sparkTop + first + 1, width, sparkRows - first - 1 };
+        } else if (sparkRows > 0) {
+            sparkCount = 1;
+            sparks[0].area = { 0, sparkTop, width, sparkRows };
+        }
+        for (int s = 0; s < sparkCount; s++) {
+            sparks[s].levels = new uint8_t[width];
+            memset(sparks[s].levels, 0, (size_t)width);
+            sparks[s].head = 0;
+            memcpy(sparks[s].color, colors[s], 3);
+        }
+    }
+
+    ~Dashboard() {
+        for (int s = 0; s < sparkCount; s++) {
+            delete[] sparks[s].levels;
+        }
+    }
+
+    // Redraw everything on the next render (new canvas, lost content)
+    void invalidateAll() { everything = true; }
+
+    int sparklines() const { return sparkCount; }
+    const Rect& sparklineArea(int s) const { return sparks[s].area; }
+    int barRows() const { return barPitch; }
+
+    // Bring canvas (config.width() x config.height(), kept between calls)
+    // to sample at nowMs and add the touched rows to damage; false if
+    // nothing changed. Sparklines take the mean of the samples of a step.
+    bool render(Canvas& canvas, const DashboardSample& sample, uint32_t nowMs, RowDamage& damage) {
+        AllocScope scope(ALLOC_SCOPE_RENDER);
+        RowDamage touched;
+        if (everything) {
+            canvas.fillRect(0, 0, config.width(), config.height(), 0, 0, 0);
+            for (int s = 0; s < sparkCount; s++) {
+                drawSparkline(canvas, sparks[s]);
+            }
+            for (int i = 0; i < MAX_CPU_CORES; i++) {
+                barLengths[i] = -1;
+            }
+            touched.markAll(config);
+        }
+        if (!started) {
+            started = true;
+            stepStartMs = nowMs;
+        }
+        drawHeader(canvas, sample, touched);
+
+        const int width = config.width();
+        for (int i = 0; i < cores && i < sample.cores; i++) {
+            fixed_t load = sample.coreLoads[i] < FIXED_100_PERCENT ? sample.coreLoads[i] : FIXED_100_PERCENT;
+            int length = (int)(((int64_t)(load > 0 ? load : 0) * width + FIXED_100_PERCENT / 2) / FIXED_100_PERCENT);
+            int shown = barLengths[i];
+            if (length == shown) {
+                continue;
+            }
+            if (shown < 0) {
+                drawBarColumns(canvas, i, 0, length);
+                clearBarColumns(canvas, i, length, width);
+            } else if (length > shown) {
+                drawBarColumns(canvas, i, shown, length);
+            } else {
+                clearBarColumns(canvas, i, length, shown);
+            }
+            barLengths[i] = length;
+            touched.markRows(config, barTop + i * barPitch, barHeight);
+            barsDrawn++;
+        }
+
+        loadSum += sample.load;
+        temperatureSum += sample.hasTemperature ? sample.milliCelsius : DASHBOARD_TEMP_LOW;
+        stepSamples++;
+        if (nowMs - stepStartMs >= DASHBOARD_STEP_MS) {
+            int64_t values[2] = { loadSum / stepSamples, temperatureSum / stepSamples };
+            int64_t lows[2] = { 0, DASHBOARD_TEMP_LOW };
+            int64_t highs[2] = { FIXED_100_PERCENT, DASHBOARD_TEMP_HIGH };
+            for (int s = 0; s < sparkCount; s++) {
+                scroll(canvas, sparks[s], levelOf(values[s], lows[s], highs[s], sparks[s].area.h), touched);
+            }
+            stepStartMs += DASHBOARD_STEP_MS * ((nowMs - stepStartMs) / DASHBOARD_STEP_MS);
+            loadSum = 0;
+            temperatureSum = 0;
+            stepSamples = 0;
+        }
+
+        everything = false;
+        if (!touched.any()) {
+            return false;
+        }
+        damage.merge(touched);
+        renders++;
+        return true;
+    }
+};
+
+#endif // DASHBOARD_H
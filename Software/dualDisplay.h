@@ -0,0 +1,266 @@
+/*
+ * P0 and P1 as two independent logical displays
+ *
+ * The chains share CLOCK, STROBE, OE and the row lines, so they are always
+ * scanned together from one BitplaneFrame, but each chain is its own sign:
+ * a LogicalDisplay with its own canvas, buffer swaps and frame rate.
+ *
+ * The two halves only meet at conversion. Each of the two BitplaneFrames
+ * remembers which canvas generation of every chain its bits hold, and
+ * update() reconverts just the chains that were swapped since; a static
+ * sign next to an animated one is converted once per frame buffer and
+ * never again.
+ *
+ *   render thread(s)   LogicalDisplay::canvas() ... swap()
+ *   converter thread   DualDisplay::update()   (or start() for a built-in one)
+ *   scan thread        DualDisplay::frameToScan() before every frame
+ */
+
+#ifndef DUAL_DISPLAY_H
+#define DUAL_DISPLAY_H
+
+#include <atomic>
+#include <pthread.h>
+#include "hub75.h"
+#include "leanIo.h"
+#include "statsSocket.h"
+
+// ============================================================================
+// LOGICAL DISPLAY - one chain, triple-buffered canvas
+// ============================================================================
+
+class LogicalDisplay {
+private:
+    Canvas* drawing;     // Owned by the render thread
+    Canvas* ready;       // Latest swapped content
+    Canvas* converting;  // Owned by the converter
+    uint32_t generation;
+    uint32_t taken;      // Generation held by `converting`
+    pthread_mutex_t lock;
+    pthread_mutex_t* notifyLock;  // Converter wake-up, may be null
+    pthread_cond_t* notify;
+
+    LogicalDisplay(const LogicalDisplay&);
+    LogicalDisplay& operator=(const LogicalDisplay&);
+
+public:
+    unsigned long swaps;
+
+    LogicalDisplay(int width, int height, pthread_mutex_t* changedLock, pthread_cond_t* changed)
+        : drawing(new Canvas(width, height)), ready(new Canvas(width, height)),
+          converting(new Canvas(width, height)), generation(0), taken(0), notifyLock(changedLock),
+          notify(changed), swaps(0) {
+        pthread_mutex_init(&lock, nullptr);
+    }
+
+    ~LogicalDisplay() {
+        delete drawing;
+        delete ready;
+        delete converting;
+        pthread_mutex_destroy(&lock);
+    }
+
+    // Canvas to draw the next frame into; after swap() it holds older
+    // content and must be redrawn completely
+    Canvas& canvas() { return *drawing; }
+
+    // Publish the drawn frame; never waits for conversion or scan-out
+    void swap() {
+        pthread_mutex_lock(&lock);
+        Canvas* swapped = ready;
+        ready = drawing;
+        drawing = swapped;
+        generation++;
+        swaps++;
+        pthread_mutex_unlock(&lock);
+        if (notify) {
+            pthread_mutex_lock(notifyLock);
+            pthread_cond_signal(notify);
+            pthread_mutex_unlock(notifyLock);
+        }
+    }
+
+    // Converter side: latest content and its generation
+    const Canvas& take(uint32_t& takenGeneration) {
+        pthread_mutex_lock(&lock);
+        if (taken != generation) {
+            Canvas* swapped = converting;
+            converting = ready;
+            ready = swapped;
+            taken = generation;
+        }
+        takenGeneration = taken;
+        pthread_mutex_unlock(&lock);
+        return *converting;
+    }
+
+    bool changedSince(uint32_t knownGeneration) {
+        pthread_mutex_lock(&lock);
+        bool changed = generation != knownGeneration;
+        pthread_mutex_unlock(&lock);
+        return changed;
+    }
+};
+
+// ============================================================================
+// DUAL DISPLAY
+// ============================================================================
+
+class DualDisplay {
+private:
+    MatrixConfig config;
+    GammaTable gamma;
+    pthread_mutex_t wakeLock;
+    pthread_cond_t wake;
+    LogicalDisplay* displays[HUB75_CHAINS];
+    BitplaneFrame* frames[2];
+    uint32_t frameGenerations[2][HUB75_CHAINS];  // Canvas generation in each frame's bits
+    uint32_t latestGenerations[HUB75_CHAINS];     // Generation in the published frame
+    int back;                                     // Frame being built
+    std::atomic<BitplaneFrame*> published;
+    std::atomic<BitplaneFrame*> scanning;
+    pthread_t thread;
+    bool threadStarted;
+    volatile bool stopping;
+
+    DualDisplay(const DualDisplay&);
+    DualDisplay& operator=(const DualDisplay&);
+
+    static void* converterThread(void* arg) {
+        DualDisplay* self = (DualDisplay*)arg;
+        pthread_mutex_lock(&self->wakeLock);
+        while (!self->stopping) {
+            pthread_mutex_unlock(&self->wakeLock);
+            bool published = self->update();
+            pthread_mutex_lock(&self->wakeLock);
+            if (!published && !self->stopping) {
+                pthread_cond_wait(&self->wake, &self->wakeLock);
+            }
+        }
+        pthread_mutex_unlock(&self->wakeLock);
+        return nullptr;
+    }
+
+public:
+    unsigned long conversions[HUB75_CHAINS];
+    unsigned long framesPublished;
+    uint64_t convertNs;
+
+    // config.parallel chains become config.parallel logical displays
+    DualDisplay(const MatrixConfig& cfg, double gammaValue)
+        : config(cfg), back(1), published(nullptr), scanning(nullptr), threadStarted(false),
+          stopping(false), framesPublished(0), convertNs(0) {
+        gamma.build(cfg.planes, gammaValue);
+        pthread_mutex_init(&wakeLock, nullptr);
+        pthread_cond_init(&wake, nullptr);
+        for (int chain = 0; chain < HUB75_CHAINS; chain++) {
+            displays[chain] = nullptr;
+            if (chain < cfg.parallel) {
+                displays[chain] = new LogicalDisplay(cfg.width(), cfg.panelRows, &wakeLock, &wake);
+            }
+            conversions[chain] = 0;
+            latestGenerations[chain] = 0;
+        }
+        for (int i = 0; i < 2; i++) {
+            frames[i] = new BitplaneFrame(cfg);
+            frames[i]->plan();
+            for (int chain = 0; chain < HUB75_CHAINS; chain++) {
+                frameGenerations[i][chain] = 0;
+            }
+        }
+        published.store(frames[0]);
+        scanning.store(frames[0]);
+    }
+
+    ~DualDisplay() {
+        stop();
+        for (int chain = 0; chain < HUB75_CHAINS; chain++) {
+            delete displays[chain];
+        }
+        delete frames[0];
+        delete frames[1];
+        pthread_cond_destroy(&wake);
+        pthread_mutex_destroy(&wakeLock);
+    }
+
+    LogicalDisplay& display(int chain) { return *displays[chain]; }
+
+    // Stats socket source; counters may be one update behind
+    void report(StatsReport& out, const char* name) const {
+        char chainName[STATS_NAME_SIZE];
+        for (int chain = 0; chain < config.parallel; chain++) {
+            statsName(chainName, name, chain);
+            out.add(chainName, "swaps", displays[chain]->swaps);
+            out.add(chainName, "conversions", conversions[chain]);
+        }
+        out.add(name, "frames_published", framesPublished);
+        out.add(name, "convert_ns", (unsigned long)convertNs);
+    }
+
+    // Bring the back frame up to date with every swapped display and publish
+    // it; false if nothing changed or the scanner still holds the back frame
+    bool update() {
+        bool changed = false;
+        for (int chain = 0; chain < config.parallel; chain++) {
+            changed = changed || displays[chain]->changedSince(latestGenerations[chain]);
+        }
+        if (!changed || scanning.load(std::memory_order_acquire) == frames[back]) {
+            return false;
+        }
+
+        uint64_t start = monotonicNs();
+        BitplaneFrame* frame = frames[back];
+        for (int chain = 0; chain < config.parallel; chain++) {
+            uint32_t generation;
+            const Canvas& canvas = displays[chain]->take(generation);
+            // Only halves this frame has not seen yet; the other chain's bits stay
+            if (frameGenerations[back][chain] != generation) {
+                frame->convertChain(canvas, chain, gamma);
+                frameGenerations[back][chain] = generation;
+                conversions[chain]++;
+            }
+            latestGenerations[chain] = generation;
+        }
+        frame->plan();
+        convertNs += monotonicNs() - start;
+
+        published.store(frame, std::memory_order_release);
+        back ^= 1;
+        framesPublished++;
+        return true;
+    }
+
+    // Scan thread: frame to show next; marks it as in use
+    const BitplaneFrame& frameToScan() {
+        BitplaneFrame* frame = published.load(std::memory_order_acquire);
+        if (scanning.load(std::memory_order_relaxed) != frame) {
+            scanning.store(frame, std::memory_order_release);
+            // The old frame may be the converter's next back frame
+            pthread_mutex_lock(&wakeLock);
+            pthread_cond_signal(&wake);
+            pthread_mutex_unlock(&wakeLock);
+        }
+        return *frame;
+    }
+
+    // Optional converter thread woken by swaps
+    bool start() {
+        stopping = false;
+        threadStarted = pthread_create(&thread, nullptr, converterThread, this) == 0;
+        return threadStarted;
+    }
+
+    void stop() {
+        if (!threadStarted) {
+            return;
+        }
+        pthread_mutex_lock(&wakeLock);
+        stopping = true;
+        pthread_cond_signal(&wake);
+        pthread_mutex_unlock(&wakeLock);
+        pthread_join(thread, nullptr);
+        threadStarted = false;
+    }
+};
+
+#endif // DUAL_DISPLAY_H
@@ -0,0 +1,232 @@
+/*
+ * Per-frame scratch memory for rendering and compositing
+ *
+ * FrameArena - bump allocator over one block reserved at start-up; every
+ *              allocation is a pointer increment and reset() at the frame
+ *              boundary frees them all at once. Pages are touched up front,
+ *              so the first frames do not fault either.
+ * ArenaSet   - one arena per worker thread, reset together
+ * ObjectPool - fixed number of fixed-size objects (layers, glyph entries)
+ *              with an intrusive free list
+ *
+ * None of them ever fall back to the heap: an exhausted arena or pool
+ * returns nullptr and counts a failure, so a frame that needs more scratch
+ * than configured shows up in the stats instead of as fragmentation after
+ * weeks of uptime. High-water marks are kept for sizing the capacities and
+ * can be read from another thread (the stats socket) at any time.
+ */
+
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <atomic>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "statsSocket.h"
+
+const size_t ARENA_ALIGNMENT = 16;  // Enough for the SIMD conversion kernels
+
+// ============================================================================
+// FRAME ARENA
+// ============================================================================
+
+class FrameArena {
+private:
+    uint8_t* memory;
+    size_t capacity;
+    size_t used;                          // Owner thread only
+    std::atomic<size_t> peak;             // Largest frame so far
+    std::atomic<size_t> lastFrame;
+    std::atomic<unsigned long> failures;
+    std::atomic<unsigned long> frames;
+
+    FrameArena(const FrameArena&);
+    FrameArena& operator=(const FrameArena&);
+
+    // Matches the aligned new[] in reserve()
+    void release() {
+        ::operator delete[](memory, std::align_val_t(ARENA_ALIGNMENT));
+        memory = nullptr;
+    }
+
+    void notePeak() {
+        if (used > peak.load(std::memory_order_relaxed)) {
+            peak.store(used, std::memory_order_relaxed);
+        }
+    }
+
+public:
+    explicit FrameArena(size_t bytes = 0) : memory(nullptr), capacity(0), used(0), peak(0), lastFrame(0),
+                                            failures(0), frames(0) {
+        if (bytes > 0) {
+            reserve(bytes);
+        }
+    }
+
+    ~FrameArena() { release(); }
+
+    // Set-up time only; drops everything allocated so far
+    void reserve(size_t bytes) {
+        release();
+        capacity = (bytes + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+        memory = new (std::align_val_t(ARENA_ALIGNMENT)) uint8_t[capacity];
+        memset(memory, 0, capacity);
+        used = 0;
+    }
+
+    // Aligned scratch valid until the next reset(), nullptr when exhausted
+    void* allocate(size_t bytes, size_t alignment = ARENA_ALIGNMENT) {
+        size_t start = (used + alignment - 1) & ~(alignment - 1);
+        if (start + bytes > capacity) {
+            failures.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        used = start + bytes;
+        return memory + start;
+    }
+
+    template <class T>
+    T* allocateArray(size_t count) {
+        return (T*)allocate(count * sizeof(T), alignof(T) > ARENA_ALIGNMENT ? alignof(T) : ARENA_ALIGNMENT);
+    }
+
+    // Nested temporaries: rewind(mark()) frees everything allocated since
+    size_t mark() const { return used; }
+
+    void rewind(size_t position) {
+        notePeak();
+        used = position;
+    }
+
+    // Frame boundary: all pointers handed out become invalid
+    void reset() {
+        notePeak();
+        lastFrame.store(used, std::memory_order_relaxed);
+        frames.fetch_add(1, std::memory_order_relaxed);
+        used = 0;
+    }
+
+    size_t bytesUsed() const { return used; }
+    size_t bytesReserved() const { return capacity; }
+    size_t highWater() const { return peak.load(std::memory_order_relaxed); }
+    unsigned long failureCount() const { return failures.load(std::memory_order_relaxed); }
+
+    void report(StatsReport& out, const char* name) const {
+        out.add(name, "capacity", capacity);
+        out.add(name, "high_water", highWater());
+        out.add(name, "last_frame", lastFrame.load(std::memory_order_relaxed));
+        out.add(name, "frames", frames.load(std::memory_order_relaxed));
+        out.add(name, "failures", failureCount());
+    }
+};
+
+// ============================================================================
+// ARENA SET - one arena per worker
+// ============================================================================
+
+const int ARENA_MAX_WORKERS = 4;
+
+class ArenaSet {
+private:
+    FrameArena arenas[ARENA_MAX_WORKERS];
+    int count;
+
+public:
+    ArenaSet(int workers, size_t bytesPerWorker) : count(workers < ARENA_MAX_WORKERS ? workers : ARENA_MAX_WORKERS) {
+        for (int i = 0; i < count; i++) {
+            arenas[i].reserve(bytesPerWorker);
+        }
+    }
+
+    int workers() const { return count; }
+    FrameArena& worker(int index) { return arenas[index]; }
+
+    // Frame boundary, once every worker is done with the frame
+    void reset() {
+        for (int i = 0; i < count; i++) {
+            arenas[i].reset();
+        }
+    }
+
+    void report(StatsReport& out, const char* name) const {
+        char workerName[STATS_NAME_SIZE];
+        for (int i = 0; i < count; i++) {
+            statsName(workerName, name, i);
+            arenas[i].report(out, workerName);
+        }
+    }
+};
+
+// ============================================================================
+// OBJECT POOL
+// ============================================================================
+
+template <class T>
+class ObjectPool {
+private:
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char object[sizeof(T)];
+    };
+
+    Slot* slots;
+    Slot* freeList;
+    int capacity;
+    int inUse;                            // Owner thread only
+    std::atomic<int> peak;
+    std::atomic<unsigned long> failures;
+
+    ObjectPool(const ObjectPool&);
+    ObjectPool& operator=(const ObjectPool&);
+
+public:
+    explicit ObjectPool(int objects) : slots(new Slot[(size_t)objects]), freeList(nullptr), capacity(objects),
+                                       inUse(0), peak(0), failures(0) {
+        for (int i = objects - 1; i >= 0; i--) {
+            slots[i].next = freeList;
+            freeList = &slots[i];
+        }
+    }
+
+    ~ObjectPool() { delete[] slots; }
+
+    // Constructed in place, nullptr when the pool is exhausted
+    template <class... Args>
+    T* create(Args&&... args) {
+        if (!freeList) {
+            failures.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Slot* slot = freeList;
+        freeList = slot->next;
+        if (++inUse > peak.load(std::memory_order_relaxed)) {
+            peak.store(inUse, std::memory_order_relaxed);
+        }
+        return new (slot->object) T(static_cast<Args&&>(args)...);
+    }
+
+    void destroy(T* object) {
+        if (!object) {
+            return;
+        }
+        object->~T();
+        Slot* slot = (Slot*)(void*)object;
+        slot->next = freeList;
+        freeList = slot;
+        inUse--;
+    }
+
+    int size() const { return inUse; }
+    int highWater() const { return peak.load(std::memory_order_relaxed); }
+    unsigned long failureCount() const { return failures.load(std::memory_order_relaxed); }
+
+    void report(StatsReport& out, const char* name) const {
+        out.add(name, "capacity", (unsigned long)capacity);
+        out.add(name, "high_water", (unsigned long)highWater());
+        out.add(name, "failures", failureCount());
+    }
+};
+
+#endif // FRAME_ARENA_H
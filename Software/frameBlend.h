@@ -0,0 +1,303 @@
+/*
+ * Motion smoothing for low-rate content
+ *
+ * Content arriving at 10-15 fps (network streams, slow renderers) steps
+ * visibly on a panel refreshed at 200 Hz and more. FrameBlender shows a
+ * crossfade of the last two submitted frames instead: a frame submitted
+ * one source interval after the previous one is faded in over the next
+ * interval, so motion is continuous and one source frame late.
+ *
+ * The blend works on packed bytes, two channels per 32-bit lane with the
+ * 0x00FF00FF split, four lanes at a time with the GCC vector extensions of
+ * the conversion kernels (-DHUB75_NO_SIMD for scalar). Every blended
+ * canvas is converted with BitplaneFrame::build() for all chains and
+ * handed to the scan thread as in DualDisplay.
+ *
+ * Blend and conversion cost a full frame build per blended frame, so they
+ * are capped twice: blend positions are quantized to settings.steps per
+ * source frame, and after each blended frame the converter rests until
+ * its share of one core is back under settings.cpuPercent. When the cap
+ * bites, fewer, larger steps are shown; the fade still ends on time.
+ *
+ *   render thread   FrameBlender::canvas() ... submit()
+ *   converter       FrameBlender::update(nowNs)   (or start() for a built-in one)
+ *   scan thread     FrameBlender::frameToScan() before every frame
+ */
+
+#ifndef FRAME_BLEND_H
+#define FRAME_BLEND_H
+
+#include <atomic>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include "dualDisplay.h"
+#include "hub75.h"
+#include "leanIo.h"
+#include "statsSocket.h"
+
+struct BlendSettings {
+    int steps;               // Blend positions per source frame, 1 = switch at once
+    int cpuPercent;          // Share of one core for blending and conversion
+    uint32_t maxIntervalMs;  // Longer gaps (a paused source) switch at once
+};
+
+const BlendSettings DEFAULT_BLEND_SETTINGS = { 16, 25, 250 };
+
+// out = a + (b - a) * alpha / 256 for every byte, alpha 0..256; exact at
+// both ends, so 0 gives a and 256 gives b
+inline void blendBytes(uint8_t* out, const uint8_t* a, const uint8_t* b, size_t bytes, uint32_t alpha) {
+    const uint32_t beta = 256 - alpha;
+    const uint32_t low = 0x00FF00FF;
+    const uint32_t round = 0x00800080;
+    size_t i = 0;
+#ifndef HUB75_NO_SIMD
+    const size_t vectorBytes = sizeof(Hub75Vector);
+    for (; i + vectorBytes <= bytes; i += vectorBytes) {
+        Hub75Vector va;
+        Hub75Vector vb;
+        memcpy(&va, a + i, vectorBytes);
+        memcpy(&vb, b + i, vectorBytes);
+        Hub75Vector even = (((va & low) * beta + (vb & low) * alpha + round) >> 8) & low;
+        Hub75Vector odd = (((va >> 8) & low) * beta + ((vb >> 8) & low) * alpha + round) & ~low;
+        Hub75Vector mixed = even | odd;
+        memcpy(out + i, &mixed, vectorBytes);
+    }
+#endif
+    for (; i + sizeof(uint32_t) <= bytes; i += sizeof(uint32_t)) {
+        uint32_t wa;
+        uint32_t wb;
+        memcpy(&wa, a + i, sizeof(wa));
+        memcpy(&wb, b + i, sizeof(wb));
+        uint32_t even = (((wa & low) * beta + (wb & low) * alpha + round) >> 8) & low;
+        uint32_t odd = (((wa >> 8) & low) * beta + ((wb >> 8) & low) * alpha + round) & ~low;
+        uint32_t mixed = even | odd;
+        memcpy(out + i, &mixed, sizeof(mixed));
+    }
+    for (; i < bytes; i++) {
+        out[i] = (uint8_t)((a[i] * beta + b[i] * alpha + 128) >> 8);
+    }
+}
+
+class FrameBlender {
+private:
+    MatrixConfig config;
+    GammaTable gamma;
+    BlendSettings settings;
+    pthread_mutex_t wakeLock;
+    pthread_cond_t wake;
+    LogicalDisplay source;
+    Canvas* from;          // Older of the two latest source frames
+    Canvas* to;            // Newest source frame
+    Canvas* mixed;
+    bool haveFrames;
+    uint32_t sourceGeneration;
+    uint64_t arrivalNs;    // When `to` was taken
+    uint64_t intervalNs;   // Fade length, 0 = show `to` at once
+    int shownStep;         // Blend position in the published frame, -1 = none
+    uint64_t restUntilNs;  // CPU cap: no blended frame before this
+    BitplaneFrame* frames[2];
+    int back;
+    std::atomic<BitplaneFrame*> published;
+    std::atomic<BitplaneFrame*> scanning;
+    pthread_t thread;
+    bool threadStarted;
+    volatile bool stopping;
+
+    FrameBlender(const FrameBlender&);
+    FrameBlender& operator=(const FrameBlender&);
+
+    size_t canvasBytes() const { return (size_t)config.width() * config.height() * 3; }
+
+    // Position of the fade at nowNs, 0..settings.steps
+    int stepAt(uint64_t nowNs) const {
+        if (intervalNs == 0 || nowNs - arrivalNs >= intervalNs) {
+            return settings.steps;
+        }
+        return (int)((nowNs - arrivalNs) * (uint64_t)settings.steps / intervalNs);
+    }
+
+    // When update() has something to do next, 0 = only after a submit()
+    uint64_t nextWorkNs() const {
+        if (!haveFrames || shownStep == settings.steps) {
+            return 0;
+        }
+        uint64_t stepNs = arrivalNs + intervalNs * (uint64_t)(shownStep + 1) / (uint64_t)settings.steps;
+        return stepNs > restUntilNs ? stepNs : restUntilNs;
+    }
+
+    static void* converterThread(void* arg) {
+        FrameBlender* self = (FrameBlender*)arg;
+        pthread_mutex_lock(&self->wakeLock);
+        while (!self->stopping) {
+            pthread_mutex_unlock(&self->wakeLock);
+            self->update(monotonicNs());
+            uint64_t nextNs = self->nextWorkNs();
+            pthread_mutex_lock(&self->wakeLock);
+            if (self->stopping || self->source.changedSince(self->sourceGeneration)) {
+                continue;
+            }
+            // Due but not done: the scanner still holds the back frame and
+            // signals when it lets go
+            bool held = self->scanning.load(std::memory_order_acquire) == self->frames[self->back];
+            uint64_t nowNs = monotonicNs();
+            if (nextNs == 0 || (nextNs <= nowNs && held)) {
+                pthread_cond_wait(&self->wake, &self->wakeLock);
+            } else if (nextNs > nowNs) {
+                struct timespec until;
+                until.tv_sec = (time_t)(nextNs / 1000000000u);
+                until.tv_nsec = (long)(nextNs % 1000000000u);
+                pthread_cond_timedwait(&self->wake, &self->wakeLock, &until);
+            }
+        }
+        pthread_mutex_unlock(&self->wakeLock);
+        return nullptr;
+    }
+
+public:
+    unsigned long sourceFrames;     // Submitted frames taken for blending
+    unsigned long framesPublished;  // Blended (or final) frames converted
+    unsigned long cappedSteps;      // Updates held back by the CPU cap
+    uint64_t blendNs;
+    uint64_t convertNs;
+
+    FrameBlender(const MatrixConfig& cfg, double gammaValue, const BlendSettings& blendSettings)
+        : config(cfg), settings(blendSettings), source(cfg.width(), cfg.height(), &wakeLock, &wake),
+          from(new Canvas(cfg.width(), cfg.height())), to(new Canvas(cfg.width(), cfg.height())),
+          mixed(new Canvas(cfg.width(), cfg.height())), haveFrames(false), sourceGeneration(0), arrivalNs(0),
+          intervalNs(0), shownStep(-1), restUntilNs(0), back(1), published(nullptr), scanning(nullptr),
+          threadStarted(false), stopping(false), sourceFrames(0), framesPublished(0), cappedSteps(0), blendNs(0),
+          convertNs(0) {
+        gamma.build(cfg.planes, gammaValue);
+        settings.steps = settings.steps < 1 ? 1 : (settings.steps > 256 ? 256 : settings.steps);
+        settings.cpuPercent = settings.cpuPercent < 1 ? 1 : (settings.cpuPercent > 100 ? 100 : settings.cpuPercent);
+        pthread_mutex_init(&wakeLock, nullptr);
+        pthread_condattr_t attributes;
+        pthread_condattr_init(&attributes);
+        pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+        pthread_cond_init(&wake, &attributes);
+        pthread_condattr_destroy(&attributes);
+        for (int i = 0; i < 2; i++) {
+            frames[i] = new BitplaneFrame(cfg);
+            frames[i]->plan();
+        }
+        published.store(frames[0]);
+        scanning.store(frames[0]);
+    }
+
+    ~FrameBlender() {
+        stop();
+        delete from;
+        delete to;
+        delete mixed;
+        delete frames[0];
+        delete frames[1];
+        pthread_cond_destroy(&wake);
+        pthread_mutex_destroy(&wakeLock);
+    }
+
+    // Render thread: canvas for the next source frame, redrawn completely
+    Canvas& canvas() { return source.canvas(); }
+
+    // Publish the drawn frame; never waits for blending or scan-out
+    void submit() { source.swap(); }
+
+    // Stats socket source; counters may be one update behind
+    void report(StatsReport& out, const char* name) const {
+        out.add(name, "source_frames", sourceFrames);
+        out.add(name, "frames_published", framesPublished);
+        out.add(name, "capped_steps", cappedSteps);
+        out.add(name, "blend_ns", (unsigned long)blendNs);
+        out.add(name, "convert_ns", (unsigned long)convertNs);
+    }
+
+    // Take a new source frame if there is one and publish the fade position
+    // at nowNs (monotonicNs() time); false if nothing new was published
+    bool update(uint64_t nowNs) {
+        if (source.changedSince(sourceGeneration)) {
+            uint32_t generation;
+            const Canvas& latest = source.take(generation);
+            // Fade from the newest frame so far; a frame arriving mid-fade
+            // makes the rest of the old fade jump
+            Canvas* older = from;
+            from = to;
+            to = older;
+            memcpy(to->row(0), latest.row(0), canvasBytes());
+            uint64_t gap = haveFrames ? nowNs - arrivalNs : 0;
+            intervalNs = gap <= (uint64_t)settings.maxIntervalMs * 1000000u ? gap : 0;
+            haveFrames = true;
+            arrivalNs = nowNs;
+            sourceGeneration = generation;
+            shownStep = -1;
+            sourceFrames++;
+        }
+        if (!haveFrames) {
+            return false;
+        }
+        int step = stepAt(nowNs);
+        if (step == shownStep || scanning.load(std::memory_order_acquire) == frames[back]) {
+            return false;
+        }
+        if (nowNs < restUntilNs) {
+            cappedSteps++;
+            return false;
+        }
+
+        uint64_t start = monotonicNs();
+        const Canvas* shown = to;
+        if (step < settings.steps) {
+            AllocScope scope(ALLOC_SCOPE_RENDER);
+            blendBytes(mixed->row(0), from->row(0), to->row(0), canvasBytes(),
+                       (uint32_t)(step * 256 / settings.steps));
+            shown = mixed;
+        }
+        uint64_t blended = monotonicNs();
+        BitplaneFrame* frame = frames[back];
+        frame->build(*shown, gamma);
+        uint64_t end = monotonicNs();
+        blendNs += blended - start;
+        convertNs += end - blended;
+
+        // Rest so that work / (work + rest) stays at cpuPercent
+        restUntilNs = nowNs + (end - start) * 100u / (uint64_t)settings.cpuPercent;
+        shownStep = step;
+        published.store(frame, std::memory_order_release);
+        back ^= 1;
+        framesPublished++;
+        return true;
+    }
+
+    // Scan thread: frame to show next; marks it as in use
+    const BitplaneFrame& frameToScan() {
+        BitplaneFrame* frame = published.load(std::memory_order_acquire);
+        if (scanning.load(std::memory_order_relaxed) != frame) {
+            scanning.store(frame, std::memory_order_release);
+            // The old frame may be the converter's next back frame
+            pthread_mutex_lock(&wakeLock);
+            pthread_cond_signal(&wake);
+            pthread_mutex_unlock(&wakeLock);
+        }
+        return *frame;
+    }
+
+    // Optional converter thread woken by submits and timed for the fade
+    bool start() {
+        stopping = false;
+        threadStarted = pthread_create(&thread, nullptr, converterThread, this) == 0;
+        return threadStarted;
+    }
+
+    void stop() {
+        if (!threadStarted) {
+            return;
+        }
+        pthread_mutex_lock(&wakeLock);
+        stopping = true;
+        pthread_cond_signal(&wake);
+        pthread_mutex_unlock(&wakeLock);
+        pthread_join(thread, nullptr);
+        threadStarted = false;
+    }
+};
+
+#endif // FRAME_BLEND_H
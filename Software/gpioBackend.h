@@ -0,0 +1,429 @@
+/*
+ * GPIO backends for the LED monitor
+ *
+ *   pigpio    - DMA-timed PWM, slowest to initialise (needs root, no pigpiod)
+ *   gpiomem   - direct register writes through /dev/gpiomem (Pi Zero .. Pi 4)
+ *   cdev      - kernel GPIO character device (/dev/gpiochip0), any Pi
+ *   simulated - no hardware, for off-target builds and benchmarks
+ *
+ * Backends are created without touching hardware; init() does the slow part
+ * and may run on its own thread while the monitor is already sampling.
+ *
+ * Build flags:
+ *   -DGPIO_NO_PIGPIO   build without pigpio (no -lpigpio needed)
+ *   -DGPIO_SIMULATED   simulated backend only (implies GPIO_NO_PIGPIO)
+ */
+
+#ifndef GPIO_BACKEND_H
+#define GPIO_BACKEND_H
+
+#ifdef GPIO_SIMULATED
+#ifndef GPIO_NO_PIGPIO
+#define GPIO_NO_PIGPIO
+#endif
+#endif
+
+#ifndef GPIO_NO_PIGPIO
+#include <pigpio.h>
+#endif
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/gpio.h>
+#include "leanIo.h"
+
+enum GpioBackendType {
+    GPIO_BACKEND_AUTO,
+    GPIO_BACKEND_PIGPIO,
+    GPIO_BACKEND_GPIOMEM,
+    GPIO_BACKEND_CDEV,
+    GPIO_BACKEND_SIMULATED
+};
+
+const int GPIO_MAX_PINS = 32;
+
+class GpioBackend {
+public:
+    virtual ~GpioBackend() {}
+
+    virtual const char* name() const = 0;
+    virtual bool supportsPwm() const { return false; }
+
+    // Slow hardware setup; safe to call from a worker thread
+    virtual bool init() = 0;
+
+    // Claim pins as outputs (all at once, some backends need the full set)
+    virtual bool configureOutputs(const int* pins, int count) = 0;
+
+    virtual void write(int pin, int level) = 0;
+
+    // Drive all pins in set high and all pins in clear low; backends with
+    // bank registers do it in one set and one clear write
+    virtual void writeMasks(uint32_t set, uint32_t clear) {
+        for (int pin = 0; pin < GPIO_MAX_PINS; pin++) {
+            if ((set | clear) & (1u << pin)) {
+                write(pin, (set >> pin) & 1);
+            }
+        }
+    }
+
+    // PWM with range 0-255; backends without PWM treat any duty > 0 as on
+    virtual void configurePwm(int pin, int frequency) { (void)pin; (void)frequency; }
+    virtual void pwm(int pin, int duty) { write(pin, duty > 0 ? 1 : 0); }
+
+    virtual void terminate() = 0;
+};
+
+// ============================================================================
+// PIGPIO
+// ============================================================================
+
+#ifndef GPIO_NO_PIGPIO
+class PigpioBackend : public GpioBackend {
+public:
+    const char* name() const { return "pigpio"; }
+    bool supportsPwm() const { return true; }
+
+    bool init() {
+        // Disable pigpio signal handling so our handlers work
+        gpioCfgSetInternals(gpioCfgGetInternals() | PI_CFG_NOSIGHANDLER);
+        return gpioInitialise() >= 0;
+    }
+
+    bool configureOutputs(const int* pins, int count) {
+        for (int i = 0; i < count; i++) {
+            if (gpioSetMode(pins[i], PI_OUTPUT) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void write(int pin, int level) { gpioWrite(pin, level); }
+
+    void writeMasks(uint32_t set, uint32_t clear) {
+        if (set) {
+            gpioWrite_Bits_0_31_Set(set);
+        }
+        if (clear) {
+            gpioWrite_Bits_0_31_Clear(clear);
+        }
+    }
+
+    void configurePwm(int pin, int frequency) {
+        gpioSetPWMfrequency(pin, frequency);
+        gpioSetPWMrange(pin, 255);
+    }
+
+    void pwm(int pin, int duty) { gpioPWM(pin, duty); }
+
+    void terminate() { gpioTerminate(); }
+};
+#endif
+
+// ============================================================================
+// GPIOMEM - BCM2835..BCM2711 GPIO registers mapped through /dev/gpiomem
+// ============================================================================
+
+class GpiomemBackend : public GpioBackend {
+private:
+    static const int GPFSEL0 = 0x00 / 4;
+    static const int GPSET0 = 0x1C / 4;
+    static const int GPCLR0 = 0x28 / 4;
+
+    int fd;
+    volatile uint32_t* registers;
+
+public:
+    GpiomemBackend() : fd(-1), registers(nullptr) {}
+
+    const char* name() const { return "gpiomem"; }
+
+    bool init() {
+        fd = open("/dev/gpiomem", O_RDWR | O_SYNC | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        void* map = mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            fd = -1;
+            return false;
+        }
+        registers = (volatile uint32_t*)map;
+        return true;
+    }
+
+    bool configureOutputs(const int* pins, int count) {
+        for (int i = 0; i < count; i++) {
+            if (pins[i] < 0 || pins[i] >= GPIO_MAX_PINS) {
+                return false;
+            }
+            int reg = GPFSEL0 + pins[i] / 10;
+            int shift = (pins[i] % 10) * 3;
+            registers[reg] = (registers[reg] & ~(7u << shift)) | (1u << shift);
+        }
+        return true;
+    }
+
+    void write(int pin, int level) {
+        registers[level ? GPSET0 : GPCLR0] = 1u << pin;
+    }
+
+    // One register store for any number of pins (used by the matrix scan-out)
+    void setMask(uint32_t mask) { registers[GPSET0] = mask; }
+    void clearMask(uint32_t mask) { registers[GPCLR0] = mask; }
+
+    void writeMasks(uint32_t set, uint32_t clear) {
+        if (set) {
+            registers[GPSET0] = set;
+        }
+        if (clear) {
+            registers[GPCLR0] = clear;
+        }
+    }
+
+    void terminate() {
+        if (registers) {
+            munmap((void*)registers, 4096);
+            registers = nullptr;
+        }
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+};
+
+// ============================================================================
+// CDEV - GPIO character device (uAPI v2), no library dependency
+// ============================================================================
+
+class CdevBackend : public GpioBackend {
+private:
+    int chipFd;
+    int lineFd;
+    int lineIndex[GPIO_MAX_PINS];
+
+public:
+    CdevBackend() : chipFd(-1), lineFd(-1) {
+        for (int i = 0; i < GPIO_MAX_PINS; i++) {
+            lineIndex[i] = -1;
+        }
+    }
+
+    const char* name() const { return "cdev"; }
+
+    bool init() {
+        chipFd = open("/dev/gpiochip0", O_RDWR | O_CLOEXEC);
+        return chipFd >= 0;
+    }
+
+    bool configureOutputs(const int* pins, int count) {
+        if (count > GPIO_V2_LINES_MAX) {
+            return false;
+        }
+
+        struct gpio_v2_line_request request;
+        memset(&request, 0, sizeof(request));
+        for (int i = 0; i < count; i++) {
+            if (pins[i] < 0 || pins[i] >= GPIO_MAX_PINS) {
+                return false;
+            }
+            request.offsets[i] = (uint32_t)pins[i];
+            lineIndex[pins[i]] = i;
+        }
+        strncpy(request.consumer, "led_monitor", sizeof(request.consumer) - 1);
+        request.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+        request.num_lines = (uint32_t)count;
+
+        if (ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+            return false;
+        }
+        lineFd = request.fd;
+        return true;
+    }
+
+    void write(int pin, int level) {
+        if (lineFd < 0 || lineIndex[pin] < 0) {
+            return;
+        }
+        struct gpio_v2_line_values values;
+        values.mask = 1ull << lineIndex[pin];
+        values.bits = level ? values.mask : 0;
+        ioctl(lineFd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
+    }
+
+    // The line request covers all pins, so one ioctl sets and clears
+    void writeMasks(uint32_t set, uint32_t clear) {
+        if (lineFd < 0) {
+            return;
+        }
+        struct gpio_v2_line_values values;
+        values.mask = 0;
+        values.bits = 0;
+        for (int pin = 0; pin < GPIO_MAX_PINS; pin++) {
+            if (lineIndex[pin] >= 0 && ((set | clear) & (1u << pin))) {
+                values.mask |= 1ull << lineIndex[pin];
+                if (set & (1u << pin)) {
+                    values.bits |= 1ull << lineIndex[pin];
+                }
+            }
+        }
+        if (values.mask) {
+            ioctl(lineFd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
+        }
+    }
+
+    void terminate() {
+        if (lineFd >= 0) {
+            close(lineFd);
+            lineFd = -1;
+        }
+        if (chipFd >= 0) {
+            close(chipFd);
+            chipFd = -1;
+        }
+    }
+};
+
+// ============================================================================
+// SIMULATED
+// ============================================================================
+
+class SimulatedBackend : public GpioBackend {
+private:
+    int initDelayMs;
+    unsigned levels[GPIO_MAX_PINS];
+
+public:
+    // GPIO calls as the hardware would see them (a writeMasks() is one call)
+    unsigned long calls;
+
+    // initDelayMs emulates the start-up cost of a real backend
+    explicit SimulatedBackend(int initDelay = 0) : initDelayMs(initDelay), calls(0) {
+        memset(levels, 0, sizeof(levels));
+    }
+
+    const char* name() const { return "simulated"; }
+    bool supportsPwm() const { return true; }
+
+    bool init() {
+        if (initDelayMs > 0) {
+            sleepMs(initDelayMs);
+        }
+        return true;
+    }
+
+    bool configureOutputs(const int*, int) { return true; }
+    void write(int pin, int level) {
+        levels[pin] = (unsigned)level;
+        calls++;
+    }
+
+    void pwm(int pin, int duty) {
+        levels[pin] = (unsigned)duty;
+        calls++;
+    }
+
+    void writeMasks(uint32_t set, uint32_t clear) {
+        for (int pin = 0; pin < GPIO_MAX_PINS; pin++) {
+            if ((set | clear) & (1u << pin)) {
+                levels[pin] = (set >> pin) & 1;
+            }
+        }
+        calls++;
+    }
+    void terminate() {}
+
+    unsigned level(int pin) const { return levels[pin]; }
+};
+
+// ============================================================================
+// SELECTION
+// ============================================================================
+
+// Pick the lightest backend that provides what the caller needs:
+// pigpio only when PWM is required, otherwise gpiomem, then cdev
+inline GpioBackendType selectGpioBackend(GpioBackendType requested, bool needPwm) {
+    if (requested != GPIO_BACKEND_AUTO) {
+        return requested;
+    }
+#ifdef GPIO_SIMULATED
+    (void)needPwm;
+    return GPIO_BACKEND_SIMULATED;
+#else
+#ifndef GPIO_NO_PIGPIO
+    if (needPwm) {
+        return GPIO_BACKEND_PIGPIO;
+    }
+#else
+    (void)needPwm;
+#endif
+    if (access("/dev/gpiomem", R_OK | W_OK) == 0) {
+        return GPIO_BACKEND_GPIOMEM;
+    }
+    if (access("/dev/gpiochip0", R_OK | W_OK) == 0) {
+        return GPIO_BACKEND_CDEV;
+    }
+#ifndef GPIO_NO_PIGPIO
+    return GPIO_BACKEND_PIGPIO;
+#else
+    return GPIO_BACKEND_GPIOMEM;
+#endif
+#endif
+}
+
+// Fast backend that can show a static LED state while a slow backend
+// (pigpio) initialises; GPIO_BACKEND_AUTO if none is needed or available
+inline GpioBackendType earlyGpioBackend(GpioBackendType slow, int simulatedInitDelayMs) {
+    if (slow == GPIO_BACKEND_SIMULATED) {
+        return simulatedInitDelayMs > 0 ? GPIO_BACKEND_SIMULATED : GPIO_BACKEND_AUTO;
+    }
+    if (slow != GPIO_BACKEND_PIGPIO) {
+        return GPIO_BACKEND_AUTO;
+    }
+    if (access("/dev/gpiomem", R_OK | W_OK) == 0) {
+        return GPIO_BACKEND_GPIOMEM;
+    }
+    if (access("/dev/gpiochip0", R_OK | W_OK) == 0) {
+        return GPIO_BACKEND_CDEV;
+    }
+    return GPIO_BACKEND_AUTO;
+}
+
+// Returns nullptr if the backend was not compiled in
+inline GpioBackend* createGpioBackend(GpioBackendType type, int simulatedInitDelayMs = 0) {
+    switch (type) {
+#ifndef GPIO_NO_PIGPIO
+    case GPIO_BACKEND_PIGPIO:
+        return new PigpioBackend();
+#endif
+    case GPIO_BACKEND_GPIOMEM:
+        return new GpiomemBackend();
+    case GPIO_BACKEND_CDEV:
+        return new CdevBackend();
+    case GPIO_BACKEND_SIMULATED:
+        return new SimulatedBackend(simulatedInitDelayMs);
+    default:
+        return nullptr;
+    }
+}
+
+inline GpioBackendType parseGpioBackend(const char* text) {
+    if (strcmp(text, "pigpio") == 0) {
+        return GPIO_BACKEND_PIGPIO;
+    } else if (strcmp(text, "gpiomem") == 0) {
+        return GPIO_BACKEND_GPIOMEM;
+    } else if (strcmp(text, "cdev") == 0) {
+        return GPIO_BACKEND_CDEV;
+    } else if (strcmp(text, "simulated") == 0) {
+        return GPIO_BACKEND_SIMULATED;
+    }
+    return GPIO_BACKEND_AUTO;
+}
+
+#endif // GPIO_BACKEND_H
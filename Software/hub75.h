@@ -0,0 +1,836 @@
+/*
+ * HUB75 matrix scan-out for the adapter
+ *
+ * Both chains share CLOCK, STROBE, OE and the row address lines; each chain
+ * has its own six color lines, so one GPSET0/GPCLR0 store drives a column of
+ * P0 and P1 at once.
+ *
+ *   Canvas        - 8-bit RGB pixels, width = panel columns x chain length,
+ *                   height = panel rows x parallel chains (P0 on top);
+ *                   Canvas16 holds 16 bits per channel and is dithered
+ *                   down to the plane depth instead of rounded to 8 bits
+ *   BitplaneFrame - gamma corrected canvas transposed into GPIO words,
+ *                   one word per column for every row address and bitplane
+ *   Hub75Scanner  - binary code modulation scan-out, templated on the output
+ *                   (GpiomemMatrixOutput on a Pi, SimulatedPanel off-target)
+ *
+ * Per-row adaptive depth: each row address only emits the bitplanes it needs.
+ * All-zero planes are skipped and identical planes are shifted out once with
+ * their on-times added, so black rows cost nothing and saturated text needs a
+ * single pass instead of one per plane. The on-time unit is rescaled every
+ * frame so brightness stays that of the full-depth schedule.
+ *
+ * Column clocking takes two or three register stores per column and is
+ * unrolled at compile time for common chain lengths. MatrixConfig's
+ * clockSlowdown adds stores per column for panels that need a slower clock.
+ *
+ * The scan-out needs no pigpio: programs that only drive the matrix define
+ * GPIO_NO_PIGPIO before including this header (see gpioBackend.h).
+ */
+
+#ifndef HUB75_H
+#define HUB75_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "allocGuard.h"
+#include "gpioBackend.h"
+
+// ============================================================================
+// ADAPTER PINS (BCM numbering)
+// ============================================================================
+
+const int HUB75_PIN_STROBE = 4;
+const int HUB75_PIN_CLOCK = 17;
+const int HUB75_PIN_OE = 18;  // Active low
+const int HUB75_ROW_PINS[5] = { 22, 23, 24, 25, 15 };  // ROW_A .. ROW_E
+
+// R1, G1, B1 (upper half), R2, G2, B2 (lower half) of P0 and P1
+const int HUB75_CHAINS = 2;
+const int HUB75_COLOR_PINS[HUB75_CHAINS][6] = {
+    { 11, 27, 7, 8, 9, 10 },
+    { 12, 5, 6, 19, 13, 20 }
+};
+
+const uint32_t HUB75_STROBE_MASK = 1u << HUB75_PIN_STROBE;
+const uint32_t HUB75_CLOCK_MASK = 1u << HUB75_PIN_CLOCK;
+const uint32_t HUB75_OE_MASK = 1u << HUB75_PIN_OE;
+
+inline uint32_t hub75ChainMask(int chain) {
+    uint32_t mask = 0;
+    for (int i = 0; i < 6; i++) {
+        mask |= 1u << HUB75_COLOR_PINS[chain][i];
+    }
+    return mask;
+}
+
+inline uint32_t hub75RowMask() {
+    uint32_t mask = 0;
+    for (int i = 0; i < 5; i++) {
+        mask |= 1u << HUB75_ROW_PINS[i];
+    }
+    return mask;
+}
+
+inline uint32_t hub75RowBits(int address) {
+    uint32_t bits = 0;
+    for (int i = 0; i < 5; i++) {
+        if (address & (1 << i)) {
+            bits |= 1u << HUB75_ROW_PINS[i];
+        }
+    }
+    return bits;
+}
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+
+const int HUB75_MAX_PLANES = 11;
+const int HUB75_MAX_ROW_ADDRESSES = 32;  // 64-row panels (1:32 scan, ROW_E)
+const int HUB75_MAX_SLOWDOWN = 4;
+
+struct MatrixConfig {
+    int panelRows;        // 16, 32 or 64
+    int panelCols;        // Columns per panel
+    int chainLength;      // Panels per chain
+    int parallel;         // 1 = P0 only, 2 = P0 and P1
+    int planes;           // Bitplanes (1-11)
+    bool adaptiveDepth;   // Emit only the planes each row needs
+    uint32_t lsbNs;       // OE time of the least significant plane (full depth)
+    uint32_t minLsbNs;    // Shortest unit the panel drivers handle reliably
+    int clockSlowdown;    // Extra stores on each CLOCK level, for panels that need a slower clock
+
+    int width() const { return panelCols * chainLength; }
+    int height() const { return panelRows * parallel; }
+    int rowAddresses() const { return panelRows / 2; }
+};
+
+const MatrixConfig DEFAULT_MATRIX_CONFIG = { 32, 64, 1, 2, 11, true, 130, 40, 0 };
+
+// Slowdown that keeps the pixel clock of this Pi near the Pi Zero's ~18 MHz,
+// which panels generally accept: 0 on BCM2835 (Zero, 1), 1 on BCM2836/7
+// (2, 3), 2 on BCM2711 and later (4, 5). 0 when the SoC is unknown.
+inline int hub75DefaultSlowdown() {
+    char compatible[256];
+    int fd = open("/proc/device-tree/compatible", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    ssize_t length = read(fd, compatible, sizeof(compatible) - 1);
+    close(fd);
+    if (length <= 0) {
+        return 0;
+    }
+    // NUL-separated list: look at every entry
+    compatible[length] = '\0';
+    int slowdown = 0;
+    for (ssize_t start = 0; start < length; start += (ssize_t)strlen(compatible + start) + 1) {
+        const char* entry = compatible + start;
+        if (strcmp(entry, "brcm,bcm2711") == 0 || strcmp(entry, "brcm,bcm2712") == 0) {
+            slowdown = 2;
+        } else if (strcmp(entry, "brcm,bcm2836") == 0 || strcmp(entry, "brcm,bcm2837") == 0) {
+            slowdown = slowdown > 1 ? slowdown : 1;
+        }
+    }
+    return slowdown;
+}
+
+// Changed canvas rows as row addresses per chain; canvas rows y and
+// y + rowAddresses() of a chain are shifted out together
+struct RowDamage {
+    uint32_t addresses[HUB75_CHAINS];
+
+    RowDamage() { clear(); }
+
+    void clear() {
+        for (int chain = 0; chain < HUB75_CHAINS; chain++) {
+            addresses[chain] = 0;
+        }
+    }
+
+    bool any() const {
+        uint32_t all = 0;
+        for (int chain = 0; chain < HUB75_CHAINS; chain++) {
+            all |= addresses[chain];
+        }
+        return all != 0;
+    }
+
+    int count() const {
+        int total = 0;
+        for (int chain = 0; chain < HUB75_CHAINS; chain++) {
+            total += __builtin_popcount(addresses[chain]);
+        }
+        return total;
+    }
+
+    void markRows(const MatrixConfig& config, int y, int height) {
+        const int rows = config.rowAddresses();
+        int end = y + height < config.height() ? y + height : config.height();
+        for (int row = y < 0 ? 0 : y; row < end; row++) {
+            addresses[row / config.panelRows] |= 1u << (row % config.panelRows % rows);
+        }
+    }
+
+    void markAll(const MatrixConfig& config) { markRows(config, 0, config.height()); }
+
+    void merge(const RowDamage& other) {
+        for (int chain = 0; chain < HUB75_CHAINS; chain++) {
+            addresses[chain] |= other.addresses[chain];
+        }
+    }
+};
+
+// ============================================================================
+// CANVAS
+// ============================================================================
+
+// RGB pixels, row-major; Channel is uint8_t (Canvas) or uint16_t (Canvas16)
+template <class Channel>
+class CanvasOf {
+private:
+    int w;
+    int h;
+    Channel* pixels;
+
+    CanvasOf(const CanvasOf&);
+    CanvasOf& operator=(const CanvasOf&);
+
+public:
+    CanvasOf(int width, int height) : w(width), h(height), pixels(new Channel[(size_t)width * height * 3]) {
+        clear();
+    }
+    ~CanvasOf() { delete[] pixels; }
+
+    int width() const { return w; }
+    int height() const { return h; }
+
+    void clear() { memset(pixels, 0, (size_t)w * h * 3 * sizeof(Channel)); }
+
+    void setPixel(int x, int y, Channel r, Channel g, Channel b) {
+        if (x < 0 || y < 0 || x >= w || y >= h) {
+            return;
+        }
+        Channel* p = pixels + ((size_t)y * w + x) * 3;
+        p[0] = r;
+        p[1] = g;
+        p[2] = b;
+    }
+
+    void fillRect(int x, int y, int width, int height, Channel r, Channel g, Channel b) {
+        for (int row = y; row < y + height; row++) {
+            for (int col = x; col < x + width; col++) {
+                setPixel(col, row, r, g, b);
+            }
+        }
+    }
+
+    const Channel* row(int y) const { return pixels + (size_t)y * w * 3; }
+    Channel* row(int y) { return pixels + (size_t)y * w * 3; }
+};
+
+typedef CanvasOf<uint8_t> Canvas;
+typedef CanvasOf<uint16_t> Canvas16;
+
+// ============================================================================
+// BITPLANES
+// ============================================================================
+
+// 8-bit value to a planes-bit on-time with the given gamma
+struct GammaTable {
+    uint16_t values[256];
+
+    void build(int planes, double gamma) {
+        double top = (double)((1 << planes) - 1);
+        for (int i = 0; i < 256; i++) {
+            values[i] = (uint16_t)(pow(i / 255.0, gamma) * top + 0.5);
+        }
+    }
+};
+
+// 16-bit value to 16-bit linear light: 4096 segments, linearly interpolated
+// (8 KB instead of 128 KB for a full table, so it stays in L1)
+struct Gamma16Table {
+    uint16_t values[4097];
+
+    void build(double gamma) {
+        for (int i = 0; i <= 4096; i++) {
+            double x = i * 16 < 65535 ? i * 16 / 65535.0 : 1.0;
+            values[i] = (uint16_t)(pow(x, gamma) * 65535.0 + 0.5);
+        }
+    }
+};
+
+// Conversion kernels work on 4 columns at a time with GCC vector extensions
+// (NEON on Pi 2 and later, SSE2 on x86, plain scalar code on the Pi Zero);
+// -DHUB75_NO_SIMD uses the scalar loops everywhere
+#ifndef HUB75_NO_SIMD
+typedef uint32_t Hub75Vector __attribute__((vector_size(16)));
+const int HUB75_LANES = 4;
+
+inline Hub75Vector hub75Load(const uint32_t* p) {
+    Hub75Vector v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline void hub75Store(uint32_t* p, Hub75Vector v) {
+    memcpy(p, &v, sizeof(v));
+}
+#else
+const int HUB75_LANES = 1;
+#endif
+
+// One shift-out of a row: a plane's column words shown for onUnits LSB times
+struct BitplanePass {
+    uint8_t plane;
+    uint16_t onUnits;
+};
+
+class BitplaneFrame {
+private:
+    MatrixConfig config;
+    uint32_t* words;      // [row address][plane][column]
+    uint32_t* levels;     // [channel R1 G1 B1 R2 G2 B2][column] of the row being converted
+    uint32_t* scratch;    // 16-bit path: gamma segment slopes and fractions
+    uint32_t* dither;     // [y & 3][column] ordered dither thresholds (Q16)
+    BitplanePass passes[HUB75_MAX_ROW_ADDRESSES][HUB75_MAX_PLANES];
+    uint8_t passCounts[HUB75_MAX_ROW_ADDRESSES];
+
+    BitplaneFrame(const BitplaneFrame&);
+    BitplaneFrame& operator=(const BitplaneFrame&);
+
+    // 8-bit rows: one table lookup per channel
+    void levelsFromRows(const uint8_t* upper, const uint8_t* lower, int, const GammaTable& gamma) {
+        const int cols = config.width();
+        for (int k = 0; k < 3; k++) {
+            uint32_t* upperLevels = levels + (size_t)k * cols;
+            uint32_t* lowerLevels = levels + (size_t)(k + 3) * cols;
+            for (int c = 0; c < cols; c++) {
+                upperLevels[c] = gamma.values[upper[c * 3 + k]];
+                lowerLevels[c] = gamma.values[lower[c * 3 + k]];
+            }
+        }
+    }
+
+    // 16-bit rows: interpolated gamma to 16-bit linear, then ordered dither
+    // down to the plane depth; nothing is rounded to 8 bits on the way
+    void levelsFromRows(const uint16_t* upper, const uint16_t* lower, int y, const Gamma16Table& gamma) {
+        const int cols = config.width();
+        const int n = 6 * cols;
+        uint32_t* slopes = scratch;
+        uint32_t* fractions = scratch + n;
+
+        // Table lookups are gathers and stay scalar
+        for (int k = 0; k < 6; k++) {
+            const uint16_t* source = (k < 3 ? upper : lower) + k % 3;
+            uint32_t* base = levels + (size_t)k * cols;
+            uint32_t* slope = slopes + (size_t)k * cols;
+            uint32_t* fraction = fractions + (size_t)k * cols;
+            for (int c = 0; c < cols; c++) {
+                uint32_t value = source[c * 3];
+                uint32_t segment = value >> 4;
+                base[c] = gamma.values[segment];
+                slope[c] = (uint32_t)(gamma.values[segment + 1] - gamma.values[segment]);
+                fraction[c] = (value & 15) + (value == 0xFFFF);  // 0xFFFF hits the table end exactly
+            }
+        }
+
+        // linear = base + slope * fraction / 16, scaled to 0..65536, then
+        // level = (linear * top + threshold) >> 16
+        const uint32_t top = (1u << config.planes) - 1;
+        const uint32_t* thresholds = dither + (size_t)(y & 3) * cols;
+        for (int k = 0; k < 6; k++) {
+            uint32_t* base = levels + (size_t)k * cols;
+            const uint32_t* slope = slopes + (size_t)k * cols;
+            const uint32_t* fraction = fractions + (size_t)k * cols;
+            int c = 0;
+#ifndef HUB75_NO_SIMD
+            for (; c + HUB75_LANES <= cols; c += HUB75_LANES) {
+                Hub75Vector linear = hub75Load(base + c) + ((hub75Load(slope + c) * hub75Load(fraction + c)) >> 4);
+                linear += linear >> 15;
+                hub75Store(base + c, (linear * top + hub75Load(thresholds + c)) >> 16);
+            }
+#endif
+            for (; c < cols; c++) {
+                uint32_t linear = base[c] + ((slope[c] * fraction[c]) >> 4);
+                linear += linear >> 15;
+                base[c] = (linear * top + thresholds[c]) >> 16;
+            }
+        }
+    }
+
+    // Levels of one row address into the chain's bits of every plane,
+    // leaving the other chain's bits alone
+    void transposeRow(int r, int chain) {
+        const int cols = config.width();
+        const int* pins = HUB75_COLOR_PINS[chain];
+        const uint32_t keep = ~hub75ChainMask(chain);
+        uint32_t* base = words + (size_t)r * config.planes * cols;
+
+        for (int p = 0; p < config.planes; p++) {
+            uint32_t* plane = base + (size_t)p * cols;
+            int c = 0;
+#ifndef HUB75_NO_SIMD
+            for (; c + HUB75_LANES <= cols; c += HUB75_LANES) {
+                Hub75Vector word = hub75Load(plane + c) & keep;
+                for (int k = 0; k < 6; k++) {
+                    word |= ((hub75Load(levels + (size_t)k * cols + c) >> p) & 1) << pins[k];
+                }
+                hub75Store(plane + c, word);
+            }
+#endif
+            for (; c < cols; c++) {
+                uint32_t word = plane[c] & keep;
+                for (int k = 0; k < 6; k++) {
+                    word |= ((levels[(size_t)k * cols + c] >> p) & 1) << pins[k];
+                }
+                plane[c] = word;
+            }
+        }
+    }
+
+    template <class Channel, class Gamma>
+    void convertRows(const CanvasOf<Channel>& canvas, int chain, int top, const Gamma& gamma) {
+        const int rows = config.rowAddresses();
+        for (int r = 0; r < rows; r++) {
+            levelsFromRows(canvas.row(top + r), canvas.row(top + r + rows), top + r, gamma);
+            transposeRow(r, chain);
+        }
+    }
+
+    void sumPlan() {
+        totalPasses = 0;
+        totalUnits = 0;
+        for (int r = 0; r < config.rowAddresses(); r++) {
+            totalPasses += passCounts[r];
+            for (int i = 0; i < passCounts[r]; i++) {
+                totalUnits += passes[r][i].onUnits;
+            }
+        }
+    }
+
+    // Choose the passes of one row address
+    void planRow(int r) {
+        const int cols = config.width();
+        const uint32_t* base = words + (size_t)r * config.planes * cols;
+        int count = 0;
+
+        for (int p = 0; p < config.planes; p++) {
+            const uint32_t* plane = base + (size_t)p * cols;
+            uint16_t units = (uint16_t)(1u << p);
+
+            if (config.adaptiveDepth) {
+                // Planes without a lit pixel add no light
+                uint32_t any = 0;
+                for (int c = 0; c < cols; c++) {
+                    any |= plane[c];
+                }
+                if (any == 0) {
+                    continue;
+                }
+
+                // Same pixels as an earlier plane: show that one longer
+                int same = -1;
+                for (int i = 0; i < count && same < 0; i++) {
+                    const uint32_t* other = base + (size_t)passes[r][i].plane * cols;
+                    if (memcmp(plane, other, (size_t)cols * sizeof(uint32_t)) == 0) {
+                        same = i;
+                    }
+                }
+                if (same >= 0) {
+                    passes[r][same].onUnits = (uint16_t)(passes[r][same].onUnits + units);
+                    continue;
+                }
+            }
+
+            passes[r][count].plane = (uint8_t)p;
+            passes[r][count].onUnits = units;
+            count++;
+        }
+        passCounts[r] = (uint8_t)count;
+    }
+
+public:
+    int totalPasses;       // Passes over all row addresses
+    uint32_t totalUnits;   // Sum of onUnits over all passes
+
+    explicit BitplaneFrame(const MatrixConfig& cfg)
+        : config(cfg), words(new uint32_t[(size_t)cfg.rowAddresses() * cfg.planes * cfg.width()]),
+          levels(new uint32_t[(size_t)6 * cfg.width()]), scratch(new uint32_t[(size_t)12 * cfg.width()]),
+          dither(new uint32_t[(size_t)4 * cfg.width()]), totalPasses(0), totalUnits(0) {
+        memset(words, 0, (size_t)cfg.rowAddresses() * cfg.planes * cfg.width() * sizeof(uint32_t));
+        memset(passCounts, 0, sizeof(passCounts));
+
+        // 4x4 Bayer matrix, thresholds centred in their sixteenths
+        static const uint8_t bayer[4][4] = { { 0, 8, 2, 10 }, { 12, 4, 14, 6 }, { 3, 11, 1, 9 }, { 15, 7, 13, 5 } };
+        for (int y = 0; y < 4; y++) {
+            for (int c = 0; c < cfg.width(); c++) {
+                dither[(size_t)y * cfg.width() + c] = bayer[y][c & 3] * 4096u + 2048u;
+            }
+        }
+    }
+
+    ~BitplaneFrame() {
+        delete[] words;
+        delete[] levels;
+        delete[] scratch;
+        delete[] dither;
+    }
+
+    const MatrixConfig& matrixConfig() const { return config; }
+
+    // Convert a full canvas (config.width() x config.height())
+    void build(const Canvas& canvas, const GammaTable& gamma) {
+        AllocScope scope(ALLOC_SCOPE_FRAME_BUILD);
+        for (int chain = 0; chain < config.parallel; chain++) {
+            convertRows(canvas, chain, chain * config.panelRows, gamma);
+        }
+        plan();
+    }
+
+    // 16-bit canvas: gamma, dithering and transpose at full precision
+    void build(const Canvas16& canvas, const Gamma16Table& gamma) {
+        AllocScope scope(ALLOC_SCOPE_FRAME_BUILD);
+        for (int chain = 0; chain < config.parallel; chain++) {
+            convertRows(canvas, chain, chain * config.panelRows, gamma);
+        }
+        plan();
+    }
+
+    // Convert one chain from its own canvas (config.width() x config.panelRows);
+    // the other chain's bits are kept, call plan() once all chains are done
+    void convertChain(const Canvas& canvas, int chain, const GammaTable& gamma) {
+        AllocScope scope(ALLOC_SCOPE_FRAME_BUILD);
+        convertRows(canvas, chain, 0, gamma);
+    }
+
+    // Reconvert and replan only the damaged row addresses of a full canvas
+    void update(const Canvas& canvas, const GammaTable& gamma, const RowDamage& damage) {
+        AllocScope scope(ALLOC_SCOPE_FRAME_BUILD);
+        const int rows = config.rowAddresses();
+        uint32_t replan = 0;
+        for (int chain = 0; chain < config.parallel; chain++) {
+            uint32_t dirty = damage.addresses[chain];
+            int top = chain * config.panelRows;
+            for (int r = 0; dirty != 0; r++, dirty >>= 1) {
+                if (dirty & 1) {
+                    levelsFromRows(canvas.row(top + r), canvas.row(top + r + rows), top + r, gamma);
+                    transposeRow(r, chain);
+                }
+            }
+            replan |= damage.addresses[chain];
+        }
+        for (int r = 0; replan != 0; r++, replan >>= 1) {
+            if (replan & 1) {
+                planRow(r);
+            }
+        }
+        sumPlan();
+    }
+
+    void plan() {
+        AllocScope scope(ALLOC_SCOPE_FRAME_BUILD);
+        for (int r = 0; r < config.rowAddresses(); r++) {
+            planRow(r);
+        }
+        sumPlan();
+    }
+
+    // Bitplanes and schedule of another frame with the same geometry
+    void copyFrom(const BitplaneFrame& other) {
+        memcpy(words, other.words, wordBytes());
+        memcpy(passes, other.passes, sizeof(passes));
+        memcpy(passCounts, other.passCounts, sizeof(passCounts));
+        totalPasses = other.totalPasses;
+        totalUnits = other.totalUnits;
+    }
+
+    // Flat image of bitplanes and schedule, e.g. for a file-backed cache
+    size_t storageSize() const { return wordBytes() + sizeof(passes) + sizeof(passCounts); }
+
+    void store(uint8_t* out) const {
+        memcpy(out, words, wordBytes());
+        memcpy(out + wordBytes(), passes, sizeof(passes));
+        memcpy(out + wordBytes() + sizeof(passes), passCounts, sizeof(passCounts));
+    }
+
+    void restore(const uint8_t* in) {
+        memcpy(words, in, wordBytes());
+        memcpy(passes, in + wordBytes(), sizeof(passes));
+        memcpy(passCounts, in + wordBytes() + sizeof(passes), sizeof(passCounts));
+        sumPlan();
+    }
+
+    size_t wordBytes() const { return (size_t)config.rowAddresses() * config.planes * config.width() * sizeof(uint32_t); }
+
+    int passCount(int row) const { return passCounts[row]; }
+    const BitplanePass& pass(int row, int i) const { return passes[row][i]; }
+
+    const uint32_t* planeWords(int row, int plane) const {
+        return words + ((size_t)row * config.planes + plane) * config.width();
+    }
+};
+
+// ============================================================================
+// SCAN-OUT
+// ============================================================================
+
+// Output: set(mask) / clear(mask) are one GPSET0 / GPCLR0 store each,
+// nowNs() reads the clock and waitNs() busy-waits
+
+// One column in at most three stores: CLOCK falls together with the data bits
+// that drop, then the bits that rise, then CLOCK rises. The data lines settle
+// for a full store before the rising edge; if no bit rises (runs of the same
+// color, black) the middle store is skipped. GPSET0 and GPCLR0 are separate
+// registers, so a set and a clear can never share a store.
+template <class Output>
+inline uint32_t clockColumn(Output& out, uint32_t word, uint32_t last) {
+    out.clear((last & ~word) | HUB75_CLOCK_MASK);
+    uint32_t rising = word & ~last;
+    if (rising) {
+        out.set(rising);
+    }
+    out.set(HUB75_CLOCK_MASK);
+    return word;
+}
+
+// clockColumn() with each CLOCK level held for slowdown more stores: repeated
+// stores of a level already there, so the data settles longer before the
+// rising edge and the clock high time grows by the same amount
+template <class Output>
+uint32_t shiftColumnsSlowed(Output& out, const uint32_t* columns, int cols, uint32_t last, int slowdown) {
+    for (int c = 0; c < cols; c++) {
+        uint32_t word = columns[c];
+        out.clear((last & ~word) | HUB75_CLOCK_MASK);
+        uint32_t rising = word & ~last;
+        if (rising) {
+            out.set(rising);
+        }
+        for (int s = 0; s < slowdown; s++) {
+            out.clear(HUB75_CLOCK_MASK);
+        }
+        out.set(HUB75_CLOCK_MASK);
+        for (int s = 0; s < slowdown; s++) {
+            out.set(HUB75_CLOCK_MASK);
+        }
+        last = word;
+    }
+    return last;
+}
+
+// Column loops return the color lines' final state; last is their current state
+template <class Output>
+uint32_t shiftColumnsGeneric(Output& out, const uint32_t* columns, int cols, uint32_t last) {
+    for (int c = 0; c < cols; c++) {
+        last = clockColumn(out, columns[c], last);
+    }
+    return last;
+}
+
+// Fully unrolled for a compile-time column count
+template <class Output, int COLS>
+uint32_t shiftColumnsFixed(Output& out, const uint32_t* columns, int, uint32_t last) {
+#pragma GCC unroll 64
+    for (int c = 0; c < COLS; c++) {
+        last = clockColumn(out, columns[c], last);
+    }
+    return last;
+}
+
+// Specialized loop for common chains (1-4 panels of 32 or 64 columns)
+template <class Output>
+struct ColumnShift {
+    typedef uint32_t (*Function)(Output&, const uint32_t*, int, uint32_t);
+
+    static Function select(int cols) {
+        switch (cols) {
+        case 32: return shiftColumnsFixed<Output, 32>;
+        case 64: return shiftColumnsFixed<Output, 64>;
+        case 96: return shiftColumnsFixed<Output, 96>;
+        case 128: return shiftColumnsFixed<Output, 128>;
+        case 192: return shiftColumnsFixed<Output, 192>;
+        case 256: return shiftColumnsFixed<Output, 256>;
+        default: return shiftColumnsGeneric<Output>;
+        }
+    }
+};
+
+template <class Output>
+class Hub75Scanner {
+private:
+    Output& out;
+    MatrixConfig config;
+    uint32_t colorMask;
+    uint32_t lastColumn;   // Current state of the color lines
+    typename ColumnShift<Output>::Function shift;
+    uint32_t rowMask;
+    uint32_t rowBits[HUB75_MAX_ROW_ADDRESSES];
+    uint32_t passShiftNs;  // Measured time of one pass apart from its OE wait
+    uint32_t storeNs;      // Measured cost of one register store
+
+    // Clock one plane's column words into the chains (CLOCK is left high)
+    void shiftColumns(const uint32_t* columns, int cols) {
+        if (config.clockSlowdown > 0) {
+            lastColumn = shiftColumnsSlowed(out, columns, cols, lastColumn, config.clockSlowdown);
+        } else {
+            lastColumn = shift(out, columns, cols, lastColumn);
+        }
+    }
+
+    // Row address and latch (OE is off)
+    void latchRow(int row) {
+        out.clear(rowMask & ~rowBits[row]);
+        out.set(rowBits[row]);
+        out.set(HUB75_STROBE_MASK);
+        out.clear(HUB75_STROBE_MASK);
+    }
+
+public:
+    // Timing of the last frame
+    uint64_t lastPeriodNs;
+    uint64_t referencePeriodNs;  // Full-depth period the brightness is matched to
+    uint32_t unitQ8;             // On-time unit used (ns, Q8)
+    unsigned long frames;
+
+    Hub75Scanner(Output& output, const MatrixConfig& cfg)
+        : out(output), config(cfg), colorMask(0), lastColumn(0),
+          shift(ColumnShift<Output>::select(cfg.width())), rowMask(hub75RowMask()), passShiftNs(0), storeNs(0),
+          lastPeriodNs(0), referencePeriodNs(0), unitQ8(cfg.lsbNs << 8), frames(0) {
+        for (int chain = 0; chain < cfg.parallel; chain++) {
+            colorMask |= hub75ChainMask(chain);
+        }
+        for (int r = 0; r < HUB75_MAX_ROW_ADDRESSES; r++) {
+            rowBits[r] = hub75RowBits(r);
+        }
+    }
+
+    // Outputs idle, display off; time one store and one blank pass for the first frame
+    void begin() {
+        out.set(HUB75_OE_MASK);
+        out.clear(HUB75_CLOCK_MASK | HUB75_STROBE_MASK | colorMask | rowMask);
+        lastColumn = 0;
+
+        // The store that enables OE already lights the row, so OE waits are shortened by it
+        const int calibrationStores = 64;
+        uint64_t storesStart = out.nowNs();
+        for (int i = 0; i < calibrationStores; i++) {
+            out.set(HUB75_OE_MASK);
+        }
+        storeNs = (uint32_t)((out.nowNs() - storesStart) / calibrationStores);
+
+        const int cols = config.width();
+        uint32_t* blank = new uint32_t[(size_t)cols];
+        memset(blank, 0, (size_t)cols * sizeof(uint32_t));
+        uint64_t start = out.nowNs();
+        shiftColumns(blank, cols);
+        latchRow(0);
+        passShiftNs = (uint32_t)(out.nowNs() - start) + 2 * storeNs;
+        delete[] blank;
+    }
+
+    void scanFrame(const BitplaneFrame& frame) {
+        AllocScope scope(ALLOC_SCOPE_SCAN_OUT);
+        const int cols = config.width();
+        const int rows = config.rowAddresses();
+
+        // Brightness per on-time unit of the full-depth schedule
+        uint64_t fullUnits = (uint64_t)rows * ((1u << config.planes) - 1);
+        uint64_t fullShiftNs = (uint64_t)rows * config.planes * passShiftNs;
+        referencePeriodNs = fullShiftNs + fullUnits * config.lsbNs;
+
+        // Shortest unit that keeps unit/period at lsbNs/referencePeriodNs:
+        // skipped passes and dark rows turn into refresh rate, not brightness
+        uint64_t shiftNs = (uint64_t)frame.totalPasses * passShiftNs;
+        uint64_t freeNs = referencePeriodNs - (uint64_t)frame.totalUnits * config.lsbNs;
+        uint64_t unit = freeNs > 0 ? ((uint64_t)config.lsbNs * shiftNs << 8) / freeNs : 0;
+        if (unit < ((uint64_t)config.minLsbNs << 8)) {
+            unit = (uint64_t)config.minLsbNs << 8;
+        }
+        if (unit > ((uint64_t)config.lsbNs << 8)) {
+            unit = (uint64_t)config.lsbNs << 8;
+        }
+        unitQ8 = (uint32_t)unit;
+        uint64_t targetNs = (referencePeriodNs * unitQ8 / config.lsbNs) >> 8;
+
+        uint64_t start = out.nowNs();
+        uint64_t measuredShiftNs = 0;
+        for (int r = 0; r < rows; r++) {
+            for (int i = 0; i < frame.passCount(r); i++) {
+                const BitplanePass& pass = frame.pass(r, i);
+                uint64_t passStart = out.nowNs();
+                shiftColumns(frame.planeWords(r, pass.plane), cols);
+                latchRow(r);
+
+                uint32_t onNs = (uint32_t)(((uint64_t)pass.onUnits * unitQ8) >> 8);
+                uint32_t waitNs = onNs > storeNs ? onNs - storeNs : 0;
+                out.clear(HUB75_OE_MASK);
+                out.waitNs(waitNs);
+                out.set(HUB75_OE_MASK);
+                measuredShiftNs += out.nowNs() - passStart - waitNs;
+            }
+        }
+
+        // Dark remainder of the period (clamped unit or a mostly black frame)
+        uint64_t elapsed = out.nowNs() - start;
+        if (elapsed < targetNs) {
+            out.waitNs((uint32_t)(targetNs - elapsed));
+        }
+        lastPeriodNs = out.nowNs() - start;
+
+        if (frame.totalPasses > 0) {
+            passShiftNs = (uint32_t)(measuredShiftNs / (uint64_t)frame.totalPasses);
+        }
+        frames++;
+    }
+
+    void end() {
+        out.set(HUB75_OE_MASK);
+        out.clear(HUB75_CLOCK_MASK | HUB75_STROBE_MASK | colorMask | rowMask);
+    }
+};
+
+// ============================================================================
+// GPIOMEM OUTPUT
+// ============================================================================
+
+class GpiomemMatrixOutput {
+private:
+    GpiomemBackend gpio;
+
+public:
+    bool init(const MatrixConfig& config) {
+        int pins[32];
+        int count = 0;
+        pins[count++] = HUB75_PIN_STROBE;
+        pins[count++] = HUB75_PIN_CLOCK;
+        pins[count++] = HUB75_PIN_OE;
+        for (int i = 0; i < (config.panelRows > 32 ? 5 : 4); i++) {
+            pins[count++] = HUB75_ROW_PINS[i];
+        }
+        for (int chain = 0; chain < config.parallel; chain++) {
+            for (int i = 0; i < 6; i++) {
+                pins[count++] = HUB75_COLOR_PINS[chain][i];
+            }
+        }
+        return gpio.init() && gpio.configureOutputs(pins, count);
+    }
+
+    void terminate() { gpio.terminate(); }
+
+    void set(uint32_t mask) { gpio.setMask(mask); }
+    void clear(uint32_t mask) { gpio.clearMask(mask); }
+    uint64_t nowNs() const { return monotonicNs(); }
+
+    void waitNs(uint32_t ns) {
+        uint64_t deadline = monotonicNs() + ns;
+        while (monotonicNs() < deadline) {
+        }
+    }
+};
+
+#endif // HUB75_H
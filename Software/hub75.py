@@ -0,0 +1,212 @@
+"""
+Python bindings for libhub75 (hub75Api.h), the adapter's matrix and LEDs
+
+Build the library next to this file first:
+  g++ -O2 -shared -fPIC -fvisibility=hidden -o libhub75.so hub75Library.cpp -lpthread
+or point HUB75_LIBRARY at it.
+
+    import numpy, hub75
+    matrix = hub75.Matrix(simulated=True)
+    pixels = numpy.asarray(matrix.canvas(0))   # (rows, width, 3) uint8, no copy
+    pixels[:] = frame
+    matrix.swap(0)
+
+canvas() is a memoryview straight onto the library's canvas (buffer
+protocol), so NumPy, PIL (Image.frombuffer) or plain slicing write the
+pixels in place. Like hub75Api.h says, every swap() moves the canvas: fetch
+canvas() again after each swap and redraw it completely. A view keeps the
+library's matrix alive, so close() only frees it once the last view is gone.
+"""
+
+import ctypes
+import os
+import weakref
+
+API_VERSION = 1
+
+PATTERN_FLASH, PATTERN_BLINK, PATTERN_LEVEL, PATTERN_TRAFFIC = range(4)
+COLOR_OFF, COLOR_RED, COLOR_GREEN, COLOR_YELLOW, COLOR_BLUE = 0, 1, 2, 3, 4
+
+
+class Config(ctypes.Structure):
+    _fields_ = [
+        ("rows", ctypes.c_int32),
+        ("cols", ctypes.c_int32),
+        ("chain_length", ctypes.c_int32),
+        ("parallel", ctypes.c_int32),
+        ("bits", ctypes.c_int32),
+        ("gamma", ctypes.c_double),
+    ]
+
+
+class Led(ctypes.Structure):
+    _fields_ = [
+        ("pins", ctypes.c_int32 * 3),
+        ("brightness", ctypes.c_uint8 * 3),
+        ("idle_color", ctypes.c_uint8),
+        ("active_color", ctypes.c_uint8),
+        ("pattern", ctypes.c_int32),
+    ]
+
+
+def _load():
+    path = os.environ.get("HUB75_LIBRARY") or os.path.join(os.path.dirname(os.path.abspath(__file__)), "libhub75.so")
+    lib = ctypes.CDLL(path)
+    matrix = ctypes.c_void_p
+    leds = ctypes.c_void_p
+    u8 = ctypes.c_uint8
+    i32 = ctypes.c_int32
+    signatures = {
+        "hub75_api_version": (i32, []),
+        "hub75_error": (ctypes.c_char_p, []),
+        "hub75_default_config": (None, [ctypes.POINTER(Config)]),
+        "hub75_open": (matrix, [ctypes.POINTER(Config), i32]),
+        "hub75_close": (None, [matrix]),
+        "hub75_width": (i32, [matrix]),
+        "hub75_chain_rows": (i32, [matrix]),
+        "hub75_chains": (i32, [matrix]),
+        "hub75_canvas": (ctypes.POINTER(u8), [matrix, i32]),
+        "hub75_set_pixel": (None, [matrix, i32, i32, i32, u8, u8, u8]),
+        "hub75_fill": (None, [matrix, i32, u8, u8, u8]),
+        "hub75_swap": (None, [matrix, i32]),
+        "hub75_write_ppm": (i32, [matrix, ctypes.c_char_p]),
+        "hub75_leds_open": (leds, [ctypes.POINTER(Led), i32, i32]),
+        "hub75_leds_close": (None, [leds]),
+        "hub75_leds_update": (None, [leds, ctypes.POINTER(u8), ctypes.POINTER(u8), ctypes.c_uint32]),
+        "hub75_leds_color": (u8, [leds, i32]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        function = getattr(lib, name)
+        function.restype = restype
+        function.argtypes = argtypes
+    if lib.hub75_api_version() != API_VERSION:
+        raise ImportError("%s has API version %d, expected %d" % (path, lib.hub75_api_version(), API_VERSION))
+    return lib
+
+
+lib = _load()
+
+
+def _error():
+    return lib.hub75_error().decode()
+
+
+class Matrix:
+    """P0/P1 as one logical display per chain; see hub75Api.h"""
+
+    def __init__(self, rows=None, cols=None, chain_length=None, parallel=None, bits=None, gamma=None,
+                 simulated=False):
+        self._handle = None
+        self._closed = False
+        self._views = 0
+        config = Config()
+        lib.hub75_default_config(ctypes.byref(config))
+        for name, value in (("rows", rows), ("cols", cols), ("chain_length", chain_length),
+                            ("parallel", parallel), ("bits", bits), ("gamma", gamma)):
+            if value is not None:
+                setattr(config, name, value)
+        self._handle = lib.hub75_open(ctypes.byref(config), 1 if simulated else 0)
+        if not self._handle:
+            raise OSError(_error())
+        self.width = lib.hub75_width(self._handle)
+        self.rows = lib.hub75_chain_rows(self._handle)
+        self.chains = lib.hub75_chains(self._handle)
+
+    def close(self):
+        """Stop the matrix; the library lets go of it once no canvas view is left"""
+        self._closed = True
+        if self._handle and self._views == 0:
+            lib.hub75_close(self._handle)
+            self._handle = None
+
+    def _view_released(self):
+        self._views -= 1
+        if self._closed:
+            self.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    def canvas(self, chain=0):
+        """Writable (rows, width, 3) uint8 view of the chain's canvas, valid until swap()
+
+        The view keeps the library memory alive, also across close().
+        """
+        if self._closed:
+            raise ValueError("matrix is closed")
+        address = lib.hub75_canvas(self._handle, chain)
+        if not address:
+            raise IndexError(_error())
+        size = self.rows * self.width * 3
+        raw = (ctypes.c_uint8 * size).from_address(ctypes.addressof(address.contents))
+        self._views += 1
+        weakref.finalize(raw, self._view_released)
+        return memoryview(raw).cast("B", (self.rows, self.width, 3))
+
+    def _open_handle(self):
+        # A closed matrix kept alive by its views takes no more calls
+        return None if self._closed else self._handle
+
+    def set_pixel(self, chain, x, y, r, g, b):
+        lib.hub75_set_pixel(self._open_handle(), chain, x, y, r, g, b)
+
+    def fill(self, chain, r, g, b):
+        lib.hub75_fill(self._open_handle(), chain, r, g, b)
+
+    def swap(self, chain=0):
+        lib.hub75_swap(self._open_handle(), chain)
+
+    def write_ppm(self, path):
+        if not lib.hub75_write_ppm(self._open_handle(), os.fsencode(path)):
+            raise OSError(_error())
+
+
+class Leds:
+    """Status LEDs with the patterns of indicators.h; input i drives LED i"""
+
+    def __init__(self, leds, simulated=False):
+        self._handle = None
+        array = (Led * len(leds))()
+        for i, led in enumerate(leds):
+            pins = list(led["pins"]) + [-1] * (3 - len(led["pins"]))
+            array[i].pins[:] = pins
+            array[i].brightness[:] = list(led.get("brightness", (255, 255, 255)))
+            array[i].idle_color = led.get("idle", COLOR_OFF)
+            array[i].active_color = led.get("active", COLOR_GREEN)
+            array[i].pattern = led.get("pattern", PATTERN_LEVEL)
+        self._handle = lib.hub75_leds_open(array, len(leds), 1 if simulated else 0)
+        if not self._handle:
+            raise OSError(_error())
+        self.count = len(leds)
+        self._loads = (ctypes.c_uint8 * self.count)()
+        self._active = (ctypes.c_uint8 * self.count)()
+
+    def close(self):
+        if self._handle:
+            lib.hub75_leds_close(self._handle)
+            self._handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    def update(self, loads, active, now_ms):
+        """loads in percent (0-100) and active flags, one per LED"""
+        for i in range(self.count):
+            self._loads[i] = max(0, min(100, int(loads[i])))
+            self._active[i] = 1 if active[i] else 0
+        lib.hub75_leds_update(self._handle, self._loads, self._active, now_ms & 0xFFFFFFFF)
+
+    def color(self, led):
+        return lib.hub75_leds_color(self._handle, led)
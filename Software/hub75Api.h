@@ -0,0 +1,119 @@
+/*
+ * C API of libhub75, the adapter's matrix and status LEDs as a shared library
+ *
+ * Build:
+ *   g++ -O2 -shared -fPIC -fvisibility=hidden -o libhub75.so hub75Library.cpp -lpthread
+ *
+ * Plain C, opaque handles and fixed-width types only, so the ABI stays the
+ * same as the C++ behind it changes; hub75_api_version() is bumped when it
+ * does not. hub75.py binds it for Python with ctypes.
+ *
+ * Matrix: every chain (P0, P1) is a logical display with its own canvas,
+ * as in --dual mode. Draw into the canvas of a chain, then swap it; the
+ * library converts and scans it out on threads of its own. The canvas is
+ * width * rows * 3 bytes of RGB, row-major, and can be written in place:
+ * its address changes with every swap, and after a swap it holds older
+ * content that must be redrawn completely.
+ *
+ * With simulated set nothing touches the GPIOs: swaps convert on the
+ * caller's thread and hub75_write_ppm() scans the current frame out on a
+ * SimulatedPanel and saves what the panel would show.
+ *
+ * Functions returning a handle or int report failure as NULL or 0, with
+ * the reason in hub75_error(). A NULL handle or pointer argument is
+ * refused the same way, void functions then do nothing.
+ */
+
+#ifndef HUB75_API_H
+#define HUB75_API_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(HUB75_BUILDING_LIBRARY)
+#define HUB75_API __attribute__((visibility("default")))
+#else
+#define HUB75_API
+#endif
+
+#define HUB75_API_VERSION 1
+
+typedef struct hub75_matrix hub75_matrix;
+typedef struct hub75_leds hub75_leds;
+
+typedef struct {
+    int32_t rows;            /* Panel rows: 16, 32 or 64 */
+    int32_t cols;            /* Panel columns */
+    int32_t chain_length;    /* Panels per chain */
+    int32_t parallel;        /* 1 = P0 only, 2 = P0 and P1 */
+    int32_t bits;            /* Bitplanes, 1-11 */
+    double gamma;
+} hub75_config;
+
+/* LED patterns and colors, as in indicators.h */
+enum {
+    HUB75_PATTERN_FLASH = 0,
+    HUB75_PATTERN_BLINK = 1,
+    HUB75_PATTERN_LEVEL = 2,
+    HUB75_PATTERN_TRAFFIC = 3
+};
+
+enum {
+    HUB75_COLOR_OFF = 0,
+    HUB75_COLOR_RED = 1,
+    HUB75_COLOR_GREEN = 2,
+    HUB75_COLOR_YELLOW = 3,
+    HUB75_COLOR_BLUE = 4
+};
+
+typedef struct {
+    int32_t pins[3];         /* BCM pins of the red, green, blue channel, -1 = none */
+    uint8_t brightness[3];   /* Must be 255 (on/off) for fitted pins: no PWM yet */
+    uint8_t idle_color;
+    uint8_t active_color;
+    int32_t pattern;
+} hub75_led;
+
+HUB75_API int32_t hub75_api_version(void);
+
+/* Reason for the last failure on this thread */
+HUB75_API const char* hub75_error(void);
+
+/* Adapter defaults: 64x32 panels, one per chain, P0 and P1, 11 bits */
+HUB75_API void hub75_default_config(hub75_config* config);
+
+HUB75_API hub75_matrix* hub75_open(const hub75_config* config, int32_t simulated);
+HUB75_API void hub75_close(hub75_matrix* matrix);
+
+HUB75_API int32_t hub75_width(const hub75_matrix* matrix);
+HUB75_API int32_t hub75_chain_rows(const hub75_matrix* matrix);
+HUB75_API int32_t hub75_chains(const hub75_matrix* matrix);
+
+/* Canvas of a chain to draw the next frame into, NULL for a bad chain */
+HUB75_API uint8_t* hub75_canvas(hub75_matrix* matrix, int32_t chain);
+
+HUB75_API void hub75_set_pixel(hub75_matrix* matrix, int32_t chain, int32_t x, int32_t y,
+                               uint8_t r, uint8_t g, uint8_t b);
+HUB75_API void hub75_fill(hub75_matrix* matrix, int32_t chain, uint8_t r, uint8_t g, uint8_t b);
+
+/* Publish the drawn canvas of a chain; never waits for the scan-out */
+HUB75_API void hub75_swap(hub75_matrix* matrix, int32_t chain);
+
+/* Simulated matrices only */
+HUB75_API int32_t hub75_write_ppm(hub75_matrix* matrix, const char* path);
+
+/* Status LEDs; input i drives LED i */
+HUB75_API hub75_leds* hub75_leds_open(const hub75_led* leds, int32_t count, int32_t simulated);
+HUB75_API void hub75_leds_close(hub75_leds* leds);
+HUB75_API void hub75_leds_update(hub75_leds* leds, const uint8_t* load_percent, const uint8_t* active,
+                                 uint32_t now_ms);
+HUB75_API uint8_t hub75_leds_color(const hub75_leds* leds, int32_t led);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HUB75_API_H */
@@ -0,0 +1,193 @@
+"""
+Benchmark of the Python bindings (hub75.py) on a simulated matrix
+
+Build libhub75.so first (see hub75Api.h), then:
+  python3 hub75Benchmark.py
+
+Compares writing a whole frame through the zero-copy canvas (a NumPy
+assignment, or a memoryview slice assignment where NumPy is not installed)
+with one set_pixel() call per pixel, and checks that the canvas really is
+the library's memory. Exits non-zero if a check fails.
+"""
+
+import ctypes
+import os
+import sys
+import tempfile
+import time
+
+import hub75
+
+try:
+    import numpy
+except ImportError:
+    numpy = None
+
+failures = 0
+
+
+def check(condition, what):
+    global failures
+    print("  check %-48s %s" % (what, "ok" if condition else "FAILED"))
+    if not condition:
+        failures += 1
+
+
+def best_of(runs, function):
+    best = None
+    for _ in range(runs):
+        start = time.perf_counter_ns()
+        function()
+        elapsed = time.perf_counter_ns() - start
+        best = elapsed if best is None or elapsed < best else best
+    return best
+
+
+def read_ppm(path):
+    with open(path, "rb") as file:
+        data = file.read()
+    fields = data.split(maxsplit=4)
+    width, height = int(fields[1]), int(fields[2])
+    return width, height, data[len(data) - width * height * 3:]
+
+
+def benchmark_writes(cols, chain_length):
+    matrix = hub75.Matrix(cols=cols, chain_length=chain_length, simulated=True)
+    width, rows = matrix.width, matrix.rows
+    pixels = width * rows
+    frame = bytes((x * 7 + y * 3 + c * 85) & 0xFF for y in range(rows) for x in range(width) for c in range(3))
+
+    canvas = matrix.canvas(0)
+    if numpy is not None:
+        array = numpy.asarray(canvas)
+        source = numpy.frombuffer(frame, dtype=numpy.uint8).reshape(rows, width, 3)
+        method = "numpy"
+
+        def write_frame():
+            array[:] = source
+    else:
+        flat = canvas.cast("B")
+        method = "memoryview"
+
+        def write_frame():
+            flat[:] = frame
+
+    def set_pixels():
+        set_pixel = matrix.set_pixel
+        i = 0
+        for y in range(rows):
+            for x in range(width):
+                set_pixel(0, x, y, frame[i], frame[i + 1], frame[i + 2])
+                i += 3
+
+    def set_pixels_raw():
+        set_pixel = hub75.lib.hub75_set_pixel
+        handle = matrix._handle
+        i = 0
+        for y in range(rows):
+            for x in range(width):
+                set_pixel(handle, 0, x, y, frame[i], frame[i + 1], frame[i + 2])
+                i += 3
+
+    frame_ns = best_of(20, write_frame)
+    check(canvas.tobytes() == frame, "%dx%d frame written in place" % (width, rows))
+    pixel_ns = best_of(3, set_pixels)
+    raw_ns = best_of(3, set_pixels_raw)
+    swap_ns = best_of(5, lambda: matrix.swap(0))
+    print("  %dx%d chain: %s frame %.1f us, set_pixel() %.1f ms (%.2f us/pixel, %.2f us calling the "
+          "library directly), swap %.1f us; frame write %.0fx faster"
+          % (width, rows, method, frame_ns / 1e3, pixel_ns / 1e6, pixel_ns / 1e3 / pixels, raw_ns / 1e3 / pixels,
+             swap_ns / 1e3, pixel_ns / frame_ns))
+    matrix.close()
+
+
+def check_zero_copy():
+    matrix = hub75.Matrix(simulated=True)
+    width, rows = matrix.width, matrix.rows
+    canvas = matrix.canvas(0)
+    address = hub75.lib.hub75_canvas(matrix._handle, 0)
+    check(canvas.shape == (rows, width, 3) and not canvas.readonly, "canvas is a writable (rows, width, 3) view")
+    matrix.set_pixel(0, 5, 3, 10, 20, 30)
+    check(canvas[3, 5, 0] == 10 and canvas[3, 5, 2] == 30, "set_pixel() lands in the view")
+    canvas[7, 9, 1] = 99
+    check(address[(7 * width + 9) * 3 + 1] == 99, "view writes land in the library canvas")
+
+    # P0 red through the view, P1 blue through fill(); the panel must show both
+    canvas.cast("B")[:] = bytes((255, 0, 0)) * (width * rows)
+    matrix.swap(0)
+    swapped = hub75.lib.hub75_canvas(matrix._handle, 0)
+    check(ctypes.addressof(swapped.contents) != ctypes.addressof(address.contents), "swap() hands out the next canvas")
+    matrix.fill(1, 0, 0, 255)
+    matrix.swap(1)
+    with tempfile.TemporaryDirectory() as directory:
+        path = os.path.join(directory, "frame.ppm")
+        matrix.write_ppm(path)
+        ppm_width, ppm_height, image = read_ppm(path)
+    top = image[(5 * ppm_width + 5) * 3:(5 * ppm_width + 5) * 3 + 3]
+    bottom = image[((rows + 5) * ppm_width + 5) * 3:((rows + 5) * ppm_width + 5) * 3 + 3]
+    check(ppm_width == width and ppm_height == 2 * rows, "simulated panel is %dx%d" % (width, 2 * rows))
+    check(top[0] > 200 and top[2] == 0 and bottom[2] > 200 and bottom[0] == 0, "P0 red and P1 blue scanned out")
+    matrix.close()
+
+    lib = hub75.lib
+    guarded = (lib.hub75_width(None) == 0 and lib.hub75_chains(None) == 0 and lib.hub75_chain_rows(None) == 0 and
+               not lib.hub75_canvas(None, 0) and lib.hub75_write_ppm(None, b"/dev/null") == 0 and
+               lib.hub75_error() == b"no matrix")
+    lib.hub75_leds_update(None, None, None, 0)
+    check(guarded and lib.hub75_leds_color(None, 0) == hub75.COLOR_OFF and lib.hub75_error() == b"no LEDs",
+          "NULL handles are refused")
+
+    # A view outlives its matrix, a closed matrix hands out no more views
+    orphan = hub75.Matrix(simulated=True).canvas(0)
+    orphan_pixels = numpy.asarray(orphan) if numpy is not None else orphan.cast("B")
+    orphan_pixels[:] = 255
+    survivor = hub75.Matrix(simulated=True)
+    survivor.fill(0, 1, 2, 3)
+    check(orphan.tobytes() == bytes((255,)) * len(orphan.tobytes()) and survivor.canvas(0)[0, 0, 2] == 3,
+          "canvas view keeps its matrix alive")
+    del orphan, orphan_pixels
+    survivor.close()
+    try:
+        survivor.canvas(0)
+        check(False, "closed matrix refuses canvas()")
+    except ValueError:
+        check(True, "closed matrix refuses canvas()")
+
+    try:
+        hub75.Matrix(rows=24, simulated=True)
+        check(False, "bad geometry is refused")
+    except OSError as error:
+        check(str(error) == "unsupported matrix geometry", "bad geometry is refused")
+
+
+def check_leds():
+    leds = hub75.Leds([
+        {"pins": (17, 27), "idle": hub75.COLOR_RED, "active": hub75.COLOR_GREEN},
+        {"pins": (22, 23), "pattern": hub75.PATTERN_TRAFFIC},
+    ], simulated=True)
+    leds.update([10, 30], [False, True], 0)
+    idle = (leds.color(0), leds.color(1))
+    leds.update([10, 90], [True, True], 10)
+    busy = (leds.color(0), leds.color(1))
+    check(idle == (hub75.COLOR_RED, hub75.COLOR_GREEN) and busy == (hub75.COLOR_GREEN, hub75.COLOR_RED),
+          "LED level and traffic patterns")
+    leds.close()
+
+    try:
+        hub75.Leds([{"pins": (17, 27), "brightness": (255, 32, 255)}], simulated=True)
+        check(False, "dimmed LED channel is refused")
+    except OSError:
+        check(True, "dimmed LED channel is refused")
+
+
+def main():
+    print("python bindings (%s)" % ("numpy %s" % numpy.__version__ if numpy is not None else "no numpy"))
+    check_zero_copy()
+    check_leds()
+    benchmark_writes(64, 1)
+    benchmark_writes(64, 4)
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
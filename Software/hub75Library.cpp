@@ -0,0 +1,332 @@
+/*
+ * libhub75 - hub75Api.h on top of the header-only driver
+ *
+ * Compilation:
+ *   g++ -O2 -shared -fPIC -fvisibility=hidden -o libhub75.so hub75Library.cpp -lpthread
+ *
+ * A matrix is a DualDisplay, one logical display per chain. A live matrix
+ * runs the DualDisplay converter thread and a scan thread that keeps
+ * Hub75Scanner on /dev/gpiomem going until hub75_close(); a simulated one
+ * converts on hub75_swap() and scans only for hub75_write_ppm(). The column
+ * clock gets the default slowdown of the Pi it runs on.
+ *
+ * Only the hub75_ functions are exported; the C++ inside may change freely.
+ */
+
+#define HUB75_BUILDING_LIBRARY
+#define GPIO_NO_PIGPIO  // Scan-out writes GPIO registers directly
+
+#include <new>
+#include <pthread.h>
+#include "dualDisplay.h"
+#include "hub75.h"
+#include "hub75Api.h"
+#include "hub75Simulator.h"
+#include "indicators.h"
+
+static thread_local const char* lastError = "";
+
+static void fail(const char* error) {
+    lastError = error;
+}
+
+struct hub75_matrix {
+    MatrixConfig config;
+    DualDisplay dual;
+    bool simulated;
+    GpiomemMatrixOutput output;
+    Hub75Scanner<GpiomemMatrixOutput> scanner;
+    pthread_t scanThread;
+    bool scanning;
+    volatile bool stopping;
+
+    hub75_matrix(const MatrixConfig& cfg, double gamma, bool simulatedPanel)
+        : config(cfg), dual(cfg, gamma), simulated(simulatedPanel), scanner(output, cfg), scanning(false),
+          stopping(false) {}
+
+    static void* scanLoop(void* arg) {
+        hub75_matrix* self = (hub75_matrix*)arg;
+        self->scanner.begin();
+        while (!self->stopping) {
+            self->scanner.scanFrame(self->dual.frameToScan());
+        }
+        self->scanner.end();
+        return nullptr;
+    }
+};
+
+struct hub75_leds {
+    IndicatorPanel panel;
+    GpioBackend* gpio;
+    IndicatorInput inputs[INDICATOR_MAX];
+    FastRandom random;
+
+    hub75_leds(const IndicatorConfig* configs, int count)
+        : panel(configs, count, DEFAULT_FLASH_SETTINGS), gpio(nullptr), random((uint32_t)monotonicNs()) {
+        memset(inputs, 0, sizeof(inputs));
+    }
+};
+
+static bool validMatrix(const hub75_matrix* matrix) {
+    if (!matrix) {
+        fail("no matrix");
+        return false;
+    }
+    return true;
+}
+
+static bool validChain(const hub75_matrix* matrix, int32_t chain) {
+    if (!validMatrix(matrix)) {
+        return false;
+    }
+    if (chain < 0 || chain >= matrix->config.parallel) {
+        fail("no such chain");
+        return false;
+    }
+    return true;
+}
+
+static bool validLeds(const hub75_leds* leds) {
+    if (!leds) {
+        fail("no LEDs");
+        return false;
+    }
+    return true;
+}
+
+extern "C" {
+
+int32_t hub75_api_version(void) {
+    return HUB75_API_VERSION;
+}
+
+const char* hub75_error(void) {
+    return lastError;
+}
+
+void hub75_default_config(hub75_config* config) {
+    if (!config) {
+        fail("no config");
+        return;
+    }
+    config->rows = DEFAULT_MATRIX_CONFIG.panelRows;
+    config->cols = DEFAULT_MATRIX_CONFIG.panelCols;
+    config->chain_length = DEFAULT_MATRIX_CONFIG.chainLength;
+    config->parallel = DEFAULT_MATRIX_CONFIG.parallel;
+    config->bits = DEFAULT_MATRIX_CONFIG.planes;
+    config->gamma = 2.2;
+}
+
+hub75_matrix* hub75_open(const hub75_config* config, int32_t simulated) {
+    if (!config) {
+        fail("no config");
+        return nullptr;
+    }
+    MatrixConfig cfg = DEFAULT_MATRIX_CONFIG;
+    cfg.panelRows = config->rows;
+    cfg.panelCols = config->cols;
+    cfg.chainLength = config->chain_length;
+    cfg.parallel = config->parallel;
+    cfg.planes = config->bits;
+    cfg.clockSlowdown = hub75DefaultSlowdown();
+    if ((cfg.panelRows != 16 && cfg.panelRows != 32 && cfg.panelRows != 64) || cfg.panelCols <= 0 ||
+        cfg.chainLength <= 0 || cfg.parallel < 1 || cfg.parallel > HUB75_CHAINS || cfg.planes < 1 ||
+        cfg.planes > HUB75_MAX_PLANES || config->gamma <= 0.0) {
+        fail("unsupported matrix geometry");
+        return nullptr;
+    }
+
+    hub75_matrix* matrix = new (std::nothrow) hub75_matrix(cfg, config->gamma, simulated != 0);
+    if (!matrix) {
+        fail("out of memory");
+        return nullptr;
+    }
+    if (matrix->simulated) {
+        return matrix;
+    }
+    if (!matrix->output.init(cfg)) {
+        delete matrix;
+        fail("cannot map /dev/gpiomem (run with sudo)");
+        return nullptr;
+    }
+    if (!matrix->dual.start() ||
+        pthread_create(&matrix->scanThread, nullptr, hub75_matrix::scanLoop, matrix) != 0) {
+        matrix->dual.stop();
+        matrix->output.terminate();
+        delete matrix;
+        fail("cannot start the scan-out threads");
+        return nullptr;
+    }
+    matrix->scanning = true;
+    return matrix;
+}
+
+void hub75_close(hub75_matrix* matrix) {
+    if (!matrix) {
+        return;
+    }
+    if (matrix->scanning) {
+        matrix->stopping = true;
+        pthread_join(matrix->scanThread, nullptr);
+        matrix->dual.stop();
+        matrix->output.terminate();
+    }
+    delete matrix;
+}
+
+int32_t hub75_width(const hub75_matrix* matrix) {
+    return validMatrix(matrix) ? matrix->config.width() : 0;
+}
+
+int32_t hub75_chain_rows(const hub75_matrix* matrix) {
+    return validMatrix(matrix) ? matrix->config.panelRows : 0;
+}
+
+int32_t hub75_chains(const hub75_matrix* matrix) {
+    return validMatrix(matrix) ? matrix->config.parallel : 0;
+}
+
+uint8_t* hub75_canvas(hub75_matrix* matrix, int32_t chain) {
+    if (!validChain(matrix, chain)) {
+        return nullptr;
+    }
+    return matrix->dual.display(chain).canvas().row(0);
+}
+
+void hub75_set_pixel(hub75_matrix* matrix, int32_t chain, int32_t x, int32_t y, uint8_t r, uint8_t g, uint8_t b) {
+    if (validChain(matrix, chain)) {
+        matrix->dual.display(chain).canvas().setPixel(x, y, r, g, b);
+    }
+}
+
+void hub75_fill(hub75_matrix* matrix, int32_t chain, uint8_t r, uint8_t g, uint8_t b) {
+    if (validChain(matrix, chain)) {
+        Canvas& canvas = matrix->dual.display(chain).canvas();
+        canvas.fillRect(0, 0, canvas.width(), canvas.height(), r, g, b);
+    }
+}
+
+void hub75_swap(hub75_matrix* matrix, int32_t chain) {
+    if (!validChain(matrix, chain)) {
+        return;
+    }
+    matrix->dual.display(chain).swap();
+    if (matrix->simulated) {
+        matrix->dual.update();
+        matrix->dual.frameToScan();
+    }
+}
+
+int32_t hub75_write_ppm(hub75_matrix* matrix, const char* path) {
+    if (!validMatrix(matrix)) {
+        return 0;
+    }
+    if (!path) {
+        fail("no path");
+        return 0;
+    }
+    if (!matrix->simulated) {
+        fail("not a simulated matrix");
+        return 0;
+    }
+    SimulatedPanel panel(matrix->config, PI_ZERO_STORE_NS);
+    Hub75Scanner<SimulatedPanel> scanner(panel, matrix->config);
+    scanner.begin();
+    scanner.scanFrame(matrix->dual.frameToScan());
+    panel.resetExposure();
+    scanner.scanFrame(matrix->dual.frameToScan());
+    if (!panel.writePpm(path)) {
+        fail("cannot write the PPM file");
+        return 0;
+    }
+    return 1;
+}
+
+hub75_leds* hub75_leds_open(const hub75_led* leds, int32_t count, int32_t simulated) {
+    if (!leds) {
+        fail("no LEDs");
+        return nullptr;
+    }
+    if (count < 1 || count > INDICATOR_MAX) {
+        fail("unsupported LED count");
+        return nullptr;
+    }
+    IndicatorConfig configs[INDICATOR_MAX];
+    for (int i = 0; i < count; i++) {
+        for (int c = 0; c < INDICATOR_CHANNELS; c++) {
+            if (leds[i].pins[c] >= GPIO_MAX_PINS) {
+                fail("LED pin out of range");
+                return nullptr;
+            }
+            // The library drives LEDs through gpiomem or cdev, which have no PWM
+            if (leds[i].pins[c] >= 0 && leds[i].brightness[c] != 255) {
+                fail("LED brightness below 255 needs PWM, which libhub75 does not support");
+                return nullptr;
+            }
+            configs[i].pins[c] = leds[i].pins[c] < 0 ? -1 : leds[i].pins[c];
+            configs[i].brightness[c] = leds[i].brightness[c];
+        }
+        configs[i].idleColor = leds[i].idle_color;
+        configs[i].activeColor = leds[i].active_color;
+        configs[i].source = i;
+        configs[i].pattern = (IndicatorPattern)(leds[i].pattern >= HUB75_PATTERN_FLASH &&
+                                                leds[i].pattern <= HUB75_PATTERN_TRAFFIC
+                                                    ? leds[i].pattern : HUB75_PATTERN_LEVEL);
+    }
+
+    hub75_leds* handle = new (std::nothrow) hub75_leds(configs, count);
+    if (!handle) {
+        fail("out of memory");
+        return nullptr;
+    }
+    GpioBackendType type = simulated ? GPIO_BACKEND_SIMULATED : selectGpioBackend(GPIO_BACKEND_AUTO, false);
+    handle->gpio = createGpioBackend(type);
+    int pins[INDICATOR_MAX * INDICATOR_CHANNELS];
+    int pinCount = handle->panel.pins(pins);
+    if (!handle->gpio || !handle->gpio->init() || !handle->gpio->configureOutputs(pins, pinCount)) {
+        delete handle->gpio;
+        delete handle;
+        fail("cannot open the GPIOs");
+        return nullptr;
+    }
+    handle->panel.showIdle(*handle->gpio);
+    return handle;
+}
+
+void hub75_leds_close(hub75_leds* leds) {
+    if (!leds) {
+        return;
+    }
+    leds->panel.off(*leds->gpio);
+    leds->gpio->terminate();
+    delete leds->gpio;
+    delete leds;
+}
+
+void hub75_leds_update(hub75_leds* leds, const uint8_t* load_percent, const uint8_t* active, uint32_t now_ms) {
+    if (!validLeds(leds)) {
+        return;
+    }
+    if (!load_percent || !active) {
+        fail("no LED inputs");
+        return;
+    }
+    for (int i = 0; i < leds->panel.size(); i++) {
+        leds->inputs[i].load = percentToFixed(load_percent[i]);
+        leds->inputs[i].active = active[i] != 0;
+    }
+    leds->panel.tick(*leds->gpio, leds->inputs, now_ms, leds->random);
+}
+
+uint8_t hub75_leds_color(const hub75_leds* leds, int32_t led) {
+    if (!validLeds(leds)) {
+        return HUB75_COLOR_OFF;
+    }
+    if (led < 0 || led >= leds->panel.size()) {
+        fail("no such LED");
+        return HUB75_COLOR_OFF;
+    }
+    return leds->panel.color(led);
+}
+
+} // extern "C"
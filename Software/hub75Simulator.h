@@ -0,0 +1,168 @@
+/*
+ * Simulated HUB75 panel for off-target scan-out tests
+ *
+ * SimulatedPanel is a Hub75Scanner output: it decodes the GPSET0/GPCLR0
+ * store stream like the panels do (shift on CLOCK rising, latch on STROBE
+ * rising, light while OE is low) on a virtual clock, and accumulates the
+ * on-time of every pixel channel. The reconstructed image is what a camera
+ * with the exposure of one frame would see.
+ *
+ * Register stores cost storeNs of virtual time each, so refresh rates can be
+ * estimated for different Pi models.
+ */
+
+#ifndef HUB75_SIMULATOR_H
+#define HUB75_SIMULATOR_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "hub75.h"
+
+// Approximate cost of one store to the GPIO block
+const uint32_t PI_ZERO_STORE_NS = 22;
+const uint32_t PI4_STORE_NS = 8;
+
+class SimulatedPanel {
+private:
+    MatrixConfig config;
+    uint32_t storeNs;
+    uint32_t levels;
+    uint32_t* shiftRing;   // Color pins sampled at each CLOCK edge
+    uint32_t* latched;
+    int ringPosition;
+    uint64_t now;
+    uint64_t litSince;     // Start of the current OE-on interval
+    uint64_t* onNs;        // [y][x][channel]
+
+    SimulatedPanel(const SimulatedPanel&);
+    SimulatedPanel& operator=(const SimulatedPanel&);
+
+    bool displaying() const { return (levels & HUB75_OE_MASK) == 0; }
+
+    int rowAddress() const {
+        int address = 0;
+        for (int i = 0; i < 5; i++) {
+            if (levels & (1u << HUB75_ROW_PINS[i])) {
+                address |= 1 << i;
+            }
+        }
+        return address % config.rowAddresses();
+    }
+
+    // Add the time since litSince to every lit pixel of the addressed rows
+    void accumulate() {
+        uint64_t dt = now - litSince;
+        litSince = now;
+        if (dt == 0) {
+            return;
+        }
+        const int cols = config.width();
+        const int rows = config.rowAddresses();
+        int address = rowAddress();
+        for (int chain = 0; chain < config.parallel; chain++) {
+            const int* pins = HUB75_COLOR_PINS[chain];
+            for (int half = 0; half < 2; half++) {
+                int y = chain * config.panelRows + half * rows + address;
+                uint64_t* row = onNs + (size_t)y * cols * 3;
+                for (int c = 0; c < cols; c++) {
+                    uint32_t word = latched[c];
+                    for (int k = 0; k < 3; k++) {
+                        if (word & (1u << pins[half * 3 + k])) {
+                            row[c * 3 + k] += dt;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void apply(uint32_t newLevels) {
+        uint32_t rising = newLevels & ~levels;
+        uint32_t changed = newLevels ^ levels;
+
+        if (displaying() && (changed & (HUB75_OE_MASK | hub75RowMask()) || (rising & HUB75_STROBE_MASK))) {
+            accumulate();
+        }
+        if (rising & HUB75_CLOCK_MASK) {
+            shiftRing[ringPosition] = levels & colorMask;
+            ringPosition = (ringPosition + 1) % config.width();
+            clockEdges++;
+        }
+        if (rising & HUB75_STROBE_MASK) {
+            // Oldest bit has travelled to the far end: column 0
+            const int cols = config.width();
+            for (int c = 0; c < cols; c++) {
+                latched[c] = shiftRing[(ringPosition + c) % cols];
+            }
+            latches++;
+        }
+        levels = newLevels;
+        if ((changed & HUB75_OE_MASK) && displaying()) {
+            litSince = now;
+        }
+        now += storeNs;
+        stores++;
+    }
+
+public:
+    uint32_t colorMask;
+    unsigned long stores;
+    unsigned long clockEdges;
+    unsigned long latches;
+
+    SimulatedPanel(const MatrixConfig& cfg, uint32_t storeCostNs)
+        : config(cfg), storeNs(storeCostNs), levels(HUB75_OE_MASK),
+          shiftRing(new uint32_t[(size_t)cfg.width()]), latched(new uint32_t[(size_t)cfg.width()]),
+          ringPosition(0), now(0), litSince(0),
+          onNs(new uint64_t[(size_t)cfg.width() * cfg.height() * 3]),
+          colorMask(hub75ChainMask(0) | hub75ChainMask(1)), stores(0), clockEdges(0), latches(0) {
+        memset(shiftRing, 0, (size_t)cfg.width() * sizeof(uint32_t));
+        memset(latched, 0, (size_t)cfg.width() * sizeof(uint32_t));
+        resetExposure();
+    }
+
+    ~SimulatedPanel() {
+        delete[] shiftRing;
+        delete[] latched;
+        delete[] onNs;
+    }
+
+    // Output interface for Hub75Scanner
+    void set(uint32_t mask) { apply(levels | mask); }
+    void clear(uint32_t mask) { apply(levels & ~mask); }
+    uint64_t nowNs() const { return now; }
+    void waitNs(uint32_t ns) { now += ns; }
+
+    void resetExposure() {
+        memset(onNs, 0, (size_t)config.width() * config.height() * 3 * sizeof(uint64_t));
+        litSince = now;
+        stores = 0;
+        clockEdges = 0;
+        latches = 0;
+    }
+
+    uint64_t exposure(int x, int y, int channel) const {
+        return onNs[((size_t)y * config.width() + x) * 3 + channel];
+    }
+
+    // Write the exposure as a binary PPM, scaled so the brightest channel is 255
+    bool writePpm(const char* path) const {
+        FILE* file = fopen(path, "wb");
+        if (!file) {
+            return false;
+        }
+        size_t count = (size_t)config.width() * config.height() * 3;
+        uint64_t peak = 1;
+        for (size_t i = 0; i < count; i++) {
+            peak = onNs[i] > peak ? onNs[i] : peak;
+        }
+        fprintf(file, "P6\n%d %d\n255\n", config.width(), config.height());
+        for (size_t i = 0; i < count; i++) {
+            fputc((int)((onNs[i] * 255 + peak / 2) / peak), file);
+        }
+        return fclose(file) == 0;
+    }
+};
+
+#endif // HUB75_SIMULATOR_H
@@ -0,0 +1,322 @@
+/*
+ * Front panel of status LEDs driven from activity sources
+ *
+ * Every indicator is an LED with one, two or three pins - single color,
+ * bi-color or RGB - on arbitrary GPIOs. Colors are channel masks: bit n
+ * lights pins[n]. Each indicator reads one input (a load and an active
+ * flag, indexed by the caller's source numbering) and shows it with a
+ * pattern:
+ *
+ *   flash   - random flashes of activeColor, more and longer with load,
+ *             idleColor in between (the classic monitor LED)
+ *   blink   - regular blink, faster with load, idleColor while inactive
+ *   level   - activeColor while the input is active, idleColor otherwise
+ *   traffic - green, yellow (red + green) or red by load; channel 0 is red
+ *             and channel 1 green, as on bi-color and RGB LEDs
+ *
+ * tick() works out the level of every pin first, then sends only the pins
+ * that changed as one writeMasks() call: one set and one clear register
+ * write however many LEDs there are. Channels dimmed with PWM (brightness
+ * below 255) cannot share a mask write and get their own pwm() call, only
+ * when they change.
+ */
+
+#ifndef INDICATORS_H
+#define INDICATORS_H
+
+#include <stdint.h>
+#include <string.h>
+#include "activityFilter.h"
+#include "gpioBackend.h"
+#include "leanIo.h"
+
+const int INDICATOR_CHANNELS = 3;
+const int INDICATOR_MAX = 16;
+
+const uint8_t COLOR_OFF = 0;
+const uint8_t COLOR_RED = 1;      // Channel 0
+const uint8_t COLOR_GREEN = 2;    // Channel 1
+const uint8_t COLOR_YELLOW = COLOR_RED | COLOR_GREEN;
+const uint8_t COLOR_BLUE = 4;     // Channel 2
+
+enum IndicatorPattern {
+    PATTERN_FLASH,
+    PATTERN_BLINK,
+    PATTERN_LEVEL,
+    PATTERN_TRAFFIC
+};
+
+struct IndicatorConfig {
+    int pins[INDICATOR_CHANNELS];               // -1 = channel not fitted
+    uint8_t brightness[INDICATOR_CHANNELS];     // 255 = plain on/off, else PWM duty
+    uint8_t idleColor;
+    uint8_t activeColor;
+    int source;                                 // Index into the tick() inputs
+    IndicatorPattern pattern;
+};
+
+struct IndicatorInput {
+    fixed_t load;
+    bool active;
+};
+
+// Timing of the flash pattern, probabilities in fixed point
+struct FlashSettings {
+    int minFlashMs;
+    int maxFlashMs;
+    int minPauseMs;
+    int64_t gainQ24;          // Flash chance per tick and percent of load
+    uint32_t variationQ16;    // Random spread of chance and duration
+};
+
+// Flash pattern of the LED monitor
+const int FLASH_MIN_DURATION_MS = 12;    // Flash duration at low load
+const int FLASH_MAX_DURATION_MS = 50;    // Flash duration at full load
+const int FLASH_MIN_PAUSE_MS = 30;       // Minimum time between flashes
+const double FLASH_BASE_CHANCE = 0.25;   // Base probability multiplier
+const double FLASH_CPU_SCALING = 0.04;   // Load influence on flash chance
+const double FLASH_VARIATION = 0.3;      // Random variation in flash timing
+
+// The same in fixed point (converted at compile time)
+const FlashSettings DEFAULT_FLASH_SETTINGS = {
+    FLASH_MIN_DURATION_MS,
+    FLASH_MAX_DURATION_MS,
+    FLASH_MIN_PAUSE_MS,
+    (int64_t)(FLASH_BASE_CHANCE * FLASH_CPU_SCALING * (1 << 24) + 0.5),
+    (uint32_t)(FLASH_VARIATION * FIXED_ONE + 0.5)
+};
+
+const int BLINK_SLOWEST_MS = 1000;  // Period at the activity threshold
+const int BLINK_FASTEST_MS = 100;   // Period at full load
+const fixed_t TRAFFIC_YELLOW = percentToFixed(50);
+const fixed_t TRAFFIC_RED = percentToFixed(85);
+
+class IndicatorPanel {
+private:
+    struct State {
+        uint8_t color;
+        bool lit;                 // Showing activeColor (flash, blink phase)
+        uint32_t since;           // When lit changed
+        int flashMs;
+    };
+
+    IndicatorConfig configs[INDICATOR_MAX];
+    State states[INDICATOR_MAX];
+    int count;
+    FlashSettings flash;
+    uint32_t maskPins;            // Pins driven through writeMasks()
+    uint32_t levels;              // Their last written levels
+    uint8_t duties[GPIO_MAX_PINS];
+
+    // Flash logic of the original single-LED monitor, unchanged
+    void flashTick(State& state, const IndicatorInput& input, uint32_t nowMs, FastRandom& random) {
+        int elapsed = (int)(nowMs - state.since);
+        if (state.lit) {
+            if (elapsed > state.flashMs) {
+                state.lit = false;
+                state.since = nowMs;
+            }
+            return;
+        }
+        if (!input.active || elapsed <= flash.minPauseMs) {
+            return;
+        }
+        // Probability in Q16: gain * load * (0.5 + rand * variation)
+        uint32_t randomFactor = FIXED_ONE / 2 + ((random.next16() * flash.variationQ16) >> FIXED_SHIFT);
+        int64_t scaledLoad = ((int64_t)input.load * flash.gainQ24) >> 24;
+        int64_t probability = (scaledLoad * randomFactor) >> FIXED_SHIFT;
+        if ((int64_t)random.next16() >= probability) {
+            return;
+        }
+        fixed_t clampedLoad = input.load < FIXED_100_PERCENT ? input.load : FIXED_100_PERCENT;
+        int range = flash.maxFlashMs - flash.minFlashMs;
+        int duration = flash.minFlashMs + (int)(((int64_t)range * clampedLoad) / FIXED_100_PERCENT);
+        int variation = (int)(((int64_t)range * flash.variationQ16 * random.next16()) >> (2 * FIXED_SHIFT));
+        duration += variation - (variation / 2);
+        state.flashMs = duration < flash.minFlashMs ? flash.minFlashMs
+                        : (duration > flash.maxFlashMs ? flash.maxFlashMs : duration);
+        state.lit = true;
+        state.since = nowMs;
+    }
+
+    void blinkTick(State& state, const IndicatorInput& input, uint32_t nowMs) {
+        if (!input.active) {
+            state.lit = false;
+            state.since = nowMs;
+            return;
+        }
+        fixed_t clampedLoad = input.load < FIXED_100_PERCENT ? input.load : FIXED_100_PERCENT;
+        int period = BLINK_SLOWEST_MS -
+                     (int)(((int64_t)(BLINK_SLOWEST_MS - BLINK_FASTEST_MS) * clampedLoad) / FIXED_100_PERCENT);
+        if ((int)(nowMs - state.since) >= period / 2) {
+            state.lit = !state.lit;
+            state.since = nowMs;
+        }
+    }
+
+    static uint8_t trafficColor(const IndicatorInput& input) {
+        if (!input.active) {
+            return COLOR_OFF;
+        }
+        return input.load >= TRAFFIC_RED ? COLOR_RED : (input.load >= TRAFFIC_YELLOW ? COLOR_YELLOW : COLOR_GREEN);
+    }
+
+    // Pins to raise and lower for the current colors; PWM channels are
+    // written here directly when their duty changes
+    void collect(GpioBackend& gpio, uint32_t& set, uint32_t& clear, bool force) {
+        uint32_t wanted = 0;
+        for (int i = 0; i < count; i++) {
+            const IndicatorConfig& config = configs[i];
+            for (int c = 0; c < INDICATOR_CHANNELS; c++) {
+                int pin = config.pins[c];
+                if (pin < 0) {
+                    continue;
+                }
+                bool on = (states[i].color >> c) & 1;
+                if (config.brightness[c] == 255) {
+                    wanted |= on ? 1u << pin : 0;
+                    continue;
+                }
+                uint8_t duty = on ? config.brightness[c] : 0;
+                if (force || duty != duties[pin]) {
+                    gpio.pwm(pin, duty);
+                    duties[pin] = duty;
+                    pwmWrites++;
+                }
+            }
+        }
+        uint32_t changed = force ? maskPins : (wanted ^ levels) & maskPins;
+        set = wanted & changed;
+        clear = ~wanted & changed;
+        levels = wanted;
+    }
+
+    void apply(GpioBackend& gpio, bool force) {
+        uint32_t set;
+        uint32_t clear;
+        collect(gpio, set, clear, force);
+        if (set | clear) {
+            gpio.writeMasks(set, clear);
+            maskWrites++;
+        }
+    }
+
+public:
+    unsigned long ticks;
+    unsigned long maskWrites;
+    unsigned long pwmWrites;
+
+    IndicatorPanel(const IndicatorConfig* indicators, int indicatorCount, const FlashSettings& flashSettings)
+        : count(indicatorCount < INDICATOR_MAX ? indicatorCount : INDICATOR_MAX), flash(flashSettings), maskPins(0),
+          levels(0), ticks(0), maskWrites(0), pwmWrites(0) {
+        memset(duties, 0, sizeof(duties));
+        memcpy(configs, indicators, sizeof(IndicatorConfig) * (size_t)count);
+        for (int i = 0; i < count; i++) {
+            states[i].color = configs[i].idleColor;
+            states[i].lit = false;
+            states[i].since = 0;
+            states[i].flashMs = flash.minFlashMs;
+            for (int c = 0; c < INDICATOR_CHANNELS; c++) {
+                if (configs[i].pins[c] >= 0 && configs[i].brightness[c] == 255) {
+                    maskPins |= 1u << configs[i].pins[c];
+                }
+            }
+        }
+    }
+
+    int size() const { return count; }
+
+    // All pins, for GpioBackend::configureOutputs(); returns the count
+    int pins(int* out) const {
+        int n = 0;
+        for (int i = 0; i < count; i++) {
+            for (int c = 0; c < INDICATOR_CHANNELS; c++) {
+                if (configs[i].pins[c] >= 0) {
+                    out[n++] = configs[i].pins[c];
+                }
+            }
+        }
+        return n;
+    }
+
+    bool needsPwm() const {
+        for (int i = 0; i < count; i++) {
+            for (int c = 0; c < INDICATOR_CHANNELS; c++) {
+                if (configs[i].pins[c] >= 0 && configs[i].brightness[c] > 0 && configs[i].brightness[c] < 255) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool uses(int source) const {
+        for (int i = 0; i < count; i++) {
+            if (configs[i].source == source) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void configurePwm(GpioBackend& gpio, int frequency) const {
+        for (int i = 0; i < count; i++) {
+            for (int c = 0; c < INDICATOR_CHANNELS; c++) {
+                if (configs[i].pins[c] >= 0 && configs[i].brightness[c] < 255) {
+                    gpio.configurePwm(configs[i].pins[c], frequency);
+                }
+            }
+        }
+    }
+
+    // Idle colors on every pin, whatever the backend showed before
+    void showIdle(GpioBackend& gpio) {
+        for (int i = 0; i < count; i++) {
+            states[i].color = configs[i].idleColor;
+            states[i].lit = false;
+        }
+        apply(gpio, true);
+    }
+
+    // All pins low, e.g. on exit
+    void off(GpioBackend& gpio) {
+        for (int i = 0; i < count; i++) {
+            states[i].color = COLOR_OFF;
+        }
+        apply(gpio, true);
+    }
+
+    // Advance every pattern and write the pins that changed
+    void tick(GpioBackend& gpio, const IndicatorInput* inputs, uint32_t nowMs, FastRandom& random) {
+        for (int i = 0; i < count; i++) {
+            const IndicatorConfig& config = configs[i];
+            const IndicatorInput& input = inputs[config.source];
+            State& state = states[i];
+            switch (config.pattern) {
+            case PATTERN_FLASH:
+                flashTick(state, input, nowMs, random);
+                state.color = state.lit ? config.activeColor : config.idleColor;
+                break;
+            case PATTERN_BLINK:
+                blinkTick(state, input, nowMs);
+                state.color = state.lit ? config.activeColor : config.idleColor;
+                break;
+            case PATTERN_LEVEL:
+                state.lit = input.active;
+                state.color = state.lit ? config.activeColor : config.idleColor;
+                break;
+            case PATTERN_TRAFFIC:
+                state.color = trafficColor(input);
+                state.lit = state.color != COLOR_OFF;
+                break;
+            }
+        }
+        apply(gpio, false);
+        ticks++;
+    }
+
+    bool lit(int indicator) const { return states[indicator].lit; }
+    uint8_t color(int indicator) const { return states[indicator].color; }
+};
+
+#endif // INDICATORS_H
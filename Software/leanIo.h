@@ -0,0 +1,172 @@
+/*
+ * Minimal I/O helpers for the LED monitor
+ * Raw syscalls and fixed buffers only - no iostream, locale or heap use,
+ * so a static build starts fast and stays small in RSS
+ */
+
+#ifndef LEAN_IO_H
+#define LEAN_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+
+// ============================================================================
+// FILE READING
+// ============================================================================
+
+// Re-read a /proc or /sys file from offset 0 into buf (NUL terminated)
+inline bool readFileAt(int fd, char* buf, size_t size, size_t& length) {
+    ssize_t n = pread(fd, buf, size - 1, 0);
+    if (n <= 0) {
+        return false;
+    }
+    buf[n] = '\0';
+    length = (size_t)n;
+    return true;
+}
+
+// Parse an unsigned decimal number, skipping leading blanks
+inline const char* parseUnsigned(const char* p, unsigned long long& value) {
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    value = 0;
+    while (*p >= '0' && *p <= '9') {
+        value = value * 10 + (unsigned long long)(*p - '0');
+        p++;
+    }
+    return p;
+}
+
+// Skip to the first character of the next line (or the terminating NUL)
+inline const char* nextLine(const char* p) {
+    while (*p && *p != '\n') {
+        p++;
+    }
+    return *p ? p + 1 : p;
+}
+
+// ============================================================================
+// OUTPUT
+// ============================================================================
+
+// Fixed-size line buffer written with a single write() call
+class LineWriter {
+private:
+    char buffer[256];
+    size_t length;
+
+public:
+    LineWriter() : length(0) {}
+
+    void clear() { length = 0; }
+
+    void append(char c) {
+        if (length < sizeof(buffer)) {
+            buffer[length++] = c;
+        }
+    }
+
+    void append(const char* text) {
+        while (*text) {
+            append(*text++);
+        }
+    }
+
+    void appendRepeat(char c, int count) {
+        for (int i = 0; i < count; i++) {
+            append(c);
+        }
+    }
+
+    // Right-aligned unsigned number, padded with spaces to width
+    void appendUnsigned(unsigned long long value, int width = 0) {
+        char digits[24];
+        int count = 0;
+        do {
+            digits[count++] = (char)('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        appendRepeat(' ', width - count);
+        while (count > 0) {
+            append(digits[--count]);
+        }
+    }
+
+    void appendSigned(long long value) {
+        if (value < 0) {
+            append('-');
+            appendUnsigned((unsigned long long)(-value));
+        } else {
+            appendUnsigned((unsigned long long)value);
+        }
+    }
+
+    void flush(int fd) {
+        size_t offset = 0;
+        while (offset < length) {
+            ssize_t n = write(fd, buffer + offset, length - offset);
+            if (n <= 0) {
+                break;
+            }
+            offset += (size_t)n;
+        }
+        length = 0;
+    }
+};
+
+// Write a string directly (async-signal-safe)
+inline void writeText(int fd, const char* text) {
+    ssize_t unused = write(fd, text, strlen(text));
+    (void)unused;
+}
+
+// ============================================================================
+// TIME AND RANDOM NUMBERS
+// ============================================================================
+
+inline uint64_t monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+inline uint64_t realtimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+inline void sleepMs(int ms) {
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+// xorshift32 - plenty for flash timing, no <random> state or static init
+class FastRandom {
+private:
+    uint32_t state;
+
+public:
+    explicit FastRandom(uint32_t seed) : state(seed ? seed : 0x9E3779B9u) {}
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Uniform value in [0, 65536)
+    uint32_t next16() { return next() >> 16; }
+};
+
+#endif // LEAN_IO_H
@@ -6,174 +6,367 @@
  * Compilation with optimizations:
  *   g++ -o led_monitor led_monitor.cpp -lpigpio -lrt -lpthread -O3 -march=native
  *
+ * Without pigpio (gpiomem/cdev backends only, green is full brightness):
+ *   g++ -DGPIO_NO_PIGPIO -o led_monitor led_monitor.cpp -lpthread -O3 -march=native
+ *
+ * Lean static build (no iostream/locale machinery, smallest startup time and RSS):
+ *   g++ -DGPIO_NO_PIGPIO -o led_monitor led_monitor.cpp -O2 -static \
+ *       -fno-exceptions -fno-rtti -lpthread
+ *
+ * Off-target build with simulated GPIO (see benchmark.sh):
+ *   g++ -DGPIO_SIMULATED -o led_monitor_sim led_monitor.cpp -O2 -lpthread
+ *
+ * Heap instrumentation (dynamic builds only, see allocGuard.h); allocation
+ * counters are printed on exit:
+ *   g++ -DALLOC_GUARD -DGPIO_SIMULATED -o led_monitor_guard led_monitor.cpp -O2 -lpthread
+ *
  * Run (requires sudo for direct GPIO access):
- *   sudo ./led_monitor
+ *   sudo ./led_monitor [--background] [--gpio auto|pigpio|gpiomem|cdev|simulated]
+ *                      [--serial-init] [--bench-startup] [--sim-init-ms N]
+ *                      [--bar-graph] [--agent | --aggregate]
+ *                      [--cluster-group ADDR] [--cluster-port N] [--node-id N]
+ *                      [--net IFACE] [--net-source ring|counters] [--net-full-pps N]
+ *                      [--stats-socket PATH]
+ *
+ * Cluster mode: every node runs --agent (no GPIO needed) and publishes its
+ * load over UDP multicast; the node with the adapter runs --aggregate and
+ * its LED shows the mean load of all nodes heard within the last second.
+ * Node ids default to a hash of the host name.
+ *
+ * Network mode (--net): the LED is the activity light of one interface and
+ * flashes with its packet rate (sent + received) instead of the CPU load.
+ * Packets are counted from a TPACKET_V3 ring (needs root) or, cheaper, from
+ * the interface counters over netlink; see netActivity.h.
+ *
+ * History (--stats-socket): the LED load and every core load of the last
+ * hour are kept compressed in memory (see loadHistory.h) and served on a
+ * Unix socket next to a counter snapshot:
+ *   echo "history seconds 600" | socat - UNIX-CONNECT:PATH   (also raw, minutes)
+ *
+ * LEDs: INDICATORS below lists every status LED - single, bi-color or RGB on
+ * any GPIO, each bound to a load source and a pattern (see indicators.h).
+ * The default is one bi-color LED. All pin changes of a tick go out as one
+ * set-mask and one clear-mask write.
+ *
+ * GPIO is initialised on a separate thread while CPU sampling already runs.
+ * pigpio is only used when GREEN_BRIGHTNESS needs PWM, otherwise the much
+ * faster gpiomem/cdev is used. While pigpio starts, the idle red state is
+ * already shown through gpiomem/cdev and handed over once pigpio is ready.
  *
  * Note: pigpiod daemon must NOT be running for direct GPIO access
  *   sudo systemctl stop pigpiod
  */
 
-#include <pigpio.h>
-#include <iostream>
-#include <fstream>
-#include <string>
-#include <thread>
-#include <chrono>
-#include <random>
+#include <atomic>
 #include <csignal>
-#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sys/random.h>
 #include <sys/resource.h>
+#include <pthread.h>
+#include "activityFilter.h"
+#include "allocGuard.h"
+#include "clusterLoad.h"
+#include "cpuMonitor.h"
+#include "gpioBackend.h"
+#include "indicators.h"
+#include "leanIo.h"
+#include "loadHistory.h"
+#include "mcp23017.h"
+#include "netActivity.h"
 
 // ============================================================================
 // CONFIGURATION - Adjust these settings to your preference
 // ============================================================================
 
-// GPIO pin configuration
-const int PIN_A = 16;  // First LED pin
-const int PIN_B = 26;  // Second LED pin
+// GPIO pin configuration of the bi-color LED
+const int PIN_A = 16;  // First LED pin (red)
+const int PIN_B = 26;  // Second LED pin (green)
 
 // Activity monitoring settings (optimized for responsiveness)
 const int CHECK_INTERVAL_MS = 25;      // Check every 25ms (fast response)
-const int MIN_FLASH_DURATION_MS = 12;  // Minimum flash duration at low CPU (milliseconds)
-const int MAX_FLASH_DURATION_MS = 50;  // Maximum flash duration at high CPU (milliseconds)
 const double ACTIVITY_THRESHOLD = 0.5; // Minimum CPU load to trigger flashes
-const double ACTIVITY_SMOOTHING = 0.5; // Activity smoothing (lower = more responsive)
+
+// Activity filter pipeline (independent of CHECK_INTERVAL_MS)
+const int ACTIVITY_TIME_CONSTANT_MS = 36; // Smoothing time constant (lower = more responsive)
+const bool ACTIVITY_MEDIAN_FILTER = false; // Reject single-sample spikes
+const int ACTIVITY_PEAK_HOLD_MS = 0;       // Hold load peaks (0 = disabled)
+const double ACTIVITY_HYSTERESIS = 0.0;    // Band around ACTIVITY_THRESHOLD in percent
 
 // LED brightness settings
 const int GREEN_BRIGHTNESS = 32;       // Green brightness (0-255)
 const int PWM_FREQUENCY = 1000;        // PWM frequency in Hz
 
-// Flash probability settings
-const double BASE_FLASH_CHANCE = 0.25; // Base probability multiplier
-const double CPU_SCALING = 0.04;       // CPU influence on flash chance
-const double FLASH_VARIATION = 0.3;    // Random variation in flash timing
-
-// Minimum time between flashes
-const int MIN_PAUSE_BETWEEN_FLASHES_MS = 30;
+// Flash durations, pauses and probabilities: FLASH_* in indicators.h
 
 // Background mode (disable console output for lower CPU usage)
 const bool BACKGROUND_MODE = false;  // Set to true when running as service
 
+// MCP23017 LED bar graph on the I2C extension header (per-core load + memory)
+const bool BAR_GRAPH_ENABLED = false;             // Also enabled with --bar-graph
+const char* const BAR_GRAPH_I2C_DEVICE = "/dev/i2c-1";
+const int BAR_GRAPH_I2C_ADDRESS = 0x20;           // A0-A2 tied low
+const int BAR_GRAPH_LEDS_PER_CORE = 3;            // 4 cores x 3 LEDs = pins 0-11
+const int BAR_GRAPH_MEMORY_LEDS = 4;              // Remaining pins show memory use
+const int MEMORY_SAMPLE_INTERVAL_MS = 1000;       // Memory changes slowly
+
+// Cluster load aggregation (--agent / --aggregate)
+const char* const CLUSTER_GROUP = CLUSTER_DEFAULT_GROUP;  // Multicast group (or a unicast address)
+const int CLUSTER_PORT = CLUSTER_DEFAULT_PORT;
+const int CLUSTER_NODE_TIMEOUT_MS = 1000;         // Forget nodes silent for this long
+
+// Interface activity (--net)
+const NetSourceType NET_SOURCE = NET_SOURCE_RING; // Falls back to counters without CAP_NET_RAW
+const uint32_t NET_FULL_SCALE_PPS = 100000;       // Packet rate shown as full load
+
+// Inputs an indicator can show; core n is SOURCE_CORE0 + n
+enum IndicatorSource { SOURCE_LOAD, SOURCE_MEMORY, SOURCE_CORE0 };
+const int SOURCE_COUNT = SOURCE_CORE0 + MAX_CPU_CORES;
+const double MEMORY_WARNING_PERCENT = 80.0;       // Memory counts as active above this
+
+// Status LEDs. SOURCE_LOAD is the CPU load, or the cluster / interface
+// activity in those modes. A front panel could add for example:
+//   { { 5, -1, -1 },  { 255, 255, 255 }, COLOR_OFF, COLOR_RED, SOURCE_CORE0 + 1, PATTERN_FLASH },
+//   { { 6, 13, 19 },  { 255, 255, 255 }, COLOR_OFF, COLOR_OFF, SOURCE_CORE0 + 2, PATTERN_TRAFFIC },
+//   { { 21, -1, -1 }, { 255, 255, 255 }, COLOR_OFF, COLOR_RED, SOURCE_MEMORY, PATTERN_LEVEL },
+const IndicatorConfig INDICATORS[] = {
+    // pins (red, green, blue)  brightness per pin                idle       active       source       pattern
+    { { PIN_A, PIN_B, -1 }, { 255, (uint8_t)GREEN_BRIGHTNESS, 255 }, COLOR_RED, COLOR_GREEN, SOURCE_LOAD, PATTERN_FLASH },
+};
+
 // ============================================================================
 
 // Global flag for clean shutdown
 volatile bool running = true;
+bool backgroundMode = BACKGROUND_MODE;
+
+// GPIO start-up state, published by the init thread
+enum GpioState { GPIO_PENDING, GPIO_READY, GPIO_FAILED };
+GpioBackend* gpio = nullptr;
+GpioBackend* earlyGpio = nullptr;  // Shows red while a slow backend starts
+IndicatorPanel indicators(INDICATORS, (int)(sizeof(INDICATORS) / sizeof(INDICATORS[0])), DEFAULT_FLASH_SETTINGS);
+Mcp23017BarGraph* barGraphOutput = nullptr;
+std::atomic<int> gpioState(GPIO_PENDING);
+bool benchStartup = false;
+uint64_t mainEntryNs = 0;
+
+// Wall-clock time of the first LED update, compared by benchmark.sh against launch time
+void reportFirstLed() {
+    if (!benchStartup) {
+        return;
+    }
+    LineWriter line;
+    line.append("first_led_ns=");
+    line.appendUnsigned(realtimeNs());
+    line.append(" main_ns=");
+    line.appendUnsigned(mainEntryNs);
+    line.append('\n');
+    line.flush(STDOUT_FILENO);
+}
 
-// CPU stats structure
-struct CPUStats {
-    unsigned long long user;
-    unsigned long long nice;
-    unsigned long long system;
-    unsigned long long idle;
-    unsigned long long iowait;
-    unsigned long long irq;
-    unsigned long long softirq;
-};
+// Bring up the GPIO backend and show the idle state as early as possible
+void* gpioInitThread(void*) {
+    int pins[INDICATOR_MAX * INDICATOR_CHANNELS];
+    int pinCount = indicators.pins(pins);
 
-// LED control functions (RED = idle, GREEN = activity with PWM)
-inline void setRed() {
-    gpioPWM(PIN_B, 0);
-    gpioWrite(PIN_A, 1);
-    gpioWrite(PIN_B, 0);
-}
+    bool earlyShown = false;
+    if (earlyGpio && earlyGpio->init() && earlyGpio->configureOutputs(pins, pinCount)) {
+        indicators.showIdle(*earlyGpio);
+        reportFirstLed();
+        earlyShown = true;
+    }
 
-inline void setGreen() {
-    gpioWrite(PIN_A, 0);
-    gpioPWM(PIN_B, GREEN_BRIGHTNESS);
-}
+    if (!gpio->init() || !gpio->configureOutputs(pins, pinCount)) {
+        gpioState.store(GPIO_FAILED, std::memory_order_release);
+        return nullptr;
+    }
+    indicators.configurePwm(*gpio, PWM_FREQUENCY);
+
+    indicators.showIdle(*gpio);
+    if (!earlyShown) {
+        reportFirstLed();
+    }
+    if (earlyGpio) {
+        earlyGpio->terminate();
+    }
 
-inline void setOff() {
-    gpioWrite(PIN_A, 0);
-    gpioPWM(PIN_B, 0);
+    gpioState.store(GPIO_READY, std::memory_order_release);
+    return nullptr;
 }
 
 // Signal handler for clean shutdown
 void signalHandler(int signum) {
-    if (!BACKGROUND_MODE) {
-        std::cout << "\n\nReceived signal " << signum << ", shutting down..." << std::endl;
+    if (!backgroundMode) {
+        LineWriter line;
+        line.append("\n\nReceived signal ");
+        line.appendUnsigned((unsigned)signum);
+        line.append(", shutting down...\n");
+        line.flush(STDOUT_FILENO);
     }
     running = false;
-    setOff();
-    gpioTerminate();
+    // Guard builds leave through the main loop, which prints the counters
+    if (allocGuardEnabled()) {
+        return;
+    }
+    if (gpioState.load(std::memory_order_acquire) == GPIO_READY) {
+        indicators.off(*gpio);
+        gpio->terminate();
+    }
+    if (barGraphOutput) {
+        barGraphOutput->clear();
+    }
     exit(0);
 }
 
-// Read CPU stats from /proc/stat (optimized)
-bool readCPUStats(CPUStats& stats) {
-    std::ifstream statFile("/proc/stat");
-    if (!statFile.is_open()) {
-        return false;
-    }
+const ActivityFilterConfig ACTIVITY_FILTER_CONFIG = {
+    ACTIVITY_TIME_CONSTANT_MS,
+    ACTIVITY_MEDIAN_FILTER,
+    ACTIVITY_PEAK_HOLD_MS,
+    percentToFixed(ACTIVITY_THRESHOLD),
+    percentToFixed(ACTIVITY_HYSTERESIS)
+};
 
-    std::string cpu;
-    statFile >> cpu >> stats.user >> stats.nice >> stats.system >> stats.idle
-             >> stats.iowait >> stats.irq >> stats.softirq;
+// Per-core loads for the bar graph get the same smoothing, no peak-hold
+const ActivityFilterConfig CORE_FILTER_CONFIG = {
+    ACTIVITY_TIME_CONSTANT_MS,
+    ACTIVITY_MEDIAN_FILTER,
+    0,
+    0,
+    0
+};
 
-    return true;
-}
+// Cluster loads arrive already smoothed by each agent
+const ActivityFilterConfig CLUSTER_FILTER_CONFIG = {
+    0,
+    false,
+    0,
+    percentToFixed(ACTIVITY_THRESHOLD),
+    percentToFixed(ACTIVITY_HYSTERESIS)
+};
 
-// CPU monitor class (optimized for minimal allocations)
-class CPUMonitor {
-private:
-    CPUStats lastStats;
-    double cpuLoad;
-    bool initialized;
+// Packet rates are smoothed like the CPU load
+const ActivityFilterConfig NET_FILTER_CONFIG = {
+    ACTIVITY_TIME_CONSTANT_MS,
+    ACTIVITY_MEDIAN_FILTER,
+    ACTIVITY_PEAK_HOLD_MS,
+    percentToFixed(ACTIVITY_THRESHOLD),
+    percentToFixed(ACTIVITY_HYSTERESIS)
+};
 
-public:
-    CPUMonitor() : cpuLoad(0.0), initialized(false) {
-        readCPUStats(lastStats);
+// Report a failed GPIO start-up with backend specific hints
+void reportGpioFailure() {
+    LineWriter line;
+    line.append("ERROR: ");
+    line.append(gpio->name());
+    line.append(" GPIO initialization failed!\n");
+    line.append("Make sure:\n");
+    line.append("  1. You're running with sudo\n");
+    if (strcmp(gpio->name(), "pigpio") == 0) {
+        line.append("  2. pigpiod daemon is NOT running (sudo killall pigpiod)\n");
     }
+    line.flush(STDERR_FILENO);
+}
 
-    double getCPULoad() {
-        CPUStats currentStats;
-        if (!readCPUStats(currentStats)) {
-            return cpuLoad;
+int main(int argc, char** argv) {
+    mainEntryNs = realtimeNs();
+    GpioBackendType requestedBackend = GPIO_BACKEND_AUTO;
+    bool serialInit = false;
+    int simulatedInitMs = 0;
+    bool barGraphEnabled = BAR_GRAPH_ENABLED;
+    bool agentMode = false;
+    bool aggregateMode = false;
+    const char* clusterGroup = CLUSTER_GROUP;
+    int clusterPort = CLUSTER_PORT;
+    uint32_t nodeId = defaultNodeId();
+    const char* netInterface = nullptr;
+    NetSourceType netSourceType = NET_SOURCE;
+    bool netSourceChosen = false;
+    uint32_t netFullScalePps = NET_FULL_SCALE_PPS;
+    const char* statsPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--background") == 0) {
+            backgroundMode = true;
+        } else if (strcmp(argv[i], "--bench-startup") == 0) {
+            benchStartup = true;
+        } else if (strcmp(argv[i], "--serial-init") == 0) {
+            serialInit = true;
+        } else if (strcmp(argv[i], "--gpio") == 0 && i + 1 < argc) {
+            requestedBackend = parseGpioBackend(argv[++i]);
+        } else if (strcmp(argv[i], "--sim-init-ms") == 0 && i + 1 < argc) {
+            simulatedInitMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bar-graph") == 0) {
+            barGraphEnabled = true;
+        } else if (strcmp(argv[i], "--agent") == 0) {
+            agentMode = true;
+        } else if (strcmp(argv[i], "--aggregate") == 0) {
+            aggregateMode = true;
+        } else if (strcmp(argv[i], "--cluster-group") == 0 && i + 1 < argc) {
+            clusterGroup = argv[++i];
+        } else if (strcmp(argv[i], "--cluster-port") == 0 && i + 1 < argc) {
+            clusterPort = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--node-id") == 0 && i + 1 < argc) {
+            nodeId = (uint32_t)strtoul(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--net") == 0 && i + 1 < argc) {
+            netInterface = argv[++i];
+        } else if (strcmp(argv[i], "--net-source") == 0 && i + 1 < argc) {
+            netSourceChosen = parseNetSource(argv[++i], netSourceType);
+        } else if (strcmp(argv[i], "--net-full-pps") == 0 && i + 1 < argc) {
+            netFullScalePps = (uint32_t)strtoul(argv[++i], nullptr, 0);
+            netFullScalePps = netFullScalePps > 0 ? netFullScalePps : NET_FULL_SCALE_PPS;
+        } else if (strcmp(argv[i], "--stats-socket") == 0 && i + 1 < argc) {
+            statsPath = argv[++i];
         }
+    }
 
-        if (!initialized) {
-            initialized = true;
-            lastStats = currentStats;
-            return 0.0;
+    // Agents only publish; the aggregator also publishes so it counts itself
+    ClusterAgent clusterAgent;
+    ClusterAggregator* clusterAggregator = nullptr;
+    if (agentMode || aggregateMode) {
+        if (!clusterAgent.open(clusterGroup, clusterPort, nodeId)) {
+            writeText(STDERR_FILENO, "ERROR: cannot open cluster socket\n");
+            return 1;
         }
-
-        // Calculate deltas
-        unsigned long long last_total = lastStats.user + lastStats.nice + lastStats.system +
-                                        lastStats.idle + lastStats.iowait + lastStats.irq + lastStats.softirq;
-        unsigned long long curr_total = currentStats.user + currentStats.nice + currentStats.system +
-                                        currentStats.idle + currentStats.iowait + currentStats.irq + currentStats.softirq;
-
-        unsigned long long total_diff = curr_total - last_total;
-        unsigned long long idle_diff = (currentStats.idle + currentStats.iowait) -
-                                       (lastStats.idle + lastStats.iowait);
-
-        lastStats = currentStats;
-
-        if (total_diff == 0) {
-            return cpuLoad;
+    }
+    if (aggregateMode) {
+        clusterAggregator = new ClusterAggregator();
+        if (!clusterAggregator->open(clusterGroup, clusterPort)) {
+            writeText(STDERR_FILENO, "ERROR: cannot join cluster group\n");
+            return 1;
         }
-
-        double currentLoad = 100.0 * (1.0 - (double)idle_diff / total_diff);
-        cpuLoad = cpuLoad * ACTIVITY_SMOOTHING + currentLoad * (1.0 - ACTIVITY_SMOOTHING);
-
-        return cpuLoad;
     }
-};
-
-int main() {
-    // Set low priority for background operation
-    setpriority(PRIO_PROCESS, 0, 19);
 
-    // Initialize pigpio for direct GPIO access
-    // Disable signal handling so our handlers work
-    gpioCfgSetInternals(gpioCfgGetInternals() | PI_CFG_NOSIGHANDLER);
+    // Interface activity replaces the CPU load; the ring needs CAP_NET_RAW
+    NetSource* netSource = nullptr;
+    if (netInterface) {
+        netSource = createNetSource(netSourceType);
+        if (!netSource->open(netInterface) && !netSourceChosen && netSourceType == NET_SOURCE_RING) {
+            delete netSource;
+            netSource = createNetSource(NET_SOURCE_COUNTERS);
+            netSource->open(netInterface);
+        }
+        if (netSource->error) {
+            LineWriter message;
+            message.append("ERROR: cannot count packets on ");
+            message.append(netInterface);
+            message.append(": ");
+            message.append(netSource->error);
+            message.append('\n');
+            message.flush(STDERR_FILENO);
+            return 1;
+        }
+    }
 
-    if (gpioInitialise() < 0) {
-        std::cerr << "ERROR: pigpio initialization failed!" << std::endl;
-        std::cerr << "Make sure:" << std::endl;
-        std::cerr << "  1. You're running with sudo" << std::endl;
-        std::cerr << "  2. pigpiod daemon is NOT running (sudo killall pigpiod)" << std::endl;
+    // Lightest backend that can do what we need (PWM only below full brightness)
+    bool needPwm = indicators.needsPwm();
+    GpioBackendType backendType = selectGpioBackend(requestedBackend, needPwm);
+    gpio = createGpioBackend(backendType, simulatedInitMs);
+    if (!gpio) {
+        writeText(STDERR_FILENO, "ERROR: requested GPIO backend is not compiled in\n");
         return 1;
     }
+    if (!serialInit && !agentMode) {
+        earlyGpio = createGpioBackend(earlyGpioBackend(backendType, simulatedInitMs));
+    }
 
     // Setup signal handlers
     signal(SIGINT, signalHandler);
@@ -182,84 +375,247 @@ int main() {
     signal(SIGABRT, signalHandler);
     signal(SIGHUP, signalHandler);
 
-    // Setup GPIO pins
-    gpioSetMode(PIN_A, PI_OUTPUT);
-    gpioSetMode(PIN_B, PI_OUTPUT);
-    gpioSetPWMfrequency(PIN_B, PWM_FREQUENCY);
-    gpioSetPWMrange(PIN_B, 255);
-
-    if (!BACKGROUND_MODE) {
-        std::cout << "System Activity Monitor Started (Direct GPIO)" << std::endl;
-        std::cout << "LED pins: GPIO " << PIN_A << " and GPIO " << PIN_B << std::endl;
-        std::cout << "Red = idle, Green flickers = CPU activity" << std::endl;
-        std::cout << "Running with low priority (nice 19)" << std::endl;
-        std::cout << "Press Ctrl+C to exit\n" << std::endl;
+    // Start GPIO initialization before lowering our priority, so the init
+    // thread keeps normal priority and CPU sampling starts right away
+    pthread_t initThread;
+    bool initThreadStarted = false;
+    if (agentMode) {
+        // No LEDs to drive
+    } else if (serialInit) {
+        gpioInitThread(nullptr);
+    } else {
+        initThreadStarted = pthread_create(&initThread, nullptr, gpioInitThread, nullptr) == 0;
+        if (!initThreadStarted) {
+            gpioInitThread(nullptr);
+        }
+    }
+
+    // Set low priority for background operation
+    setpriority(PRIO_PROCESS, 0, 19);
+
+    LineWriter line;
+    if (!backgroundMode) {
+        line.append("System Activity Monitor Started (");
+        line.append(gpio->name());
+        line.append(" GPIO)\n");
+        int pins[INDICATOR_MAX * INDICATOR_CHANNELS];
+        int pinCount = indicators.pins(pins);
+        line.append("LED pins: GPIO");
+        for (int i = 0; i < pinCount; i++) {
+            line.append(i > 0 ? ", " : " ");
+            line.appendUnsigned((unsigned)pins[i]);
+        }
+        line.append("\nRed = idle, Green flickers = CPU activity\n");
+        if (agentMode) {
+            line.append("Cluster agent: publishing load, LEDs unused\n");
+        } else if (aggregateMode) {
+            line.append("Cluster aggregator: LEDs show the cluster-wide load\n");
+        }
+        if (netSource) {
+            line.append("Interface ");
+            line.append(netInterface);
+            line.append(": LEDs show packet activity (");
+            line.append(netSource->name());
+            line.append(")\n");
+        }
+        line.append("Running with low priority (nice 19)\n");
+        line.append("Press Ctrl+C to exit\n\n");
+        line.flush(STDOUT_FILENO);
+    }
+
+    CPUMonitor monitor(ACTIVITY_FILTER_CONFIG, CORE_FILTER_CONFIG);
+    ActivityFilter clusterFilter(CLUSTER_FILTER_CONFIG);
+    uint32_t lastClusterMs = 0;
+    int clusterNodes = 0;
+    NetActivity netActivity(netFullScalePps);
+    ActivityFilter netFilter(NET_FILTER_CONFIG);
+
+    // Load history for "what happened 10 minutes ago", served from its own thread
+    LoadHistory* history = nullptr;
+    StatsServer stats;
+    if (statsPath) {
+        history = new LoadHistory(1 + monitor.coreCount());
+        stats.add(*history, "history");
+        stats.addQuery(*history, "history");
+        if (clusterAggregator) {
+            stats.add(*clusterAggregator, "cluster");
+        }
+        if (!stats.start(statsPath)) {
+            writeText(STDERR_FILENO, "WARNING: cannot open stats socket, continuing without it\n");
+        }
     }
 
-    CPUMonitor monitor;
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(0.0, 1.0);
+    // Optional bar graph: one bar per core, then memory use
+    LinuxI2cDevice barGraphDevice;
+    Mcp23017BarGraph barGraph(barGraphDevice);
+    bool barGraphActive = false;
+    if (barGraphEnabled) {
+        int ledsPerCore = barGraph.layoutCoresAndMemory(monitor.coreCount(), BAR_GRAPH_LEDS_PER_CORE,
+                                                        BAR_GRAPH_MEMORY_LEDS);
+        LineWriter message;
+        if (ledsPerCore == 0) {
+            message.append("WARNING: ");
+            message.appendUnsigned((unsigned)monitor.coreCount());
+            message.append(" core bars and the memory bar do not fit on 16 expander pins, no bar graph\n");
+            message.flush(STDERR_FILENO);
+        } else {
+            if (ledsPerCore < BAR_GRAPH_LEDS_PER_CORE) {
+                message.append("WARNING: ");
+                message.appendUnsigned((unsigned)monitor.coreCount());
+                message.append(" cores: bar graph shows ");
+                message.appendUnsigned((unsigned)ledsPerCore);
+                message.append(" LED(s) per core to keep the memory bar\n");
+                message.flush(STDERR_FILENO);
+            }
+            if (barGraphDevice.open(BAR_GRAPH_I2C_DEVICE, BAR_GRAPH_I2C_ADDRESS)) {
+                barGraphActive = barGraph.init();
+            }
+            if (barGraphActive) {
+                barGraphOutput = &barGraph;
+            } else {
+                writeText(STDERR_FILENO, "WARNING: MCP23017 bar graph not found, continuing without it\n");
+            }
+        }
+    }
+    fixed_t memoryUse = 0;
+    uint32_t lastMemorySampleMs = 0;
+    uint32_t seed = 0;
+    if (getrandom(&seed, sizeof(seed), GRND_NONBLOCK) != sizeof(seed)) {
+        seed = (uint32_t)monotonicNs();
+    }
+    FastRandom random(seed);
 
-    setRed();
-    bool isGreen = false;
-    auto flashTimer = std::chrono::steady_clock::now();
-    auto lastFlashEndTime = std::chrono::steady_clock::now();
-    int currentFlashDuration = MIN_FLASH_DURATION_MS;
+    uint64_t startNs = monotonicNs();
+    IndicatorInput inputs[SOURCE_COUNT];
+    memset(inputs, 0, sizeof(inputs));
+    bool indicatorsUseMemory = indicators.uses(SOURCE_MEMORY);
 
     while (running) {
-        double cpuLoad = monitor.getCPULoad();
-        auto currentTime = std::chrono::steady_clock::now();
-
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-            currentTime - flashTimer).count();
-        auto timeSinceLastFlash = std::chrono::duration_cast<std::chrono::milliseconds>(
-            currentTime - lastFlashEndTime).count();
-
-        if (isGreen && elapsed > currentFlashDuration) {
-            setRed();
-            isGreen = false;
-            lastFlashEndTime = currentTime;
-        } else if (!isGreen && cpuLoad > ACTIVITY_THRESHOLD && timeSinceLastFlash > MIN_PAUSE_BETWEEN_FLASHES_MS) {
-            double randomFactor = 0.5 + dis(gen) * FLASH_VARIATION;
-            double flashProbability = BASE_FLASH_CHANCE * (cpuLoad * CPU_SCALING) * randomFactor;
-
-            if (dis(gen) < flashProbability) {
-                double cpuFactor = std::min(1.0, cpuLoad / 100.0);
-                int durationRange = MAX_FLASH_DURATION_MS - MIN_FLASH_DURATION_MS;
-                currentFlashDuration = MIN_FLASH_DURATION_MS + (int)(durationRange * cpuFactor);
-
-                int randomVariation = (int)(durationRange * 0.3 * dis(gen));
-                currentFlashDuration += randomVariation - (randomVariation / 2);
-                currentFlashDuration = std::max(MIN_FLASH_DURATION_MS,
-                                               std::min(MAX_FLASH_DURATION_MS, currentFlashDuration));
-
-                setGreen();
-                isGreen = true;
-                flashTimer = currentTime;
+        AllocScope tickScope(ALLOC_SCOPE_TICK);
+        uint32_t currentTime = (uint32_t)((monotonicNs() - startNs) / 1000000u);
+        fixed_t cpuLoad = monitor.getCPULoad(currentTime);
+        bool active = monitor.isActive();
+
+        if (agentMode || aggregateMode) {
+            fixed_t coreLoads[MAX_CPU_CORES];
+            int cores = monitor.coreCount();
+            for (int i = 0; i < cores; i++) {
+                coreLoads[i] = monitor.coreLoad(i);
+            }
+            clusterAgent.publish(cpuLoad, coreLoads, cores);
+        }
+        if (clusterAggregator) {
+            clusterAggregator->poll(currentTime);
+            fixed_t load = clusterAggregator->clusterLoad(currentTime, CLUSTER_NODE_TIMEOUT_MS, clusterNodes);
+            cpuLoad = clusterFilter.update(load, currentTime - lastClusterMs);
+            active = clusterFilter.isActive();
+            lastClusterMs = currentTime;
+        }
+        if (netSource) {
+            netActivity.tick(*netSource, netFilter, currentTime);
+            cpuLoad = netFilter.value();
+            active = netFilter.isActive();
+        }
+
+        if (history) {
+            fixed_t loads[HISTORY_MAX_CHANNELS];
+            int cores = monitor.coreCount();
+            loads[0] = cpuLoad;
+            for (int i = 0; i < cores && i + 1 < HISTORY_MAX_CHANNELS; i++) {
+                loads[i + 1] = monitor.coreLoad(i);
+            }
+            history->add(loads, currentTime);
+        }
+
+        // Keep sampling while GPIO comes up; LED updates start once it is ready
+        int state = gpioState.load(std::memory_order_acquire);
+        if (state == GPIO_FAILED) {
+            reportGpioFailure();
+            return 1;
+        }
+        bool gpioReady = state == GPIO_READY;
+
+        // Memory is sampled for the bar graph and any indicator showing it
+        if ((barGraphActive || indicatorsUseMemory) &&
+            (currentTime - lastMemorySampleMs >= (uint32_t)MEMORY_SAMPLE_INTERVAL_MS || lastMemorySampleMs == 0)) {
+            readMemoryUse(memoryUse);
+            lastMemorySampleMs = currentTime;
+        }
+
+        // All LEDs: one mask write for every pin that changed
+        if (gpioReady) {
+            inputs[SOURCE_LOAD].load = cpuLoad;
+            inputs[SOURCE_LOAD].active = active;
+            inputs[SOURCE_MEMORY].load = memoryUse;
+            inputs[SOURCE_MEMORY].active = memoryUse >= percentToFixed(MEMORY_WARNING_PERCENT);
+            int cores = monitor.coreCount();
+            for (int i = 0; i < cores; i++) {
+                inputs[SOURCE_CORE0 + i].load = monitor.coreLoad(i);
+                inputs[SOURCE_CORE0 + i].active = monitor.coreLoad(i) >= percentToFixed(ACTIVITY_THRESHOLD);
+            }
+            indicators.tick(*gpio, inputs, currentTime, random);
+        }
+
+        // Bar graph: all pin changes of this tick go out in one I2C write
+        if (barGraphActive) {
+            fixed_t values[MAX_CPU_CORES + 1];
+            int cores = monitor.coreCount();
+            for (int i = 0; i < cores; i++) {
+                values[i] = monitor.coreLoad(i);
             }
+            values[cores] = memoryUse;
+            barGraph.update(values, cores + 1);
         }
 
         // Only show output if not in background mode
-        if (!BACKGROUND_MODE) {
-            int barLength = std::min(50, (int)(cpuLoad / 2));
-            printf("\rCPU: %5.1f%% %s [%.*s%.*s]",
-                   cpuLoad,
-                   isGreen ? "*" : " ",
-                   barLength, "##################################################",
-                   50 - barLength, "--------------------------------------------------");
-            fflush(stdout);
+        if (!backgroundMode) {
+            int tenths = (int)(((int64_t)cpuLoad * 10 + FIXED_ONE / 2) >> FIXED_SHIFT);
+            int barLength = tenths / 20;
+            if (barLength > 50) {
+                barLength = 50;
+            }
+            line.append(netSource ? "\rNet: " : (clusterAggregator ? "\rCluster: " : "\rCPU: "));
+            line.appendUnsigned((unsigned)(tenths / 10), 3);
+            line.append('.');
+            line.appendUnsigned((unsigned)(tenths % 10));
+            // The init thread drives the LEDs (showIdle) until it reports ready
+            line.append(gpioReady && indicators.lit(0) ? "% * [" : "%   [");
+            line.appendRepeat('#', barLength);
+            line.appendRepeat('-', 50 - barLength);
+            line.append(']');
+            if (clusterAggregator) {
+                line.append(' ');
+                line.appendUnsigned((unsigned)clusterNodes, 4);
+                line.append(" nodes");
+            }
+            if (netSource) {
+                line.append(' ');
+                line.appendUnsigned(netActivity.packetsPerSecond, 7);
+                line.append(" pps");
+            }
+            line.flush(STDOUT_FILENO);
         }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(CHECK_INTERVAL_MS));
+        sleepMs(CHECK_INTERVAL_MS);
     }
 
-    setOff();
-    gpioTerminate();
+    if (initThreadStarted) {
+        pthread_join(initThread, nullptr);
+    }
+    if (gpioState.load(std::memory_order_acquire) == GPIO_READY) {
+        indicators.off(*gpio);
+        gpio->terminate();
+    }
+    if (barGraphActive) {
+        barGraph.clear();
+    }
+    stats.stop();
+    delete history;
 
-    if (!BACKGROUND_MODE) {
-        std::cout << std::endl;
+    if (!backgroundMode) {
+        writeText(STDOUT_FILENO, "\n");
     }
+    allocGuardPrint();
 
     return 0;
 }
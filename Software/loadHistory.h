@@ -0,0 +1,542 @@
+/*
+ * Load history of the last hour, compressed in memory
+ *
+ * The monitor tick appends one sample per channel (the LED load, then each
+ * core) at 0.5% resolution. Samples go into a ring of fixed-size blocks:
+ *
+ *   block  - first sample time (ms, 4 bytes), stride (1 byte), channel
+ *            values before the first record (1 byte each), then records
+ *   record - 0x00..0x7F   run of 1-128 samples in which nothing changed
+ *            0x80         one sample: a nibble per channel with the zigzag
+ *                         delta (0-14), 15 = escape, followed by the
+ *                         escaped deltas as zigzag varints
+ *            0x81 N       from here on a sample every N ticks
+ *
+ * A busy 4-core machine takes 4 bytes per tick, an idle one a byte every
+ * 128 ticks. The ring gets HISTORY_RAW_BYTES_PER_CHANNEL per channel, and
+ * each block a fixed slice of the hour (the ring holds one block more than
+ * the hour needs), so the oldest block is reused only once it is an hour
+ * old. A block that fills faster than its slice passes stores only every
+ * 2nd, 4th ... (up to HISTORY_MAX_STRIDE) tick, and goes back to finer
+ * strides once it is below half its budget; busy stretches lose time
+ * resolution instead of the ring losing the hour. Sample times are
+ * interpolated by tick between the first and last sample of a block.
+ *
+ * Per channel min/max/mean rollups of every second (one hour) and every
+ * minute (one hour) are kept in plain rings alongside.
+ *
+ * Readers (the stats server thread) never stop the tick: each block has a
+ * generation counter (odd while it is being reset) and a tail word packing
+ * the committed length, the not yet written quiet run and the last sample
+ * time. A reader copies a block, and keeps it if the generation did not
+ * change meanwhile; bytes behind the tail are never modified in place.
+ */
+
+#ifndef LOAD_HISTORY_H
+#define LOAD_HISTORY_H
+
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "activityFilter.h"
+#include "clusterLoad.h"
+#include "cpuMonitor.h"
+#include "statsSocket.h"
+
+const int HISTORY_BLOCK_SIZE = 4096;
+const size_t HISTORY_RAW_BYTES_PER_CHANNEL = 24 * 1024;  // Ceiling of the per-tick samples
+const int HISTORY_MAX_STRIDE = 16;             // Coarsest raw rate: every 16th tick
+const int HISTORY_STRIDE_SLACK = 256;          // Bytes a block may run ahead of its budget
+const int HISTORY_SECONDS = 3600;
+const int HISTORY_MINUTES = 60;
+const int HISTORY_MAX_CHANNELS = MAX_CPU_CORES + 1;
+const int HISTORY_MAX_RUN = 128;
+const int HISTORY_HEADER_SIZE = 5;             // Plus one byte per channel
+
+// ============================================================================
+// ROLLUPS
+// ============================================================================
+
+// min/max/mean per channel over fixed periods; written by the tick thread,
+// entries are stable for a whole ring turn after they are published
+class LoadRollup {
+private:
+    uint32_t periodMs;
+    int capacity;
+    int channels;
+    uint8_t* values;         // capacity x channels x (min, max, mean)
+    uint32_t* stamps;        // Period number of each entry
+    std::atomic<uint32_t> written;
+
+    bool open;
+    uint32_t period;
+    uint8_t minimum[HISTORY_MAX_CHANNELS];
+    uint8_t maximum[HISTORY_MAX_CHANNELS];
+    uint32_t sum[HISTORY_MAX_CHANNELS];
+    uint32_t count;
+
+    LoadRollup(const LoadRollup&);
+    LoadRollup& operator=(const LoadRollup&);
+
+    void commit() {
+        uint32_t index = written.load(std::memory_order_relaxed);
+        uint8_t* entry = values + (size_t)(index % (uint32_t)capacity) * channels * 3;
+        for (int c = 0; c < channels; c++) {
+            entry[c * 3] = minimum[c];
+            entry[c * 3 + 1] = maximum[c];
+            entry[c * 3 + 2] = (uint8_t)((sum[c] + count / 2) / count);
+        }
+        stamps[index % (uint32_t)capacity] = period;
+        written.store(index + 1, std::memory_order_release);
+    }
+
+public:
+    LoadRollup(uint32_t periodLengthMs, int entries, int channelCount)
+        : periodMs(periodLengthMs), capacity(entries), channels(channelCount), written(0), open(false), period(0),
+          count(0) {
+        values = new uint8_t[(size_t)capacity * channels * 3];
+        stamps = new uint32_t[(size_t)capacity];
+    }
+
+    ~LoadRollup() {
+        delete[] values;
+        delete[] stamps;
+    }
+
+    void add(const uint8_t* sample, uint32_t nowMs) {
+        uint32_t current = nowMs / periodMs;
+        if (open && current != period) {
+            commit();
+            open = false;
+        }
+        if (!open) {
+            open = true;
+            period = current;
+            count = 0;
+            for (int c = 0; c < channels; c++) {
+                minimum[c] = 255;
+                maximum[c] = 0;
+                sum[c] = 0;
+            }
+        }
+        for (int c = 0; c < channels; c++) {
+            minimum[c] = sample[c] < minimum[c] ? sample[c] : minimum[c];
+            maximum[c] = sample[c] > maximum[c] ? sample[c] : maximum[c];
+            sum[c] += sample[c];
+        }
+        count++;
+    }
+
+    size_t memoryBytes() const { return (size_t)capacity * (channels * 3 + sizeof(uint32_t)); }
+
+    // Newest count entries, oldest first: visit(periodNumber, minMaxMean[channels * 3])
+    template <class Visit>
+    int read(int wanted, Visit visit) const {
+        uint32_t total = written.load(std::memory_order_acquire);
+        // The oldest slot may be overwritten while we read it (capacity is one
+        // more than the entries to keep)
+        uint32_t available = total < (uint32_t)capacity - 1 ? total : (uint32_t)capacity - 1;
+        uint32_t n = (uint32_t)wanted < available ? (uint32_t)wanted : available;
+        uint8_t entry[HISTORY_MAX_CHANNELS * 3];
+        for (uint32_t i = total - n; i < total; i++) {
+            memcpy(entry, values + (size_t)(i % (uint32_t)capacity) * channels * 3, (size_t)channels * 3);
+            visit(stamps[i % (uint32_t)capacity], entry);
+        }
+        return (int)n;
+    }
+
+    uint32_t periods() const { return written.load(std::memory_order_relaxed); }
+};
+
+// ============================================================================
+// HISTORY
+// ============================================================================
+
+class LoadHistory {
+private:
+    int channels;
+    int blockCount;
+    uint8_t* blocks;
+    std::atomic<uint32_t>* generations;
+    std::atomic<uint64_t>* tails;        // used | pending run << 16 | last sample ms << 32
+    std::atomic<int> current;
+
+    // Tick thread only
+    uint8_t* block;
+    int used;
+    int pending;
+    uint8_t last[HISTORY_MAX_CHANNELS];
+    bool started;
+    uint32_t lastMs;
+    uint32_t blockMs;                    // First sample of the current block
+    uint32_t sliceMs;                    // Time each block covers
+    int stride;                          // Ticks per stored sample
+    int skipped;
+
+    LoadRollup seconds;
+    LoadRollup minutes;
+
+    LoadHistory(const LoadHistory&);
+    LoadHistory& operator=(const LoadHistory&);
+
+    static uint64_t packTail(int length, int run, uint32_t ms) {
+        return (uint64_t)length | ((uint64_t)run << 16) | ((uint64_t)ms << 32);
+    }
+
+    void publish() {
+        tails[current.load(std::memory_order_relaxed)].store(packTail(used, pending, lastMs),
+                                                             std::memory_order_release);
+    }
+
+    void flushRun() {
+        if (pending > 0) {
+            block[used++] = (uint8_t)(pending - 1);
+            pending = 0;
+        }
+    }
+
+    // Close the current block and start the next one with the values so far
+    void nextBlock(uint32_t firstMs) {
+        if (started) {
+            flushRun();
+            publish();
+        }
+        int index = started ? (current.load(std::memory_order_relaxed) + 1) % blockCount : 0;
+        uint32_t generation = generations[index].load(std::memory_order_relaxed);
+        blocksRecycled += generation != 0;
+        generations[index].store(generation + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        tails[index].store(0, std::memory_order_relaxed);
+        block = blocks + (size_t)index * HISTORY_BLOCK_SIZE;
+        memcpy(block, &firstMs, 4);
+        block[4] = (uint8_t)stride;
+        memcpy(block + HISTORY_HEADER_SIZE, last, (size_t)channels);
+        blockMs = firstMs;
+        used = HISTORY_HEADER_SIZE + channels;
+        pending = 0;
+        tails[index].store(packTail(used, 0, firstMs), std::memory_order_relaxed);
+        current.store(index, std::memory_order_release);
+        generations[index].store(generation + 2, std::memory_order_release);
+    }
+
+    static int zigzag(int delta) { return delta >= 0 ? delta * 2 : -delta * 2 - 1; }
+    static int unzigzag(int value) { return value & 1 ? -(value + 1) / 2 : value / 2; }
+
+    // Decode one consistent copy of a block; visit(tick, values) per sample,
+    // tick counted from the first sample. Returns the tick of the last one
+    template <class Visit>
+    int decode(const uint8_t* data, int length, int run, Visit visit) const {
+        uint8_t values[HISTORY_MAX_CHANNELS];
+        memcpy(values, data + HISTORY_HEADER_SIZE, (size_t)channels);
+        int step = data[4];
+        int tick = -step;
+        int position = HISTORY_HEADER_SIZE + channels;
+        int nibbleBytes = (channels + 1) / 2;
+        while (position < length) {
+            uint8_t token = data[position++];
+            if (token < 0x80) {
+                for (int i = 0; i <= token; i++) {
+                    visit(tick += step, values);
+                }
+                continue;
+            }
+            if (token == 0x81) {
+                step = position < length ? data[position++] : step;
+                tick = tick < 0 ? -step : tick;
+                continue;
+            }
+            const uint8_t* nibbles = data + position;
+            position += nibbleBytes;
+            for (int c = 0; c < channels && position <= length; c++) {
+                int z = (nibbles[c / 2] >> ((c & 1) * 4)) & 15;
+                if (z == 15) {
+                    z = 0;
+                    int shift = 0;
+                    while (position < length) {
+                        uint8_t byte = data[position++];
+                        z |= (byte & 0x7F) << shift;
+                        shift += 7;
+                        if (!(byte & 0x80)) {
+                            break;
+                        }
+                    }
+                }
+                values[c] = (uint8_t)(values[c] + unzigzag(z));
+            }
+            visit(tick += step, values);
+        }
+        for (int i = 0; i < run; i++) {
+            visit(tick += step, values);
+        }
+        return tick;
+    }
+
+    // Keep the block within its share of the ring: the bytes used may grow
+    // with the time the block has covered, (used / size) against (age / slice)
+    void adjustStride(uint32_t nowMs) {
+        int64_t budget = (int64_t)HISTORY_BLOCK_SIZE * (nowMs - blockMs) / sliceMs;
+        int wanted = stride;
+        if (used > budget + HISTORY_STRIDE_SLACK && stride < HISTORY_MAX_STRIDE) {
+            wanted = stride * 2;
+        } else if (used + HISTORY_STRIDE_SLACK < budget / 2 && stride > 1) {
+            wanted = stride / 2;
+        }
+        if (wanted != stride && used + (pending > 0 ? 1 : 0) + 2 <= HISTORY_BLOCK_SIZE) {
+            flushRun();
+            block[used++] = 0x81;
+            block[used++] = (uint8_t)wanted;
+            stride = wanted;
+        }
+    }
+
+    static void appendLoad(StatsStream& out, uint8_t value) {
+        out.appendUnsigned(value / 2);
+        out.append(value & 1 ? ".5" : ".0");
+    }
+
+    void appendHeader(StatsStream& out, const char* unit) const {
+        out.append("# age_s led");
+        for (int c = 1; c < channels; c++) {
+            out.append(" cpu");
+            out.appendUnsigned((unsigned long)(c - 1));
+        }
+        out.append(" (");
+        out.append(unit);
+        out.append(")\n");
+    }
+
+    void queryRollup(StatsStream& out, const LoadRollup& rollup, uint32_t periodSeconds, int wanted) const {
+        appendHeader(out, "min/max/mean load %");
+        uint32_t nowPeriod = newestMs() / 1000 / periodSeconds;
+        rollup.read(wanted, [&](uint32_t period, const uint8_t* entry) {
+            out.append('-');
+            out.appendUnsigned((unsigned long)(nowPeriod - period) * periodSeconds);
+            for (int c = 0; c < channels; c++) {
+                out.append(' ');
+                appendLoad(out, entry[c * 3]);
+                out.append('/');
+                appendLoad(out, entry[c * 3 + 1]);
+                out.append('/');
+                appendLoad(out, entry[c * 3 + 2]);
+            }
+            out.append('\n');
+        });
+    }
+
+public:
+    unsigned long samples;
+    unsigned long blocksRecycled;
+
+    // channelCount = 1 + cores; rawBytes (0 = HISTORY_RAW_BYTES_PER_CHANNEL
+    // per channel) is rounded down to whole blocks
+    explicit LoadHistory(int channelCount, size_t rawBytes = 0)
+        : channels(channelCount < HISTORY_MAX_CHANNELS ? channelCount : HISTORY_MAX_CHANNELS), current(0),
+          block(nullptr), used(0), pending(0), started(false), lastMs(0), blockMs(0), sliceMs(0), stride(1), skipped(0),
+          seconds(1000, HISTORY_SECONDS + 1, channels), minutes(60000, HISTORY_MINUTES + 1, channels), samples(0),
+          blocksRecycled(0) {
+        blockCount = (int)((rawBytes > 0 ? rawBytes : HISTORY_RAW_BYTES_PER_CHANNEL * channels) / HISTORY_BLOCK_SIZE);
+        blockCount = blockCount >= 2 ? blockCount : 2;
+        sliceMs = HISTORY_SECONDS * 1000u / (uint32_t)(blockCount - 1);
+        blocks = new uint8_t[(size_t)blockCount * HISTORY_BLOCK_SIZE];
+        generations = new std::atomic<uint32_t>[(size_t)blockCount];
+        tails = new std::atomic<uint64_t>[(size_t)blockCount];
+        for (int i = 0; i < blockCount; i++) {
+            generations[i].store(0, std::memory_order_relaxed);
+            tails[i].store(0, std::memory_order_relaxed);
+        }
+        memset(last, 0, sizeof(last));
+    }
+
+    ~LoadHistory() {
+        delete[] blocks;
+        delete[] generations;
+        delete[] tails;
+    }
+
+    int channelCount() const { return channels; }
+
+    // Time of the latest sample, safe from any thread
+    uint32_t newestMs() const {
+        return (uint32_t)(tails[current.load(std::memory_order_acquire)].load(std::memory_order_acquire) >> 32);
+    }
+
+    // Tick thread: one load per channel at nowMs (non-decreasing)
+    void add(const fixed_t* loads, uint32_t nowMs) {
+        uint8_t values[HISTORY_MAX_CHANNELS] = {};
+        bool changed = false;
+        for (int c = 0; c < channels; c++) {
+            values[c] = loadToWire(loads[c]);
+            changed |= values[c] != last[c];
+        }
+        seconds.add(values, nowMs);
+        minutes.add(values, nowMs);
+        samples++;
+        if (started && ++skipped < stride) {
+            return;
+        }
+        skipped = 0;
+
+        if (!started || nowMs - blockMs >= sliceMs) {
+            nextBlock(nowMs);
+            started = true;
+        }
+
+        if (!changed) {
+            // Room for the run byte is kept free while a run is pending
+            if (pending == 0 && used + 1 > HISTORY_BLOCK_SIZE) {
+                nextBlock(nowMs);
+            }
+            if (++pending == HISTORY_MAX_RUN) {
+                flushRun();
+            }
+            lastMs = nowMs;
+            adjustStride(nowMs);
+            publish();
+            return;
+        }
+
+        uint8_t record[1 + HISTORY_MAX_CHANNELS / 2 + 1 + HISTORY_MAX_CHANNELS * 2];
+        int nibbleBytes = (channels + 1) / 2;
+        int length = 1 + nibbleBytes;
+        record[0] = 0x80;
+        memset(record + 1, 0, (size_t)nibbleBytes);
+        for (int c = 0; c < channels; c++) {
+            int z = zigzag((int)values[c] - (int)last[c]);
+            if (z >= 15) {
+                record[1 + c / 2] |= (uint8_t)(15 << ((c & 1) * 4));
+                while (z >= 0x80) {
+                    record[length++] = (uint8_t)(z | 0x80);
+                    z >>= 7;
+                }
+                record[length++] = (uint8_t)z;
+            } else {
+                record[1 + c / 2] |= (uint8_t)(z << ((c & 1) * 4));
+            }
+        }
+        if (used + (pending > 0 ? 1 : 0) + length > HISTORY_BLOCK_SIZE) {
+            nextBlock(nowMs);
+        }
+        flushRun();
+        memcpy(block + used, record, (size_t)length);
+        used += length;
+        memcpy(last, values, (size_t)channels);
+        lastMs = nowMs;
+        adjustStride(nowMs);
+        publish();
+    }
+
+    // Any thread: every stored tick at or after sinceMs, oldest first, as
+    // visit(timeMs, values[channels]) with values in 0.5% steps
+    template <class Visit>
+    unsigned long readRaw(uint32_t sinceMs, Visit visit) const {
+        uint8_t copy[HISTORY_BLOCK_SIZE];
+        unsigned long visited = 0;
+        uint32_t previousMs = 0;
+        int newest = current.load(std::memory_order_acquire);
+        for (int i = 1; i <= blockCount; i++) {
+            int index = (newest + i) % blockCount;
+            uint32_t before = generations[index].load(std::memory_order_acquire);
+            uint64_t tail = tails[index].load(std::memory_order_acquire);
+            int length = (int)(tail & 0xFFFF);
+            if (before == 0 || (before & 1) || length < HISTORY_HEADER_SIZE + channels) {
+                continue;
+            }
+            memcpy(copy, blocks + (size_t)index * HISTORY_BLOCK_SIZE, (size_t)length);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (generations[index].load(std::memory_order_relaxed) != before) {
+                continue;  // Reused while we copied: older than anything left
+            }
+            int run = (int)((tail >> 16) & 0xFFFF);
+            uint32_t endMs = (uint32_t)(tail >> 32);
+            uint32_t firstMs;
+            memcpy(&firstMs, copy, 4);
+            endMs = endMs > firstMs ? endMs : firstMs;
+            if (endMs < sinceMs || firstMs < previousMs) {
+                continue;
+            }
+            previousMs = firstMs;
+            int lastTick = decode(copy, length, run, [](int, const uint8_t*) {});
+            uint32_t spanMs = endMs - firstMs;
+            decode(copy, length, run, [&](int tick, const uint8_t* values) {
+                uint32_t timeMs = lastTick > 0 ? firstMs + (uint32_t)((uint64_t)spanMs * tick / lastTick) : firstMs;
+                if (timeMs >= sinceMs) {
+                    visit(timeMs, values);
+                    visited++;
+                }
+            });
+        }
+        return visited;
+    }
+
+    template <class Visit>
+    int readSeconds(int count, Visit visit) const { return seconds.read(count, visit); }
+
+    template <class Visit>
+    int readMinutes(int count, Visit visit) const { return minutes.read(count, visit); }
+
+    // Time span of the per-tick samples still in memory
+    uint32_t rawSpanMs() const {
+        uint32_t first = 0;
+        bool found = false;
+        readRaw(0, [&](uint32_t timeMs, const uint8_t*) {
+            if (!found) {
+                first = timeMs;
+                found = true;
+            }
+        });
+        return found ? newestMs() - first : 0;
+    }
+
+    size_t rawBytes() const { return (size_t)blockCount * HISTORY_BLOCK_SIZE; }
+
+    size_t memoryBytes() const {
+        return sizeof(*this) + rawBytes() + (size_t)blockCount * (sizeof(uint32_t) + sizeof(uint64_t)) +
+               seconds.memoryBytes() + minutes.memoryBytes();
+    }
+
+    void report(StatsReport& out, const char* name) const {
+        out.add(name, "channels", (unsigned long)channels);
+        out.add(name, "samples", samples);
+        out.add(name, "memory_bytes", (unsigned long)memoryBytes());
+        out.add(name, "raw_bytes", (unsigned long)rawBytes());
+        out.add(name, "blocks_recycled", blocksRecycled);
+        out.add(name, "raw_stride", (unsigned long)stride);
+        out.add(name, "seconds", (unsigned long)seconds.periods());
+        out.add(name, "minutes", (unsigned long)minutes.periods());
+    }
+
+    // "raw [seconds=60]", "seconds [count=600]" or "minutes [count=60]"
+    void query(StatsStream& out, const char* argument) const {
+        const char* count = strchr(argument, ' ');
+        long wanted = count ? strtol(count + 1, nullptr, 10) : 0;
+        if (strncmp(argument, "raw", 3) == 0) {
+            wanted = wanted > 0 ? wanted : 60;
+            uint32_t newest = newestMs();
+            uint32_t sinceMs = newest > (uint32_t)wanted * 1000u ? newest - (uint32_t)wanted * 1000u : 0;
+            appendHeader(out, "load %");
+            readRaw(sinceMs, [&](uint32_t timeMs, const uint8_t* values) {
+                uint32_t ageMs = newest > timeMs ? newest - timeMs : 0;
+                out.append('-');
+                out.appendUnsigned(ageMs / 1000);
+                out.append('.');
+                out.append((char)('0' + ageMs / 100 % 10));
+                out.append((char)('0' + ageMs / 10 % 10));
+                out.append((char)('0' + ageMs % 10));
+                for (int c = 0; c < channels; c++) {
+                    out.append(' ');
+                    appendLoad(out, values[c]);
+                }
+                out.append('\n');
+            });
+        } else if (strncmp(argument, "seconds", 7) == 0) {
+            queryRollup(out, seconds, 1, wanted > 0 ? (int)wanted : 600);
+        } else if (strncmp(argument, "minutes", 7) == 0) {
+            queryRollup(out, minutes, 60, wanted > 0 ? (int)wanted : HISTORY_MINUTES);
+        } else {
+            out.append("usage: history raw [seconds] | seconds [count] | minutes [count]\n");
+        }
+    }
+};
+
+#endif // LOAD_HISTORY_H
@@ -0,0 +1,2510 @@
+/*
+ * Off-target benchmarks for the HUB75 scan-out
+ * Runs the scanner against SimulatedPanel, so it runs on any Linux machine
+ *
+ * Compilation:
+ *   g++ -std=c++20 -O2 -o matrix_benchmark matrixBenchmark.cpp -lpthread
+ * (without -std=c++20 the coroutine playlist section is skipped)
+ *
+ * Run all benchmarks, or only the named ones:
+ *   ./matrix_benchmark [depth] [clocking] [bitdepth] [dual] [arena] [scene]
+ *                      [dashboard] [blend] [preview] [cache] [animation]
+ *                      [video] [spectrum] [playlist]
+ *
+ * Build with -DHUB75_NO_SIMD as well to compare the scalar conversion.
+ *
+ * Heap use of frame building, scan-out and rendering is counted
+ * (allocGuard.h) and printed at the end; exits non-zero if a sanity check
+ * fails or one of them used the heap.
+ */
+
+#define ALLOC_GUARD
+#define GPIO_NO_PIGPIO  // Scan-out writes GPIO registers directly
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "allocGuard.h"
+#include "animation.h"
+#include "assetCache.h"
+#include "dashboard.h"
+#include "dualDisplay.h"
+#include "frameArena.h"
+#include "frameBlend.h"
+#include "hub75.h"
+#include "hub75Simulator.h"
+#include "previewServer.h"
+#include "sceneGraph.h"
+#include "spectrum.h"
+#include "videoPipeline.h"
+#if __cplusplus >= 202002L
+#include "playlist.h"
+#endif
+#include "leanIo.h"
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    printf("  check %-48s %s\n", what, condition ? "ok" : "FAILED");
+    if (!condition) {
+        failures++;
+    }
+}
+
+static bool selected(int argc, char** argv, const char* name) {
+    if (argc < 2) {
+        return true;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Blocky "text": saturated pixels on black in a band of rows
+static void drawText(Canvas& canvas, int y, int height, uint8_t r, uint8_t g, uint8_t b, FastRandom& random) {
+    for (int row = y; row < y + height; row++) {
+        for (int x = 0; x < canvas.width(); x++) {
+            if ((random.next() & 3) == 0) {
+                canvas.setPixel(x, row, r, g, b);
+            }
+        }
+    }
+}
+
+// Smooth photo-like gradient in a band of rows
+static void drawImage(Canvas& canvas, int y, int height) {
+    for (int row = y; row < y + height; row++) {
+        for (int x = 0; x < canvas.width(); x++) {
+            canvas.setPixel(x, row, (uint8_t)(x * 255 / canvas.width()), (uint8_t)((row - y) * 255 / height),
+                            (uint8_t)(128 + (x ^ row) % 64));
+        }
+    }
+}
+
+// Scene names for the scan-out benchmarks
+enum Scene { SCENE_SIGNAGE, SCENE_TEXT, SCENE_IMAGE };
+static const char* const SCENE_NAMES[] = { "signage", "text", "image" };
+
+static void drawScene(Canvas& canvas, Scene scene) {
+    FastRandom random(4242);
+    canvas.clear();
+    int h = canvas.height();
+    if (scene == SCENE_SIGNAGE) {
+        // Text lines, a black gap and an image on P0; a text sign on P1
+        drawText(canvas, 1, 7, 255, 255, 255, random);
+        drawText(canvas, 9, 7, 255, 0, 0, random);
+        drawImage(canvas, 20, 12);
+        drawText(canvas, h / 2 + 4, 8, 0, 255, 0, random);
+        drawText(canvas, h / 2 + 18, 8, 255, 255, 0, random);
+    } else if (scene == SCENE_TEXT) {
+        for (int y = 0; y + 8 <= h; y += 10) {
+            drawText(canvas, y, 8, 255, (uint8_t)(y * 8), 0, random);
+        }
+    } else {
+        drawImage(canvas, 0, h);
+    }
+}
+
+// Scan a frame twice (the first calibrates the timing), keep the second's exposure
+static void scanTwice(SimulatedPanel& panel, Hub75Scanner<SimulatedPanel>& scanner, const BitplaneFrame& frame) {
+    scanner.scanFrame(frame);
+    panel.resetExposure();
+    scanner.scanFrame(frame);
+}
+
+// Largest difference between exposure and the gamma levels, in LSB units
+static double levelError(const SimulatedPanel& panel, const Hub75Scanner<SimulatedPanel>& scanner,
+                         const Canvas& canvas, const GammaTable& gamma, const MatrixConfig& config) {
+    double scale = (double)scanner.referencePeriodNs / ((double)scanner.lastPeriodNs * config.lsbNs);
+    double worst = 0;
+    for (int y = 0; y < canvas.height(); y++) {
+        for (int x = 0; x < canvas.width(); x++) {
+            for (int k = 0; k < 3; k++) {
+                double level = panel.exposure(x, y, k) * scale;
+                double error = level - gamma.values[canvas.row(y)[x * 3 + k]];
+                error = error < 0 ? -error : error;
+                worst = error > worst ? error : worst;
+            }
+        }
+    }
+    return worst;
+}
+
+// ============================================================================
+// DEPTH - per-row adaptive bitplane depth
+// ============================================================================
+
+static void benchmarkDepth() {
+    printf("depth\n");
+
+    MatrixConfig config = DEFAULT_MATRIX_CONFIG;
+    GammaTable gamma;
+    gamma.build(config.planes, 2.2);
+    Canvas canvas(config.width(), config.height());
+
+    // Identical planes merge, zero planes vanish
+    canvas.fillRect(0, 0, config.width(), 1, 255, 0, 0);
+    MatrixConfig adaptive = config;
+    adaptive.adaptiveDepth = true;
+    BitplaneFrame frame(adaptive);
+    frame.build(canvas, gamma);
+    check(frame.passCount(0) == 1 && frame.pass(0, 0).onUnits == (1 << config.planes) - 1,
+          "saturated row is a single full-length pass");
+    check(frame.passCount(1) == 0, "black row emits nothing");
+
+    for (int s = 0; s < 3; s++) {
+        Scene scene = (Scene)s;
+        drawScene(canvas, scene);
+
+        for (int pi = 0; pi < 2; pi++) {
+            uint32_t storeNs = pi == 0 ? PI_ZERO_STORE_NS : PI4_STORE_NS;
+            double fullHz = 0;
+            double exposures[2][3] = { { 0 } };
+            for (int mode = 0; mode < 2; mode++) {
+                MatrixConfig modeConfig = config;
+                modeConfig.adaptiveDepth = mode == 1;
+                BitplaneFrame modeFrame(modeConfig);
+                uint64_t start = monotonicNs();
+                modeFrame.build(canvas, gamma);
+                uint64_t buildNs = monotonicNs() - start;
+
+                SimulatedPanel panel(modeConfig, storeNs);
+                Hub75Scanner<SimulatedPanel> scanner(panel, modeConfig);
+                scanner.begin();
+                scanTwice(panel, scanner, modeFrame);
+
+                double hz = 1e9 / (double)scanner.lastPeriodNs;
+                double error = levelError(panel, scanner, canvas, gamma, modeConfig);
+                if (mode == 0) {
+                    fullHz = hz;
+                }
+                // Brightness of a few probe pixels relative to the frame period
+                const int probes[3][2] = { { 5, 3 }, { 40, 25 }, { 20, config.height() / 2 + 5 } };
+                for (int p = 0; p < 3; p++) {
+                    exposures[mode][p] = (double)panel.exposure(probes[p][0], probes[p][1], 0) /
+                                         (double)scanner.lastPeriodNs;
+                }
+
+                printf("  %-8s %-7s %-8s passes=%4d stores=%7lu refresh=%6.0f Hz (x%.2f) "
+                       "unit=%5.1f ns build=%5.0f us max_error=%.2f lsb\n",
+                       SCENE_NAMES[s], pi == 0 ? "pi-zero" : "pi-4", mode ? "adaptive" : "full",
+                       modeFrame.totalPasses, panel.stores, hz, hz / fullHz, scanner.unitQ8 / 256.0,
+                       buildNs / 1000.0, error);
+
+                if (pi == 0) {
+                    char what[64];
+                    snprintf(what, sizeof(what), "%s %s exposure matches gamma levels", SCENE_NAMES[s],
+                             mode ? "adaptive" : "full");
+                    check(error <= 0.5, what);
+                }
+            }
+
+            if (pi == 0) {
+                bool same = true;
+                for (int p = 0; p < 3; p++) {
+                    double a = exposures[0][p];
+                    double b = exposures[1][p];
+                    double difference = a > b ? a - b : b - a;
+                    same = same && difference <= 0.01 * (a > b ? a : b) + 1e-9;
+                }
+                char what[64];
+                snprintf(what, sizeof(what), "%s brightness unchanged by adaptive depth", SCENE_NAMES[s]);
+                check(same, what);
+            }
+        }
+    }
+}
+
+// ============================================================================
+// CLOCKING - register stores per column and pixel clock
+// ============================================================================
+
+// Register pair standing in for GPSET0/GPCLR0, to time the column loops on the host
+struct StoreCountingOutput {
+    volatile uint32_t setRegister;
+    volatile uint32_t clearRegister;
+    unsigned long stores;
+
+    StoreCountingOutput() : setRegister(0), clearRegister(0), stores(0) {}
+    void set(uint32_t mask) { setRegister = mask; stores++; }
+    void clear(uint32_t mask) { clearRegister = mask; stores++; }
+};
+
+// Host time per column of a column loop over every plane of a frame
+static double columnLoopNs(ColumnShift<StoreCountingOutput>::Function shift, const BitplaneFrame& frame,
+                           const MatrixConfig& config, unsigned long& stores) {
+    StoreCountingOutput output;
+    const int repeats = 50;
+    uint32_t last = 0;
+    uint64_t start = monotonicNs();
+    for (int i = 0; i < repeats; i++) {
+        for (int r = 0; r < config.rowAddresses(); r++) {
+            for (int p = 0; p < config.planes; p++) {
+                last = shift(output, frame.planeWords(r, p), config.width(), last);
+            }
+        }
+    }
+    uint64_t elapsed = monotonicNs() - start;
+    stores = output.stores / repeats;
+    return (double)elapsed / ((double)repeats * config.rowAddresses() * config.planes * config.width());
+}
+
+static void benchmarkClocking() {
+    printf("clocking (pixel clocks are estimates from assumed store costs: %u ns Pi Zero, %u ns Pi 4)\n",
+           PI_ZERO_STORE_NS, PI4_STORE_NS);
+
+    MatrixConfig config = DEFAULT_MATRIX_CONFIG;
+    GammaTable gamma;
+    gamma.build(config.planes, 2.2);
+
+    const int chains[] = { 1, 2, 4, 3 };
+    for (int ci = 0; ci < 4; ci++) {
+        MatrixConfig chainConfig = config;
+        chainConfig.chainLength = chains[ci];
+        chainConfig.panelCols = ci == 3 ? 40 : 64;  // 120 columns: no specialization
+        Canvas canvas(chainConfig.width(), chainConfig.height());
+
+        for (int s = 0; s < 3; s++) {
+            drawScene(canvas, (Scene)s);
+            BitplaneFrame frame(chainConfig);
+            frame.build(canvas, gamma);
+
+            unsigned long genericStores = 0;
+            unsigned long fixedStores = 0;
+            double genericNs = columnLoopNs(shiftColumnsGeneric<StoreCountingOutput>, frame, chainConfig,
+                                            genericStores);
+            double fixedNs = columnLoopNs(ColumnShift<StoreCountingOutput>::select(chainConfig.width()), frame,
+                                          chainConfig, fixedStores);
+            double columns = (double)chainConfig.rowAddresses() * chainConfig.planes * chainConfig.width();
+            double perColumn = genericStores / columns;
+
+            // Whole frames through the simulated panel, per Pi model
+            double refresh[2];
+            unsigned long panelStores = 0;
+            double maxError = 0;
+            for (int pi = 0; pi < 2; pi++) {
+                SimulatedPanel panel(chainConfig, pi == 0 ? PI_ZERO_STORE_NS : PI4_STORE_NS);
+                Hub75Scanner<SimulatedPanel> scanner(panel, chainConfig);
+                scanner.begin();
+                scanTwice(panel, scanner, frame);
+                refresh[pi] = 1e9 / (double)scanner.lastPeriodNs;
+                panelStores = panel.stores;
+                double error = levelError(panel, scanner, canvas, gamma, chainConfig);
+                maxError = error > maxError ? error : maxError;
+            }
+
+            printf("  %3d cols %-8s stores/frame=%7lu (naive %7.0f) %.2f stores/col  "
+                   "est. pixel clock %4.1f MHz (pi-zero) %4.1f MHz (pi-4)  refresh %4.0f / %4.0f Hz  "
+                   "host %.2f ns/col generic, %.2f %s\n",
+                   chainConfig.width(), SCENE_NAMES[s], panelStores, 4 * columns, perColumn,
+                   1e3 / (perColumn * PI_ZERO_STORE_NS), 1e3 / (perColumn * PI4_STORE_NS),
+                   refresh[0], refresh[1], genericNs, fixedNs, ci == 3 ? "(fallback)" : "unrolled");
+
+            if (s == 0) {
+                char what[64];
+                snprintf(what, sizeof(what), "%d cols: at most 3 stores per column", chainConfig.width());
+                check(perColumn <= 3.0, what);
+                snprintf(what, sizeof(what), "%d cols: unrolled loop stores match generic", chainConfig.width());
+                check(fixedStores == genericStores, what);
+                snprintf(what, sizeof(what), "%d cols: exposure matches gamma levels", chainConfig.width());
+                check(maxError <= 0.5, what);
+            }
+        }
+    }
+
+    // Slowdown: 2 more stores per column and step, same image
+    MatrixConfig slowConfig = config;
+    slowConfig.chainLength = 2;
+    Canvas canvas(slowConfig.width(), slowConfig.height());
+    drawScene(canvas, (Scene)0);
+    BitplaneFrame frame(slowConfig);
+    frame.build(canvas, gamma);
+    double baseColumns = 0;
+    bool linear = true;
+    bool exposure = true;
+    for (int slowdown = 0; slowdown <= 2; slowdown++) {
+        slowConfig.clockSlowdown = slowdown;
+        SimulatedPanel panel(slowConfig, PI4_STORE_NS);
+        Hub75Scanner<SimulatedPanel> scanner(panel, slowConfig);
+        scanner.begin();
+        scanTwice(panel, scanner, frame);
+        double perColumn = (double)panel.stores / ((double)frame.totalPasses * slowConfig.width());
+        baseColumns = slowdown == 0 ? perColumn : baseColumns;
+        linear = linear && fabs(perColumn - baseColumns - 2 * slowdown) < 0.1;
+        exposure = exposure && levelError(panel, scanner, canvas, gamma, slowConfig) <= 0.5;
+        printf("  slowdown %d: %.2f stores/col, est. pixel clock %4.1f MHz (pi-4), refresh %4.0f Hz\n", slowdown,
+               perColumn, 1e3 / (perColumn * PI4_STORE_NS), 1e9 / (double)scanner.lastPeriodNs);
+    }
+    check(linear, "slowdown adds 2 stores per column and step");
+    check(exposure, "slowed clock keeps the gamma levels");
+}
+
+// ============================================================================
+// BITDEPTH - 16-bit canvas against the 8-bit path
+// ============================================================================
+
+static double exposureScale(const Hub75Scanner<SimulatedPanel>& scanner, const MatrixConfig& config) {
+    return (double)scanner.referencePeriodNs / ((double)scanner.lastPeriodNs * config.lsbNs);
+}
+
+// Mean of the displayed levels over each 4x4 dither cell against the ideal
+// (unquantized) gamma curve of the 16-bit values; returns the mean and worst error
+static void darkToneError(const SimulatedPanel& panel, double scale, const Canvas16& ideal, double gamma, int planes,
+                          double& meanError, double& worstError) {
+    double top = (double)((1 << planes) - 1);
+    double sum = 0;
+    int cells = 0;
+    worstError = 0;
+    for (int y = 0; y + 4 <= ideal.height(); y += 4) {
+        for (int x = 0; x + 4 <= ideal.width(); x += 4) {
+            double shown = 0;
+            double wanted = 0;
+            for (int dy = 0; dy < 4; dy++) {
+                for (int dx = 0; dx < 4; dx++) {
+                    shown += panel.exposure(x + dx, y + dy, 1) * scale;
+                    wanted += pow(ideal.row(y + dy)[(x + dx) * 3 + 1] / 65535.0, gamma) * top;
+                }
+            }
+            double error = (shown - wanted) / 16;
+            error = error < 0 ? -error : error;
+            sum += error;
+            worstError = error > worstError ? error : worstError;
+            cells++;
+        }
+    }
+    meanError = sum / cells;
+}
+
+static void benchmarkBitDepth() {
+#ifdef HUB75_NO_SIMD
+    printf("bitdepth (scalar kernels)\n");
+#else
+    printf("bitdepth (%d-lane kernels)\n", HUB75_LANES);
+#endif
+
+    // Conversion cost per frame, 8-bit vs 16-bit canvas
+    const int sizes[2][3] = { { 32, 64, 1 }, { 64, 64, 4 } };  // panel rows, panel cols, chain
+    for (int i = 0; i < 2; i++) {
+        MatrixConfig config = DEFAULT_MATRIX_CONFIG;
+        config.panelRows = sizes[i][0];
+        config.panelCols = sizes[i][1];
+        config.chainLength = sizes[i][2];
+        GammaTable gamma8;
+        gamma8.build(config.planes, 2.2);
+        Gamma16Table gamma16;
+        gamma16.build(2.2);
+
+        Canvas canvas8(config.width(), config.height());
+        Canvas16 canvas16(config.width(), config.height());
+        drawScene(canvas8, SCENE_IMAGE);
+        for (int y = 0; y < config.height(); y++) {
+            for (int x = 0; x < config.width() * 3; x++) {
+                canvas16.row(y)[x] = (uint16_t)(canvas8.row(y)[x] * 257 + (x * 37 + y * 11) % 257);
+            }
+        }
+
+        BitplaneFrame frame(config);
+        const int repeats = 200;
+        uint64_t start = monotonicNs();
+        for (int n = 0; n < repeats; n++) {
+            frame.build(canvas8, gamma8);
+        }
+        double ns8 = (double)(monotonicNs() - start) / repeats;
+        start = monotonicNs();
+        for (int n = 0; n < repeats; n++) {
+            frame.build(canvas16, gamma16);
+        }
+        double ns16 = (double)(monotonicNs() - start) / repeats;
+
+        printf("  %dx%d  8-bit %7.1f us/frame  16-bit %7.1f us/frame  (x%.2f, %.1f ns/pixel extra)\n",
+               config.width(), config.height(), ns8 / 1000, ns16 / 1000, ns16 / ns8,
+               (ns16 - ns8) / (config.width() * config.height()));
+    }
+
+    // Dark tones: a ramp over the lowest 3% of the range
+    MatrixConfig config = DEFAULT_MATRIX_CONFIG;
+    config.adaptiveDepth = false;
+    GammaTable gamma8;
+    gamma8.build(config.planes, 2.2);
+    Gamma16Table gamma16;
+    gamma16.build(2.2);
+    Canvas16 ramp16(config.width(), config.height());
+    Canvas ramp8(config.width(), config.height());
+    for (int y = 0; y < config.height(); y++) {
+        for (int x = 0; x < config.width(); x++) {
+            uint16_t value = (uint16_t)((y * config.width() + x) * 2048 / (config.width() * config.height()));
+            ramp16.setPixel(x, y, value, value, value);
+            uint8_t value8 = (uint8_t)((value + 128) / 257);
+            ramp8.setPixel(x, y, value8, value8, value8);
+        }
+    }
+
+    double mean[2];
+    double worst[2];
+    for (int path = 0; path < 2; path++) {
+        BitplaneFrame frame(config);
+        if (path == 0) {
+            frame.build(ramp8, gamma8);
+        } else {
+            frame.build(ramp16, gamma16);
+        }
+        SimulatedPanel panel(config, PI4_STORE_NS);
+        Hub75Scanner<SimulatedPanel> scanner(panel, config);
+        scanner.begin();
+        scanTwice(panel, scanner, frame);
+        darkToneError(panel, exposureScale(scanner, config), ramp16, 2.2, config.planes, mean[path], worst[path]);
+        printf("  dark ramp %-6s mean error %.3f lsb, worst %.3f lsb (per 4x4 cell)\n",
+               path == 0 ? "8-bit" : "16-bit", mean[path], worst[path]);
+    }
+    check(mean[1] < mean[0] / 2, "16-bit path halves the dark tone error");
+    check(worst[1] <= 0.5, "16-bit dark tones within half an LSB");
+
+    // 8-bit content widened to 16 bits looks the same as through the 8-bit path
+    Canvas16 wide(config.width(), config.height());
+    Canvas narrow(config.width(), config.height());
+    drawScene(narrow, SCENE_IMAGE);
+    for (int y = 0; y < config.height(); y++) {
+        for (int x = 0; x < config.width() * 3; x++) {
+            wide.row(y)[x] = (uint16_t)(narrow.row(y)[x] * 257);
+        }
+    }
+    BitplaneFrame frame(config);
+    frame.build(wide, gamma16);
+    SimulatedPanel panel(config, PI4_STORE_NS);
+    Hub75Scanner<SimulatedPanel> scanner(panel, config);
+    scanner.begin();
+    scanTwice(panel, scanner, frame);
+    double largest = 0;
+    double scale = exposureScale(scanner, config);
+    for (int y = 0; y + 4 <= config.height(); y += 4) {
+        for (int x = 0; x + 4 <= config.width(); x += 4) {
+            double shown = 0;
+            double wanted = 0;
+            for (int dy = 0; dy < 4; dy++) {
+                for (int dx = 0; dx < 4; dx++) {
+                    shown += panel.exposure(x + dx, y + dy, 0) * scale;
+                    wanted += gamma8.values[narrow.row(y + dy)[(x + dx) * 3]];
+                }
+            }
+            double difference = (shown - wanted) / 16;
+            difference = difference < 0 ? -difference : difference;
+            largest = difference > largest ? difference : largest;
+        }
+    }
+    printf("  8-bit content through the 16-bit path: largest cell difference %.3f lsb\n", largest);
+    check(largest <= 0.75, "16-bit path reproduces 8-bit content");
+}
+
+// ============================================================================
+// DUAL - independent displays on P0 and P1
+// ============================================================================
+
+// Animated sign: a bar moving across a gradient
+static void drawAnimation(Canvas& canvas, int frame) {
+    for (int y = 0; y < canvas.height(); y++) {
+        for (int x = 0; x < canvas.width(); x++) {
+            canvas.setPixel(x, y, (uint8_t)(x * 4), (uint8_t)(y * 8), 64);
+        }
+    }
+    canvas.fillRect(frame % canvas.width(), 0, 4, canvas.height(), 255, 255, 255);
+}
+
+// Static sign: text lines
+static void drawStaticSign(Canvas& canvas) {
+    FastRandom random(99);
+    canvas.clear();
+    drawText(canvas, 2, 6, 255, 128, 0, random);
+    drawText(canvas, 12, 6, 0, 128, 255, random);
+}
+
+struct DualRenderer {
+    LogicalDisplay* display;
+    int frameMs;
+    int seconds;
+    bool animated;
+};
+
+static void* dualRenderThread(void* arg) {
+    DualRenderer* renderer = (DualRenderer*)arg;
+    int frames = renderer->seconds * 1000 / renderer->frameMs;
+    for (int i = 0; i < frames; i++) {
+        if (renderer->animated) {
+            drawAnimation(renderer->display->canvas(), i);
+        } else {
+            drawStaticSign(renderer->display->canvas());
+        }
+        renderer->display->swap();
+        sleepMs(renderer->frameMs);
+    }
+    return nullptr;
+}
+
+static void benchmarkDual() {
+    printf("dual\n");
+
+    MatrixConfig config = DEFAULT_MATRIX_CONFIG;
+    GammaTable gamma;
+    gamma.build(config.planes, 2.2);
+
+    // Deterministic: P0 animates, P1 was drawn once
+    DualDisplay dual(config, 2.2);
+    drawStaticSign(dual.display(1).canvas());
+    dual.display(1).swap();
+    const int ticks = 300;
+    for (int i = 0; i < ticks; i++) {
+        drawAnimation(dual.display(0).canvas(), i);
+        dual.display(0).swap();
+        dual.update();
+        dual.frameToScan();
+    }
+    double halfUs = (double)dual.convertNs / dual.framesPublished / 1000;
+
+    // Same content converted as one canvas every time
+    Canvas combined(config.width(), config.height());
+    Canvas part(config.width(), config.panelRows);
+    drawStaticSign(part);
+    for (int y = 0; y < config.panelRows; y++) {
+        memcpy(combined.row(config.panelRows + y), part.row(y), (size_t)config.width() * 3);
+    }
+    BitplaneFrame full(config);
+    uint64_t start = monotonicNs();
+    for (int i = 0; i < ticks; i++) {
+        drawAnimation(part, i);
+        for (int y = 0; y < config.panelRows; y++) {
+            memcpy(combined.row(y), part.row(y), (size_t)config.width() * 3);
+        }
+        full.build(combined, gamma);
+    }
+    double fullUs = (double)(monotonicNs() - start) / ticks / 1000;
+
+    printf("  %d P0 swaps: conversions P0=%lu P1=%lu  %.1f us/update (full canvas build %.1f us)\n",
+           ticks, dual.conversions[0], dual.conversions[1], halfUs, fullUs);
+    check(dual.conversions[1] <= 2, "static P1 converted once per frame buffer");
+    check(dual.conversions[0] == (unsigned long)ticks, "every P0 swap converted");
+
+    // Scanned result shows both signs
+    SimulatedPanel panel(config, PI4_STORE_NS);
+    Hub75Scanner<SimulatedPanel> scanner(panel, config);
+    scanner.begin();
+    scanTwice(panel, scanner, dual.frameToScan());
+    check(levelError(panel, scanner, combined, gamma, config) <= 0.5, "merged frame shows P0 and P1 content");
+
+    // Threaded: own render thread and frame rate per sign, converter thread
+    DualDisplay threaded(config, 2.2);
+    threaded.start();
+    DualRenderer renderers[2] = {
+        { &threaded.display(0), 20, 2, true },
+        { &threaded.display(1), 500, 2, false }
+    };
+    pthread_t threads[2];
+    for (int i = 0; i < 2; i++) {
+        pthread_create(&threads[i], nullptr, dualRenderThread, &renderers[i]);
+    }
+    uint64_t scanEnd = monotonicNs() + 2200000000ull;
+    unsigned long scans = 0;
+    while (monotonicNs() < scanEnd) {
+        threaded.frameToScan();
+        scans++;
+        sleepMs(2);
+    }
+    for (int i = 0; i < 2; i++) {
+        pthread_join(threads[i], nullptr);
+    }
+    threaded.stop();
+    printf("  threaded: P0 %lu swaps -> %lu conversions, P1 %lu swaps -> %lu conversions, "
+           "%lu frames published, %lu scans\n",
+           threaded.display(0).swaps, threaded.conversions[0], threaded.display(1).swaps,
+           threaded.conversions[1], threaded.framesPublished, scans);
+    check(threaded.conversions[1] <= 2 * threaded.display(1).swaps &&
+          threaded.conversions[1] * 5 < threaded.conversions[0],
+          "threaded P1 reconverted only when swapped");
+}
+
+// ============================================================================
+// ARENA - per-frame scratch for compositing
+// ============================================================================
+
+struct GlyphEntry {
+    uint32_t code;
+    uint8_t bitmap[8];
+
+    explicit GlyphEntry(uint32_t glyph) : code(glyph) {
+        for (int i = 0; i < 8; i++) {
+            bitmap[i] = (uint8_t)(glyph * 37 + i * 11);
+        }
+    }
+};
+
+// Per-frame scratch from the general heap, freed at the end of the frame
+struct HeapScratch {
+    void* blocks[8];
+    int count;
+
+    HeapScratch() : count(0) {}
+
+    template <class T>
+    T* allocateArray(size_t n) {
+        T* block = (T*)malloc(n * sizeof(T));
+        blocks[count++] = block;
+        return block;
+    }
+
+    void endFrame() {
+        while (count > 0) {
+            free(blocks[--count]);
+        }
+    }
+};
+
+struct ArenaScratch {
+    FrameArena* arena;
+    bool ownsFrame;  // Workers leave the reset to the frame boundary
+
+    template <class T>
+    T* allocateArray(size_t n) { return arena->allocateArray<T>(n); }
+
+    void endFrame() {
+        if (ownsFrame) {
+            arena->reset();
+        }
+    }
+};
+
+// Typical compositing temporaries: a 16-bit accumulation layer, a sprite
+// scaled up 2x and a text layout, blended into rows [top, bottom)
+template <class Scratch>
+static void composeRows(Canvas& canvas, int top, int bottom, int frame, Scratch& scratch) {
+    const int w = canvas.width();
+    const int rows = bottom - top;
+    uint16_t* layer = scratch.template allocateArray<uint16_t>((size_t)w * rows * 3);
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < w; x++) {
+            uint16_t* p = layer + ((size_t)y * w + x) * 3;
+            p[0] = (uint16_t)((x + frame) * 97);
+            p[1] = (uint16_t)((top + y) * 701);
+            p[2] = 8192;
+        }
+    }
+
+    const int spriteSize = 16;
+    uint8_t* sprite = scratch.template allocateArray<uint8_t>(spriteSize * spriteSize);
+    uint8_t* scaled = scratch.template allocateArray<uint8_t>(4 * spriteSize * spriteSize);
+    for (int i = 0; i < spriteSize * spriteSize; i++) {
+        sprite[i] = (uint8_t)((i ^ frame) & 0xFF);
+    }
+    for (int y = 0; y < 2 * spriteSize; y++) {
+        for (int x = 0; x < 2 * spriteSize; x++) {
+            scaled[y * 2 * spriteSize + x] = sprite[(y / 2) * spriteSize + x / 2];
+        }
+    }
+    int spriteX = frame % (w - 2 * spriteSize);
+    for (int y = 0; y < 2 * spriteSize && y < rows; y++) {
+        for (int x = 0; x < 2 * spriteSize; x++) {
+            layer[((size_t)y * w + spriteX + x) * 3] += (uint16_t)(scaled[y * 2 * spriteSize + x] << 6);
+        }
+    }
+
+    const int glyphs = 24;
+    int16_t* positions = scratch.template allocateArray<int16_t>(glyphs * 2);
+    for (int i = 0; i < glyphs; i++) {
+        positions[i * 2] = (int16_t)((i * 6 + frame) % w);
+        positions[i * 2 + 1] = (int16_t)(i % rows);
+    }
+    for (int i = 0; i < glyphs; i++) {
+        uint16_t* p = layer + ((size_t)positions[i * 2 + 1] * w + positions[i * 2]) * 3;
+        p[0] = p[1] = p[2] = 0xFFFF;
+    }
+
+    for (int y = 0; y < rows; y++) {
+        uint8_t* out = canvas.row(top + y);
+        const uint16_t* in = layer + (size_t)y * w * 3;
+        for (int i = 0; i < w * 3; i++) {
+            out[i] = (uint8_t)(in[i] >> 8);
+        }
+    }
+    scratch.endFrame();
+}
+
+template <class Scratch>
+static void composeFrames(Canvas& canvas, int frames, Scratch& scratch, double& meanUs, double& worstUs) {
+    uint64_t total = 0;
+    uint64_t worst = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        uint64_t start = monotonicNs();
+        composeRows(canvas, 0, canvas.height(), frame, scratch);
+        uint64_t ns = monotonicNs() - start;
+        total += ns;
+        worst = ns > worst ? ns : worst;
+    }
+    meanUs = (double)total / frames / 1000;
+    worstUs = (double)worst / 1000;
+}
+
+struct ComposeWorker {
+    Canvas* canvas;
+    FrameArena* arena;
+    pthread_barrier_t* barrier;
+    int top;
+    int bottom;
+    int frames;
+};
+
+// Composes its band every frame; the main thread resets the arenas between
+static void* composeWorkerThread(void* arg) {
+    ComposeWorker* worker = (ComposeWorker*)arg;
+    ArenaScratch scratch = { worker->arena, false };
+    for (int frame = 0; frame < worker->frames; frame++) {
+        pthread_barrier_wait(worker->barrier);
+        {
+            AllocScope scope(ALLOC_SCOPE_RENDER);
+            composeRows(*worker->canvas, worker->top, worker->bottom, frame, scratch);
+        }
+        pthread_barrier_wait(worker->barrier);
+    }
+    return nullptr;
+}
+
+static void benchmarkArena() {
+    printf("arena\n");
+
+    FrameArena tiny(64);
+    void* first = tiny.allocate(40);
+    void* second = tiny.allocate(40);
+    tiny.reset();
+    check(first && !second && tiny.failureCount() == 1 && tiny.highWater() == 40,
+          "exhausted arena fails without touching the heap");
+
+    ObjectPool<GlyphEntry> small(2);
+    GlyphEntry* a = small.create(1u);
+    GlyphEntry* b = small.create(2u);
+    GlyphEntry* c = small.create(3u);
+    small.destroy(a);
+    GlyphEntry* d = small.create(4u);
+    check(a && b && !c && d == a && small.highWater() == 2 && small.failureCount() == 1,
+          "pool reuses freed slots, fails when full");
+
+    // Single thread: heap against arena scratch
+    MatrixConfig config = DEFAULT_MATRIX_CONFIG;
+    config.chainLength = 2;
+    Canvas canvas(config.width(), config.height());
+    const int frames = 2000;
+    HeapScratch heap;
+    FrameArena arena(256 * 1024);
+    ArenaScratch arenaScratch = { &arena, true };
+    double heapMeanUs, heapWorstUs, arenaMeanUs, arenaWorstUs;
+    composeFrames(canvas, frames, heap, heapMeanUs, heapWorstUs);
+    unsigned long callsBefore = allocGuardScopeCalls(ALLOC_SCOPE_RENDER);
+    {
+        AllocScope scope(ALLOC_SCOPE_RENDER);
+        composeFrames(canvas, frames, arenaScratch, arenaMeanUs, arenaWorstUs);
+    }
+    printf("  %dx%d compose: heap %.1f us/frame (worst %.1f), arena %.1f us/frame (worst %.1f), "
+           "arena high water %zu of %zu bytes\n",
+           config.width(), config.height(), heapMeanUs, heapWorstUs, arenaMeanUs, arenaWorstUs,
+           arena.highWater(), arena.bytesReserved());
+    check(allocGuardScopeCalls(ALLOC_SCOPE_RENDER) == callsBefore && arena.failureCount() == 0,
+          "arena compositing makes no heap calls");
+
+    // Glyph cache: direct mapped, entries from the pool
+    ObjectPool<GlyphEntry> glyphPool(64);
+    GlyphEntry* cache[64] = {};
+    unsigned long misses = 0;
+    {
+        AllocScope scope(ALLOC_SCOPE_RENDER);
+        for (int frame = 0; frame < frames; frame++) {
+            for (int i = 0; i < 24; i++) {
+                uint32_t code = (uint32_t)(frame / 40 + i * 7) % 96;
+                GlyphEntry*& slot = cache[code % 64];
+                if (!slot || slot->code != code) {
+                    glyphPool.destroy(slot);
+                    slot = glyphPool.create(code);
+                    misses++;
+                }
+            }
+        }
+    }
+    printf("  glyph cache: %lu misses in %d lookups, pool high water %d of 64\n", misses, frames * 24,
+           glyphPool.highWater());
+    check(glyphPool.failureCount() == 0 && glyphPool.highWater() <= 64, "glyph entries stay within the pool");
+
+    // Two workers with their own arenas, reset together at the frame boundary
+    ArenaSet workers(2, 128 * 1024);
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, nullptr, 3);
+    const int workerFrames = 500;
+    ComposeWorker jobs[2] = {
+        { &canvas, &workers.worker(0), &barrier, 0, config.panelRows, workerFrames },
+        { &canvas, &workers.worker(1), &barrier, config.panelRows, config.height(), workerFrames }
+    };
+    pthread_t threads[2];
+    for (int i = 0; i < 2; i++) {
+        pthread_create(&threads[i], nullptr, composeWorkerThread, &jobs[i]);
+    }
+    for (int frame = 0; frame < workerFrames; frame++) {
+        pthread_barrier_wait(&barrier);
+        pthread_barrier_wait(&barrier);
+        workers.reset();
+    }
+    for (int i = 0; i < 2; i++) {
+        pthread_join(threads[i], nullptr);
+    }
+    pthread_barrier_destroy(&barrier);
+    check(workers.worker(0).highWater() > 0 && workers.worker(1).highWater() > 0 &&
+          workers.worker(0).failureCount() + workers.worker(1).failureCount() == 0,
+          "per-worker arenas cover each band");
+
+    // High-water marks through the stats socket
+    StatsServer server;
+    server.add(arena, "compose");
+    server.add(workers, "worker");
+    server.add(glyphPool, "glyphs");
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/matrix_benchmark_%d.stats", (int)getpid());
+    char report[STATS_REPORT_SIZE];
+    size_t length = 0;
+    bool served = server.start(path) && statsQuery(path, report, sizeof(report), length);
+    server.stop();
+    for (const char* line = report; served && *line; line = nextLine(line)) {
+        const char* end = strchr(line, '\n');
+        printf("    %.*s\n", (int)(end ? end - line : (long)strlen(line)), line);
+    }
+    check(served && strstr(report, "compose.high_water ") && strstr(report, "worker.1.high_water ") &&
+          strstr(report, "glyphs.high_water "), "stats socket reports high-water marks");
+}
+
+// ============================================================================
+// SCENE - retained widgets with damage tracking
+// ============================================================================
+
+struct SignageScene {
+    uint8_t imagePixels[32 * 32 * 3];
+    SceneGraph scene;
+    ImageNode image;
+    ClockNode clock;
+    TextNode title;
+    TickerNode ticker;
+
+    // 128x64: logo and clock on P0, title and ticker on P1
+    explicit SignageScene(const MatrixConfig& config)
+        : scene(config), image({ 0, 0, 32, 32 }, imagePixels),
+          clock({ 44, 8, 62, 10 }, 1700000000000ll, 0, 2, 255, 160, 0),
+          title({ 4, 36, 120, 10 }, "PLATFORM 3", 2, 0, 200, 255),
+          ticker({ 0, 52, 128, 8 }, "NEXT TRAIN IN 4 MIN - MIND THE GAP", 20, 255, 255, 255) {
+        for (int y = 0; y < 32; y++) {
+            for (int x = 0; x < 32; x++) {
+                uint8_t* p = imagePixels + (y * 32 + x) * 3;
+                p[0] = (uint8_t)(x * 8);
+                p[1] = (uint8_t)(y * 8);
+                p[2] = (uint8_t)((x ^ y) * 8);
+            }
+        }
+        scene.add(&image);
+        scene.add(&clock);
+        scene.add(&title);
+        scene.add(&ticker);
+    }
+};
+
+static bool framesEqual(const BitplaneFrame& a, const BitplaneFrame& b, const MatrixConfig& config) {
+    if (a.totalPasses != b.totalPasses || a.totalUnits != b.totalUnits) {
+        return false;
+    }
+    for (int r = 0; r < config.rowAddresses(); r++) {
+        for (int p = 0; p < config.planes; p++) {
+            if (memcmp(a.planeWords(r, p), b.planeWords(r, p), (size_t)config.width() * sizeof(uint32_t)) != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void benchmarkScene() {
+    printf("scene\n");
+
+    MatrixConfig config = DEFAULT_MATRIX_CONFIG;
+    config.chainLength = 2;
+    GammaTable gamma;
+    gamma.build(config.planes, 2.2);
+
+    // 10 s at a 200 Hz refresh: render + bitplane update before every frame
+    const int ticks = 2000;
+    const uint32_t tickMs = 5;
+    SignageScene retained(config);
+    Canvas canvas(config.width(), config.height());
+    BitplaneFrame frame(config);
+    frame.plan();
+    unsigned long updates = 0;
+    unsigned long rowsConverted = 0;
+    uint64_t retainedNs = 0;
+    for (int i = 0; i < ticks; i++) {
+        uint64_t start = monotonicNs();
+        RowDamage damage;
+        if (retained.scene.render(canvas, (uint32_t)i * tickMs, damage)) {
+            frame.update(canvas, gamma, damage);
+            updates++;
+            rowsConverted += (unsigned long)damage.count();
+        }
+        retainedNs += monotonicNs() - start;
+    }
+
+    // Same scene redrawn and converted completely every frame
+    SignageScene immediate(config);
+    Canvas fullCanvas(config.width(), config.height());
+    BitplaneFrame fullFrame(config);
+    uint64_t fullNs = 0;
+    for (int i = 0; i < ticks; i++) {
+        uint64_t start = monotonicNs();
+        RowDamage damage;
+        immediate.scene.invalidateAll();
+        immediate.scene.render(fullCanvas, (uint32_t)i * tickMs, damage);
+        fullFrame.build(fullCanvas, gamma);
+        fullNs += monotonicNs() - start;
+    }
+    printf("  %dx%d signage, %d frames: retained %.2f us/frame (%lu updates, %.1f row addresses each, "
+           "%lu node draws), full redraw %.2f us/frame\n",
+           config.width(), config.height(), ticks, (double)retainedNs / ticks / 1000, updates,
+           updates ? (double)rowsConverted / updates : 0.0, retained.scene.nodesDrawn, (double)fullNs / ticks / 1000);
+    check(memcmp(canvas.row(0), fullCanvas.row(0), (size_t)config.width() * config.height() * 3) == 0,
+          "retained canvas matches a full redraw");
+    check(framesEqual(frame, fullFrame, config), "damaged-row update matches a full build");
+
+    // Clock alone: one update per second, nothing in between
+    SceneGraph clockScene(config);
+    ClockNode clock({ 44, 8, 62, 10 }, 1700000000000ll, 0, 2, 255, 160, 0);
+    clockScene.add(&clock);
+    Canvas clockCanvas(config.width(), config.height());
+    BitplaneFrame clockFrame(config);
+    RowDamage first;
+    clockScene.render(clockCanvas, 0, first);
+    clockFrame.update(clockCanvas, gamma, first);
+    uint64_t idleNs = 0;
+    uint64_t changeNs = 0;
+    int changes = 0;
+    int widestDamage = 0;
+    for (int i = 1; i <= ticks; i++) {
+        uint64_t start = monotonicNs();
+        RowDamage damage;
+        bool changed = clockScene.render(clockCanvas, (uint32_t)i * tickMs, damage);
+        if (changed) {
+            clockFrame.update(clockCanvas, gamma, damage);
+            changes++;
+            widestDamage = damage.count() > widestDamage ? damage.count() : widestDamage;
+        }
+        (changed ? changeNs : idleNs) += monotonicNs() - start;
+    }
+    printf("  clock: %d updates in %d frames, %.0f ns per idle frame, %.1f us per update (%d row addresses)\n",
+           changes, ticks, (double)idleNs / (ticks - changes), (double)changeNs / changes / 1000, widestDamage);
+    check(changes == ticks * (int)tickMs / 1000, "clock redraws once per second");
+    check(widestDamage <= 10, "clock damage stays within its rows");
+
+    // Moving a node damages where it was and where it is
+    RowDamage moved;
+    retained.title.moveTo(4, 40);
+    retained.scene.render(canvas, (uint32_t)ticks * tickMs, moved);
+    bool oldAndNew = false;
+    for (int i = 0; i < retained.scene.damageRects(); i++) {
+        const Rect& area = retained.scene.damageRect(i);
+        oldAndNew = oldAndNew || (area.y == 36 && area.h == 14 && area.x == 4);
+    }
+    check(oldAndNew, "moved node damages old and new area");
+}
+
+// ============================================================================
+// DASHBOARD - per-core bars and sparklines, redrawn incrementally
+// ============================================================================
+
+// Four cores that sit still most samples and move a few percent otherwise
+static void nextDashboardSample(DashboardSample& sample, FastRandom& random) {
+    int64_t total = 0;
+    for (int i = 0; i < sample.cores; i++) {
+        if (random.next16() < 16384) {
+            int step = (int)(random.next16() % 17) - 8;
+            int percent = (int)(sample.coreLoads[i] >> FIXED_SHIFT) + step;
+            percent = percent < 0 ? 0 : (percent > 100 ? 100 : percent);
+            sample.coreLoads[i] = percentToFixed(percent);
+        }
+        total += sample.coreLoads[i];
+    }
+    sample.load = (fixed_t)(total / sample.cores);
+    sample.hasTemperature = true;
+    sample.milliCelsius = 45000 + (int)((int64_t)sample.load * 25000 / FIXED_100_PERCENT);
+}
+
+static void benchmarkDashboard() {
+    printf("dashboard\n");
+
+    MatrixConfig config = DEFAULT_MATRIX_CONFIG;
+    config.chainLength = 2;
+    GammaTable gamma;
+    gamma.build(config.planes, 2.2);
+
+    // 10 minutes sampled every 100 ms, as matrixDisplay --dashboard does
+    const int samples = 6000;
+    const uint32_t sampleMs = 100;
+    DashboardSample sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.cores = 4;
+    FastRandom random(97);
+
+    Dashboard incremental(config, sample.cores);
+    Canvas canvas(config.width(), config.height());
+    BitplaneFrame frame(config);
+    frame.plan();
+    Dashboard redrawn(config, sample.cores);
+    Canvas fullCanvas(config.width(), config.height());
+    BitplaneFrame fullFrame(config);
+    uint64_t incrementalNs = 0;
+    uint64_t fullNs = 0;
+    unsigned long updates = 0;
+    unsigned long rowsConverted = 0;
+    bool canvasesEqual = true;
+    for (int i = 0; i < samples; i++) {
+        nextDashboardSample(sample, random);
+        uint32_t nowMs = (uint32_t)i * sampleMs;
+
+        uint64_t start = monotonicNs();
+        RowDamage damage;
+        if (incremental.render(canvas, sample, nowMs, damage)) {
+            frame.update(canvas, gamma, damage);
+            updates++;
+            rowsConverted += (unsigned long)damage.count();
+        }
+        incrementalNs += monotonicNs() - start;
+
+        // Same samples, redrawn and converted completely every time
+        start = monotonicNs();
+        RowDamage all;
+        redrawn.invalidateAll();
+        redrawn.render(fullCanvas, sample, nowMs, all);
+        fullFrame.build(fullCanvas, gamma);
+        fullNs += monotonicNs() - start;
+
+        if (i % 500 == 499) {
+            canvasesEqual = canvasesEqual &&
+                            memcmp(canvas.row(0), fullCanvas.row(0), (size_t)config.width() * config.height() * 3) == 0;
+        }
+    }
+    double incrementalUs = (double)incrementalNs / samples / 1000;
+    double fullUs = (double)fullNs / samples / 1000;
+    printf("  %dx%d, %d cores, %d samples: incremental %.2f us/sample (%lu updates, %.1f row addresses each, "
+           "%lu bar draws, %lu scrolls), full redraw %.2f us/sample\n",
+           config.width(), config.height(), sample.cores, samples, incrementalUs, updates,
+           updates ? (double)rowsConverted / updates : 0.0, incremental.barsDrawn, incremental.columnsScrolled, fullUs);
+    printf("  at %u ms per sample: %.3f%% of a core incremental, %.3f%% full redraw\n", sampleMs,
+           incrementalUs / (sampleMs * 10.0), fullUs / (sampleMs * 10.0));
+    check(canvasesEqual, "shifted sparklines match a full redraw");
+    check(framesEqual(frame, fullFrame, config), "damaged-row update matches a full build");
+    check(incremental.columnsScrolled ==
+              (unsigned long)(samples - 1) * sampleMs / DASHBOARD_STEP_MS * incremental.sparklines(),
+          "sparklines step once per second");
+
+    // Nothing changed: nothing drawn; one core moved: only its bar rows
+    // (and the header, whose total follows it)
+    RowDamage idle;
+    uint32_t nowMs = (uint32_t)(samples - 1) * sampleMs;
+    bool quiet = !incremental.render(canvas, sample, nowMs, idle);
+    sample.coreLoads[2] = sample.coreLoads[2] < percentToFixed(50) ? percentToFixed(90) : percentToFixed(10);
+    RowDamage oneBar;
+    incremental.render(canvas, sample, nowMs, oneBar);
+    check(quiet, "unchanged sample touches nothing");
+    check(oneBar.count() <= incremental.barRows() + FONT_HEIGHT, "one changed bar damages its rows and the header");
+
+    // What the adapter shows, through the simulated scan-out
+    frame.update(canvas, gamma, oneBar);
+    SimulatedPanel panel(config, PI_ZERO_STORE_NS);
+    Hub75Scanner<SimulatedPanel> scanner(panel, config);
+    scanner.begin();
+    scanTwice(panel, scanner, frame);
+    check(levelError(panel, scanner, canvas, gamma, config) <= 0.5, "simulated panel shows the dashboard");
+}
+
+// ============================================================================
+// BLEND - crossfade of low-rate content between refreshes
+// ============================================================================
+
+static void blendBytesScalar(uint8_t* out, const uint8_t* a, const uint8_t* b, size_t bytes, uint32_t alpha) {
+    for (size_t i = 0; i < bytes; i++) {
+        out[i] = (uint8_t)((a[i] * (256 - alpha) + b[i] * alpha + 128) >> 8);
+    }
+}
+
+struct BlendSource {
+    FrameBlender* blender;
+    int frameMs;
+    int frames;
+};
+
+static void* blendSourceThread(void* arg) {
+    BlendSource* source = (BlendSource*)arg;
+    for (int i = 0; i < source->frames; i++) {
+        drawAnimation(source->blender->canvas(), i * 8);
+        source->blender->submit();
+        sleepMs(source->frameMs);
+    }
+    return nullptr;
+}
+
+// Blend and build cost of one interpolated frame
+static void blendCost(const MatrixConfig& config, const GammaTable& gamma) {
+    Canvas a(config.width(), config.height());
+    Canvas b(config.width(), config.height());
+    Canvas out(config.width(), config.height());
+    BitplaneFrame frame(config);
+    drawAnimation(a, 0);
+    drawAnimation(b, 8);
+    const size_t bytes = (size_t)config.width() * config.height() * 3;
+    const int rounds = 200;
+
+    uint64_t start = monotonicNs();
+    for (int i = 0; i < rounds; i++) {
+        blendBytes(out.row(0), a.row(0), b.row(0), bytes, (uint32_t)(i & 255));
+    }
+    double vectorUs = (double)(monotonicNs() - start) / rounds / 1000;
+    start = monotonicNs();
+    for (int i = 0; i < rounds; i++) {
+        blendBytesScalar(out.row(0), a.row(0), b.row(0), bytes, (uint32_t)(i & 255));
+    }
+    double scalarUs = (double)(monotonicNs() - start) / rounds / 1000;
+    start = monotonicNs();
+    for (int i = 0; i < rounds; i++) {
+        frame.build(out, gamma);
+    }
+    double buildUs = (double)(monotonicNs() - start) / rounds / 1000;
+    double frameUs = vectorUs + buildUs;
+    printf("  %dx%d: blend %.1f us (byte loop %.1f us), build %.1f us, %.1f us per interpolated frame; "
+           "%d%% of a core allows %.0f blended fps\n",
+           config.width(), config.height(), vectorUs, scalarUs, buildUs, frameUs,
+           DEFAULT_BLEND_SETTINGS.cpuPercent, DEFAULT_BLEND_SETTINGS.cpuPercent * 10000.0 / frameUs);
+}
+
+static void benchmarkBlend() {
+    printf("blend\n");
+
+    // Packed-lane blend against the plain formula, odd length for the tails
+    uint8_t a[1003];
+    uint8_t b[1003];
+    uint8_t fast[1003];
+    uint8_t reference[1003];
+    FastRandom random(98);
+    for (int i = 0; i < 1003; i++) {
+        a[i] = (uint8_t)random.next();
+        b[i] = (uint8_t)random.next();
+    }
+    bool exact = true;
+    static const uint32_t alphas[6] = { 0, 1, 77, 128, 255, 256 };
+    for (int i = 0; i < 6; i++) {
+        blendBytes(fast, a, b, sizeof(a), alphas[i]);
+        blendBytesScalar(reference, a, b, sizeof(a), alphas[i]);
+        exact = exact && memcmp(fast, reference, sizeof(a)) == 0;
+    }
+    check(exact, "vector blend matches the byte formula");
+    blendBytes(fast, a, b, sizeof(a), 0);
+    bool ends = memcmp(fast, a, sizeof(a)) == 0;
+    blendBytes(fast, a, b, sizeof(a), 256);
+    check(ends && memcmp(fast, b, sizeof(b)) == 0, "alpha 0 and 256 give the source frames");
+
+    MatrixConfig small = DEFAULT_MATRIX_CONFIG;
+    small.chainLength = 2;
+    MatrixConfig large = DEFAULT_MATRIX_CONFIG;
+    large.panelRows = 64;
+    large.chainLength = 4;
+    GammaTable gamma;
+    gamma.build(small.planes, 2.2);
+    blendCost(small, gamma);
+    blendCost(large, gamma);
+
+    // Driven by hand: 12 fps source, 200 Hz refresh, no cap in the way
+    const uint64_t sourceNs = 83333333;
+    const uint64_t refreshNs = 5000000;
+    BlendSettings uncapped = { 16, 100, 250 };
+    FrameBlender blender(small, 2.2, uncapped);
+    Canvas first(small.width(), small.height());
+    Canvas second(small.width(), small.height());
+    drawAnimation(first, 0);
+    drawAnimation(second, 8);
+    memcpy(blender.canvas().row(0), first.row(0), (size_t)small.width() * small.height() * 3);
+    blender.submit();
+    blender.update(0);
+    blender.frameToScan();
+    memcpy(blender.canvas().row(0), second.row(0), (size_t)small.width() * small.height() * 3);
+    blender.submit();
+    blender.update(sourceNs);
+    blender.frameToScan();
+
+    Canvas halfway(small.width(), small.height());
+    blendBytes(halfway.row(0), first.row(0), second.row(0), (size_t)small.width() * small.height() * 3, 128);
+    BitplaneFrame expected(small);
+    expected.build(halfway, gamma);
+    blender.update(sourceNs + (sourceNs + 1) / 2);
+    check(framesEqual(blender.frameToScan(), expected, small), "halfway frame is the 50% crossfade");
+    expected.build(second, gamma);
+    blender.update(2 * sourceNs);
+    check(framesEqual(blender.frameToScan(), expected, small), "fade ends on the new frame");
+
+    unsigned long before = blender.framesPublished;
+    blender.submit();
+    for (uint64_t t = 2 * sourceNs; t < 3 * sourceNs; t += refreshNs) {
+        blender.update(t);
+        blender.frameToScan();
+    }
+    unsigned long perSource = blender.framesPublished - before;
+    printf("  12 fps source at 200 Hz refresh: %lu frames per source frame (%d steps)\n", perSource,
+           uncapped.steps);
+    check(perSource >= (unsigned long)uncapped.steps / 2 && perSource <= (unsigned long)uncapped.steps + 1,
+          "one frame per blend step");
+
+    // A tight cap at 256x128: fewer steps, work stays under the cap
+    BlendSettings capped = { 16, 5, 250 };
+    FrameBlender cappedBlender(large, 2.2, capped);
+    const int sourceFrames = 24;
+    for (int i = 0; i < sourceFrames; i++) {
+        drawAnimation(cappedBlender.canvas(), i * 8);
+        cappedBlender.submit();
+        for (uint64_t t = i * sourceNs; t < (i + 1) * sourceNs; t += refreshNs) {
+            cappedBlender.update(t);
+            cappedBlender.frameToScan();
+        }
+    }
+    double share = (double)(cappedBlender.blendNs + cappedBlender.convertNs) / (sourceFrames * sourceNs) * 100;
+    printf("  256x128 capped at %d%%: %lu frames for %d source frames, %lu updates held back, %.1f%% of a core\n",
+           capped.cpuPercent, cappedBlender.framesPublished, sourceFrames, cappedBlender.cappedSteps, share);
+    check(share <= capped.cpuPercent * 1.2, "blending stays under the CPU cap");
+
+    // Threaded: 12 fps render thread, converter thread, scan loop
+    FrameBlender threaded(small, 2.2, DEFAULT_BLEND_SETTINGS);
+    threaded.start();
+    BlendSource source = { &threaded, 83, 24 };
+    pthread_t sourceId;
+    pthread_create(&sourceId, nullptr, blendSourceThread, &source);
+    uint64_t startNs = monotonicNs();
+    uint64_t scanEnd = startNs + 2100000000ull;
+    unsigned long scans = 0;
+    unsigned long changes = 0;
+    const BitplaneFrame* last = nullptr;
+    while (monotonicNs() < scanEnd) {
+        const BitplaneFrame* frame = &threaded.frameToScan();
+        changes += frame != last;
+        last = frame;
+        scans++;
+        sleepMs(2);
+    }
+    pthread_join(sourceId, nullptr);
+    threaded.stop();
+    double threadedShare = (double)(threaded.blendNs + threaded.convertNs) / (monotonicNs() - startNs) * 100;
+    printf("  threaded: %lu source frames, %lu frames published, %lu frame changes in %lu scans, "
+           "%.1f%% of a core\n",
+           threaded.sourceFrames, threaded.framesPublished, changes, scans, threadedShare);
+    check(threaded.framesPublished > 2 * threaded.sourceFrames, "threaded frames are blended between sources");
+    check(threadedShare <= DEFAULT_BLEND_SETTINGS.cpuPercent * 1.2, "threaded blending stays under the CPU cap");
+}
+
+// ============================================================================
+// PREVIEW - changed tiles to a browser over a loopback WebSocket
+// ============================================================================
+
+// Apply one preview message to image, as the page's script does
+static bool decodePreview(const uint8_t* d, size_t length, Canvas& image) {
+    if (length < 8 || d[0] != 1 || (d[1] | d[2] << 8) != image.width() || (d[3] | d[4] << 8) != image.height()) {
+        return false;
+    }
+    const int w = image.width();
+    const int h = image.height();
+    const int t = d[5];
+    const int tiles = d[6] | d[7] << 8;
+    size_t p = 8;
+    for (int k = 0; k < tiles; k++) {
+        if (p + 3 > length) {
+            return false;
+        }
+        int x = d[p] * t;
+        int y = d[p + 1] * t;
+        int colors = d[p + 2];
+        int tw = w - x < t ? w - x : t;
+        int th = h - y < t ? h - y : t;
+        size_t palette = p + 3;
+        p = palette + (size_t)colors * 3;
+        for (int i = 0; i < tw * th;) {
+            size_t source;
+            int run;
+            if (colors == 0) {
+                source = p;
+                run = 1;
+                p += 3;
+            } else {
+                if (d[p] >= colors) {
+                    return false;
+                }
+                source = palette + (size_t)d[p] * 3;
+                run = d[p + 1] + 1;
+                p += 2;
+            }
+            if (p > length) {
+                return false;
+            }
+            for (int j = 0; j < run && i < tw * th; j++, i++) {
+                image.setPixel(x + i % tw, y + i / tw, d[source], d[source + 1], d[source + 2]);
+            }
+        }
+    }
+    return p == length;
+}
+
+static int previewConnect(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd >= 0 && connect(fd, (const struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Send request, read up to the end of the response head into buffer
+static bool previewRequest(int fd, const char* request, char* buffer, size_t size) {
+    if (send(fd, request, strlen(request), MSG_NOSIGNAL) != (ssize_t)strlen(request)) {
+        return false;
+    }
+    size_t length = 0;
+    while (length + 1 < size) {
+        ssize_t n = recv(fd, buffer + length, 1, 0);  // Byte by byte: frames follow the head
+        if (n <= 0) {
+            break;
+        }
+        length += (size_t)n;
+        buffer[length] = '\0';
+        if (length >= 4 && memcmp(buffer + length - 4, "\r\n\r\n", 4) == 0) {
+            return true;
+        }
+    }
+    buffer[length] = '\0';
+    return length > 0;
+}
+
+// RFC 6455 sample key and its accept value
+static const char PREVIEW_UPGRADE[] =
+    "GET /ws HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+
+struct PreviewClient {
+    int fd;
+    Canvas* image;
+    uint8_t* buffer;
+    size_t bufferSize;
+    unsigned long bytes;
+    unsigned long messages;
+    bool valid;
+};
+
+static void* previewClientThread(void* arg) {
+    PreviewClient* client = (PreviewClient*)arg;
+    size_t length = 0;
+    for (;;) {
+        ssize_t n = recv(client->fd, client->buffer + length, client->bufferSize - length, 0);
+        if (n <= 0) {
+            return nullptr;
+        }
+        length += (size_t)n;
+        client->bytes += (unsigned long)n;
+        size_t p = 0;
+        for (;;) {
+            if (length - p < 2) {
+                break;
+            }
+            const uint8_t* frame = client->buffer + p;
+            size_t head = 2;
+            uint64_t size = frame[1] & 0x7F;
+            if (size == 126) {
+                head = 4;
+                size = length - p >= 4 ? (uint64_t)frame[2] << 8 | frame[3] : 0;
+            } else if (size == 127) {
+                head = 10;
+                size = 0;
+                for (int i = 0; i < 8 && length - p >= 10; i++) {
+                    size = size << 8 | frame[2 + i];
+                }
+            }
+            if (length - p < head || length - p < head + size) {
+                break;
+            }
+            client->valid = client->valid && frame[0] == 0x82 && decodePreview(frame + head, (size_t)size, *client->image);
+            client->messages++;
+            p += head + (size_t)size;
+        }
+        memmove(client->buffer, client->buffer + p, length - p);
+        length -= p;
+    }
+}
+
+// Every tile changes every frame: the gradient moves
+static void drawMotion(Canvas& canvas, int frame) {
+    for (int y = 0; y < canvas.height(); y++) {
+        for (int x = 0; x < canvas.width(); x++) {
+            canvas.setPixel(x, y, (uint8_t)((x + frame) * 4), (uint8_t)((y + frame) * 8), (uint8_t)(frame * 3));
+        }
+    }
+}
+
+enum PreviewContent { PREVIEW_SIGNAGE, PREVIEW_DASHBOARD, PREVIEW_MOTION };
+static const char* const PREVIEW_CONTENT_NAMES[] = { "signage", "dashboard", "full motion" };
+
+static void runPreview(const MatrixConfig& config, PreviewContent content, int maxFps, bool stalledClient) {
+    PreviewServer server(config.width(), config.height(), maxFps);
+    if (!server.start("127.0.0.1", 0)) {
+        check(false, server.error);
+        return;
+    }
+    PreviewClient client = { previewConnect(server.port()), new Canvas(config.width(), config.height()),
+                             new uint8_t[512 * 1024], 512 * 1024, 0, 0, true };
+    char head[512];
+    bool upgraded = client.fd >= 0 && previewRequest(client.fd, PREVIEW_UPGRADE, head, sizeof(head)) &&
+                    strncmp(head, "HTTP/1.1 101", 12) == 0 && strstr(head, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != nullptr;
+    pthread_t reader;
+    pthread_create(&reader, nullptr, previewClientThread, &client);
+
+    // Connected and upgraded, never read: its socket buffers fill up
+    int stalled = -1;
+    if (stalledClient) {
+        stalled = previewConnect(server.port());
+        int small = 4096;
+        setsockopt(stalled, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+        previewRequest(stalled, PREVIEW_UPGRADE, head, sizeof(head));
+    }
+
+    Canvas canvas(config.width(), config.height());
+    SignageScene scene(config);
+    DashboardSample sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.cores = 4;
+    Dashboard dashboard(config, sample.cores);
+    FastRandom random(99);
+
+    // 2 s of content at a 200 Hz refresh, offered whenever it changed
+    const int ticks = 400;
+    uint64_t cpuBefore = server.cpuNs;
+    uint64_t startNs = monotonicNs();
+    uint64_t offerNs = 0;
+    uint64_t worstOfferNs = 0;
+    unsigned long offers = 0;
+    for (int i = 0; i < ticks; i++) {
+        uint32_t nowMs = (uint32_t)i * 5;
+        RowDamage damage;
+        bool changed = true;
+        if (content == PREVIEW_SIGNAGE) {
+            changed = scene.scene.render(canvas, nowMs, damage);
+        } else if (content == PREVIEW_DASHBOARD) {
+            changed = false;
+            if (i % 20 == 0) {
+                nextDashboardSample(sample, random);
+                changed = dashboard.render(canvas, sample, nowMs, damage);
+            }
+        } else {
+            drawMotion(canvas, i);
+        }
+        if (changed) {
+            uint64_t start = monotonicNs();
+            server.offer(canvas);
+            uint64_t spent = monotonicNs() - start;
+            offerNs += spent;
+            worstOfferNs = spent > worstOfferNs ? spent : worstOfferNs;
+            offers++;
+        }
+        sleepMs(5);
+    }
+    double seconds = (double)(monotonicNs() - startNs) / 1e9;
+    uint64_t cpuNs = server.cpuNs - cpuBefore;
+    unsigned long bytes = client.bytes;
+    unsigned long messages = client.messages;
+    sleepMs(3 * 1000 / maxFps + 100);  // Last offer reaches the client
+
+    server.stop();
+    pthread_join(reader, nullptr);
+    close(client.fd);
+    if (stalled >= 0) {
+        close(stalled);
+    }
+    printf("  %-11s %3d fps cap: %4lu offers (%.2f us mean, %.0f us worst), %3lu updates, %6.1f KB/s, "
+           "%5.0f B/update, server %.2f%% of a core%s\n",
+           PREVIEW_CONTENT_NAMES[content], maxFps, offers, offers ? (double)offerNs / offers / 1000 : 0.0,
+           (double)worstOfferNs / 1000, messages, bytes / seconds / 1024, messages ? (double)bytes / messages : 0.0,
+           (double)cpuNs / seconds / 1e7, stalledClient ? ", one client stalled" : "");
+    check(upgraded, "WebSocket handshake accepted");
+    check(client.valid && memcmp(client.image->row(0), canvas.row(0), (size_t)config.width() * config.height() * 3) == 0,
+          "decoded preview matches the canvas");
+    check(messages <= (unsigned long)(seconds * maxFps) + 2, "updates stay under the rate cap");
+    if (stalledClient) {
+        check(server.overflows > 0 && messages * 2 > (unsigned long)(seconds * maxFps),
+              "stalled client does not hold up the other");
+    }
+    delete client.image;
+    delete[] client.buffer;
+}
+
+static void benchmarkPreview() {
+    printf("preview\n");
+
+    uint8_t digest[20];
+    char text[32];
+    sha1((const uint8_t*)"abc", 3, digest);
+    base64Encode(digest, sizeof(digest), text);
+    check(strcmp(text, "qZk+NkcGgWq6PiVxeFDCbJzQ2J0=") == 0, "SHA-1 and base64 of \"abc\"");
+
+    MatrixConfig config = DEFAULT_MATRIX_CONFIG;
+    config.chainLength = 2;
+    runPreview(config, PREVIEW_SIGNAGE, 10, false);
+    runPreview(config, PREVIEW_DASHBOARD, 10, false);
+    runPreview(config, PREVIEW_MOTION, 10, false);
+    runPreview(config, PREVIEW_MOTION, 30, true);
+
+    // The page itself
+    PreviewServer server(config.width(), config.height(), 10);
+    server.start("127.0.0.1", 0);
+    int fd = previewConnect(server.port());
+    char head[512];
+    bool page = fd >= 0 && previewRequest(fd, "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n", head, sizeof(head)) &&
+                strncmp(head, "HTTP/1.1 200", 12) == 0;
+    char body[256];
+    ssize_t n = fd >= 0 ? recv(fd, body, sizeof(body) - 1, MSG_WAITALL) : -1;
+    body[n > 0 ? n : 0] = '\0';
+    check(page && strstr(body, "<!DOCTYPE html>") != nullptr, "GET / serves the preview page");
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+// ============================================================================
+// CACHE - decoded assets kept as bitplanes
+// ============================================================================
+
+const int CACHE_ASSETS = 12;
+const int CACHE_SOURCE_SCALE = 2;  // Assets are stored at twice the panel size
+
+struct CacheAsset {
+    uint8_t* encoded;   // Stand-in for the file: RGB at source resolution
+    size_t bytes;
+    uint64_t hash;
+};
+
+// "Decode": box filter the source down to the canvas, then convert
+static void decodeAsset(const CacheAsset& asset, Canvas& canvas, const GammaTable& gamma, BitplaneFrame& frame) {
+    const int sourceWidth = canvas.width() * CACHE_SOURCE_SCALE;
+    for (int y = 0; y < canvas.height(); y++) {
+        for (int x = 0; x < canvas.width(); x++) {
+            unsigned sum[3] = { 0, 0, 0 };
+            for (int dy = 0; dy < CACHE_SOURCE_SCALE; dy++) {
+                const uint8_t* p = asset.encoded +
+                                   ((size_t)(y * CACHE_SOURCE_SCALE + dy) * sourceWidth + x * CACHE_SOURCE_SCALE) * 3;
+                for (int dx = 0; dx < CACHE_SOURCE_SCALE * 3; dx++) {
+                    sum[dx % 3] += p[dx];
+                }
+            }
+            const unsigned n = CACHE_SOURCE_SCALE * CACHE_SOURCE_SCALE;
+            canvas.setPixel(x, y, (uint8_t)(sum[0] / n), (uint8_t)(sum[1] / n), (uint8_t)(sum[2] / n));
+        }
+    }
+    frame.build(canvas, gamma);
+}
+
+static void benchmarkCache() {
+    printf("cache (%d assets, room for 5 in memory and 8 in the spill file)\n", CACHE_ASSETS);
+
+    MatrixConfig config = DEFAULT_MATRIX_CONFIG;
+    config.chainLength = 2;
+    GammaTable gamma;
+    gamma.build(config.planes, 2.2);
+    Canvas canvas(config.width(), config.height());
+
+    CacheAsset assets[CACHE_ASSETS];
+    FastRandom random(7);
+    const size_t sourceBytes = (size_t)config.width() * config.height() * CACHE_SOURCE_SCALE * CACHE_SOURCE_SCALE * 3;
+    for (int i = 0; i < CACHE_ASSETS; i++) {
+        assets[i].encoded = new uint8_t[sourceBytes];
+        assets[i].bytes = sourceBytes;
+        for (size_t b = 0; b < sourceBytes; b++) {
+            assets[i].encoded[b] = (uint8_t)((b * (i + 1) + (random.next() & 15)) >> 3);
+        }
+        assets[i].hash = assetHash(assets[i].encoded, sourceBytes);  // Once, when the asset is registered
+    }
+    const uint64_t settings = displaySettingsHash(config, 2.2);
+
+    BitplaneFrame probe(config);
+    const size_t frameBytes = probe.storageSize();
+    const char* spillPath = "/tmp/hub75-asset-cache.spill";
+    AssetCache cache(config, 5 * frameBytes, spillPath, 8 * ((frameBytes + 63) & ~(size_t)63));
+    check(cache.memorySlots() == 5 && cache.spillCapacity() == 8, "budgets split into whole frames");
+
+    // Playlist-like rotation: three hot assets between every cold one
+    const int fetches = 600;
+    uint64_t hitNs = 0, spillNs = 0, missNs = 0;
+    unsigned long lastHits = 0, lastSpill = 0;
+    for (int i = 0; i < fetches; i++) {
+        int index = i % 4 != 3 ? (int)(random.next() % 3) : 3 + (int)(random.next() % (CACHE_ASSETS - 3));
+        const CacheAsset& asset = assets[index];
+        uint64_t start = monotonicNs();
+        const BitplaneFrame& frame = cache.fetch(asset.hash, settings, asset.bytes, [&](BitplaneFrame& out) {
+            decodeAsset(asset, canvas, gamma, out);
+        });
+        uint64_t elapsed = monotonicNs() - start;
+        if (cache.hits != lastHits) {
+            hitNs += elapsed;
+        } else if (cache.spillHits != lastSpill) {
+            spillNs += elapsed;
+        } else {
+            missNs += elapsed;
+        }
+        lastHits = cache.hits;
+        lastSpill = cache.spillHits;
+        (void)frame;
+    }
+    printf("  %d fetches: %lu hits (%.0f ns), %lu spill hits (%.1f us), %lu decodes (%.1f us)\n", fetches,
+           cache.hits, cache.hits ? (double)hitNs / cache.hits : 0.0, cache.spillHits,
+           cache.spillHits ? spillNs / 1000.0 / cache.spillHits : 0.0, cache.misses,
+           cache.misses ? missNs / 1000.0 / cache.misses : 0.0);
+    printf("  hit rate %.1f%% (%.1f%% with spill), %.1f MB of decoding saved, %lu evictions\n",
+           100.0 * cache.hits / cache.lookups, 100.0 * (cache.hits + cache.spillHits) / cache.lookups,
+           cache.bytesSaved / 1e6, cache.evictions);
+    check(cache.hits + cache.spillHits + cache.misses == (unsigned long)fetches, "every fetch counted once");
+    check(cache.hits > cache.misses && cache.spillHits > 0, "hot assets hit, cold ones come back from spill");
+    check(missNs > 0 && hitNs / (cache.hits ? cache.hits : 1) < missNs / (cache.misses ? cache.misses : 1) / 100,
+          "memory hit is 100x cheaper than a decode");
+
+    // Cached and spilled frames must scan out exactly like a fresh decode
+    BitplaneFrame fresh(config);
+    bool identical = true;
+    for (int i = 0; i < CACHE_ASSETS; i++) {
+        decodeAsset(assets[i], canvas, gamma, fresh);
+        const BitplaneFrame& cached = cache.fetch(assets[i].hash, settings, assets[i].bytes, [&](BitplaneFrame& out) {
+            decodeAsset(assets[i], canvas, gamma, out);
+        });
+        identical = identical && framesEqual(cached, fresh, config);
+    }
+    check(identical, "cached frames identical to a fresh decode");
+
+    BitplaneFrame copy(config);
+    copy.copyFrom(cache.fetch(assets[0].hash, settings, assets[0].bytes, [&](BitplaneFrame& out) {
+        decodeAsset(assets[0], canvas, gamma, out);
+    }));
+    decodeAsset(assets[0], canvas, gamma, fresh);
+    check(framesEqual(copy, fresh, config), "copyFrom keeps bitplanes and schedule");
+
+    unsigned long misses = cache.misses;
+    cache.fetch(assets[0].hash, displaySettingsHash(config, 1.8), assets[0].bytes, [&](BitplaneFrame& out) {
+        decodeAsset(assets[0], canvas, gamma, out);
+    });
+    check(cache.misses == misses + 1, "other gamma is another entry");
+
+    // One slot and one spill record: the hit's record is also the spill victim
+    {
+        AssetCache tiny(config, frameBytes, spillPath, (frameBytes + 63) & ~(size_t)63);
+        for (int i = 0; i < 2; i++) {
+            tiny.fetch(assets[i].hash, settings, assets[i].bytes, [&](BitplaneFrame& out) {
+                decodeAsset(assets[i], canvas, gamma, out);
+            });
+        }
+        const BitplaneFrame& back = tiny.fetch(assets[0].hash, settings, assets[0].bytes, [&](BitplaneFrame& out) {
+            decodeAsset(assets[0], canvas, gamma, out);
+        });
+        decodeAsset(assets[0], canvas, gamma, fresh);
+        bool restored = tiny.spillHits == 1 && framesEqual(back, fresh, config);
+        const BitplaneFrame& other = tiny.fetch(assets[1].hash, settings, assets[1].bytes, [&](BitplaneFrame& out) {
+            decodeAsset(assets[1], canvas, gamma, out);
+        });
+        decodeAsset(assets[1], canvas, gamma, fresh);
+        check(restored && tiny.spillHits == 2 && framesEqual(other, fresh, config),
+              "spill hit in a full one-record spill file");
+    }
+
+    for (int i = 0; i < CACHE_ASSETS; i++) {
+        delete[] assets[i].encoded;
+    }
+    unlink(spillPath);
+}
+
+// ============================================================================
+// ANIMATION - GIF decoded once, played from pre-converted frames
+// ============================================================================
+
+// Minimal GIF writer for test material: 256-color palette, LZW with only
+// literal codes (a clear code every 250 keeps the code width at 9 bits)
+class GifWriter {
+private:
+    uint8_t* bytes;
+    size_t capacity;
+
+public:
+    size_t size;
+
+    explicit GifWriter(size_t bytesCapacity) : bytes(new uint8_t[bytesCapacity]), capacity(bytesCapacity), size(0) {}
+    ~GifWriter() { delete[] bytes; }
+
+    const uint8_t* data() const { return bytes; }
+
+    void byte(int value) {
+        if (size < capacity) {
+            bytes[size++] = (uint8_t)value;
+        }
+    }
+
+    void le16(int value) {
+        byte(value & 0xFF);
+        byte(value >> 8);
+    }
+
+    void header(int width, int height, const uint8_t* palette, int loops) {
+        const char* magic = "GIF89a";
+        for (int i = 0; i < 6; i++) {
+            byte(magic[i]);
+        }
+        le16(width);
+        le16(height);
+        byte(0xF7);  // Global table of 256 colors
+        byte(0);
+        byte(0);
+        for (int i = 0; i < 256 * 3; i++) {
+            byte(palette[i]);
+        }
+        if (loops >= 0) {
+            byte(0x21);
+            byte(0xFF);
+            byte(11);
+            const char* app = "NETSCAPE2.0";
+            for (int i = 0; i < 11; i++) {
+                byte(app[i]);
+            }
+            byte(3);
+            byte(1);
+            le16(loops);
+            byte(0);
+        }
+    }
+
+    void image(int x, int y, int w, int h, const uint8_t* indices, int delayCs, int disposal, int transparent,
+               bool interlace) {
+        byte(0x21);
+        byte(0xF9);
+        byte(4);
+        byte((disposal << 2) | (transparent >= 0 ? 1 : 0));
+        le16(delayCs);
+        byte(transparent >= 0 ? transparent : 0);
+        byte(0);
+
+        byte(0x2C);
+        le16(x);
+        le16(y);
+        le16(w);
+        le16(h);
+        byte(interlace ? 0x40 : 0);
+        byte(8);
+
+        uint8_t block[255];
+        int blockLength = 0;
+        uint32_t bits = 0;
+        int bitCount = 0;
+        int literals = 0;
+        auto code = [&](int value) {
+            bits |= (uint32_t)value << bitCount;
+            bitCount += 9;
+            while (bitCount >= 8) {
+                block[blockLength++] = (uint8_t)bits;
+                bits >>= 8;
+                bitCount -= 8;
+                if (blockLength == 255) {
+                    byte(255);
+                    for (int i = 0; i < 255; i++) {
+                        byte(block[i]);
+                    }
+                    blockLength = 0;
+                }
+            }
+        };
+        code(256);
+        static const int starts[4] = { 0, 4, 2, 1 };
+        static const int steps[4] = { 8, 8, 4, 2 };
+        for (int pass = 0; pass < (interlace ? 4 : 1); pass++) {
+            int first = interlace ? starts[pass] : 0;
+            int step = interlace ? steps[pass] : 1;
+            for (int row = first; row < h; row += step) {
+                for (int col = 0; col < w; col++) {
+                    if (literals == 250) {
+                        code(256);
+                        literals = 0;
+                    }
+                    code(indices[(size_t)row * w + col]);
+                    literals++;
+                }
+            }
+        }
+        code(257);
+        if (bitCount > 0) {
+            block[blockLength++] = (uint8_t)bits;
+        }
+        if (blockLength > 0) {
+            byte(blockLength);
+            for (int i = 0; i < blockLength; i++) {
+                byte(block[i]);
+            }
+        }
+        byte(0);
+    }
+
+    void trailer() { byte(0x3B); }
+};
+
+// 6x6x6 color cube in the first 216 entries
+static void cubePalette(uint8_t* palette) {
+    memset(palette, 0, 256 * 3);
+    for (int i = 0; i < 216; i++) {
+        palette[i * 3] = (uint8_t)(i / 36 * 51);
+        palette[i * 3 + 1] = (uint8_t)(i / 6 % 6 * 51);
+        palette[i * 3 + 2] = (uint8_t)(i % 6 * 51);
+    }
+}
+
+// Bouncing ball over a scrolling gradient; the second half plays the first
+// backwards, so 32 of the 64 frames are repeats
+static void animationFrame(uint8_t* indices, int width, int height, int frame) {
+    int t = frame < 32 ? frame : 63 - frame;
+    int ballX = 8 + t * (width - 16) / 31;
+    int ballY = height / 2 + (int)(sin(t * 0.2) * (height / 2 - 8));
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int dx = x - ballX, dy = y - ballY;
+            int index = dx * dx + dy * dy < 49 ? 5 * 36 + 5 * 6 : ((x + t * 2) / 22 % 6) * 6 + y * 6 / height;
+            indices[(size_t)y * width + x] = (uint8_t)index;
+        }
+    }
+}
+
+static const int ANIMATION_DELAYS_CS[4] = { 3, 4, 4, 12 };
+
+static size_t writeAnimation(GifWriter& gif, int width, int height) {
+    uint8_t palette[256 * 3];
+    cubePalette(palette);
+    uint8_t* indices = new uint8_t[(size_t)width * height];
+    gif.header(width, height, palette, 0);
+    for (int frame = 0; frame < 64; frame++) {
+        animationFrame(indices, width, height, frame);
+        gif.image(0, 0, width, height, indices, ANIMATION_DELAYS_CS[frame % 4], 1, -1, false);
+    }
+    gif.trailer();
+    delete[] indices;
+    return gif.size;
+}
+
+static bool pixelIs(const uint8_t* rgb, int width, int x, int y, int r, int g, int b) {
+    const uint8_t* p = rgb + ((size_t)y * width + x) * 3;
+    return p[0] == r && p[1] == g && p[2] == b;
+}
+
+static void checkGifDecoding() {
+    // 8x8: red; green 4x4 at (2,2) to be cleared; blue pixel at (0,0)
+    // interlaced over a transparent background, on top of what disposal left
+    uint8_t palette[256 * 3];
+    cubePalette(palette);
+    const int red = 5 * 36, green = 5 * 6, blue = 5, hole = 255;
+    uint8_t full[64], square[16], corner[64];
+    memset(full, red, sizeof(full));
+    memset(square, green, sizeof(square));
+    memset(corner, hole, sizeof(corner));
+    corner[0] = blue;
+    corner[7 * 8 + 7] = blue;
+    GifWriter gif(4096);
+    gif.header(8, 8, palette, -1);
+    gif.image(0, 0, 8, 8, full, 5, 1, -1, false);
+    gif.image(2, 2, 4, 4, square, 0, 2, -1, false);
+    gif.image(0, 0, 8, 8, corner, 7, 1, hole, true);
+    gif.trailer();
+
+    GifDecoder decoder;
+    const uint8_t* rgb = nullptr;
+    uint32_t delays[3] = { 0, 0, 0 };
+    bool ok = decoder.open(gif.data(), gif.size) && decoder.nextFrame(rgb, delays[0]) &&
+              pixelIs(rgb, 8, 3, 3, 255, 0, 0) && decoder.nextFrame(rgb, delays[1]) &&
+              pixelIs(rgb, 8, 3, 3, 0, 255, 0) && pixelIs(rgb, 8, 1, 1, 255, 0, 0) &&
+              decoder.nextFrame(rgb, delays[2]) && pixelIs(rgb, 8, 3, 3, 0, 0, 0) &&
+              pixelIs(rgb, 8, 1, 1, 255, 0, 0) && pixelIs(rgb, 8, 0, 0, 0, 0, 255) &&
+              pixelIs(rgb, 8, 7, 7, 0, 0, 255) && !decoder.nextFrame(rgb, delays[0]) && !decoder.error();
+    check(ok, "GIF transparency, disposal and interlacing");
+    check(delays[1] == GIF_DEFAULT_DELAY_MS && delays[2] == 70 && decoder.loopCount == 1,
+          "GIF delays and play count");
+
+    GifDecoder truncated;
+    check(truncated.open(gif.data(), gif.size - 40) && truncated.nextFrame(rgb, delays[0]) &&
+          truncated.nextFrame(rgb, delays[0]) && !truncated.nextFrame(rgb, delays[0]) && truncated.error(),
+          "truncated GIF reports an error");
+}
+
+static void benchmarkAnimation() {
+    printf("animation (64-frame GIF, 128x64)\n");
+    checkGifDecoding();
+
+    MatrixConfig config = DEFAULT_MATRIX_CONFIG;
+    config.chainLength = 2;
+    GammaTable gamma;
+    gamma.build(config.planes, 2.2);
+    GifWriter gif(2 * 1024 * 1024);
+    writeAnimation(gif, config.width(), config.height());
+
+    AnimationSequence sequence(config);
+    uint64_t start = monotonicNs();
+    bool loaded = sequence.loadGif(gif.data(), gif.size, gamma);
+    double loadMs = (monotonicNs() - start) / 1e6;
+    printf("  %zu byte GIF loaded in %.1f ms: %d frames, %d unique, %d steps, %u ms per loop\n", gif.size, loadMs,
+           sequence.decodedFrames, sequence.uniqueFrames(), sequence.stepsPerLoop(), sequence.loopMs());
+    check(loaded && sequence.decodedFrames == 64 && sequence.loopCount == 0, "whole animation decoded");
+    check(sequence.uniqueFrames() == 32 && sequence.stepsPerLoop() == 63, "repeated frames stored once");
+
+    // Decoding every frame while playing: LZW, compositing, scaling, conversion
+    Canvas canvas(config.width(), config.height());
+    BitplaneFrame frame(config);
+    GifDecoder decoder;
+    decoder.open(gif.data(), gif.size);
+    const uint8_t* rgb;
+    uint32_t delayMs;
+    int decoded = 0;
+    start = monotonicNs();
+    while (decoder.nextFrame(rgb, delayMs)) {
+        for (int y = 0; y < canvas.height(); y++) {
+            for (int x = 0; x < canvas.width(); x++) {
+                const uint8_t* p = rgb + ((size_t)y * decoder.width() + x) * 3;
+                canvas.setPixel(x, y, p[0], p[1], p[2]);
+            }
+        }
+        frame.build(canvas, gamma);
+        decoded++;
+    }
+    double decodeUs = (monotonicNs() - start) / 1e3 / decoded;
+    double framesPerSecond = 64 * 1000.0 / sequence.loopMs();
+
+    // Playback: frameAt() before every refresh of a simulated panel
+    SimulatedPanel panel(config, PI_ZERO_STORE_NS);
+    Hub75Scanner<SimulatedPanel> scanner(panel, config);
+    scanner.begin();
+    scanner.scanFrame(sequence.frame(0));
+    const uint64_t refreshNs = scanner.lastPeriodNs;
+    AnimationPlayer player(sequence);
+    const uint32_t playMs = 3 * sequence.loopMs() + 17;
+    uint64_t playerNs = 0;
+    uint32_t worstLateUs = 0;
+    uint32_t expectedMs = sequence.step(0).delayMs;
+    int expectedStep = 1 % sequence.stepsPerLoop();
+    bool onTime = true;
+    int scans = 0;
+    for (uint64_t nowNs = 0; nowNs < (uint64_t)playMs * 1000000; nowNs += refreshNs) {
+        uint64_t callStart = monotonicNs();
+        const BitplaneFrame& shown = player.frameAt((uint32_t)(nowNs / 1000000));
+        playerNs += monotonicNs() - callStart;
+        if (scans++ % 50 == 0) {
+            scanner.scanFrame(shown);  // Occasionally, the simulator is slow
+        }
+        if (player.currentStep() == expectedStep && nowNs >= (uint64_t)expectedMs * 1000000) {
+            uint32_t lateUs = (uint32_t)((nowNs - (uint64_t)expectedMs * 1000000) / 1000);
+            worstLateUs = lateUs > worstLateUs ? lateUs : worstLateUs;
+            onTime = onTime && lateUs < refreshNs / 1000 + 1000;
+            expectedMs += sequence.step(expectedStep).delayMs;
+            expectedStep = (expectedStep + 1) % sequence.stepsPerLoop();
+        }
+    }
+    double playerPercent = 100.0 * playerNs / ((double)playMs * 1e6);
+    printf("  decode per frame: %.0f us, %.2f%% of a core at %.1f fps\n", decodeUs,
+           decodeUs * framesPerSecond / 1e4, framesPerSecond);
+    printf("  pre-converted: %.3f%% of a core over %d refreshes (%.0f Hz), %lu frame changes, "
+           "worst boundary %u us late\n",
+           playerPercent, scans, 1e9 / refreshNs, player.framesShown, worstLateUs);
+    check(onTime && player.framesShown == 3ul * sequence.stepsPerLoop() + 1 && player.framesSkipped == 0,
+          "every delay honored within one refresh");
+    check(player.loops == 3, "animation loops");
+    check(playerPercent * 10 < decodeUs * framesPerSecond / 1e4, "playback 10x cheaper than decoding");
+}
+
+// ============================================================================
+// VIDEO - decode, scale and convert as pipelined stages
+// ============================================================================
+
+const int VIDEO_SOURCE_WIDTH = 640;
+const int VIDEO_SOURCE_HEIGHT = 360;
+const int VIDEO_CLIP_FRAMES = 120;
+
+static void benchmarkVideo() {
+    printf("video (%dx%d synthetic clip -> 128x64)\n", VIDEO_SOURCE_WIDTH, VIDEO_SOURCE_HEIGHT);
+
+    MatrixConfig config = DEFAULT_MATRIX_CONFIG;
+    config.chainLength = 2;
+    GammaTable gamma;
+    gamma.build(config.planes, 2.2);
+
+    SpscQueue<int, 4> queue;
+    int items[5] = { 0, 1, 2, 3, 4 };
+    bool fifo = queue.push(&items[0]) && queue.push(&items[1]) && queue.push(&items[2]) && queue.push(&items[3]) &&
+                !queue.push(&items[4]) && queue.pop() == &items[0] && queue.push(&items[4]) &&
+                queue.pop() == &items[1] && queue.peek() == &items[2];
+    check(fifo, "bounded queue is FIFO and refuses when full");
+
+    // Serial: all three stages on one thread
+    SyntheticVideoSource serialSource(VIDEO_SOURCE_WIDTH, VIDEO_SOURCE_HEIGHT, VIDEO_CLIP_FRAMES, 30);
+    VideoPicture picture(VIDEO_SOURCE_WIDTH, VIDEO_SOURCE_HEIGHT);
+    VideoScaler scaler(VIDEO_SOURCE_WIDTH, VIDEO_SOURCE_HEIGHT, config.width(), config.height());
+    Canvas canvas(config.width(), config.height());
+    BitplaneFrame serialFrame(config);
+    uint64_t stageNs[3] = { 0, 0, 0 };
+    uint64_t serialStart = monotonicNs();
+    for (int i = 0; i < VIDEO_CLIP_FRAMES; i++) {
+        uint64_t t0 = monotonicNs();
+        serialSource.decode(picture);
+        uint64_t t1 = monotonicNs();
+        scaler.scale(picture, canvas);
+        uint64_t t2 = monotonicNs();
+        serialFrame.build(canvas, gamma);
+        uint64_t t3 = monotonicNs();
+        stageNs[0] += t1 - t0;
+        stageNs[1] += t2 - t1;
+        stageNs[2] += t3 - t2;
+    }
+    double serialFps = VIDEO_CLIP_FRAMES * 1e9 / (double)(monotonicNs() - serialStart);
+
+    // Pipelined, taking frames as fast as they come
+    SyntheticVideoSource source(VIDEO_SOURCE_WIDTH, VIDEO_SOURCE_HEIGHT, VIDEO_CLIP_FRAMES, 30);
+    VideoPipeline<SyntheticVideoSource> pipeline(source, config, 2.2, false);
+    uint64_t pipelineStart = monotonicNs();
+    pipeline.start();
+    int received = 0;
+    bool ordered = true;
+    uint32_t lastPts = 0;
+    const BitplaneFrame* last = nullptr;
+    while (const BitplaneFrame* frame = pipeline.nextFrame()) {
+        ordered = ordered && (received == 0 || pipeline.shownPtsMs() > lastPts);
+        lastPts = pipeline.shownPtsMs();
+        last = frame;
+        received++;
+    }
+    double pipelineFps = received * 1e9 / (double)(monotonicNs() - pipelineStart);
+    bool identical = last && framesEqual(*last, serialFrame, config);
+    pipeline.stop();
+
+    static const char* const names[3] = { "decode", "scale", "convert" };
+    int slowest = 0;
+    for (int i = 0; i < 3; i++) {
+        const VideoStageStats& stage = pipeline.stages[i];
+        printf("  %-8s %7.0f us/frame (serial %7.0f), %6.0f fps alone, output queued %6.0f us, worst %.0f us\n",
+               names[i], stage.meanUs(), stageNs[i] / 1e3 / VIDEO_CLIP_FRAMES, stage.throughput(),
+               stage.waitNs.load() / 1e3 / stage.frames.load(), stage.worstNs.load() / 1e3);
+        slowest = stage.throughput() < pipeline.stages[slowest].throughput() ? i : slowest;
+    }
+    printf("  serial %.0f fps, pipelined %.0f fps on %ld CPU(s); one core per stage: %.0f fps, limited by %s\n",
+           serialFps, pipelineFps, sysconf(_SC_NPROCESSORS_ONLN), pipeline.stages[slowest].throughput(),
+           names[slowest]);
+    printf("  latency decode start to shown: mean %.1f ms, worst %.1f ms\n",
+           pipeline.latencyNs / 1e6 / (pipeline.framesShown ? pipeline.framesShown : 1),
+           pipeline.worstLatencyNs / 1e6);
+    check(received == VIDEO_CLIP_FRAMES && ordered, "every frame through the pipeline, in order");
+    check(identical, "pipelined frame identical to the serial one");
+
+    // Real time: looping clip presented by timestamp at panel refreshes
+    SyntheticVideoSource loopSource(VIDEO_SOURCE_WIDTH, VIDEO_SOURCE_HEIGHT, 10, 30);
+    VideoPipeline<SyntheticVideoSource> player(loopSource, config, 2.2, true);
+    player.start();
+    uint64_t start = monotonicNs();
+    uint32_t previousPts = 0;
+    bool monotonic = true;
+    while (monotonicNs() - start < 1000000000ull) {
+        const BitplaneFrame* frame = player.frameAt((uint32_t)((monotonicNs() - start) / 1000000));
+        if (frame) {
+            monotonic = monotonic && player.shownPtsMs() >= previousPts;
+            previousPts = player.shownPtsMs();
+        }
+        sleepMs(4);
+    }
+    player.stop();
+    printf("  real time, 1 s at 30 fps with a 10-frame loop: %lu shown, %lu dropped, last timestamp %u ms\n",
+           player.framesShown, player.framesDropped, previousPts);
+    check(player.framesShown >= 25 && monotonic && previousPts > 900, "looped clip keeps its timestamps");
+}
+
+// ============================================================================
+// SPECTRUM - audio visualizer, FFT and render per audio-aligned frame
+// ============================================================================
+
+const int SPECTRUM_RATE = 44100;
+const int SPECTRUM_FPS = 60;
+
+static void writeAll(int fd, const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0) {
+            return;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+}
+
+// Stereo 16-bit tone of hz (0 = silence) at half scale
+static void writeTone(int fd, float hz, float seconds, uint64_t& phase) {
+    int16_t block[2 * 512];
+    int total = (int)(seconds * SPECTRUM_RATE);
+    for (int done = 0; done < total;) {
+        int count = total - done < 512 ? total - done : 512;
+        for (int i = 0; i < count; i++, phase++) {
+            int16_t value = (int16_t)(hz > 0 ? 16384 * sin(2 * M_PI * hz * phase / SPECTRUM_RATE) : 0);
+            block[2 * i] = value;
+            block[2 * i + 1] = value;
+        }
+        writeAll(fd, block, (size_t)count * 4);
+        done += count;
+    }
+}
+
+static bool writeWav(const char* path, const float* tones, const float* seconds, int parts) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    uint32_t frames = 0;
+    for (int i = 0; i < parts; i++) {
+        frames += (uint32_t)(seconds[i] * SPECTRUM_RATE);
+    }
+    uint8_t header[44];
+    uint32_t dataBytes = frames * 4;
+    memcpy(header, "RIFF", 4);
+    uint32_t riffSize = 36 + dataBytes;
+    memcpy(header + 4, &riffSize, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    uint32_t fmtSize = 16, rate = SPECTRUM_RATE, byteRate = SPECTRUM_RATE * 4;
+    uint16_t tag = 1, channels = 2, blockAlign = 4, bits = 16;
+    memcpy(header + 16, &fmtSize, 4);
+    memcpy(header + 20, &tag, 2);
+    memcpy(header + 22, &channels, 2);
+    memcpy(header + 24, &rate, 4);
+    memcpy(header + 28, &byteRate, 4);
+    memcpy(header + 32, &blockAlign, 2);
+    memcpy(header + 34, &bits, 2);
+    memcpy(header + 36, "data", 4);
+    memcpy(header + 40, &dataBytes, 4);
+    writeAll(fd, header, sizeof(header));
+    uint64_t phase = 0;
+    for (int i = 0; i < parts; i++) {
+        writeTone(fd, tones[i], seconds[i], phase);
+    }
+    close(fd);
+    return true;
+}
+
+static int loudestBand(const SpectrumVisualizer& spectrum) {
+    int loudest = 0;
+    for (int b = 1; b < spectrum.bands(); b++) {
+        loudest = spectrum.bar(b) > spectrum.bar(loudest) ? b : loudest;
+    }
+    return loudest;
+}
+
+struct ToneWriter {
+    int fd;
+    float hz;
+};
+
+static void* toneWriterThread(void* arg) {
+    ToneWriter* writer = (ToneWriter*)arg;
+    uint64_t phase = 0;
+    writeTone(writer->fd, writer->hz, 0.25f, phase);
+    close(writer->fd);
+    return nullptr;
+}
+
+static void benchmarkSpectrum() {
+    printf("spectrum (%d-point FFT, %d Hz, %d fps, 128x64)\n", SPECTRUM_FFT_SIZE, SPECTRUM_RATE, SPECTRUM_FPS);
+
+    // FFT against a direct DFT
+    RealFft fft(SPECTRUM_FFT_SIZE);
+    static float input[SPECTRUM_FFT_SIZE];
+    static float powers[SPECTRUM_FFT_SIZE / 2];
+    FastRandom random(5);
+    for (int i = 0; i < SPECTRUM_FFT_SIZE; i++) {
+        input[i] = (float)random.next16() / 32768.0f - 1.0f;
+    }
+    fft.power(input, powers);
+    double worstError = 0, largest = 0;
+    for (int k = 0; k < SPECTRUM_FFT_SIZE / 2; k++) {
+        double re = 0, im = 0;
+        for (int n = 0; n < SPECTRUM_FFT_SIZE; n++) {
+            re += input[n] * cos(2 * M_PI * k * n / SPECTRUM_FFT_SIZE);
+            im -= input[n] * sin(2 * M_PI * k * n / SPECTRUM_FFT_SIZE);
+        }
+        double error = fabs(sqrt(re * re + im * im) - sqrt(powers[k]));
+        worstError = error > worstError ? error : worstError;
+        largest = sqrt(re * re + im * im) > largest ? sqrt(re * re + im * im) : largest;
+    }
+    check(worstError < largest * 1e-4, "real FFT matches a direct DFT");
+
+    // Offline: tones from a WAV file land in their bands
+    const char* wavPath = "/tmp/hub75-spectrum.wav";
+    const float tones[3] = { 440.0f, 3000.0f, 0.0f };
+    const float seconds[3] = { 0.5f, 0.5f, 1.5f };
+    check(writeWav(wavPath, tones, seconds, 3), "test WAV written");
+    MatrixConfig config = DEFAULT_MATRIX_CONFIG;
+    config.chainLength = 2;
+    SpectrumVisualizer spectrum(SPECTRUM_RATE, SPECTRUM_FPS, config.width(), 2);
+    PcmReader reader;
+    bool opened = reader.openWav(wavPath) && reader.sampleRate == SPECTRUM_RATE;
+    static float hop[SPECTRUM_RATE / SPECTRUM_FPS];
+    int loudAt440 = -1, loudAt3000 = -1;
+    float peakAtSilence = 0, peakHeld = 0, peakLater = 1, barLater = 1;
+    const int band3000 = spectrum.bandOf(3000.0f);
+    bool aligned = true;
+    int frames = 0;
+    while (opened && reader.read(hop, spectrum.hopSamples()) == spectrum.hopSamples()) {
+        spectrum.analyze(hop);
+        frames++;
+        uint32_t ms = spectrum.frameTimeMs();
+        aligned = aligned && ms == (uint32_t)((uint64_t)frames * spectrum.hopSamples() * 1000 / SPECTRUM_RATE);
+        if (frames == 15) {
+            loudAt440 = loudestBand(spectrum);
+        } else if (frames == 45) {
+            loudAt3000 = loudestBand(spectrum);
+        } else if (frames == 61) {
+            peakAtSilence = spectrum.peak(band3000);
+        } else if (frames == 90) {
+            peakHeld = spectrum.peak(band3000);
+        } else if (frames == 140) {
+            peakLater = spectrum.peak(band3000);
+            barLater = spectrum.bar(band3000);
+        }
+    }
+    unlink(wavPath);
+    printf("  WAV: %d frames; 440 Hz -> band %d (loudest %d), 3 kHz -> band %d (loudest %d)\n", frames,
+           spectrum.bandOf(440.0f), loudAt440, band3000, loudAt3000);
+    check(opened && frames == (int)(2.5 * SPECTRUM_FPS), "WAV read to the end");
+    check(loudAt440 == spectrum.bandOf(440.0f) && loudAt3000 == band3000, "tones show in their bands");
+    check(aligned, "frame times follow the audio clock");
+    check(peakAtSilence > 0.8f && peakHeld == peakAtSilence && peakLater < peakHeld && barLater == 0.0f,
+          "peaks hold, then fall with the bars");
+
+    // Live: raw PCM through a pipe
+    int fds[2];
+    bool piped = pipe(fds) == 0;
+    ToneWriter writer = { piped ? fds[1] : -1, 1000.0f };
+    pthread_t writerId;
+    piped = piped && pthread_create(&writerId, nullptr, toneWriterThread, &writer) == 0;
+    SpectrumVisualizer live(SPECTRUM_RATE, SPECTRUM_FPS, config.width(), 2);
+    PcmReader pipeReader;
+    int pipeFrames = 0;
+    if (piped && pipeReader.openRaw(fds[0], SPECTRUM_RATE, 2)) {
+        while (pipeReader.read(hop, live.hopSamples()) == live.hopSamples()) {
+            live.analyze(hop);
+            pipeFrames++;
+        }
+        pthread_join(writerId, nullptr);
+    }
+    if (piped) {
+        close(fds[0]);
+    }
+    check(pipeFrames == 15 && loudestBand(live) == live.bandOf(1000.0f), "raw PCM from a pipe");
+
+    // 48 kHz at 30 fps: a hop of 1600 samples is longer than the FFT
+    SpectrumVisualizer slow(48000, 30, config.width(), 2);
+    static float longHop[48000 / 30];
+    for (int i = 0; i < slow.hopSamples(); i++) {
+        longHop[i] = (float)(0.5 * sin(2.0 * M_PI * 2000.0 * i / 48000.0));
+    }
+    slow.analyze(longHop);
+    slow.analyze(longHop);
+    check(slow.hopSamples() > SPECTRUM_FFT_SIZE && loudestBand(slow) == slow.bandOf(2000.0f) &&
+              slow.frameTimeMs() == 66,
+          "hop longer than the FFT keeps its last samples");
+
+    // Cost per frame: FFT and bars, drawing, conversion
+    Canvas canvas(config.width(), config.height());
+    GammaTable gamma;
+    gamma.build(config.planes, 2.2);
+    BitplaneFrame frame(config);
+    for (int i = 0; i < spectrum.hopSamples(); i++) {
+        hop[i] = (float)(0.3 * sin(i * 0.05) + 0.2 * sin(i * 0.7) + 0.05 * (random.next16() / 32768.0 - 1.0));
+    }
+    const int rounds = 600;
+    uint64_t analyzeNs = 0, renderNs = 0, buildNs = 0;
+    for (int i = 0; i < rounds; i++) {
+        uint64_t t0 = monotonicNs();
+        {
+            AllocScope scope(ALLOC_SCOPE_RENDER);
+            spectrum.analyze(hop);
+        }
+        uint64_t t1 = monotonicNs();
+        {
+            AllocScope scope(ALLOC_SCOPE_RENDER);
+            spectrum.render(canvas);
+        }
+        uint64_t t2 = monotonicNs();
+        frame.build(canvas, gamma);
+        uint64_t t3 = monotonicNs();
+        analyzeNs += t1 - t0;
+        renderNs += t2 - t1;
+        buildNs += t3 - t2;
+    }
+    double frameUs = 1e6 / SPECTRUM_FPS;
+    double perFrameUs = (analyzeNs + renderNs + buildNs) / 1e3 / rounds;
+    printf("  per frame: FFT+bands %.1f us, render %.1f us, convert %.1f us = %.1f%% of a %.1f ms frame%s\n",
+           analyzeNs / 1e3 / rounds, renderNs / 1e3 / rounds, buildNs / 1e3 / rounds, 100.0 * perFrameUs / frameUs,
+           frameUs / 1e3,
+#ifndef HUB75_NO_SIMD
+           ""
+#else
+           " (scalar)"
+#endif
+    );
+    check(perFrameUs * 20 < frameUs, "analysis and drawing under 5% of a frame");
+}
+
+// ============================================================================
+// PLAYLIST - item transitions with and without prefetch (needs -std=c++20)
+// ============================================================================
+
+#if __cplusplus >= 202002L
+
+struct ItemSpec {
+    int loadMs;    // Read and decode before the first frame
+    int frameMs;
+    int frames;
+};
+
+static ContentItem imageItem(Canvas& canvas, const void* argument) {
+    const ItemSpec* spec = (const ItemSpec*)argument;
+    sleepMs(spec->loadMs);
+    drawImage(canvas, 0, canvas.height());
+    for (int i = 0; i < spec->frames; i++) {
+        co_yield (uint32_t)spec->frameMs;
+    }
+}
+
+static ContentItem videoItem(Canvas& canvas, const void* argument) {
+    const ItemSpec* spec = (const ItemSpec*)argument;
+    sleepMs(spec->loadMs);
+    for (int i = 0; i < spec->frames; i++) {
+        drawAnimation(canvas, i);
+        co_yield (uint32_t)spec->frameMs;
+    }
+}
+
+static ContentItem tickerItem(Canvas& canvas, const void* argument) {
+    const ItemSpec* spec = (const ItemSpec*)argument;
+    sleepMs(spec->loadMs);
+    const uint8_t white[3] = { 255, 255, 255 };
+    Rect all = { 0, 0, canvas.width(), canvas.height() };
+    for (int i = 0; i < spec->frames; i++) {
+        canvas.clear();
+        drawString(canvas, all, canvas.width() - i, canvas.height() / 2 - 2, "NEXT STOP CENTRAL", 1, white);
+        co_yield (uint32_t)spec->frameMs;
+    }
+}
+
+static void runPlaylist(const MatrixConfig& config, const PlaylistEntry* entries, int count, bool prefetch,
+                        unsigned long& gapFrames) {
+    PlaylistPlayer player(config, 2.2, entries, count, prefetch);
+    player.start();
+    const unsigned long transitions = 2 * (unsigned long)count;
+    uint64_t startNs = monotonicNs();
+    while (player.transitions < transitions && monotonicNs() - startNs < 20000000000ull) {
+        player.frameAt((uint32_t)((monotonicNs() - startNs) / 1000000u));
+        sleepMs(2);
+    }
+    player.stop();
+    printf("  %-11s %lu transitions, %lu frames shown, gap %lu frames (worst %u ms), %lu dropped overall\n",
+           prefetch ? "prefetch" : "no prefetch", player.transitions, player.framesShown, player.gapFrames,
+           player.worstGapMs, player.droppedFrames);
+    gapFrames = player.gapFrames;
+}
+
+static void benchmarkPlaylist() {
+    printf("playlist (image -> video -> ticker, loads of 60/80/30 ms)\n");
+
+    MatrixConfig config = DEFAULT_MATRIX_CONFIG;
+    config.chainLength = 2;
+    static const ItemSpec image = { 60, 40, 15 };
+    static const ItemSpec video = { 80, 40, 15 };
+    static const ItemSpec ticker = { 30, 20, 30 };
+    const PlaylistEntry entries[3] = {
+        { "image", imageItem, &image },
+        { "video", videoItem, &video },
+        { "ticker", tickerItem, &ticker }
+    };
+
+    unsigned long withoutGap;
+    unsigned long withGap;
+    runPlaylist(config, entries, 3, false, withoutGap);
+    runPlaylist(config, entries, 3, true, withGap);
+    check(withoutGap > 0, "loading at the boundary stalls without prefetch");
+    check(withGap == 0, "no frames dropped at item boundaries");
+}
+
+#else
+
+static void benchmarkPlaylist() {
+    printf("playlist: coroutines need -std=c++20, skipped\n");
+}
+
+#endif
+
+int main(int argc, char** argv) {
+    if (selected(argc, argv, "depth")) {
+        benchmarkDepth();
+    }
+    if (selected(argc, argv, "clocking")) {
+        benchmarkClocking();
+    }
+    if (selected(argc, argv, "bitdepth")) {
+        benchmarkBitDepth();
+    }
+    if (selected(argc, argv, "dual")) {
+        benchmarkDual();
+    }
+    if (selected(argc, argv, "arena")) {
+        benchmarkArena();
+    }
+    if (selected(argc, argv, "scene")) {
+        benchmarkScene();
+    }
+    if (selected(argc, argv, "dashboard")) {
+        benchmarkDashboard();
+    }
+    if (selected(argc, argv, "blend")) {
+        benchmarkBlend();
+    }
+    if (selected(argc, argv, "preview")) {
+        benchmarkPreview();
+    }
+    if (selected(argc, argv, "cache")) {
+        benchmarkCache();
+    }
+    if (selected(argc, argv, "animation")) {
+        benchmarkAnimation();
+    }
+    if (selected(argc, argv, "video")) {
+        benchmarkVideo();
+    }
+    if (selected(argc, argv, "spectrum")) {
+        benchmarkSpectrum();
+    }
+    if (selected(argc, argv, "playlist")) {
+        benchmarkPlaylist();
+    }
+
+    allocGuardPrint();
+    check(allocGuardViolations() == 0, "no heap use in frame build, scan-out or render");
+
+    if (failures > 0) {
+        printf("%d check(s) FAILED\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,843 @@
+/*
+ * HUB75 matrix driver for the adapter
+ * Scans a test pattern out on P0/P1 through /dev/gpiomem
+ *
+ * Compilation:
+ *   g++ -O2 -o matrix_display matrixDisplay.cpp -lpthread
+ *
+ * Run (requires sudo or gpio group for /dev/gpiomem):
+ *   sudo ./matrix_display [--rows 16|32|64] [--cols N] [--chain N] [--parallel 1|2]
+ *                         [--bits 1-11] [--full-depth] [--slowdown 0-4] [--16bit]
+ *                         [--dual | --scene | --dashboard]
+ *                         [--gif FILE] [--video FILE|test] [--audio FILE.wav|-] [--blend FPS]
+ *                         [--stats-socket PATH] [--preview PORT] [--preview-address ADDR]
+ *                         [--simulate FILE.ppm]
+ *
+ * --slowdown holds each CLOCK level for N more register stores; the default
+ * depends on the Pi (hub75DefaultSlowdown()), raise it if a panel shows
+ * noise or shifted columns.
+ * --16bit draws into a 16-bit per channel canvas, dithered to the plane depth.
+ * --dual runs P0 and P1 as two logical displays: the test pattern on P0 and
+ * an animation with its own frame rate on P1.
+ * --scene shows a clock, a title and a ticker as a retained scene; only rows
+ * that changed are redrawn and reconverted between frames.
+ * --dashboard shows CPU load, per-core bars, temperature and sparklines of
+ * this machine (dashboard.h), sampled every DASHBOARD_SAMPLE_MS; with
+ * --simulate the PPM shows DASHBOARD_SIMULATE_SECONDS of sampling.
+ * --gif plays an animated GIF, decoded and converted once at start-up.
+ * --video loops a clip through the decode/scale/convert pipeline on cores
+ * 1-3 (videoPipeline.h); files need a build with -DHUB75_LIBAV and
+ * -lavformat -lavcodec -lavutil, "test" plays a generated clip.
+ * --audio shows a spectrum of a WAV file, or of raw 16-bit stereo 44.1 kHz
+ * PCM on stdin with "-" (arecord -f cd -t raw | ...), on every chain.
+ * --blend renders the --dual animation at only FPS frames per second and
+ * crossfades between them on every refresh (frameBlend.h).
+ * --stats-socket serves conversion counters and scratch high-water marks of
+ * --dual, --video and --blend mode on a Unix socket (see statsSocket.h).
+ * --preview serves http://<pi>:PORT/, a live view of the canvas for a
+ * browser (previewServer.h), in --dual, --scene, --dashboard and --blend
+ * mode and for the 8-bit test pattern. It listens on 127.0.0.1 only (use
+ * an SSH tunnel) unless --preview-address names another local address,
+ * such as 0.0.0.0 for every interface.
+ * --simulate scans against SimulatedPanel instead of the GPIOs and writes
+ * the reconstructed image as PPM.
+ */
+
+#define GPIO_NO_PIGPIO  // Scan-out writes GPIO registers directly
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include "animation.h"
+#include "dashboard.h"
+#include "dualDisplay.h"
+#include "frameArena.h"
+#include "frameBlend.h"
+#include "hub75.h"
+#include "hub75Simulator.h"
+#include "leanIo.h"
+#include "previewServer.h"
+#include "sceneGraph.h"
+#include "spectrum.h"
+#include "videoPipeline.h"
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+
+const double GAMMA = 2.2;
+const int DUAL_ANIMATION_FRAME_MS = 40;  // P1 frame rate in --dual mode
+const size_t RENDER_ARENA_BYTES = 64 * 1024;  // Per-frame scratch of the render thread
+const int AUDIO_FPS = 60;
+const int AUDIO_BAR_PIXELS = 2;
+const int VIDEO_STAGE_CORES[3] = { 1, 2, 3 };  // Decode, scale, convert; scan-out keeps core 0
+const int BLEND_PIXELS_PER_SECOND = 48;  // Bar speed in --blend mode
+const uint32_t DASHBOARD_SAMPLE_MS = 100;
+const char* const PREVIEW_ADDRESS = "127.0.0.1";  // --preview-address 0.0.0.0 opens it to the LAN
+const int PREVIEW_FPS = 10;
+const int DASHBOARD_SIMULATE_SECONDS = 5;
+
+// Dashboard loads, smoothed over about two samples
+const ActivityFilterConfig DASHBOARD_FILTER_CONFIG = { 200, true, 0, 0, 0 };
+
+// ============================================================================
+
+volatile bool running = true;
+PreviewServer* preview = nullptr;  // Created by --preview
+
+void signalHandler(int) {
+    running = false;
+}
+
+// Color bars on the upper half, a gradient below, per chain
+template <class Channel>
+void drawTestPattern(CanvasOf<Channel>& canvas, const MatrixConfig& config, Channel full) {
+    static const uint8_t bars[8][3] = {
+        { 1, 1, 1 }, { 1, 1, 0 }, { 0, 1, 1 }, { 0, 1, 0 },
+        { 1, 0, 1 }, { 1, 0, 0 }, { 0, 0, 1 }, { 0, 0, 0 }
+    };
+    int w = config.width();
+    int half = config.panelRows / 2;
+    for (int chain = 0; chain < config.parallel; chain++) {
+        int top = chain * config.panelRows;
+        for (int i = 0; i < 8; i++) {
+            canvas.fillRect(i * w / 8, top, w / 8 + 1, half, (Channel)(bars[i][0] * full),
+                            (Channel)(bars[i][1] * full), (Channel)(bars[i][2] * full));
+        }
+        for (int y = 0; y < half; y++) {
+            for (int x = 0; x < w; x++) {
+                Channel level = (Channel)((uint32_t)x * full / (w - 1));
+                canvas.setPixel(x, top + half + y, level, chain == 0 ? level : 0, chain == 1 ? level : 0);
+            }
+        }
+    }
+}
+
+// Bar with a fading trail sweeping over a dark background, for the second
+// logical display; the trail is laid out in per-frame scratch
+void drawAnimationFrame(Canvas& canvas, int frame, FrameArena& arena) {
+    const int w = canvas.width();
+    uint8_t* trail = arena.allocateArray<uint8_t>((size_t)w);
+    if (trail) {
+        int head = frame % w;
+        for (int x = 0; x < w; x++) {
+            int distance = (head - x + w) % w;
+            trail[x] = distance < 16 ? (uint8_t)(255 - distance * 16) : 0;
+        }
+        for (int x = 0; x < w; x++) {
+            canvas.fillRect(x, 0, 1, canvas.height(), trail[x], (uint8_t)(trail[x] * 3 / 8), 32);
+        }
+    }
+    arena.reset();
+}
+
+struct Animation {
+    LogicalDisplay* display;
+    int top;  // Canvas row of the display's chain, for the preview
+    FrameArena arena;
+
+    Animation(LogicalDisplay* target, int chainTop) : display(target), top(chainTop), arena(RENDER_ARENA_BYTES) {}
+};
+
+void* animationThread(void* arg) {
+    Animation* animation = (Animation*)arg;
+    for (int frame = 0; running; frame++) {
+        {
+            AllocScope scope(ALLOC_SCOPE_RENDER);
+            drawAnimationFrame(animation->display->canvas(), frame, animation->arena);
+        }
+        if (preview) {
+            preview->offer(animation->display->canvas(), animation->top);
+        }
+        animation->display->swap();
+        sleepMs(DUAL_ANIMATION_FRAME_MS);
+    }
+    return nullptr;
+}
+
+// P0 and P1 as separate displays, each converted only when it swaps
+int runDual(const MatrixConfig& config, const char* simulatePath, const char* statsPath) {
+    DualDisplay dual(config, GAMMA);
+    Animation animation(&dual.display(1), config.panelRows);
+    MatrixConfig single = config;
+    single.parallel = 1;
+    drawTestPattern<uint8_t>(dual.display(0).canvas(), single, 0xFF);
+    if (preview) {
+        preview->offer(dual.display(0).canvas());
+    }
+    dual.display(0).swap();
+
+    if (simulatePath) {
+        for (int frame = 0; frame < 10; frame++) {
+            drawAnimationFrame(dual.display(1).canvas(), frame, animation.arena);
+            dual.display(1).swap();
+            dual.update();
+            dual.frameToScan();
+        }
+        SimulatedPanel panel(config, PI_ZERO_STORE_NS);
+        Hub75Scanner<SimulatedPanel> scanner(panel, config);
+        scanner.begin();
+        scanner.scanFrame(dual.frameToScan());
+        panel.resetExposure();
+        scanner.scanFrame(dual.frameToScan());
+        printf("P0 converted %lu times, P1 %lu times for 10 P1 frames\n", dual.conversions[0], dual.conversions[1]);
+        return panel.writePpm(simulatePath) ? 0 : 1;
+    }
+
+    GpiomemMatrixOutput output;
+    if (!output.init(config)) {
+        writeText(STDERR_FILENO, "ERROR: cannot map /dev/gpiomem (run with sudo)\n");
+        return 1;
+    }
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+
+    StatsServer stats;
+    if (statsPath) {
+        stats.add(dual, "dual");
+        stats.add(animation.arena, "render_arena");
+        if (!stats.start(statsPath)) {
+            fprintf(stderr, "WARNING: cannot open stats socket %s\n", statsPath);
+        }
+    }
+
+    dual.start();
+    pthread_t animationId;
+    bool animating = pthread_create(&animationId, nullptr, animationThread, &animation) == 0;
+
+    Hub75Scanner<GpiomemMatrixOutput> scanner(output, config);
+    scanner.begin();
+    while (running) {
+        scanner.scanFrame(dual.frameToScan());
+    }
+    scanner.end();
+    if (animating) {
+        pthread_join(animationId, nullptr);
+    }
+    dual.stop();
+    stats.stop();
+    output.terminate();
+    return 0;
+}
+
+// Signage scene rendered between frames on the scan thread
+int runScene(const MatrixConfig& config, const char* simulatePath) {
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    struct tm local;
+    localtime_r(&now.tv_sec, &local);
+    int64_t unixMs = (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+
+    const int w = config.width();
+    SceneGraph scene(config);
+    ClockNode clock({ (w - 62) / 2, 2, 62, 10 }, unixMs, (int32_t)local.tm_gmtoff, 2, 255, 160, 0);
+    TextNode title({ 2, config.height() - 18, w - 4, 5 }, "HUB75 ADAPTER", 1, 0, 200, 255);
+    TickerNode ticker({ 0, config.height() - 9, w, 7 }, "SCENE GRAPH - ONLY DAMAGED ROWS ARE RECONVERTED", 20,
+                      255, 255, 255);
+    scene.add(&clock);
+    scene.add(&title);
+    scene.add(&ticker);
+
+    GammaTable gamma;
+    gamma.build(config.planes, GAMMA);
+    Canvas canvas(config.width(), config.height());
+    BitplaneFrame frame(config);
+    frame.plan();
+    uint64_t startNs = monotonicNs();
+
+    if (simulatePath) {
+        RowDamage damage;
+        scene.render(canvas, 0, damage);
+        frame.update(canvas, gamma, damage);
+        SimulatedPanel panel(config, PI_ZERO_STORE_NS);
+        Hub75Scanner<SimulatedPanel> scanner(panel, config);
+        scanner.begin();
+        scanner.scanFrame(frame);
+        panel.resetExposure();
+        scanner.scanFrame(frame);
+        return panel.writePpm(simulatePath) ? 0 : 1;
+    }
+
+    GpiomemMatrixOutput output;
+    if (!output.init(config)) {
+        writeText(STDERR_FILENO, "ERROR: cannot map /dev/gpiomem (run with sudo)\n");
+        return 1;
+    }
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+
+    Hub75Scanner<GpiomemMatrixOutput> scanner(output, config);
+    scanner.begin();
+    while (running) {
+        RowDamage damage;
+        if (scene.render(canvas, (uint32_t)((monotonicNs() - startNs) / 1000000u), damage)) {
+            frame.update(canvas, gamma, damage);
+            if (preview) {
+                preview->offer(canvas);
+            }
+        }
+        scanner.scanFrame(frame);
+    }
+    scanner.end();
+    output.terminate();
+    return 0;
+}
+
+// Low-rate animation for --blend, submitted at its own frame rate
+struct BlendAnimation {
+    FrameBlender* blender;
+    int fps;
+    FrameArena arena;
+
+    BlendAnimation(FrameBlender* target, int framesPerSecond)
+        : blender(target), fps(framesPerSecond), arena(RENDER_ARENA_BYTES) {}
+
+    void draw(int frame) {
+        AllocScope scope(ALLOC_SCOPE_RENDER);
+        drawAnimationFrame(blender->canvas(), frame * BLEND_PIXELS_PER_SECOND / fps, arena);
+    }
+};
+
+void* blendAnimationThread(void* arg) {
+    BlendAnimation* animation = (BlendAnimation*)arg;
+    uint64_t startNs = monotonicNs();
+    for (int frame = 0; running; frame++) {
+        animation->draw(frame);
+        if (preview) {
+            preview->offer(animation->blender->canvas());
+        }
+        animation->blender->submit();
+        uint64_t dueNs = startNs + (uint64_t)(frame + 1) * 1000000000u / (uint64_t)animation->fps;
+        uint64_t nowNs = monotonicNs();
+        if (dueNs > nowNs) {
+            sleepMs((int)((dueNs - nowNs) / 1000000u));
+        }
+    }
+    return nullptr;
+}
+
+// Animation at fps, crossfaded between frames by the blender's converter
+int runBlend(const MatrixConfig& config, int fps, const char* simulatePath, const char* statsPath) {
+    FrameBlender blender(config, GAMMA, DEFAULT_BLEND_SETTINGS);
+    BlendAnimation animation(&blender, fps);
+
+    if (simulatePath) {
+        // Halfway between the first two frames
+        uint64_t intervalNs = 1000000000u / (uint64_t)fps;
+        for (int frame = 0; frame < 2; frame++) {
+            animation.draw(frame);
+            blender.submit();
+            blender.update(frame * intervalNs);
+            blender.frameToScan();
+        }
+        blender.update(intervalNs + intervalNs / 2 + 1);
+        SimulatedPanel panel(config, PI_ZERO_STORE_NS);
+        Hub75Scanner<SimulatedPanel> scanner(panel, config);
+        scanner.begin();
+        scanner.scanFrame(blender.frameToScan());
+        panel.resetExposure();
+        scanner.scanFrame(blender.frameToScan());
+        return panel.writePpm(simulatePath) ? 0 : 1;
+    }
+
+    GpiomemMatrixOutput output;
+    if (!output.init(config)) {
+        writeText(STDERR_FILENO, "ERROR: cannot map /dev/gpiomem (run with sudo)\n");
+        return 1;
+    }
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+
+    StatsServer stats;
+    if (statsPath) {
+        stats.add(blender, "blend");
+        stats.add(animation.arena, "render_arena");
+        if (!stats.start(statsPath)) {
+            fprintf(stderr, "WARNING: cannot open stats socket %s\n", statsPath);
+        }
+    }
+
+    blender.start();
+    pthread_t animationId;
+    bool animating = pthread_create(&animationId, nullptr, blendAnimationThread, &animation) == 0;
+
+    Hub75Scanner<GpiomemMatrixOutput> scanner(output, config);
+    scanner.begin();
+    while (running) {
+        scanner.scanFrame(blender.frameToScan());
+    }
+    scanner.end();
+    if (animating) {
+        pthread_join(animationId, nullptr);
+    }
+    blender.stop();
+    stats.stop();
+    output.terminate();
+    return 0;
+}
+
+// Dashboard of this machine, sampled and rendered between frames on the
+// scan thread; most samples touch a few bar rows, one per second scrolls
+// the sparklines
+int runDashboard(const MatrixConfig& config, const char* simulatePath) {
+    CPUMonitor monitor(DASHBOARD_FILTER_CONFIG, DASHBOARD_FILTER_CONFIG);
+    Dashboard dashboard(config, monitor.coreCount());
+    DashboardSample sample;
+
+    GammaTable gamma;
+    gamma.build(config.planes, GAMMA);
+    Canvas canvas(config.width(), config.height());
+    BitplaneFrame frame(config);
+    frame.plan();
+    uint64_t startNs = monotonicNs();
+
+    if (simulatePath) {
+        RowDamage damage;
+        for (uint32_t ms = 0; ms <= DASHBOARD_SIMULATE_SECONDS * 1000u; ms += DASHBOARD_SAMPLE_MS) {
+            readDashboardSample(monitor, ms, sample);
+            dashboard.render(canvas, sample, ms, damage);
+            sleepMs((int)DASHBOARD_SAMPLE_MS);
+        }
+        frame.update(canvas, gamma, damage);
+        SimulatedPanel panel(config, PI_ZERO_STORE_NS);
+        Hub75Scanner<SimulatedPanel> scanner(panel, config);
+        scanner.begin();
+        scanner.scanFrame(frame);
+        panel.resetExposure();
+        scanner.scanFrame(frame);
+        return panel.writePpm(simulatePath) ? 0 : 1;
+    }
+
+    GpiomemMatrixOutput output;
+    if (!output.init(config)) {
+        writeText(STDERR_FILENO, "ERROR: cannot map /dev/gpiomem (run with sudo)\n");
+        return 1;
+    }
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+
+    Hub75Scanner<GpiomemMatrixOutput> scanner(output, config);
+    scanner.begin();
+    uint32_t nextSampleMs = 0;
+    while (running) {
+        uint32_t nowMs = (uint32_t)((monotonicNs() - startNs) / 1000000u);
+        if ((int32_t)(nowMs - nextSampleMs) >= 0) {
+            nextSampleMs = nowMs + DASHBOARD_SAMPLE_MS;
+            readDashboardSample(monitor, nowMs, sample);
+            RowDamage damage;
+            if (dashboard.render(canvas, sample, nowMs, damage)) {
+                frame.update(canvas, gamma, damage);
+                if (preview) {
+                    preview->offer(canvas);
+                }
+            }
+        }
+        scanner.scanFrame(frame);
+    }
+    scanner.end();
+    output.terminate();
+    return 0;
+}
+
+// Animated GIF from pre-converted frames
+int runGif(const MatrixConfig& config, const char* path, const char* simulatePath) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "ERROR: cannot open %s\n", path);
+        return 1;
+    }
+    uint8_t* gif = new uint8_t[(size_t)info.st_size];
+    size_t length = 0;
+    ssize_t n;
+    while (length < (size_t)info.st_size && (n = read(fd, gif + length, (size_t)info.st_size - length)) > 0) {
+        length += (size_t)n;
+    }
+    close(fd);
+
+    GammaTable gamma;
+    gamma.build(config.planes, GAMMA);
+    AnimationSequence sequence(config);
+    bool loaded = sequence.loadGif(gif, length, gamma);
+    delete[] gif;
+    if (!loaded) {
+        fprintf(stderr, "ERROR: %s: %s\n", path, sequence.error ? sequence.error : "no frames");
+        return 1;
+    }
+    printf("%d frames, %d unique, %u ms per loop\n", sequence.decodedFrames, sequence.uniqueFrames(),
+           sequence.loopMs());
+    AnimationPlayer player(sequence);
+
+    if (simulatePath) {
+        SimulatedPanel panel(config, PI_ZERO_STORE_NS);
+        Hub75Scanner<SimulatedPanel> scanner(panel, config);
+        scanner.begin();
+        scanner.scanFrame(player.frameAt(0));
+        panel.resetExposure();
+        scanner.scanFrame(player.frameAt(0));
+        return panel.writePpm(simulatePath) ? 0 : 1;
+    }
+
+    GpiomemMatrixOutput output;
+    if (!output.init(config)) {
+        writeText(STDERR_FILENO, "ERROR: cannot map /dev/gpiomem (run with sudo)\n");
+        return 1;
+    }
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+
+    uint64_t startNs = monotonicNs();
+    Hub75Scanner<GpiomemMatrixOutput> scanner(output, config);
+    scanner.begin();
+    while (running) {
+        scanner.scanFrame(player.frameAt((uint32_t)((monotonicNs() - startNs) / 1000000u)));
+    }
+    scanner.end();
+    output.terminate();
+    return 0;
+}
+
+struct AudioVisualizer {
+    DualDisplay* display;
+    int chains;
+    PcmReader* reader;
+    bool paceToClock;   // Files play in real time, pipes are paced by the writer
+    SpectrumVisualizer* spectrum;
+};
+
+// Reads a hop, analyses it and draws every chain; the scan thread never waits for audio
+void* audioThread(void* arg) {
+    AudioVisualizer* audio = (AudioVisualizer*)arg;
+    float hop[48000 / AUDIO_FPS];
+    uint64_t startNs = monotonicNs();
+    while (running && audio->reader->read(hop, audio->spectrum->hopSamples()) == audio->spectrum->hopSamples()) {
+        {
+            AllocScope scope(ALLOC_SCOPE_RENDER);
+            audio->spectrum->analyze(hop);
+        }
+        if (audio->paceToClock) {
+            uint64_t dueNs = startNs + (uint64_t)audio->spectrum->frameTimeMs() * 1000000u;
+            uint64_t nowNs = monotonicNs();
+            if (dueNs > nowNs) {
+                sleepMs((int)((dueNs - nowNs) / 1000000u));
+            }
+        }
+        for (int chain = 0; chain < audio->chains; chain++) {
+            AllocScope scope(ALLOC_SCOPE_RENDER);
+            audio->spectrum->render(audio->display->display(chain).canvas());
+            audio->display->display(chain).swap();
+        }
+    }
+    running = false;
+    return nullptr;
+}
+
+// Spectrum of a WAV file or a raw PCM pipe, frames paced by the audio
+int runAudio(const MatrixConfig& config, const char* path, const char* simulatePath) {
+    PcmReader reader;
+    bool opened = strcmp(path, "-") == 0 ? reader.openRaw(STDIN_FILENO, 44100, 2) : reader.openWav(path);
+    if (!opened) {
+        fprintf(stderr, "ERROR: %s: %s\n", path, reader.error);
+        return 1;
+    }
+    if (reader.sampleRate / AUDIO_FPS > 48000 / AUDIO_FPS) {
+        writeText(STDERR_FILENO, "ERROR: sample rates above 48 kHz are not supported\n");
+        return 1;
+    }
+    SpectrumVisualizer spectrum(reader.sampleRate, AUDIO_FPS, config.width(), AUDIO_BAR_PIXELS);
+    DualDisplay display(config, GAMMA);
+    AudioVisualizer audio = { &display, config.parallel, &reader, strcmp(path, "-") != 0, &spectrum };
+
+    if (simulatePath) {
+        // First second of audio, unpaced
+        audio.paceToClock = false;
+        float hop[48000 / AUDIO_FPS];
+        for (int frame = 0; frame < AUDIO_FPS && reader.read(hop, spectrum.hopSamples()) == spectrum.hopSamples();
+             frame++) {
+            spectrum.analyze(hop);
+        }
+        for (int chain = 0; chain < config.parallel; chain++) {
+            spectrum.render(display.display(chain).canvas());
+            display.display(chain).swap();
+        }
+        display.update();
+        SimulatedPanel panel(config, PI_ZERO_STORE_NS);
+        Hub75Scanner<SimulatedPanel> scanner(panel, config);
+        scanner.begin();
+        scanner.scanFrame(display.frameToScan());
+        panel.resetExposure();
+        scanner.scanFrame(display.frameToScan());
+        return panel.writePpm(simulatePath) ? 0 : 1;
+    }
+
+    GpiomemMatrixOutput output;
+    if (!output.init(config)) {
+        writeText(STDERR_FILENO, "ERROR: cannot map /dev/gpiomem (run with sudo)\n");
+        return 1;
+    }
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+
+    display.start();
+    pthread_t audioId;
+    bool listening = pthread_create(&audioId, nullptr, audioThread, &audio) == 0;
+    Hub75Scanner<GpiomemMatrixOutput> scanner(output, config);
+    scanner.begin();
+    while (running) {
+        scanner.scanFrame(display.frameToScan());
+    }
+    scanner.end();
+    if (listening) {
+        pthread_join(audioId, nullptr);  // A blocked pipe read ends with the writer or the signal
+    }
+    display.stop();
+    output.terminate();
+    return 0;
+}
+
+// Looping video through the pipeline, frames shown by timestamp
+template <class Source>
+int runVideo(const MatrixConfig& config, Source& source, const char* simulatePath, const char* statsPath) {
+    VideoPipeline<Source> pipeline(source, config, GAMMA, true);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (!pipeline.start(cores > 3 ? VIDEO_STAGE_CORES : nullptr)) {
+        writeText(STDERR_FILENO, "ERROR: cannot start video threads\n");
+        return 1;
+    }
+
+    if (simulatePath) {
+        const BitplaneFrame* frame = pipeline.nextFrame();
+        pipeline.stop();
+        if (!frame) {
+            writeText(STDERR_FILENO, "ERROR: no video frame decoded\n");
+            return 1;
+        }
+        SimulatedPanel panel(config, PI_ZERO_STORE_NS);
+        Hub75Scanner<SimulatedPanel> scanner(panel, config);
+        scanner.begin();
+        scanner.scanFrame(*frame);
+        panel.resetExposure();
+        scanner.scanFrame(*frame);
+        return panel.writePpm(simulatePath) ? 0 : 1;
+    }
+
+    GpiomemMatrixOutput output;
+    if (!output.init(config)) {
+        writeText(STDERR_FILENO, "ERROR: cannot map /dev/gpiomem (run with sudo)\n");
+        return 1;
+    }
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+
+    StatsServer stats;
+    if (statsPath) {
+        stats.add(pipeline, "video");
+        if (!stats.start(statsPath)) {
+            fprintf(stderr, "WARNING: cannot open stats socket %s\n", statsPath);
+        }
+    }
+
+    uint64_t startNs = monotonicNs();
+    Hub75Scanner<GpiomemMatrixOutput> scanner(output, config);
+    scanner.begin();
+    while (running) {
+        const BitplaneFrame* frame = pipeline.frameAt((uint32_t)((monotonicNs() - startNs) / 1000000u));
+        if (frame) {
+            scanner.scanFrame(*frame);
+        }
+    }
+    scanner.end();
+    pipeline.stop();
+    stats.stop();
+    output.terminate();
+    return 0;
+}
+
+static int run(int argc, char** argv) {
+    MatrixConfig config = DEFAULT_MATRIX_CONFIG;
+    config.clockSlowdown = hub75DefaultSlowdown();
+    const char* simulatePath = nullptr;
+    const char* statsPath = nullptr;
+    const char* gifPath = nullptr;
+    const char* videoPath = nullptr;
+    const char* audioPath = nullptr;
+    bool wideCanvas = false;
+    bool dualMode = false;
+    bool sceneMode = false;
+    bool dashboardMode = false;
+    int blendFps = 0;
+    int previewPort = 0;
+    const char* previewAddress = PREVIEW_ADDRESS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc) {
+            config.panelRows = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cols") == 0 && i + 1 < argc) {
+            config.panelCols = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--chain") == 0 && i + 1 < argc) {
+            config.chainLength = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--parallel") == 0 && i + 1 < argc) {
+            config.parallel = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bits") == 0 && i + 1 < argc) {
+            config.planes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--full-depth") == 0) {
+            config.adaptiveDepth = false;
+        } else if (strcmp(argv[i], "--slowdown") == 0 && i + 1 < argc) {
+            config.clockSlowdown = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--dual") == 0) {
+            dualMode = true;
+        } else if (strcmp(argv[i], "--scene") == 0) {
+            sceneMode = true;
+        } else if (strcmp(argv[i], "--dashboard") == 0) {
+            dashboardMode = true;
+        } else if (strcmp(argv[i], "--blend") == 0 && i + 1 < argc) {
+            blendFps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--gif") == 0 && i + 1 < argc) {
+            gifPath = argv[++i];
+        } else if (strcmp(argv[i], "--video") == 0 && i + 1 < argc) {
+            videoPath = argv[++i];
+        } else if (strcmp(argv[i], "--audio") == 0 && i + 1 < argc) {
+            audioPath = argv[++i];
+        } else if (strcmp(argv[i], "--16bit") == 0) {
+            wideCanvas = true;
+        } else if (strcmp(argv[i], "--stats-socket") == 0 && i + 1 < argc) {
+            statsPath = argv[++i];
+        } else if (strcmp(argv[i], "--preview") == 0 && i + 1 < argc) {
+            previewPort = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--preview-address") == 0 && i + 1 < argc) {
+            previewAddress = argv[++i];
+        } else if (strcmp(argv[i], "--simulate") == 0 && i + 1 < argc) {
+            simulatePath = argv[++i];
+        }
+    }
+    if ((config.panelRows != 16 && config.panelRows != 32 && config.panelRows != 64) ||
+        config.parallel < 1 || config.parallel > HUB75_CHAINS ||
+        config.planes < 1 || config.planes > HUB75_MAX_PLANES || config.width() <= 0 ||
+        config.clockSlowdown < 0 || config.clockSlowdown > HUB75_MAX_SLOWDOWN) {
+        writeText(STDERR_FILENO, "ERROR: unsupported matrix geometry\n");
+        return 1;
+    }
+
+    if (previewPort > 0 && !simulatePath) {
+        preview = new PreviewServer(config.width(), config.height(), PREVIEW_FPS);
+        if (previewPort > 65535 || !preview->start(previewAddress, (uint16_t)previewPort)) {
+            fprintf(stderr, "WARNING: no preview on %s:%d: %s\n", previewAddress, previewPort,
+                    preview->error ? preview->error : "invalid port");
+            delete preview;
+            preview = nullptr;
+        }
+    }
+
+    if (dualMode) {
+        if (config.parallel != 2) {
+            writeText(STDERR_FILENO, "ERROR: --dual needs --parallel 2\n");
+            return 1;
+        }
+        return runDual(config, simulatePath, statsPath);
+    }
+
+    if (sceneMode) {
+        return runScene(config, simulatePath);
+    }
+
+    if (dashboardMode) {
+        return runDashboard(config, simulatePath);
+    }
+
+    if (blendFps != 0) {
+        if (blendFps < 1 || blendFps > 60) {
+            writeText(STDERR_FILENO, "ERROR: --blend needs 1-60 frames per second\n");
+            return 1;
+        }
+        return runBlend(config, blendFps, simulatePath, statsPath);
+    }
+
+    if (gifPath) {
+        return runGif(config, gifPath, simulatePath);
+    }
+
+    if (audioPath) {
+        return runAudio(config, audioPath, simulatePath);
+    }
+
+    if (videoPath && strcmp(videoPath, "test") == 0) {
+        SyntheticVideoSource source(640, 360, 300, 30);
+        return runVideo(config, source, simulatePath, statsPath);
+    }
+    if (videoPath) {
+#ifdef HUB75_LIBAV
+        LibavSource source;
+        if (!source.open(videoPath)) {
+            fprintf(stderr, "ERROR: %s: %s\n", videoPath, source.error);
+            return 1;
+        }
+        return runVideo(config, source, simulatePath, statsPath);
+#else
+        writeText(STDERR_FILENO, "ERROR: built without libav (-DHUB75_LIBAV), only --video test\n");
+        return 1;
+#endif
+    }
+
+    BitplaneFrame frame(config);
+    if (wideCanvas) {
+        Gamma16Table gamma;
+        gamma.build(GAMMA);
+        Canvas16 canvas(config.width(), config.height());
+        drawTestPattern<uint16_t>(canvas, config, 0xFFFF);
+        frame.build(canvas, gamma);
+    } else {
+        GammaTable gamma;
+        gamma.build(config.planes, GAMMA);
+        Canvas canvas(config.width(), config.height());
+        drawTestPattern<uint8_t>(canvas, config, 0xFF);
+        frame.build(canvas, gamma);
+        if (preview) {
+            preview->offer(canvas);
+        }
+    }
+
+    if (simulatePath) {
+        SimulatedPanel panel(config, PI_ZERO_STORE_NS);
+        Hub75Scanner<SimulatedPanel> scanner(panel, config);
+        scanner.begin();
+        scanner.scanFrame(frame);
+        panel.resetExposure();
+        scanner.scanFrame(frame);
+        printf("%d passes, %lu stores, %.0f Hz refresh (Pi Zero estimate)\n",
+               frame.totalPasses, panel.stores, 1e9 / (double)scanner.lastPeriodNs);
+        if (!panel.writePpm(simulatePath)) {
+            fprintf(stderr, "ERROR: cannot write %s\n", simulatePath);
+            return 1;
+        }
+        return 0;
+    }
+
+    GpiomemMatrixOutput output;
+    if (!output.init(config)) {
+        writeText(STDERR_FILENO, "ERROR: cannot map /dev/gpiomem (run with sudo)\n");
+        return 1;
+    }
+
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+
+    Hub75Scanner<GpiomemMatrixOutput> scanner(output, config);
+    scanner.begin();
+    while (running) {
+        scanner.scanFrame(frame);
+    }
+    scanner.end();
+    output.terminate();
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int result = run(argc, argv);
+    delete preview;  // Stops its thread
+    return result;
+}
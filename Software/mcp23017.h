@@ -0,0 +1,221 @@
+/*
+ * Per-core LED bar graph on an MCP23017 I2C GPIO expander
+ * Plugs into the adapter's I2C extension header (SDA/SCL, 3.3V, GND)
+ *
+ * The 16 expander pins (GPA0-7 = pins 0-7, GPB0-7 = pins 8-15) are split into
+ * segments, each showing one value (a CPU core or memory use) as a bar.
+ * All pin changes of a tick are coalesced into one OLATA/OLATB burst write,
+ * and nothing is written at all when the pattern did not change.
+ *
+ * The I2C device is an interface so the bar graph runs against MockI2cDevice
+ * off-target (see monitorBenchmark.cpp).
+ */
+
+#ifndef MCP23017_H
+#define MCP23017_H
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+#include "activityFilter.h"
+
+// ============================================================================
+// I2C DEVICES
+// ============================================================================
+
+class I2cDevice {
+public:
+    virtual ~I2cDevice() {}
+
+    // Write data starting at register reg in a single bus transaction
+    virtual bool writeRegisters(uint8_t reg, const uint8_t* data, int length) = 0;
+};
+
+// /dev/i2c-N character device
+class LinuxI2cDevice : public I2cDevice {
+private:
+    int fd;
+
+public:
+    LinuxI2cDevice() : fd(-1) {}
+    ~LinuxI2cDevice() { close(); }
+
+    bool open(const char* path, int address) {
+        fd = ::open(path, O_RDWR | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        if (ioctl(fd, I2C_SLAVE, address) < 0) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    bool writeRegisters(uint8_t reg, const uint8_t* data, int length) {
+        uint8_t buffer[33];
+        if (fd < 0 || length < 0 || length > 32) {
+            return false;
+        }
+        buffer[0] = reg;
+        memcpy(buffer + 1, data, (size_t)length);
+        return ::write(fd, buffer, (size_t)length + 1) == length + 1;
+    }
+};
+
+// Register-file model of an MCP23017 (IOCON.BANK = 0, sequential mode)
+class MockI2cDevice : public I2cDevice {
+public:
+    uint8_t registers[0x16];
+    unsigned long transactions;
+    unsigned long bytes;
+
+    MockI2cDevice() : transactions(0), bytes(0) {
+        memset(registers, 0, sizeof(registers));
+    }
+
+    bool writeRegisters(uint8_t reg, const uint8_t* data, int length) {
+        transactions++;
+        bytes += (unsigned long)length + 2;  // Address byte + register byte + data
+        for (int i = 0; i < length; i++) {
+            registers[(reg + i) % sizeof(registers)] = data[i];
+        }
+        return true;
+    }
+
+    uint16_t outputLatch() const {
+        return (uint16_t)(registers[0x14] | (registers[0x15] << 8));
+    }
+};
+
+// ============================================================================
+// BAR GRAPH
+// ============================================================================
+
+const int MCP23017_PINS = 16;
+const int BAR_GRAPH_MAX_SEGMENTS = 16;
+
+// One bar: ledCount consecutive expander pins starting at firstPin
+struct BarSegment {
+    int firstPin;
+    int ledCount;
+};
+
+class Mcp23017BarGraph {
+private:
+    static const uint8_t REG_IODIRA = 0x00;
+    static const uint8_t REG_IOCON = 0x0A;
+    static const uint8_t REG_OLATA = 0x14;
+
+    I2cDevice& device;
+    BarSegment segments[BAR_GRAPH_MAX_SEGMENTS];
+    int segmentCount;
+    uint16_t lastPattern;
+    bool patternValid;
+
+public:
+    unsigned long updates;
+    unsigned long writes;
+
+    explicit Mcp23017BarGraph(I2cDevice& dev)
+        : device(dev), segmentCount(0), lastPattern(0), patternValid(false), updates(0), writes(0) {}
+
+    // Split the pins into one bar per core plus a memory bar from the
+    // remaining pins. Core bars shrink until every bar fits; returns the LEDs
+    // per core used, 0 if not even one each fits (nothing laid out)
+    int layoutCoresAndMemory(int cores, int ledsPerCore, int memoryLeds) {
+        segmentCount = 0;
+        if (cores < 1 || memoryLeds < 1 || cores + memoryLeds > MCP23017_PINS) {
+            return 0;
+        }
+        int fitting = (MCP23017_PINS - memoryLeds) / cores;
+        ledsPerCore = ledsPerCore < fitting ? ledsPerCore : fitting;
+        int pin = 0;
+        for (int i = 0; i < cores; i++) {
+            addSegment(pin, ledsPerCore);
+            pin += ledsPerCore;
+        }
+        addSegment(pin, memoryLeds);
+        return ledsPerCore;
+    }
+
+    bool addSegment(int firstPin, int ledCount) {
+        if (segmentCount >= BAR_GRAPH_MAX_SEGMENTS || firstPin < 0 || ledCount <= 0) {
+            return false;
+        }
+        if (firstPin + ledCount > MCP23017_PINS) {
+            ledCount = MCP23017_PINS - firstPin;
+            if (ledCount <= 0) {
+                return false;
+            }
+        }
+        segments[segmentCount].firstPin = firstPin;
+        segments[segmentCount].ledCount = ledCount;
+        segmentCount++;
+        return true;
+    }
+
+    // All pins outputs, sequential addressing, LEDs off
+    bool init() {
+        const uint8_t iocon = 0x00;
+        const uint8_t direction[2] = { 0x00, 0x00 };
+        const uint8_t off[2] = { 0x00, 0x00 };
+        patternValid = false;
+        if (!device.writeRegisters(REG_IOCON, &iocon, 1) ||
+            !device.writeRegisters(REG_IODIRA, direction, 2) ||
+            !device.writeRegisters(REG_OLATA, off, 2)) {
+            return false;
+        }
+        lastPattern = 0;
+        patternValid = true;
+        return true;
+    }
+
+    // Pin pattern for one value per segment (fixed-point percent)
+    uint16_t pattern(const fixed_t* values, int count) const {
+        uint16_t bits = 0;
+        for (int i = 0; i < segmentCount && i < count; i++) {
+            fixed_t value = values[i] < 0 ? 0 : (values[i] > FIXED_100_PERCENT ? FIXED_100_PERCENT : values[i]);
+            int lit = (int)(((int64_t)value * segments[i].ledCount + FIXED_100_PERCENT / 2) / FIXED_100_PERCENT);
+            bits |= (uint16_t)(((1u << lit) - 1) << segments[i].firstPin);
+        }
+        return bits;
+    }
+
+    // One burst write per tick at most, none if nothing changed
+    bool update(const fixed_t* values, int count) {
+        updates++;
+        uint16_t bits = pattern(values, count);
+        if (patternValid && bits == lastPattern) {
+            return true;
+        }
+
+        const uint8_t latches[2] = { (uint8_t)(bits & 0xFF), (uint8_t)(bits >> 8) };
+        if (!device.writeRegisters(REG_OLATA, latches, 2)) {
+            patternValid = false;
+            return false;
+        }
+        writes++;
+        lastPattern = bits;
+        patternValid = true;
+        return true;
+    }
+
+    void clear() {
+        const uint8_t off[2] = { 0x00, 0x00 };
+        device.writeRegisters(REG_OLATA, off, 2);
+        lastPattern = 0;
+    }
+};
+
+#endif // MCP23017_H
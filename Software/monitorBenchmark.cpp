@@ -0,0 +1,1266 @@
+/*
+ * Off-target benchmarks for the LED monitor components
+ * Uses mock/simulated hardware, so it runs on any Linux machine
+ *
+ * Compilation:
+ *   g++ -O2 -o monitor_benchmark monitorBenchmark.cpp -lpthread
+ *
+ * Run all benchmarks, or only the named ones:
+ *   ./monitor_benchmark [filter] [tick] [bargraph] [indicators] [response] [history] [cluster] [net]
+ *
+ * Heap use is counted per thread and per hot-path scope (allocGuard.h) and
+ * printed at the end; exits non-zero if a sanity check fails or an
+ * allocation-free scope used the heap.
+ */
+
+#define ALLOC_GUARD
+#define GPIO_SIMULATED  // LEDs are simulated, no pigpio needed
+
+#include <cmath>
+#include <cstdio>
+#include <atomic>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include "activityFilter.h"
+#include "allocGuard.h"
+#include "clusterLoad.h"
+#include "cpuMonitor.h"
+#include "gpioBackend.h"
+#include "indicators.h"
+#include "leanIo.h"
+#include "loadHistory.h"
+#include "mcp23017.h"
+#include "netActivity.h"
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static int failures = 0;
+static unsigned long expectedViolations = 0;  // Deliberate ones of the guard self-test
+
+static void check(bool condition, const char* what) {
+    printf("  check %-48s %s\n", what, condition ? "ok" : "FAILED");
+    if (!condition) {
+        failures++;
+    }
+}
+
+static bool selected(int argc, char** argv, const char* name) {
+    if (argc < 2) {
+        return true;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// ============================================================================
+// FILTER - activityFilter.h against its closed form
+// ============================================================================
+
+// Filter output after elapsedMs of a 0 -> 100% step, sampled every intervalMs
+static fixed_t stepResponse(const ActivityFilterConfig& config, uint32_t intervalMs, uint32_t elapsedMs) {
+    ActivityFilter filter(config);
+    fixed_t value = 0;
+    for (uint32_t t = intervalMs; t <= elapsedMs; t += intervalMs) {
+        value = filter.update(FIXED_100_PERCENT, intervalMs);
+    }
+    return value;
+}
+
+static void benchmarkFilter() {
+    printf("filter\n");
+
+    // The EMA takes the elapsed time, so the sampling interval must not change the response
+    const ActivityFilterConfig stepConfig = { 36, false, 0, 0, 0 };
+    const uint32_t intervals[] = { 1, 25, 50 };
+    const uint32_t elapsed[] = { 50, 100, 200 };
+    fixed_t worstSpread = 0;
+    fixed_t worstError = 0;
+    for (unsigned e = 0; e < sizeof(elapsed) / sizeof(elapsed[0]); e++) {
+        fixed_t exact = (fixed_t)(FIXED_100_PERCENT * (1.0 - exp(-(double)elapsed[e] / stepConfig.timeConstantMs)));
+        printf("  step after %3u ms:", elapsed[e]);
+        fixed_t lo = FIXED_100_PERCENT;
+        fixed_t hi = 0;
+        for (unsigned i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++) {
+            fixed_t value = stepResponse(stepConfig, intervals[i], elapsed[e]);
+            printf(" %2u ms %.3f%%", intervals[i], (double)value / FIXED_ONE);
+            lo = value < lo ? value : lo;
+            hi = value > hi ? value : hi;
+            fixed_t error = value > exact ? value - exact : exact - value;
+            worstError = error > worstError ? error : worstError;
+        }
+        printf(" (exact %.3f%%)\n", (double)exact / FIXED_ONE);
+        worstSpread = hi - lo > worstSpread ? hi - lo : worstSpread;
+    }
+    check(worstSpread < percentToFixed(0.5), "1, 25 and 50 ms samples agree within 0.5%");
+    check(worstError < percentToFixed(0.5), "step response follows 1 - exp(-t / tau)");
+}
+
+// ============================================================================
+// TICK - sampling, filtering and console line of the monitor loop
+// ============================================================================
+
+static void benchmarkTick() {
+    printf("tick\n");
+
+    // The guard must notice a heap call inside an allocation-free scope
+    static void* volatile sink;
+    unsigned long before = allocGuardViolations();
+    {
+        AllocScope scope(ALLOC_SCOPE_TICK);
+        sink = malloc(16);
+        free(sink);
+    }
+    expectedViolations += allocGuardViolations() - before;
+    check(!allocGuardEnabled() || allocGuardViolations() == before + 2, "guard counts malloc/free in tick scope");
+
+    const ActivityFilterConfig config = { 36, false, 0, percentToFixed(25), percentToFixed(5) };
+    const ActivityFilterConfig coreConfig = { 36, false, 0, 0, 0 };
+    CPUMonitor monitor(config, coreConfig);
+    LineWriter line;
+    int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    fixed_t memoryUse = 0;
+
+    const int ticks = 2000;
+    unsigned long callsBefore = allocGuardScopeCalls(ALLOC_SCOPE_TICK);
+    uint64_t start = monotonicNs();
+    for (int tick = 0; tick < ticks; tick++) {
+        AllocScope scope(ALLOC_SCOPE_TICK);
+        fixed_t load = monitor.getCPULoad((uint32_t)tick * 25);
+        readMemoryUse(memoryUse);
+        line.append("\rCPU: ");
+        line.appendUnsigned((unsigned)(load >> FIXED_SHIFT), 3);
+        line.append(monitor.isActive() ? "% * [" : "%   [");
+        line.appendRepeat('#', (int)(load >> FIXED_SHIFT) / 2);
+        line.append(']');
+        line.flush(devNull);
+    }
+    uint64_t tickNs = (monotonicNs() - start) / ticks;
+    close(devNull);
+
+    printf("  ticks=%d %lu ns/tick (/proc/stat + /proc/meminfo + console line)\n", ticks, (unsigned long)tickNs);
+    check(!allocGuardEnabled() || allocGuardScopeCalls(ALLOC_SCOPE_TICK) == callsBefore,
+          "monitor tick does not touch the heap");
+}
+
+// ============================================================================
+// BAR GRAPH - MCP23017 batching against a mock I2C device
+// ============================================================================
+
+static void runBarGraphScenario(const char* name, int ticks, fixed_t stepPercent, FastRandom& random) {
+    const int cores = 4;
+    const int tickMs = 25;
+    const ActivityFilterConfig config = { 36, false, 0, 0, 0 };
+
+    MockI2cDevice device;
+    Mcp23017BarGraph barGraph(device);
+    barGraph.layoutCoresAndMemory(cores, 3, 4);
+    barGraph.init();
+    unsigned long setupTransactions = device.transactions;
+    unsigned long setupBytes = device.bytes;
+
+    ActivityFilter filters[cores];
+    fixed_t raw[cores];
+    for (int i = 0; i < cores; i++) {
+        filters[i] = ActivityFilter(config);
+        raw[i] = percentToFixed(50);
+    }
+    fixed_t values[cores + 1];
+    values[cores] = percentToFixed(40);
+
+    uint64_t updateNs = 0;
+    for (int tick = 0; tick < ticks; tick++) {
+        // Random walk of the raw per-core load
+        for (int i = 0; i < cores; i++) {
+            int32_t step = (int32_t)((((int64_t)random.next16() - 32768) * stepPercent) >> 15);
+            raw[i] += step;
+            raw[i] = raw[i] < 0 ? 0 : (raw[i] > FIXED_100_PERCENT ? FIXED_100_PERCENT : raw[i]);
+            values[i] = filters[i].update(raw[i], tickMs);
+        }
+
+        AllocScope scope(ALLOC_SCOPE_TICK);
+        uint64_t start = monotonicNs();
+        barGraph.update(values, cores + 1);
+        updateNs += monotonicNs() - start;
+    }
+
+    unsigned long transactions = device.transactions - setupTransactions;
+    unsigned long bytes = device.bytes - setupBytes;
+
+    // Baseline without change detection: one OLATA/OLATB write every tick
+    unsigned long naiveBytes = (unsigned long)ticks * 4;
+    printf("  %-10s ticks=%d writes=%lu (%.1f%% of ticks) bus_bytes=%lu (naive %lu) "
+           "update=%.0f ns  bus_time@100kHz=%.2f ms/s\n",
+           name, ticks, transactions, 100.0 * transactions / ticks, bytes, naiveBytes,
+           (double)updateNs / ticks, bytes * 9 / 100.0 / (ticks * tickMs / 1000.0));
+}
+
+static void benchmarkBarGraph() {
+    printf("bargraph\n");
+
+    MockI2cDevice device;
+    Mcp23017BarGraph barGraph(device);
+    barGraph.layoutCoresAndMemory(4, 3, 4);
+    check(barGraph.init() && device.registers[0x00] == 0 && device.registers[0x01] == 0,
+          "init sets all pins to outputs");
+
+    fixed_t values[5] = { FIXED_100_PERCENT, 0, percentToFixed(50), percentToFixed(34), FIXED_100_PERCENT };
+    barGraph.update(values, 5);
+    check(device.outputLatch() == (0x0007 | (0x3 << 6) | (0x1 << 9) | 0xF000),
+          "per-core and memory bars map to expander pins");
+
+    unsigned long before = device.transactions;
+    barGraph.update(values, 5);
+    check(device.transactions == before, "unchanged pattern skips the I2C write");
+
+    values[1] = FIXED_100_PERCENT;
+    barGraph.update(values, 5);
+    check(device.transactions == before + 1, "changed pattern is one burst write");
+
+    // 8 cores x 3 LEDs + 4 memory LEDs need 28 pins: one LED per core, memory bar kept
+    Mcp23017BarGraph eightCores(device);
+    int ledsPerCore = eightCores.layoutCoresAndMemory(8, 3, 4);
+    fixed_t full[9];
+    for (int i = 0; i < 9; i++) {
+        full[i] = FIXED_100_PERCENT;
+    }
+    eightCores.init();
+    eightCores.update(full, 9);
+    check(ledsPerCore == 1 && device.outputLatch() == 0x0FFF, "8 cores shrink to 1 LED each, memory bar kept");
+    check(eightCores.layoutCoresAndMemory(13, 3, 4) == 0, "bars that cannot fit are refused");
+
+    FastRandom random(12345);
+    runBarGraphScenario("steady", 40 * 60, percentToFixed(1), random);
+    runBarGraphScenario("bursty", 40 * 60, percentToFixed(30), random);
+}
+
+// ============================================================================
+// INDICATORS - a front panel of LEDs written as one mask per tick
+// ============================================================================
+
+static void benchmarkIndicators() {
+    printf("indicators\n");
+
+    // The monitor's own LED: red idle, dimmed green flashes
+    const IndicatorConfig single[] = {
+        { { 16, 26, -1 }, { 255, 32, 255 }, COLOR_RED, COLOR_GREEN, 0, PATTERN_FLASH },
+    };
+    SimulatedBackend gpio;
+    IndicatorPanel led(single, 1, DEFAULT_FLASH_SETTINGS);
+    led.showIdle(gpio);
+    check(led.needsPwm() && gpio.level(16) == 1 && gpio.level(26) == 0, "bi-color LED starts red");
+    IndicatorInput busy[1] = { { FIXED_100_PERCENT, true } };
+    FastRandom random(777);
+    uint32_t nowMs = 100;
+    while (!led.lit(0) && nowMs < 10000) {
+        led.tick(gpio, busy, nowMs, random);
+        nowMs += 25;
+    }
+    check(led.lit(0) && gpio.level(16) == 0 && gpio.level(26) == 32, "flash turns red off and green on (PWM)");
+
+    // Front panel of 12 LEDs, 20 pins: per-core flashes, bi-color blinkers,
+    // two RGB traffic lights and two warning LEDs
+    const int cores = 4;
+    IndicatorConfig panelConfig[12];
+    int pin = 2;
+    for (int i = 0; i < 12; i++) {
+        IndicatorConfig& config = panelConfig[i];
+        memset(&config, 0, sizeof(config));
+        int channels = i < 4 ? 1 : (i < 8 ? 2 : (i < 10 ? 3 : 1));
+        for (int c = 0; c < INDICATOR_CHANNELS; c++) {
+            config.pins[c] = c < channels ? pin++ : -1;
+            config.brightness[c] = 255;
+        }
+        config.source = i % cores;
+        config.pattern = i < 4 ? PATTERN_FLASH : (i < 8 ? PATTERN_BLINK : (i < 10 ? PATTERN_TRAFFIC : PATTERN_LEVEL));
+        config.idleColor = i >= 4 && i < 8 ? COLOR_RED : COLOR_OFF;
+        config.activeColor = i >= 4 && i < 8 ? COLOR_GREEN : COLOR_RED;
+    }
+    SimulatedBackend panelGpio;
+    IndicatorPanel panel(panelConfig, 12, DEFAULT_FLASH_SETTINGS);
+    int pins[INDICATOR_MAX * INDICATOR_CHANNELS];
+    int pinCount = panel.pins(pins);
+    panel.showIdle(panelGpio);
+
+    IndicatorInput inputs[cores] = { { percentToFixed(20), true }, { percentToFixed(60), true },
+                                     { percentToFixed(95), true }, { 0, false } };
+    panel.tick(panelGpio, inputs, 0, random);
+    check(panelGpio.level(14) == 0 && panelGpio.level(15) == 1 && panelGpio.level(17) == 1 &&
+          panelGpio.level(18) == 1 && panelGpio.level(19) == 0,
+          "RGB traffic lights show green and yellow");
+
+    // Random walk of the loads; naive drivers write every pin every tick,
+    // or each changed pin on its own
+    const int ticks = 40 * 60;
+    const ActivityFilterConfig config = { 36, false, 0, percentToFixed(0.5), 0 };
+    ActivityFilter filters[cores];
+    fixed_t raw[cores];
+    for (int i = 0; i < cores; i++) {
+        filters[i] = ActivityFilter(config);
+        raw[i] = percentToFixed(40);
+    }
+    unsigned long callsBefore = panelGpio.calls;
+    unsigned long changedPins = 0;
+    uint64_t tickNs = 0;
+    for (int tick = 0; tick < ticks; tick++) {
+        for (int i = 0; i < cores; i++) {
+            int32_t step = (int32_t)((((int64_t)random.next16() - 32768) * percentToFixed(20)) >> 15);
+            raw[i] += step;
+            raw[i] = raw[i] < 0 ? 0 : (raw[i] > FIXED_100_PERCENT ? FIXED_100_PERCENT : raw[i]);
+            inputs[i].load = filters[i].update(raw[i], 25);
+            inputs[i].active = filters[i].isActive();
+        }
+        unsigned before[GPIO_MAX_PINS];
+        for (int p = 0; p < pinCount; p++) {
+            before[p] = panelGpio.level(pins[p]);
+        }
+
+        AllocScope scope(ALLOC_SCOPE_TICK);
+        uint64_t start = monotonicNs();
+        panel.tick(panelGpio, inputs, (uint32_t)tick * 25, random);
+        tickNs += monotonicNs() - start;
+
+        for (int p = 0; p < pinCount; p++) {
+            changedPins += panelGpio.level(pins[p]) != before[p];
+        }
+    }
+    unsigned long calls = panelGpio.calls - callsBefore;
+    printf("  leds=12 pins=%d ticks=%d gpio_calls=%lu (%.2f/tick) per_pin_on_change=%lu (%.2f/tick) "
+           "every_pin=%lu  tick=%.0f ns\n",
+           pinCount, ticks, calls, (double)calls / ticks, changedPins, (double)changedPins / ticks,
+           (unsigned long)pinCount * ticks, (double)tickNs / ticks);
+    check(calls <= (unsigned long)ticks && panel.maskWrites >= calls, "at most one mask write per tick");
+    check(calls < changedPins, "fewer GPIO calls than changed pins");
+}
+
+// ============================================================================
+// RESPONSE - CPU load step to LED transition, through the whole monitor path
+// ============================================================================
+
+const int RESPONSE_MAX_EVENTS = 8192;
+const int RESPONSE_TRIALS = 12;
+const int RESPONSE_HOLD_MS = 300;     // Load step length
+const int RESPONSE_STEADY_MS = 300;   // No flash for this long counts as steady red
+const int RESPONSE_TIMEOUT_MS = 3000;
+const int RESPONSE_MAX_BUSY = 4;
+
+// Forwards to another backend and timestamps every change of the green pin
+class RecordingBackend : public GpioBackend {
+private:
+    GpioBackend& inner;
+    int watched;
+    bool on;
+
+    void record(bool level) {
+        if (level == on) {
+            return;
+        }
+        on = level;
+        int index = count.load(std::memory_order_relaxed);
+        if (index < RESPONSE_MAX_EVENTS) {
+            times[index] = monotonicNs();
+            levels[index] = level;
+            count.store(index + 1, std::memory_order_release);
+        }
+    }
+
+public:
+    uint64_t times[RESPONSE_MAX_EVENTS];
+    bool levels[RESPONSE_MAX_EVENTS];
+    std::atomic<int> count;
+
+    RecordingBackend(GpioBackend& backend, int pin) : inner(backend), watched(pin), on(false), count(0) {}
+
+    const char* name() const { return inner.name(); }
+    bool supportsPwm() const { return inner.supportsPwm(); }
+    bool init() { return inner.init(); }
+    bool configureOutputs(const int* pins, int n) { return inner.configureOutputs(pins, n); }
+    void configurePwm(int pin, int frequency) { inner.configurePwm(pin, frequency); }
+    void terminate() { inner.terminate(); }
+
+    void write(int pin, int level) {
+        inner.write(pin, level);
+        if (pin == watched) {
+            record(level != 0);
+        }
+    }
+
+    void pwm(int pin, int duty) {
+        inner.pwm(pin, duty);
+        if (pin == watched) {
+            record(duty > 0);
+        }
+    }
+
+    void writeMasks(uint32_t set, uint32_t clear) {
+        inner.writeMasks(set, clear);
+        if ((set | clear) & (1u << watched)) {
+            record((set >> watched) & 1);
+        }
+    }
+
+    // Time of the first green after startNs, 0 if none yet
+    uint64_t firstGreenAfter(uint64_t startNs) const {
+        int n = count.load(std::memory_order_acquire);
+        for (int i = 0; i < n; i++) {
+            if (levels[i] && times[i] >= startNs) {
+                return times[i];
+            }
+        }
+        return 0;
+    }
+
+    // Whether green is on, and since when the LED has been in that state
+    bool current(uint64_t& sinceNs) const {
+        int n = count.load(std::memory_order_acquire);
+        sinceNs = n > 0 ? times[n - 1] : 0;
+        return n > 0 && levels[n - 1];
+    }
+};
+
+// The monitor loop: sample /proc/stat, filter, drive the LED
+struct ResponseLoop {
+    int intervalMs;
+    int timeConstantMs;
+    RecordingBackend* gpio;
+    volatile bool stop;
+    unsigned long ticks;
+    uint64_t cpuNs;
+};
+
+static uint64_t threadCpuNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static void* responseLoopThread(void* arg) {
+    ResponseLoop* loop = (ResponseLoop*)arg;
+    const ActivityFilterConfig config = { (uint32_t)loop->timeConstantMs, false, 0, percentToFixed(0.5), 0 };
+    const ActivityFilterConfig coreConfig = { (uint32_t)loop->timeConstantMs, false, 0, 0, 0 };
+    const IndicatorConfig led[] = {
+        { { 16, 26, -1 }, { 255, 32, 255 }, COLOR_RED, COLOR_GREEN, 0, PATTERN_FLASH },
+    };
+    CPUMonitor monitor(config, coreConfig);
+    IndicatorPanel panel(led, 1, DEFAULT_FLASH_SETTINGS);
+    panel.showIdle(*loop->gpio);
+    FastRandom random(4242);
+    uint64_t startNs = monotonicNs();
+    uint64_t cpuStart = threadCpuNs();
+    while (!loop->stop) {
+        uint32_t nowMs = (uint32_t)((monotonicNs() - startNs) / 1000000u);
+        IndicatorInput input;
+        input.load = monitor.getCPULoad(nowMs);
+        input.active = monitor.isActive();
+        panel.tick(*loop->gpio, &input, nowMs, random);
+        loop->ticks++;
+        sleepMs(loop->intervalMs);
+    }
+    loop->cpuNs = threadCpuNs() - cpuStart;
+    return nullptr;
+}
+
+struct BusyThread {
+    int core;
+    volatile bool* run;
+};
+
+static void* busyThread(void* arg) {
+    BusyThread* busy = (BusyThread*)arg;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(busy->core, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    volatile unsigned long spins = 0;
+    while (*busy->run) {
+        spins++;
+    }
+    return nullptr;
+}
+
+static void sortMs(double* values, int count) {
+    for (int i = 1; i < count; i++) {
+        double value = values[i];
+        int j = i;
+        for (; j > 0 && values[j - 1] > value; j--) {
+            values[j] = values[j - 1];
+        }
+        values[j] = value;
+    }
+}
+
+static void printDistribution(const char* name, double* values, int count) {
+    if (count == 0) {
+        printf(" %s=none", name);
+        return;
+    }
+    sortMs(values, count);
+    printf(" %s min/p50/p90/max=%.0f/%.0f/%.0f/%.0f ms", name, values[0], values[count / 2],
+           values[(count * 9) / 10 < count ? (count * 9) / 10 : count - 1], values[count - 1]);
+}
+
+// Steps of one busy thread per core (up to RESPONSE_MAX_BUSY); returns the
+// median rise and fall times
+static void runResponseScenario(int intervalMs, int timeConstantMs, int busyCores, double& riseMedian,
+                                double& fallMedian) {
+    SimulatedBackend simulated;
+    RecordingBackend* gpio = new RecordingBackend(simulated, 26);
+    ResponseLoop loop = { intervalMs, timeConstantMs, gpio, false, 0, 0 };
+    pthread_t loopThread;
+    pthread_create(&loopThread, nullptr, responseLoopThread, &loop);
+    uint64_t loopStart = monotonicNs();
+
+    double rise[RESPONSE_TRIALS];
+    double fall[RESPONSE_TRIALS];
+    int rises = 0;
+    int falls = 0;
+    int unsettled = 0;
+    for (int trial = 0; trial < RESPONSE_TRIALS; trial++) {
+        // Start from steady red
+        uint64_t deadline = monotonicNs() + (uint64_t)RESPONSE_TIMEOUT_MS * 1000000u;
+        uint64_t since;
+        while ((gpio->current(since) || monotonicNs() - since < (uint64_t)RESPONSE_STEADY_MS * 1000000u) &&
+               monotonicNs() < deadline) {
+            sleepMs(5);
+        }
+
+        volatile bool run = true;
+        BusyThread busy[RESPONSE_MAX_BUSY];
+        pthread_t threads[RESPONSE_MAX_BUSY];
+        uint64_t stepNs = monotonicNs();
+        for (int i = 0; i < busyCores; i++) {
+            busy[i].core = i;
+            busy[i].run = &run;
+            pthread_create(&threads[i], nullptr, busyThread, &busy[i]);
+        }
+        sleepMs(RESPONSE_HOLD_MS);
+        run = false;
+        uint64_t removeNs = monotonicNs();
+        for (int i = 0; i < busyCores; i++) {
+            pthread_join(threads[i], nullptr);
+        }
+
+        uint64_t green = gpio->firstGreenAfter(stepNs);
+        if (green != 0) {
+            rise[rises++] = (green - stepNs) / 1e6;
+        }
+
+        // Steady red: off, and no flash for RESPONSE_STEADY_MS
+        deadline = monotonicNs() + (uint64_t)RESPONSE_TIMEOUT_MS * 1000000u;
+        for (;;) {
+            bool on = gpio->current(since);
+            uint64_t now = monotonicNs();
+            if (!on && now - since >= (uint64_t)RESPONSE_STEADY_MS * 1000000u) {
+                fall[falls++] = since > removeNs ? (since - removeNs) / 1e6 : 0.0;
+                break;
+            }
+            if (now > deadline) {
+                unsettled++;
+                break;
+            }
+            sleepMs(5);
+        }
+    }
+
+    loop.stop = true;
+    pthread_join(loopThread, nullptr);
+    double seconds = (monotonicNs() - loopStart) / 1e9;
+
+    printf("  interval=%2d ms tc=%3d ms busy=%d:", intervalMs, timeConstantMs, busyCores);
+    double sortedRise[RESPONSE_TRIALS];
+    double sortedFall[RESPONSE_TRIALS];
+    memcpy(sortedRise, rise, sizeof(double) * rises);
+    memcpy(sortedFall, fall, sizeof(double) * falls);
+    printDistribution("to_green", sortedRise, rises);
+    printDistribution("to_steady_red", sortedFall, falls);
+    printf(" misses=%d unsettled=%d cpu=%.1f us/tick (%.3f%% core)\n", RESPONSE_TRIALS - rises, unsettled,
+           loop.ticks > 0 ? loop.cpuNs / 1e3 / loop.ticks : 0.0, 100.0 * loop.cpuNs / 1e9 / seconds);
+    riseMedian = rises > 0 ? sortedRise[rises / 2] : 1e9;
+    fallMedian = falls > 0 ? sortedFall[falls / 2] : 1e9;
+    delete gpio;
+}
+
+static void benchmarkResponse() {
+    printf("response\n");
+
+    int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int busyCores = cores < RESPONSE_MAX_BUSY ? cores : RESPONSE_MAX_BUSY;
+    printf("  %d trials per setting, %d ms steps of %d busy thread(s), steady = no flash for %d ms\n",
+           RESPONSE_TRIALS, RESPONSE_HOLD_MS, busyCores, RESPONSE_STEADY_MS);
+
+    // Interval and smoothing around the defaults (25 ms, 36 ms)
+    const int settings[][2] = { { 10, 36 }, { 25, 0 }, { 25, 36 }, { 25, 100 }, { 50, 36 } };
+    double defaultRise = 0;
+    double defaultFall = 0;
+    for (unsigned i = 0; i < sizeof(settings) / sizeof(settings[0]); i++) {
+        double rise;
+        double fall;
+        runResponseScenario(settings[i][0], settings[i][1], busyCores, rise, fall);
+        if (settings[i][0] == 25 && settings[i][1] == 36) {
+            defaultRise = rise;
+            defaultFall = fall;
+        }
+    }
+    check(defaultRise < 150, "defaults: median step to green below 150 ms");
+    check(defaultFall < 400, "defaults: median removal to steady red below 400 ms");
+}
+
+// ============================================================================
+// HISTORY - an hour of per-core load at 40 Hz, compressed, read while written
+// ============================================================================
+
+const int HISTORY_BENCH_CHANNELS = 5;  // LED load + 4 cores
+
+// Monitor-like loads: filtered random walks, with idle stretches
+struct HistoryLoadModel {
+    int channels;
+    ActivityFilter filters[HISTORY_MAX_CHANNELS];
+    fixed_t raw[HISTORY_MAX_CHANNELS];
+    FastRandom random;
+
+    explicit HistoryLoadModel(int channelCount = HISTORY_BENCH_CHANNELS) : channels(channelCount), random(2024) {
+        const ActivityFilterConfig config = { 36, false, 0, 0, 0 };
+        for (int c = 0; c < channels; c++) {
+            filters[c] = ActivityFilter(config);
+            raw[c] = 0;
+        }
+    }
+
+    void next(int tick, fixed_t* loads) {
+        bool busy = (tick / (40 * 90)) % 3 == 1;   // 90 s busy out of every 270 s
+        fixed_t sum = 0;
+        for (int c = 1; c < channels; c++) {
+            if (busy) {
+                int32_t step = (int32_t)((((int64_t)random.next16() - 32768) * percentToFixed(10)) >> 15);
+                raw[c] += step;
+                raw[c] = raw[c] < 0 ? 0 : (raw[c] > FIXED_100_PERCENT ? FIXED_100_PERCENT : raw[c]);
+            } else {
+                raw[c] = c == 1 && tick % 400 == 0 ? percentToFixed(30) : 0;  // Occasional blip
+            }
+            loads[c] = filters[c].update(raw[c], 25);
+            sum += loads[c];
+        }
+        loads[0] = sum / (channels - 1);
+    }
+};
+
+struct HistoryWriter {
+    LoadHistory* history;
+    unsigned long ticks;
+    uint64_t worstNs;
+    uint64_t totalNs;
+    volatile bool stop;
+};
+
+// Ticks as fast as possible while the main thread queries the socket
+static void* historyWriterThread(void* arg) {
+    HistoryWriter* writer = (HistoryWriter*)arg;
+    HistoryLoadModel model;
+    fixed_t loads[HISTORY_BENCH_CHANNELS];
+    for (int tick = 0; !writer->stop; tick++) {
+        model.next(tick, loads);
+        AllocScope scope(ALLOC_SCOPE_TICK);
+        uint64_t start = monotonicNs();
+        writer->history->add(loads, (uint32_t)tick * 25);
+        uint64_t took = monotonicNs() - start;
+        writer->totalNs += took;
+        writer->worstNs = took > writer->worstNs ? took : writer->worstNs;
+        writer->ticks++;
+    }
+    return nullptr;
+}
+
+// Answers far beyond any socket buffer, until the client is gone
+struct BulkQuery {
+    void query(StatsStream& out, const char*) const {
+        for (int i = 0; i < 1000000 && !out.closed(); i++) {
+            out.append("0123456789abcdef0123456789abcdef\n");
+        }
+    }
+};
+
+static int countLines(const char* text) {
+    int lines = 0;
+    for (; *text; text++) {
+        lines += *text == '\n';
+    }
+    return lines;
+}
+
+// 90 minutes at 40 Hz, with the quantized samples kept for comparison
+static void runHistoryHour(int channels) {
+    const int ticks = 5400 * 40;
+    LoadHistory* history = new LoadHistory(channels);
+    uint8_t* expected = new uint8_t[(size_t)ticks * channels];
+    HistoryLoadModel model(channels);
+    fixed_t loads[HISTORY_MAX_CHANNELS];
+    uint64_t addNs = 0;
+    uint64_t worstNs = 0;
+    for (int tick = 0; tick < ticks; tick++) {
+        model.next(tick, loads);
+        for (int c = 0; c < channels; c++) {
+            expected[(size_t)tick * channels + c] = loadToWire(loads[c]);
+        }
+        AllocScope scope(ALLOC_SCOPE_TICK);
+        uint64_t start = monotonicNs();
+        history->add(loads, (uint32_t)tick * 25);
+        uint64_t took = monotonicNs() - start;
+        addNs += took;
+        worstNs = took > worstNs ? took : worstNs;
+    }
+
+    // Raw samples still held must match exactly, at their tick times, and
+    // be no further apart than the coarsest stride
+    unsigned long stored = 0;
+    unsigned long mismatches = 0;
+    uint32_t firstMs = 0;
+    uint32_t previousMs = 0;
+    bool contiguous = true;
+    history->readRaw(0, [&](uint32_t timeMs, const uint8_t* values) {
+        int tick = (int)((timeMs + 12) / 25);
+        firstMs = stored == 0 ? timeMs : firstMs;
+        contiguous = contiguous && (stored == 0 || (timeMs > previousMs && timeMs - previousMs <= HISTORY_MAX_STRIDE * 25u));
+        previousMs = timeMs;
+        stored++;
+        if (tick >= ticks || timeMs != (uint32_t)tick * 25 ||
+            memcmp(values, expected + (size_t)tick * channels, (size_t)channels) != 0) {
+            mismatches++;
+        }
+    });
+    uint32_t spanMs = history->newestMs() - firstMs;
+
+    // 1 s rollups against the reference
+    int secondMismatches = 0;
+    int secondCount = history->readSeconds(HISTORY_SECONDS, [&](uint32_t second, const uint8_t* entry) {
+        for (int c = 0; c < channels; c++) {
+            uint8_t low = 255;
+            uint8_t high = 0;
+            uint32_t sum = 0;
+            for (int t = 0; t < 40; t++) {
+                uint8_t value = expected[((size_t)second * 40 + t) * channels + c];
+                low = value < low ? value : low;
+                high = value > high ? value : high;
+                sum += value;
+            }
+            if (entry[c * 3] != low || entry[c * 3 + 1] != high || entry[c * 3 + 2] != (sum + 20) / 40) {
+                secondMismatches++;
+            }
+        }
+    });
+    int minuteCount = history->readMinutes(HISTORY_MINUTES, [](uint32_t, const uint8_t*) {});
+
+    size_t memory = history->memoryBytes();
+    printf("  channels=%d ticks=%d memory=%zu bytes (raw ring %zu) raw covers %.0f s (%lu samples, "
+           "%.0f%% of the ticks, %.2f bytes/sample) recycled=%lu add=%.0f ns mean %llu ns worst\n",
+           channels, ticks, memory, history->rawBytes(), spanMs / 1000.0, stored,
+           100.0 * stored * 25 / (spanMs > 0 ? spanMs : 1), (double)history->rawBytes() / (stored > 0 ? stored : 1),
+           history->blocksRecycled,
+           (double)addNs / ticks, (unsigned long long)worstNs);
+    printf("  rollups: %d seconds, %d minutes\n", secondCount, minuteCount);
+    char what[64];
+    snprintf(what, sizeof(what), "%d channels: history stays below 400 KB", channels);
+    check(memory < 400 * 1024, what);
+    snprintf(what, sizeof(what), "%d channels: raw samples decode exactly, no gaps", channels);
+    check(stored > 0 && mismatches == 0 && contiguous, what);
+    snprintf(what, sizeof(what), "%d channels: raw samples cover the last hour", channels);
+    check(spanMs >= 3600 * 1000, what);
+    snprintf(what, sizeof(what), "%d channels: 1 s min/max/mean of the last hour", channels);
+    check(secondCount == HISTORY_SECONDS && secondMismatches == 0, what);
+    snprintf(what, sizeof(what), "%d channels: 1 min rollups of the last hour", channels);
+    check(minuteCount == HISTORY_MINUTES, what);
+    delete[] expected;
+    delete history;
+}
+
+static void benchmarkHistory() {
+    printf("history\n");
+    runHistoryHour(HISTORY_BENCH_CHANNELS);
+    runHistoryHour(HISTORY_MAX_CHANNELS);
+
+    // Socket queries while a writer ticks flat out: the writer never waits
+    const char* path = "/tmp/monitor_benchmark_history.sock";
+    LoadHistory* live = new LoadHistory(HISTORY_BENCH_CHANNELS);
+    StatsServer server;
+    BulkQuery bulk;
+    server.add(*live, "history");
+    server.addQuery(*live, "history");
+    server.addQuery(bulk, "bulk");
+    if (!server.start(path)) {
+        check(false, "stats socket starts");
+        delete live;
+        return;
+    }
+    HistoryWriter writer = { live, 0, 0, 0, false };
+    pthread_t thread;
+    pthread_create(&thread, nullptr, historyWriterThread, &writer);
+    const size_t answerSize = 4 * 1024 * 1024;
+    char* answer = new char[answerSize];
+    int queries = 0;
+    int badAnswers = 0;
+    size_t length = 0;
+    uint64_t queryNs = 0;
+    sleepMs(200);  // Some history first
+    uint64_t endNs = monotonicNs() + 1000000000u;
+    while (monotonicNs() < endNs) {
+        const char* requests[] = { "history raw 60\n", "history seconds 600\n", "history minutes\n" };
+        for (int i = 0; i < 3; i++) {
+            uint64_t start = monotonicNs();
+            if (!statsRequest(path, requests[i], answer, answerSize, length) || length == 0 || answer[0] != '#') {
+                badAnswers++;
+            }
+            queryNs += monotonicNs() - start;
+            queries++;
+        }
+    }
+    writer.stop = true;
+    pthread_join(thread, nullptr);
+    statsRequest(path, "history raw 60\n", answer, answerSize, length);
+    int rawLines = countLines(answer) - 1;
+    statsRequest(path, "history seconds 600\n", answer, answerSize, length);
+    int secondLines = countLines(answer) - 1;
+    statsQuery(path, answer, answerSize, length);
+    bool snapshot = strstr(answer, "history.samples ") != nullptr;
+
+    // A client that asks for a long answer and never reads may not stall the others
+    int stalled = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_un stalledAddress;
+    memset(&stalledAddress, 0, sizeof(stalledAddress));
+    stalledAddress.sun_family = AF_UNIX;
+    strcpy(stalledAddress.sun_path, path);
+    connect(stalled, (const struct sockaddr*)&stalledAddress, sizeof(stalledAddress));
+    send(stalled, "bulk\n", 5, MSG_NOSIGNAL);
+    sleepMs(STATS_QUERY_WAIT_MS);
+    uint64_t stalledStart = monotonicNs();
+    statsQuery(path, answer, answerSize, length);
+    double stalledMs = (monotonicNs() - stalledStart) / 1e6;
+    bool dropped = strstr(answer, "stats.dropped 1\n") != nullptr;
+    close(stalled);
+    server.stop();
+
+    printf("  live: %d queries (%.2f ms each) during %lu ticks, add=%.0f ns mean %llu ns worst, "
+           "raw 60 s = %d lines, 600 s rollups = %d lines\n",
+           queries, queryNs / 1e6 / (queries > 0 ? queries : 1), writer.ticks,
+           (double)writer.totalNs / writer.ticks,
+           (unsigned long long)writer.worstNs, rawLines, secondLines);
+    check(queries > 0 && badAnswers == 0, "history queries answered while ticking");
+    // Ticks come faster than real time, so the raw minute may be at a coarse stride
+    check(rawLines >= 60 * 40 / HISTORY_MAX_STRIDE && rawLines <= 60 * 40 + 1 && secondLines == 600,
+          "raw and rollup answers are complete");
+    check(snapshot, "plain connection still gets the counter snapshot");
+    printf("  next client waited %.0f ms behind one that stopped reading\n", stalledMs);
+    check(dropped && stalledMs < 4 * STATS_SEND_TIMEOUT_MS, "client that stops reading is dropped");
+    delete[] answer;
+    delete live;
+}
+
+// ============================================================================
+// CLUSTER - many agents at tick rate into one aggregator over loopback
+// ============================================================================
+
+struct ClusterSender {
+    const char* group;
+    int port;
+    int nodes;
+    int ticks;
+    int tickMs;
+    unsigned long sent;
+};
+
+// Emulates `nodes` agents, each publishing once per tick
+static void* clusterSenderThread(void* arg) {
+    ClusterSender* sender = (ClusterSender*)arg;
+    struct sockaddr_in destination;
+    clusterAddress(sender->group, sender->port, destination);
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    unsigned char loop = 1;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+    fixed_t cores[4] = { percentToFixed(10), percentToFixed(20), percentToFixed(30), percentToFixed(40) };
+    uint8_t buffer[CLUSTER_MAX_DATAGRAM];
+    uint64_t next = monotonicNs();
+    for (int tick = 0; tick < sender->ticks; tick++) {
+        for (int node = 0; node < sender->nodes; node++) {
+            int length = ClusterAgent::encode(buffer, 0x1000u + (uint32_t)node, (uint16_t)tick,
+                                              percentToFixed(25), cores, 4);
+            if (sendto(fd, buffer, (size_t)length, 0, (const struct sockaddr*)&destination,
+                       sizeof(destination)) == length) {
+                sender->sent++;
+            }
+        }
+        next += (uint64_t)sender->tickMs * 1000000u;
+        uint64_t now = monotonicNs();
+        if (next > now) {
+            struct timespec delay = { 0, (long)(next - now) };
+            nanosleep(&delay, nullptr);
+        }
+    }
+    close(fd);
+    return nullptr;
+}
+
+// True if a datagram sent to group arrives on this host
+static bool clusterGroupReachable(const char* group, int port) {
+    ClusterAggregator aggregator;
+    if (!aggregator.open(group, port)) {
+        return false;
+    }
+    ClusterAgent agent;
+    if (!agent.open(group, port, 1)) {
+        return false;
+    }
+    fixed_t core = 0;
+    agent.publish(0, &core, 1);
+    sleepMs(50);
+    return aggregator.poll(0) > 0;
+}
+
+static void runClusterScenario(const char* group, int port, int nodes, int seconds) {
+    const int tickMs = 25;
+    ClusterAggregator* aggregator = new ClusterAggregator();
+    if (!aggregator->open(group, port)) {
+        check(false, "aggregator socket opens");
+        delete aggregator;
+        return;
+    }
+
+    ClusterSender sender = { group, port, nodes, seconds * 1000 / tickMs, tickMs, 0 };
+    pthread_t thread;
+    pthread_create(&thread, nullptr, clusterSenderThread, &sender);
+
+    // Aggregator tick: drain, then compute the cluster load, like the monitor loop
+    uint64_t pollNs = 0;
+    uint64_t startNs = monotonicNs();
+    int activeNodes = 0;
+    fixed_t load = 0;
+    int maxBurst = 0;
+    for (int tick = 0; tick < sender.ticks + 4; tick++) {
+        uint32_t nowMs = (uint32_t)((monotonicNs() - startNs) / 1000000u);
+        AllocScope scope(ALLOC_SCOPE_TICK);
+        uint64_t start = monotonicNs();
+        int count = aggregator->poll(nowMs);
+        load = aggregator->clusterLoad(nowMs, 1000, activeNodes);
+        pollNs += monotonicNs() - start;
+        if (count > maxBurst) {
+            maxBurst = count;
+        }
+        sleepMs(tickMs);
+    }
+    pthread_join(thread, nullptr);
+
+    double datagrams = aggregator->received > 0 ? (double)aggregator->received : 1.0;
+    printf("  nodes=%-5d sent=%lu received=%lu lost=%lu max_per_tick=%d recvmmsg_calls=%lu "
+           "%.0f ns/datagram cpu=%.2f%%\n",
+           nodes, sender.sent, aggregator->received, sender.sent - aggregator->received, maxBurst,
+           aggregator->receiveCalls, pollNs / datagrams, 100.0 * pollNs / ((monotonicNs() - startNs)));
+
+    char what[64];
+    snprintf(what, sizeof(what), "%d nodes x 40 Hz without drops", nodes);
+    check(aggregator->received == sender.sent && aggregator->lost == 0, what);
+    snprintf(what, sizeof(what), "%d nodes seen, mean load 25%%", nodes);
+    check(activeNodes == nodes && loadToWire(load) == 50, what);
+    delete aggregator;
+}
+
+// One datagram per node id, drained at nowMs
+static void sendClusterNodes(ClusterAggregator& aggregator, int fd, const struct sockaddr_in& destination,
+                             uint32_t firstId, int count, uint32_t nowMs) {
+    uint8_t buffer[CLUSTER_MAX_DATAGRAM];
+    fixed_t core = percentToFixed(50);
+    for (int i = 0; i < count; i++) {
+        int length = ClusterAgent::encode(buffer, firstId + (uint32_t)i, 0, percentToFixed(50), &core, 1);
+        sendto(fd, buffer, (size_t)length, 0, (const struct sockaddr*)&destination, sizeof(destination));
+        if (i % 256 == 255) {
+            aggregator.poll(nowMs);  // Stay below the receive buffer
+        }
+    }
+    sleepMs(20);
+    aggregator.poll(nowMs);
+}
+
+// A full node table refuses new nodes while every node is fresh, then
+// hands the slot of the longest silent one to the next new node
+static void checkClusterEviction(int port) {
+    ClusterAggregator* aggregator = new ClusterAggregator();
+    struct sockaddr_in destination;
+    clusterAddress("127.0.0.1", port, destination);
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (!aggregator->open("127.0.0.1", port) || fd < 0) {
+        check(false, "aggregator socket opens");
+        delete aggregator;
+        return;
+    }
+    sendClusterNodes(*aggregator, fd, destination, 0x2000, CLUSTER_MAX_NODES, 0);
+    sendClusterNodes(*aggregator, fd, destination, 0x9000, 1, 100);
+    bool refused = aggregator->nodeCount() == CLUSTER_MAX_NODES && aggregator->refused == 1 &&
+                   aggregator->evicted == 0;
+
+    // All but the first node keep talking; a new one then replaces the first
+    uint32_t later = CLUSTER_EVICT_MS + 1000;
+    sendClusterNodes(*aggregator, fd, destination, 0x2001, CLUSTER_MAX_NODES - 1, later);
+    sendClusterNodes(*aggregator, fd, destination, 0x9000, 1, later);
+    sendClusterNodes(*aggregator, fd, destination, 0x9000, 1, later);
+    int activeNodes = 0;
+    aggregator->clusterLoad(later, 1000, activeNodes);
+    bool replaced = false;
+    bool firstGone = true;
+    for (int i = 0; i < aggregator->nodeCount(); i++) {
+        replaced |= aggregator->node(i).nodeId == 0x9000 && aggregator->node(i).received == 2;
+        firstGone &= aggregator->node(i).nodeId != 0x2000;
+    }
+    close(fd);
+    printf("  full table: received=%lu refused=%lu evicted=%lu active=%d\n", aggregator->received,
+           aggregator->refused, aggregator->evicted, activeNodes);
+    check(refused, "full node table refuses a new node");
+    check(replaced && firstGone && aggregator->evicted == 1 && aggregator->refused == 1 &&
+          activeNodes == CLUSTER_MAX_NODES, "silent node's slot goes to a new node");
+    delete aggregator;
+}
+
+static void benchmarkCluster() {
+    printf("cluster\n");
+
+    uint8_t buffer[CLUSTER_MAX_DATAGRAM];
+    fixed_t cores[2] = { percentToFixed(12.5), FIXED_100_PERCENT };
+    int length = ClusterAgent::encode(buffer, 0xA1B2C3D4u, 0x1234, percentToFixed(33), cores, 2);
+    check(length == CLUSTER_HEADER_SIZE + 2 && buffer[12] == 66 && buffer[13] == 25 && buffer[14] == 200,
+          "datagram is 13 bytes + 1 per core");
+
+    // Multicast needs a multicast capable interface; fall back to unicast
+    const int port = 17575;
+    const char* group = CLUSTER_DEFAULT_GROUP;
+    if (!clusterGroupReachable(group, port)) {
+        group = "127.0.0.1";
+        printf("  multicast not available here, using unicast %s\n", group);
+    }
+
+    runClusterScenario(group, port, 100, 3);
+    runClusterScenario(group, port, 500, 3);
+    runClusterScenario(group, port, 1000, 3);
+    checkClusterEviction(port + 1);
+}
+
+// ============================================================================
+// NET - packet rate of the loopback interface under a UDP flood
+// ============================================================================
+
+struct NetFlood {
+    int port;
+    int seconds;
+    unsigned long sent;
+    volatile bool done;
+};
+
+// Small datagrams to a bound local socket, in sendmmsg() batches
+static void* netFloodThread(void* arg) {
+    NetFlood* flood = (NetFlood*)arg;
+    struct sockaddr_in destination;
+    clusterAddress("127.0.0.1", flood->port, destination);
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    connect(fd, (const struct sockaddr*)&destination, sizeof(destination));
+
+    const int batch = 64;
+    uint8_t payload[32];
+    memset(payload, 0x5A, sizeof(payload));
+    struct iovec vectors[batch];
+    struct mmsghdr messages[batch];
+    memset(messages, 0, sizeof(messages));
+    for (int i = 0; i < batch; i++) {
+        vectors[i].iov_base = payload;
+        vectors[i].iov_len = sizeof(payload);
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    uint64_t end = monotonicNs() + (uint64_t)flood->seconds * 1000000000u;
+    while (monotonicNs() < end) {
+        int count = sendmmsg(fd, messages, batch, 0);
+        if (count > 0) {
+            flood->sent += (unsigned long)count;
+        }
+    }
+    close(fd);
+    flood->done = true;
+    return nullptr;
+}
+
+static void runNetScenario(NetSource& source) {
+    const int tickMs = 25;
+    const int port = 17576;
+    int sink = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in address;
+    clusterAddress("127.0.0.1", port, address);
+    int reuse = 1;
+    setsockopt(sink, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    bind(sink, (const struct sockaddr*)&address, sizeof(address));
+
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    source.sample(packets, bytes);
+    uint64_t startPackets = packets;
+    uint64_t startBytes = bytes;
+
+    // The monitor tick: sample, rate, filter
+    NetActivity activity(100000);
+    const ActivityFilterConfig config = { 36, false, 0, percentToFixed(0.5), 0 };
+    ActivityFilter filter(config);
+    NetFlood flood = { port, 2, 0, false };
+    pthread_t thread;
+    pthread_create(&thread, nullptr, netFloodThread, &flood);
+
+    uint64_t startNs = monotonicNs();
+    uint64_t sampleNs = 0;
+    uint64_t worstSampleNs = 0;
+    int samples = 0;
+    uint32_t peakPps = 0;
+    fixed_t peakLoad = 0;
+    while (!flood.done) {
+        uint32_t nowMs = (uint32_t)((monotonicNs() - startNs) / 1000000u);
+        AllocScope scope(ALLOC_SCOPE_TICK);
+        uint64_t start = monotonicNs();
+        source.sample(packets, bytes);
+        uint64_t took = monotonicNs() - start;
+        fixed_t load = filter.update(activity.update(packets, nowMs), tickMs);
+        sampleNs += took;
+        worstSampleNs = took > worstSampleNs ? took : worstSampleNs;
+        samples++;
+        if (samples > 4) {
+            peakPps = activity.packetsPerSecond > peakPps ? activity.packetsPerSecond : peakPps;
+            peakLoad = load > peakLoad ? load : peakLoad;
+        }
+        sleepMs(tickMs);
+    }
+    pthread_join(thread, nullptr);
+    sleepMs(3 * NET_RING_BLOCK_TIMEOUT_MS);  // Last partly filled block
+    source.sample(packets, bytes);
+    double seconds = (monotonicNs() - startNs) / 1e9;
+    close(sink);
+
+    // Loopback shows every datagram twice, sent and received
+    uint64_t counted = packets - startPackets;
+    uint64_t expected = 2 * (uint64_t)flood.sent;
+    printf("  %-8s sent=%lu (%.0f pps) counted=%llu (%.4fx) bytes=%llu peak=%u pps load=%.1f%% "
+           "sample=%.0f ns mean %.0f ns worst\n",
+           source.name(), flood.sent, flood.sent / seconds, (unsigned long long)counted,
+           (double)counted / (expected > 0 ? expected : 1), (unsigned long long)(bytes - startBytes),
+           peakPps, (double)peakLoad / FIXED_ONE, (double)sampleNs / (samples > 0 ? samples : 1),
+           (double)worstSampleNs);
+
+    char what[64];
+    snprintf(what, sizeof(what), "%s: flood above 100k pps", source.name());
+    check(flood.sent / seconds > 100000.0, what);
+    // Other loopback traffic may add a little, nothing may be missed
+    snprintf(what, sizeof(what), "%s: counts every datagram twice", source.name());
+    check(counted >= expected && counted < expected + expected / 100 + 1000, what);
+    snprintf(what, sizeof(what), "%s: full scale at 100k+ pps", source.name());
+    check(peakLoad > percentToFixed(95), what);
+}
+
+// Counters from a script; a count of 0 is a sample without a reply
+class ScriptedNetSource : public NetSource {
+public:
+    const uint64_t* counts;
+    int next;
+
+    explicit ScriptedNetSource(const uint64_t* script) : counts(script), next(0) {}
+
+    const char* name() const { return "scripted"; }
+    bool open(const char*) { return true; }
+
+    bool sample(uint64_t& packets, uint64_t& bytes) {
+        uint64_t count = counts[next++];
+        if (count == 0) {
+            return false;
+        }
+        packets = count;
+        bytes = count * 64;
+        return true;
+    }
+};
+
+static void benchmarkNet() {
+    printf("net\n");
+
+    // 1000 pps, then a sample without a netlink reply, a counter reset, 1000 pps again
+    const uint64_t script[] = { 1000, 1025, 1050, 0, 1100, 5, 30 };
+    ScriptedNetSource scripted(script);
+    NetActivity scriptedActivity(100000);
+    const ActivityFilterConfig scriptedConfig = { 36, false, 0, percentToFixed(0.5), 0 };
+    ActivityFilter scriptedFilter(scriptedConfig);
+    fixed_t loads[7];
+    bool sampled[7];
+    for (int i = 0; i < 7; i++) {
+        sampled[i] = scriptedActivity.tick(scripted, scriptedFilter, (uint32_t)(i + 1) * 25);
+        loads[i] = scriptedFilter.value();
+    }
+    // 1000 pps is 60% of the scale; a wrapped rate would jump to 100%
+    bool rising = true;
+    for (int i = 1; i < 7; i++) {
+        rising = rising && loads[i] >= loads[i - 1] && loads[i] < percentToFixed(61);
+    }
+    check(!sampled[3] && loads[3] == loads[2] && rising, "failed net sample keeps the load");
+    check(sampled[5] && scriptedActivity.packetsPerSecond == 1000 && rising, "net counter reset keeps the rate");
+
+    NetActivity activity(100000);
+    activity.update(0, 0);
+    fixed_t idle = activity.update(0, 1000);
+    fixed_t slow = activity.update(10, 2000);
+    fixed_t busy = activity.update(10 + 1000, 2010);
+    check(idle == 0 && slow > percentToFixed(18) && slow < percentToFixed(23) && busy == FIXED_100_PERCENT,
+          "pps map logarithmically onto the load");
+
+    NetCounterSource counters;
+    if (counters.open("lo")) {
+        runNetScenario(counters);
+    } else {
+        check(false, counters.error);
+    }
+
+    PacketRingSource ring;
+    if (ring.open("lo")) {
+        runNetScenario(ring);
+        printf("  ring blocks=%lu ring_full_drops=%lu (counted, bytes unknown)\n", ring.blocksRead, ring.drops);
+    } else {
+        printf("  ring: %s, skipped\n", ring.error);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (selected(argc, argv, "filter")) {
+        benchmarkFilter();
+    }
+    if (selected(argc, argv, "tick")) {
+        benchmarkTick();
+    }
+    if (selected(argc, argv, "bargraph")) {
+        benchmarkBarGraph();
+    }
+    if (selected(argc, argv, "indicators")) {
+        benchmarkIndicators();
+    }
+    if (selected(argc, argv, "response")) {
+        benchmarkResponse();
+    }
+    if (selected(argc, argv, "history")) {
+        benchmarkHistory();
+    }
+    if (selected(argc, argv, "cluster")) {
+        benchmarkCluster();
+    }
+    if (selected(argc, argv, "net")) {
+        benchmarkNet();
+    }
+
+    allocGuardPrint();
+    check(allocGuardViolations() == expectedViolations, "no heap use in allocation-free scopes");
+
+    if (failures > 0) {
+        printf("%d check(s) FAILED\n", failures);
+        return 1;
+    }
+    return 0;
+}
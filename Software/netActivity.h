@@ -0,0 +1,413 @@
+/*
+ * Network interface activity for the LED monitor
+ *
+ * Turns the packet rate of one interface into a load value, so the status
+ * LED flashes like the activity light of a switch port. Two sources count
+ * packets and bytes (received + sent):
+ *
+ *   ring     - AF_PACKET socket with an mmap'd TPACKET_V3 receive ring.
+ *              Packets land in the ring without a copy to user space, the
+ *              kernel hands over whole blocks (retired at the latest after
+ *              NET_RING_BLOCK_TIMEOUT_MS), and a one-instruction BPF filter
+ *              caps the capture at NET_RING_SNAPLEN bytes per packet.
+ *   counters - the interface counters (IFLA_STATS64) over one persistent
+ *              netlink socket, a single request per sample. Cheapest, and
+ *              nothing is captured at all.
+ *
+ * Both are sampled from the monitor tick without blocking or touching the
+ * heap. On the loopback interface every packet is seen twice, once sent and
+ * once received, by both sources alike.
+ *
+ * The ring needs CAP_NET_RAW; the counters need no privileges.
+ */
+
+#ifndef NET_ACTIVITY_H
+#define NET_ACTIVITY_H
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <linux/if_packet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include "activityFilter.h"
+
+enum NetSourceType {
+    NET_SOURCE_RING,
+    NET_SOURCE_COUNTERS
+};
+
+const int NET_RING_BLOCK_SIZE = 64 * 1024;
+const int NET_RING_BLOCKS = 16;           // 1 MB, about 35 ms of 100k pps on loopback
+const int NET_RING_FRAME_SIZE = 2048;     // Only sizes the request, V3 packs packets tightly
+const int NET_RING_BLOCK_TIMEOUT_MS = 10; // Partly filled blocks are handed over after this
+const int NET_RING_SNAPLEN = 64;
+const int NET_NETLINK_BUFFER = 16 * 1024;
+
+class NetSource {
+public:
+    virtual ~NetSource() {}
+
+    virtual const char* name() const = 0;
+
+    // Start counting on the named interface; false with error set
+    virtual bool open(const char* interfaceName) = 0;
+
+    // Cumulative packets and bytes since open(); never blocks
+    virtual bool sample(uint64_t& packets, uint64_t& bytes) = 0;
+
+    const char* error;
+
+protected:
+    NetSource() : error(nullptr) {}
+};
+
+// ============================================================================
+// TPACKET_V3 RING
+// ============================================================================
+
+class PacketRingSource : public NetSource {
+private:
+    int fd;
+    uint8_t* ring;
+    size_t ringSize;
+    int block;           // Next block to hand back
+    uint64_t packets;
+    uint64_t bytes;
+
+    PacketRingSource(const PacketRingSource&);
+    PacketRingSource& operator=(const PacketRingSource&);
+
+    bool fail(const char* what) {
+        error = what;
+        close();
+        return false;
+    }
+
+public:
+    unsigned long blocksRead;
+    unsigned long drops;   // Packets the kernel could not place in the ring
+
+    PacketRingSource() : fd(-1), ring(nullptr), ringSize(0), block(0), packets(0), bytes(0), blocksRead(0), drops(0) {}
+    ~PacketRingSource() { close(); }
+
+    const char* name() const { return "ring"; }
+
+    bool open(const char* interfaceName) {
+        int interfaceIndex = (int)if_nametoindex(interfaceName);
+        if (interfaceIndex == 0) {
+            error = "unknown interface";
+            return false;
+        }
+        fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, htons(ETH_P_ALL));
+        if (fd < 0) {
+            error = "cannot open packet socket (needs CAP_NET_RAW)";
+            return false;
+        }
+
+        // Only the headers are of interest: accept every packet, truncated
+        struct sock_filter snap[1] = { BPF_STMT(BPF_RET | BPF_K, NET_RING_SNAPLEN) };
+        struct sock_fprog program = { 1, snap };
+        int version = TPACKET_V3;
+        if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program)) != 0 ||
+            setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) != 0) {
+            return fail("TPACKET_V3 not supported");
+        }
+
+        struct tpacket_req3 request;
+        memset(&request, 0, sizeof(request));
+        request.tp_block_size = NET_RING_BLOCK_SIZE;
+        request.tp_block_nr = NET_RING_BLOCKS;
+        request.tp_frame_size = NET_RING_FRAME_SIZE;
+        request.tp_frame_nr = NET_RING_BLOCK_SIZE / NET_RING_FRAME_SIZE * NET_RING_BLOCKS;
+        request.tp_retire_blk_tov = NET_RING_BLOCK_TIMEOUT_MS;
+        if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &request, sizeof(request)) != 0) {
+            return fail("cannot set up the receive ring");
+        }
+        ringSize = (size_t)NET_RING_BLOCK_SIZE * NET_RING_BLOCKS;
+        void* mapped = mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            mapped = mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (mapped == MAP_FAILED) {
+            return fail("cannot map the receive ring");
+        }
+        ring = (uint8_t*)mapped;
+
+        struct sockaddr_ll address;
+        memset(&address, 0, sizeof(address));
+        address.sll_family = AF_PACKET;
+        address.sll_protocol = htons(ETH_P_ALL);
+        address.sll_ifindex = interfaceIndex;
+        if (bind(fd, (const struct sockaddr*)&address, sizeof(address)) != 0) {
+            return fail("cannot bind to the interface");
+        }
+        return true;
+    }
+
+    void close() {
+        if (ring) {
+            munmap(ring, ringSize);
+            ring = nullptr;
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    // Walk the blocks the kernel has retired and give them back; only the
+    // small per-packet headers are read, never the payload
+    bool sample(uint64_t& totalPackets, uint64_t& totalBytes) {
+        if (!ring) {
+            return false;
+        }
+        for (;;) {
+            struct tpacket_block_desc* desc = (struct tpacket_block_desc*)(ring + (size_t)block * NET_RING_BLOCK_SIZE);
+            if (!(__atomic_load_n(&desc->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+                break;
+            }
+            uint32_t count = desc->hdr.bh1.num_pkts;
+            const uint8_t* next = (const uint8_t*)desc + desc->hdr.bh1.offset_to_first_pkt;
+            for (uint32_t i = 0; i < count; i++) {
+                const struct tpacket3_hdr* header = (const struct tpacket3_hdr*)next;
+                bytes += header->tp_len;
+                next += header->tp_next_offset;
+            }
+            packets += count;
+            blocksRead++;
+            __atomic_store_n(&desc->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+            block = (block + 1) % NET_RING_BLOCKS;
+        }
+
+        // Packets dropped on a full ring still count as activity (their
+        // bytes are not known)
+        struct tpacket_stats_v3 stats;
+        socklen_t length = sizeof(stats);
+        if (getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &stats, &length) == 0) {
+            drops += stats.tp_drops;
+            packets += stats.tp_drops;
+        }
+        totalPackets = packets;
+        totalBytes = bytes;
+        return true;
+    }
+};
+
+// ============================================================================
+// NETLINK INTERFACE COUNTERS
+// ============================================================================
+
+class NetCounterSource : public NetSource {
+private:
+    int fd;
+    int interfaceIndex;
+    uint32_t sequence;
+    bool haveBase;
+    uint64_t basePackets;
+    uint64_t baseBytes;
+    uint8_t buffer[NET_NETLINK_BUFFER];
+
+    NetCounterSource(const NetCounterSource&);
+    NetCounterSource& operator=(const NetCounterSource&);
+
+    // rx + tx from the IFLA_STATS64 attribute of the reply to our request
+    bool parse(int length, uint64_t& packets, uint64_t& bytes) {
+        for (struct nlmsghdr* message = (struct nlmsghdr*)buffer; NLMSG_OK(message, (unsigned)length);
+             message = NLMSG_NEXT(message, length)) {
+            if (message->nlmsg_seq != sequence || message->nlmsg_type != RTM_NEWLINK) {
+                continue;
+            }
+            struct ifinfomsg* info = (struct ifinfomsg*)NLMSG_DATA(message);
+            int attributesLength = (int)IFLA_PAYLOAD(message);
+            for (struct rtattr* attribute = IFLA_RTA(info); RTA_OK(attribute, attributesLength);
+                 attribute = RTA_NEXT(attribute, attributesLength)) {
+                if (attribute->rta_type == IFLA_STATS64 &&
+                    RTA_PAYLOAD(attribute) >= sizeof(struct rtnl_link_stats64)) {
+                    struct rtnl_link_stats64 stats;
+                    memcpy(&stats, RTA_DATA(attribute), sizeof(stats));  // Attribute is only 4-byte aligned
+                    packets = stats.rx_packets + stats.tx_packets;
+                    bytes = stats.rx_bytes + stats.tx_bytes;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+public:
+    NetCounterSource() : fd(-1), interfaceIndex(0), sequence(0), haveBase(false), basePackets(0), baseBytes(0) {}
+    ~NetCounterSource() { close(); }
+
+    const char* name() const { return "counters"; }
+
+    bool open(const char* interfaceName) {
+        interfaceIndex = (int)if_nametoindex(interfaceName);
+        if (interfaceIndex == 0) {
+            error = "unknown interface";
+            return false;
+        }
+        fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+        if (fd < 0) {
+            error = "cannot open netlink socket";
+            return false;
+        }
+        struct sockaddr_nl address;
+        memset(&address, 0, sizeof(address));
+        address.nl_family = AF_NETLINK;
+        if (bind(fd, (const struct sockaddr*)&address, sizeof(address)) != 0) {
+            error = "cannot bind netlink socket";
+            close();
+            return false;
+        }
+        haveBase = false;
+        uint64_t packets;
+        uint64_t bytes;
+        if (!sample(packets, bytes)) {
+            error = "interface counters not available";
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    bool sample(uint64_t& packets, uint64_t& bytes) {
+        struct {
+            struct nlmsghdr header;
+            struct ifinfomsg info;
+        } request;
+        memset(&request, 0, sizeof(request));
+        request.header.nlmsg_len = sizeof(request);
+        request.header.nlmsg_type = RTM_GETLINK;
+        request.header.nlmsg_flags = NLM_F_REQUEST;
+        request.header.nlmsg_seq = ++sequence;
+        request.info.ifi_family = AF_UNSPEC;
+        request.info.ifi_index = interfaceIndex;
+        if (send(fd, &request, sizeof(request), 0) != (ssize_t)sizeof(request)) {
+            return false;
+        }
+
+        // rtnetlink answers inside send(), so the reply is queued by now or
+        // lost (socket buffer full); an empty queue fails the sample instead
+        // of stalling the tick. Replies to older requests are skipped by sequence
+        uint64_t currentPackets = 0;
+        uint64_t currentBytes = 0;
+        for (;;) {
+            ssize_t length = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (length <= 0) {
+                return false;
+            }
+            if (parse((int)length, currentPackets, currentBytes)) {
+                break;
+            }
+            const struct nlmsghdr* message = (const struct nlmsghdr*)buffer;
+            if (message->nlmsg_seq == sequence && message->nlmsg_type == NLMSG_ERROR) {
+                return false;
+            }
+        }
+        if (!haveBase) {
+            basePackets = currentPackets;
+            baseBytes = currentBytes;
+            haveBase = true;
+        }
+        packets = currentPackets - basePackets;
+        bytes = currentBytes - baseBytes;
+        return true;
+    }
+};
+
+// Returns a source that still needs open()
+inline NetSource* createNetSource(NetSourceType type) {
+    if (type == NET_SOURCE_COUNTERS) {
+        return new NetCounterSource();
+    }
+    return new PacketRingSource();
+}
+
+inline bool parseNetSource(const char* text, NetSourceType& type) {
+    if (strcmp(text, "ring") == 0) {
+        type = NET_SOURCE_RING;
+    } else if (strcmp(text, "counters") == 0) {
+        type = NET_SOURCE_COUNTERS;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// RATE TO LOAD
+// ============================================================================
+
+// log2(x) in Q16, mantissa interpolated linearly (error below 0.09)
+inline fixed_t log2Fixed(uint64_t x) {
+    if (x == 0) {
+        return 0;
+    }
+    int exponent = 63 - __builtin_clzll(x);
+    uint64_t mantissa = exponent >= FIXED_SHIFT ? (x >> (exponent - FIXED_SHIFT)) : (x << (FIXED_SHIFT - exponent));
+    return (fixed_t)(((int64_t)exponent << FIXED_SHIFT) + (int64_t)(mantissa - FIXED_ONE));
+}
+
+// Packet rate between samples, mapped logarithmically onto 0-100% so that
+// a few packets per second and a saturated link are both visible
+class NetActivity {
+private:
+    uint64_t lastPackets;
+    uint32_t lastMs;
+    uint32_t filterMs;  // Last tick() that reached the filter
+    bool started;
+    fixed_t fullScaleLog;
+
+public:
+    uint32_t packetsPerSecond;
+
+    // fullScalePps is the rate shown as 100%
+    explicit NetActivity(uint32_t fullScalePps)
+        : lastPackets(0), lastMs(0), filterMs(0), started(false), fullScaleLog(log2Fixed((uint64_t)fullScalePps + 1)),
+          packetsPerSecond(0) {}
+
+    fixed_t update(uint64_t packets, uint32_t nowMs) {
+        // A counter that went backwards (reset interface) restarts the
+        // measurement and keeps the last rate
+        if (started && nowMs > lastMs && packets >= lastPackets) {
+            packetsPerSecond = (uint32_t)((packets - lastPackets) * 1000u / (nowMs - lastMs));
+        }
+        if (!started || nowMs > lastMs || packets < lastPackets) {
+            lastPackets = packets;
+            lastMs = nowMs;
+            started = true;
+        }
+        fixed_t load = (fixed_t)((int64_t)log2Fixed((uint64_t)packetsPerSecond + 1) * FIXED_100_PERCENT / fullScaleLog);
+        return load < FIXED_100_PERCENT ? load : FIXED_100_PERCENT;
+    }
+
+    // One monitor tick: sample the source and feed the filter; a failed
+    // sample (no netlink reply queued yet) leaves both untouched
+    bool tick(NetSource& source, ActivityFilter& filter, uint32_t nowMs) {
+        uint64_t packets;
+        uint64_t bytes;
+        if (!source.sample(packets, bytes)) {
+            return false;
+        }
+        filter.update(update(packets, nowMs), nowMs - filterMs);
+        filterMs = nowMs;
+        return true;
+    }
+};
+
+#endif // NET_ACTIVITY_H
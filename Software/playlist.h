@@ -0,0 +1,360 @@
+/*
+ * Playlist of coroutine content items with lookahead prefetch
+ *
+ * Every content item is a C++20 coroutine that draws a frame into its
+ * canvas and yields how long to show it; returning ends the item:
+ *
+ *     ContentItem ticker(Canvas& canvas, const void* argument) {
+ *         loadFont();                        // slow set-up before the first frame
+ *         for (int i = 0; i < 100; i++) {
+ *             drawTicker(canvas, i);
+ *             co_yield 20u;                  // show for 20 ms
+ *         }
+ *     }
+ *
+ * Items are played on two lanes. While one lane plays, a worker thread
+ * starts the next playlist entry on the other lane and runs it up to
+ * PLAYLIST_PREFETCH_FRAMES frames ahead, converting each to bitplanes -
+ * the first resume is where items load and decode, so that cost is paid
+ * while the previous item is still on screen. At the boundary the scan
+ * thread switches lanes and shows the prefetched frames; later frames are
+ * produced on the scan thread itself, one resume and conversion at a time.
+ *
+ * Without prefetch the scan thread starts the next item only when the
+ * current one ends, which is the stall this avoids.
+ *
+ * Needs -std=c++20. Coroutine frames are allocated when an item starts
+ * (on the worker) and freed when its lane is reused (on the worker).
+ */
+
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#include <atomic>
+#include <coroutine>
+#include <pthread.h>
+#include <stdlib.h>
+#include "allocGuard.h"
+#include "hub75.h"
+#include "leanIo.h"
+
+const int PLAYLIST_PREFETCH_FRAMES = 2;
+const int PLAYLIST_LANE_SLOTS = PLAYLIST_PREFETCH_FRAMES + 1;  // Plus the one being shown
+
+// ============================================================================
+// CONTENT ITEM - coroutine yielding hold times
+// ============================================================================
+
+class ContentItem {
+public:
+    struct promise_type {
+        uint32_t holdMs = 0;
+
+        ContentItem get_return_object() {
+            return ContentItem(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(uint32_t ms) noexcept {
+            holdMs = ms;
+            return {};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { abort(); }
+    };
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit ContentItem(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+    ContentItem(const ContentItem&);
+    ContentItem& operator=(const ContentItem&);
+
+public:
+    ContentItem() : handle(nullptr) {}
+
+    ContentItem(ContentItem&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+
+    ContentItem& operator=(ContentItem&& other) noexcept {
+        if (this != &other) {
+            reset();
+            handle = other.handle;
+            other.handle = nullptr;
+        }
+        return *this;
+    }
+
+    ~ContentItem() { reset(); }
+
+    void reset() {
+        if (handle) {
+            handle.destroy();
+            handle = nullptr;
+        }
+    }
+
+    // Draw the next frame; false once the item has ended
+    bool next(uint32_t& holdMs) {
+        if (!handle || handle.done()) {
+            return false;
+        }
+        handle.resume();
+        if (handle.done()) {
+            return false;
+        }
+        holdMs = handle.promise().holdMs;
+        return true;
+    }
+};
+
+typedef ContentItem (*ContentFactory)(Canvas& canvas, const void* argument);
+
+struct PlaylistEntry {
+    const char* name;
+    ContentFactory make;
+    const void* argument;
+};
+
+// ============================================================================
+// PLAYLIST PLAYER
+// ============================================================================
+
+class PlaylistPlayer {
+private:
+    enum LaneState { LANE_FREE, LANE_LOADING, LANE_READY, LANE_PLAYING };
+
+    struct Lane {
+        Canvas* canvas;
+        ContentItem item;
+        BitplaneFrame* frames[PLAYLIST_LANE_SLOTS];
+        uint32_t holds[PLAYLIST_LANE_SLOTS];
+        int prefetched;      // Frames waiting in slots [0, prefetched)
+        int taken;           // Of those, already shown
+        bool ended;          // Item finished while prefetching
+        int entry;
+        std::atomic<int> state;
+    };
+
+    MatrixConfig config;
+    GammaTable gamma;
+    const PlaylistEntry* entries;
+    int entryCount;
+    bool prefetch;
+    Lane lanes[2];
+    int playing;             // Lane on screen
+    int shownSlot;
+    int nextEntry;           // Next entry to load, owned by whoever loads
+    uint32_t dueMs;          // When the shown frame's hold ends
+    uint32_t lastHoldMs;
+    bool started;
+
+    pthread_t thread;
+    bool threadStarted;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    volatile bool stopping;
+
+    PlaylistPlayer(const PlaylistPlayer&);
+    PlaylistPlayer& operator=(const PlaylistPlayer&);
+
+    // Start the next entry on lane and produce its first frames
+    void load(Lane& lane, int frames) {
+        lane.entry = nextEntry;
+        nextEntry = (nextEntry + 1) % entryCount;
+        lane.item = entries[lane.entry].make(*lane.canvas, entries[lane.entry].argument);
+        lane.prefetched = 0;
+        lane.taken = 0;
+        lane.ended = false;
+        while (lane.prefetched < frames) {
+            uint32_t hold;
+            if (!lane.item.next(hold)) {
+                lane.ended = true;
+                break;
+            }
+            lane.frames[lane.prefetched]->build(*lane.canvas, gamma);
+            lane.holds[lane.prefetched] = hold;
+            lane.prefetched++;
+        }
+    }
+
+    static void* prefetchThread(void* arg) {
+        PlaylistPlayer* self = (PlaylistPlayer*)arg;
+        pthread_mutex_lock(&self->lock);
+        while (!self->stopping) {
+            Lane* free = nullptr;
+            for (int i = 0; i < 2 && !free; i++) {
+                if (self->lanes[i].state.load(std::memory_order_acquire) == LANE_FREE) {
+                    free = &self->lanes[i];
+                }
+            }
+            if (!free) {
+                pthread_cond_wait(&self->wake, &self->lock);
+                continue;
+            }
+            free->state.store(LANE_LOADING, std::memory_order_relaxed);
+            pthread_mutex_unlock(&self->lock);
+            self->load(*free, PLAYLIST_PREFETCH_FRAMES);
+            free->state.store(LANE_READY, std::memory_order_release);
+            self->prefetches++;
+            pthread_mutex_lock(&self->lock);
+        }
+        pthread_mutex_unlock(&self->lock);
+        return nullptr;
+    }
+
+    // Next frame of the playing lane into shownSlot; false if the item ended
+    bool produce(Lane& lane, uint32_t& holdMs) {
+        if (lane.taken < lane.prefetched) {
+            shownSlot = lane.taken++;
+            holdMs = lane.holds[shownSlot];
+            return true;
+        }
+        if (lane.ended) {
+            return false;
+        }
+        AllocScope scope(ALLOC_SCOPE_RENDER);
+        uint32_t hold;
+        if (!lane.item.next(hold)) {
+            lane.ended = true;
+            return false;
+        }
+        // Any slot but the one on screen
+        int slot = (shownSlot + 1) % PLAYLIST_LANE_SLOTS;
+        lane.frames[slot]->build(*lane.canvas, gamma);
+        shownSlot = slot;
+        holdMs = hold;
+        return true;
+    }
+
+    // Move to the other lane; false if its item is not loaded yet
+    bool transition() {
+        Lane& next = lanes[playing ^ 1];
+        if (!prefetch && next.state.load(std::memory_order_relaxed) == LANE_FREE) {
+            load(next, 1);  // On the scan thread: the stall prefetching avoids
+            next.state.store(LANE_READY, std::memory_order_relaxed);
+        }
+        if (next.state.load(std::memory_order_acquire) != LANE_READY) {
+            return false;
+        }
+        next.state.store(LANE_PLAYING, std::memory_order_relaxed);
+        Lane& old = lanes[playing];
+        playing ^= 1;
+        shownSlot = -1;
+        pthread_mutex_lock(&lock);
+        old.state.store(LANE_FREE, std::memory_order_release);
+        pthread_cond_signal(&wake);
+        pthread_mutex_unlock(&lock);
+        if (started) {
+            transitions++;
+        }
+        started = true;
+        return true;
+    }
+
+public:
+    unsigned long transitions;
+    unsigned long prefetches;
+    unsigned long framesShown;
+    unsigned long droppedFrames;   // Whole frame times a frame came late, anywhere
+    unsigned long gapFrames;       // Of those, at item boundaries
+    uint32_t worstGapMs;           // Longest boundary delay
+    int currentEntry;
+
+    PlaylistPlayer(const MatrixConfig& cfg, double gammaValue, const PlaylistEntry* playlist, int count,
+                   bool lookahead)
+        : config(cfg), entries(playlist), entryCount(count), prefetch(lookahead), playing(1), shownSlot(-1),
+          nextEntry(0), dueMs(0), lastHoldMs(0), started(false), threadStarted(false), stopping(false), transitions(0),
+          prefetches(0), framesShown(0), droppedFrames(0), gapFrames(0), worstGapMs(0), currentEntry(-1) {
+        gamma.build(cfg.planes, gammaValue);
+        pthread_mutex_init(&lock, nullptr);
+        pthread_cond_init(&wake, nullptr);
+        for (int i = 0; i < 2; i++) {
+            lanes[i].canvas = new Canvas(cfg.width(), cfg.height());
+            for (int s = 0; s < PLAYLIST_LANE_SLOTS; s++) {
+                lanes[i].frames[s] = new BitplaneFrame(cfg);
+                lanes[i].frames[s]->plan();
+            }
+            lanes[i].prefetched = 0;
+            lanes[i].taken = 0;
+            lanes[i].ended = true;
+            lanes[i].entry = -1;
+            lanes[i].state.store(LANE_FREE);
+        }
+        // Lane 1 counts as playing an empty item, so lane 0 gets the first entry
+        lanes[1].state.store(LANE_PLAYING);
+    }
+
+    ~PlaylistPlayer() {
+        stop();
+        for (int i = 0; i < 2; i++) {
+            lanes[i].item.reset();
+            delete lanes[i].canvas;
+            for (int s = 0; s < PLAYLIST_LANE_SLOTS; s++) {
+                delete lanes[i].frames[s];
+            }
+        }
+        pthread_cond_destroy(&wake);
+        pthread_mutex_destroy(&lock);
+    }
+
+    bool start() {
+        if (!prefetch) {
+            return true;
+        }
+        stopping = false;
+        threadStarted = pthread_create(&thread, nullptr, prefetchThread, this) == 0;
+        return threadStarted;
+    }
+
+    void stop() {
+        if (!threadStarted) {
+            return;
+        }
+        pthread_mutex_lock(&lock);
+        stopping = true;
+        pthread_cond_signal(&wake);
+        pthread_mutex_unlock(&lock);
+        pthread_join(thread, nullptr);
+        threadStarted = false;
+    }
+
+    // Scan thread, before every refresh: the frame to show at nowMs, or
+    // nullptr to keep showing the previous one (nothing loaded yet)
+    const BitplaneFrame* frameAt(uint32_t nowMs) {
+        if (started && nowMs < dueMs) {
+            return lanes[playing].frames[shownSlot];
+        }
+        uint64_t startNs = monotonicNs();
+        uint32_t holdMs;
+        bool boundary = false;
+        while (!started || !produce(lanes[playing], holdMs)) {
+            if (!transition()) {
+                // Next item still loading: the last frame stays up
+                return shownSlot >= 0 ? lanes[playing].frames[shownSlot] : nullptr;
+            }
+            boundary = true;
+            currentEntry = lanes[playing].entry;
+        }
+
+        // Lateness in frame times of the content being replaced, up to when
+        // the frame is ready; less than one frame (polling jitter) drops nothing
+        nowMs += (uint32_t)((monotonicNs() - startNs) / 1000000u);
+        if (framesShown > 0 && nowMs > dueMs) {
+            uint32_t lateMs = nowMs - dueMs;
+            uint32_t dropped = lateMs / (lastHoldMs > 0 ? lastHoldMs : 1);
+            droppedFrames += dropped;
+            if (boundary) {
+                gapFrames += dropped;
+                worstGapMs = lateMs > worstGapMs ? lateMs : worstGapMs;
+            }
+        }
+        // Keep the schedule unless a whole frame was lost
+        dueMs = (framesShown > 0 && nowMs - dueMs < holdMs ? dueMs : nowMs) + holdMs;
+        lastHoldMs = holdMs;
+        framesShown++;
+        return lanes[playing].frames[shownSlot];
+    }
+};
+
+#endif // PLAYLIST_H
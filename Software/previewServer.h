@@ -0,0 +1,739 @@
+/*
+ * Live preview of the canvas in a browser
+ *
+ * A small HTTP server: GET / returns a page that opens a WebSocket on /ws
+ * and paints what the matrix should be showing, scaled up with square
+ * pixels, so content can be checked from a laptop during installation.
+ *
+ * The render side only ever calls offer() when it swaps a canvas: the rows
+ * are copied into a snapshot under a sequence counter (writers never wait;
+ * the server retries a torn copy). Everything else runs on the server
+ * thread, at most maxFps times per second and only when the snapshot
+ * changed: the snapshot is compared tile by tile with what the clients
+ * already have and only changed tiles are sent, each as a palette with
+ * runs of indices or as raw RGB, whichever is smaller.
+ *
+ * Clients are written non-blocking from a per-client buffer. A client
+ * that cannot keep up loses deltas instead of stalling the others and gets
+ * a full frame once its buffer has drained; a new client starts with one.
+ *
+ * Message (one binary WebSocket frame, integers little-endian):
+ *   u8 1, u16 width, u16 height, u8 tile size, u16 tile count, tiles
+ * Tile:
+ *   u8 column, u8 row (in tiles), u8 colors n,
+ *   n = 0: RGB of every pixel of the tile, row-major, clipped to the canvas
+ *   n > 0: n RGB palette entries, then (u8 index, u8 length - 1) runs
+ */
+
+#ifndef PREVIEW_SERVER_H
+#define PREVIEW_SERVER_H
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "hub75.h"
+#include "leanIo.h"
+#include "statsSocket.h"
+
+const int PREVIEW_TILE = 8;
+const int PREVIEW_MAX_PALETTE = 16;           // More colors in a tile: raw RGB
+const int PREVIEW_MAX_CLIENTS = 4;
+const size_t PREVIEW_CLIENT_BUFFER = 256 * 1024;
+const int PREVIEW_SOCKET_BUFFER = 64 * 1024;  // Kernel send buffer: stale frames queue here too
+const size_t PREVIEW_REQUEST_SIZE = 2048;
+const int PREVIEW_IDLE_POLL_MS = 200;
+const int PREVIEW_SNAPSHOT_TRIES = 4;
+
+// ============================================================================
+// WEBSOCKET HANDSHAKE - SHA-1 and base64 of the accept key
+// ============================================================================
+
+inline uint32_t sha1Rotate(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+inline void sha1Block(uint32_t* state, const uint8_t* block) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8 |
+               block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = sha1Rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f;
+        uint32_t k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t next = sha1Rotate(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = sha1Rotate(b, 30);
+        b = a;
+        a = next;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+inline void sha1(const uint8_t* data, size_t length, uint8_t* digest) {
+    uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    size_t offset = 0;
+    for (; offset + 64 <= length; offset += 64) {
+        sha1Block(state, data + offset);
+    }
+    uint8_t tail[128];
+    size_t rest = length - offset;
+    memcpy(tail, data + offset, rest);
+    tail[rest] = 0x80;
+    size_t padded = rest + 9 <= 64 ? 64 : 128;
+    memset(tail + rest + 1, 0, padded - rest - 1);
+    uint64_t bits = (uint64_t)length * 8;
+    for (int i = 0; i < 8; i++) {
+        tail[padded - 1 - i] = (uint8_t)(bits >> (i * 8));
+    }
+    for (size_t block = 0; block < padded; block += 64) {
+        sha1Block(state, tail + block);
+    }
+    for (int i = 0; i < 20; i++) {
+        digest[i] = (uint8_t)(state[i / 4] >> (24 - i % 4 * 8));
+    }
+}
+
+// NUL-terminated base64 of data into out (4 * ((length + 2) / 3) + 1 bytes)
+inline void base64Encode(const uint8_t* data, size_t length, char* out) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t group = (uint32_t)data[i] << 16 | (i + 1 < length ? (uint32_t)data[i + 1] << 8 : 0) |
+                         (i + 2 < length ? data[i + 2] : 0);
+        *out++ = alphabet[group >> 18];
+        *out++ = alphabet[(group >> 12) & 63];
+        *out++ = i + 1 < length ? alphabet[(group >> 6) & 63] : '=';
+        *out++ = i + 2 < length ? alphabet[group & 63] : '=';
+    }
+    *out = '\0';
+}
+
+// Sec-WebSocket-Accept for a Sec-WebSocket-Key (RFC 6455); out holds 29 bytes
+inline bool websocketAccept(const char* key, char* out) {
+    static const char guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    char joined[128];
+    size_t keyLength = strlen(key);
+    if (keyLength + sizeof(guid) > sizeof(joined)) {
+        return false;
+    }
+    memcpy(joined, key, keyLength);
+    memcpy(joined + keyLength, guid, sizeof(guid) - 1);
+    uint8_t digest[20];
+    sha1((const uint8_t*)joined, keyLength + sizeof(guid) - 1, digest);
+    base64Encode(digest, sizeof(digest), out);
+    return true;
+}
+
+// ============================================================================
+// TILE ENCODING
+// ============================================================================
+
+// One tile of rgb (width pixels per row) at (x, y), tw x th pixels, into
+// out (at most 3 + tw * th * 3 bytes); returns the bytes written
+inline size_t encodeTile(const uint8_t* rgb, int width, int x, int y, int tw, int th, uint8_t* out) {
+    uint8_t palette[PREVIEW_MAX_PALETTE * 3];
+    uint8_t indices[PREVIEW_TILE * PREVIEW_TILE];
+    int colors = 0;
+    int runs = 0;
+    int pixels = 0;
+    for (int row = 0; row < th && colors <= PREVIEW_MAX_PALETTE; row++) {
+        const uint8_t* p = rgb + ((size_t)(y + row) * width + x) * 3;
+        for (int col = 0; col < tw; col++, p += 3) {
+            int index = 0;
+            while (index < colors && memcmp(palette + index * 3, p, 3) != 0) {
+                index++;
+            }
+            if (index == colors) {
+                if (colors == PREVIEW_MAX_PALETTE) {
+                    colors++;
+                    break;
+                }
+                memcpy(palette + colors * 3, p, 3);
+                colors++;
+            }
+            runs += pixels == 0 || indices[pixels - 1] != index;
+            indices[pixels++] = (uint8_t)index;
+        }
+    }
+
+    out[0] = (uint8_t)(x / PREVIEW_TILE);
+    out[1] = (uint8_t)(y / PREVIEW_TILE);
+    size_t raw = (size_t)tw * th * 3;
+    if (colors > PREVIEW_MAX_PALETTE || (size_t)colors * 3 + (size_t)runs * 2 >= raw) {
+        out[2] = 0;
+        uint8_t* q = out + 3;
+        for (int row = 0; row < th; row++) {
+            memcpy(q, rgb + ((size_t)(y + row) * width + x) * 3, (size_t)tw * 3);
+            q += tw * 3;
+        }
+        return 3 + raw;
+    }
+    out[2] = (uint8_t)colors;
+    memcpy(out + 3, palette, (size_t)colors * 3);
+    uint8_t* q = out + 3 + colors * 3;
+    for (int i = 0; i < pixels;) {
+        int length = 1;
+        while (i + length < pixels && indices[i + length] == indices[i]) {
+            length++;
+        }
+        *q++ = indices[i];
+        *q++ = (uint8_t)(length - 1);
+        i += length;
+    }
+    return (size_t)(q - out);
+}
+
+// Page served on GET /: paints every message into an ImageData
+const char PREVIEW_PAGE[] =
+    "<!DOCTYPE html><html><head><title>HUB75 preview</title><style>"
+    "body{margin:0;background:#111;color:#888;font:12px sans-serif}"
+    "canvas{width:100%;image-rendering:pixelated;background:#000}</style></head><body>"
+    "<canvas id=c width=64 height=32></canvas><div id=s>connecting</div><script>"
+    "const c=document.getElementById('c'),g=c.getContext('2d'),s=document.getElementById('s');let m=null,n=0;"
+    "function put(x,y,d,q){const o=(y*m.width+x)*4;m.data[o]=d[q];m.data[o+1]=d[q+1];m.data[o+2]=d[q+2];"
+    "m.data[o+3]=255;}"
+    "const w=new WebSocket('ws://'+location.host+'/ws');w.binaryType='arraybuffer';"
+    "w.onclose=()=>{s.textContent='disconnected';};"
+    "w.onmessage=e=>{const d=new Uint8Array(e.data);if(d[0]!==1)return;"
+    "const W=d[1]|d[2]<<8,H=d[3]|d[4]<<8,t=d[5],k=d[6]|d[7]<<8;let p=8;"
+    "if(!m||m.width!==W||m.height!==H){c.width=W;c.height=H;m=g.createImageData(W,H);}"
+    "for(let j=0;j<k;j++){const x=d[p]*t,y=d[p+1]*t,u=d[p+2],tw=Math.min(t,W-x),th=Math.min(t,H-y),a=p+3;"
+    "p=a+u*3;let i=0;if(u===0){for(;i<tw*th;i++,p+=3)put(x+i%tw,y+(i/tw|0),d,p);}"
+    "else while(i<tw*th){const q=a+d[p]*3,r=d[p+1]+1;p+=2;for(let l=0;l<r;l++,i++)put(x+i%tw,y+(i/tw|0),d,q);}}"
+    "g.putImageData(m,0,0);s.textContent=W+'x'+H+', '+(++n)+' updates';};"
+    "</script></body></html>";
+
+// ============================================================================
+// SERVER
+// ============================================================================
+
+class PreviewServer {
+private:
+    enum ClientState {
+        CLIENT_FREE,
+        CLIENT_HTTP,        // Reading the request
+        CLIENT_WEBSOCKET,
+        CLIENT_CLOSING      // Page or error sent, close once flushed
+    };
+
+    struct Client {
+        int fd;
+        ClientState state;
+        char request[PREVIEW_REQUEST_SIZE];
+        size_t requestLength;
+        uint8_t* out;
+        size_t outHead;
+        size_t outTail;
+        bool needsKeyframe;
+    };
+
+    int width;
+    int height;
+    int tilesX;
+    int tilesY;
+    uint64_t periodNs;
+    uint8_t* snapshot;       // Written by offer()
+    uint8_t* current;        // Server copy of the snapshot
+    uint8_t* sent;           // What in-sync clients show
+    uint8_t* message;
+    size_t messageCapacity;
+    size_t bufferSize;
+    std::atomic<uint32_t> writers;
+    std::atomic<uint32_t> version;
+    uint32_t takenVersion;
+    Client clients[PREVIEW_MAX_CLIENTS];
+    int listenFd;
+    pthread_t thread;
+    bool threadStarted;
+    volatile bool stopping;
+    uint64_t nextFrameNs;
+
+    PreviewServer(const PreviewServer&);
+    PreviewServer& operator=(const PreviewServer&);
+
+    enum SnapshotResult { SNAPSHOT_UNCHANGED, SNAPSHOT_TAKEN, SNAPSHOT_TORN };
+
+    // Consistent copy of the snapshot into current; torn if every try
+    // overlapped a write
+    SnapshotResult takeSnapshot() {
+        for (int attempt = 0; attempt < PREVIEW_SNAPSHOT_TRIES; attempt++) {
+            uint32_t seen = version.load(std::memory_order_acquire);
+            if (seen == takenVersion) {
+                return SNAPSHOT_UNCHANGED;
+            }
+            if (writers.load(std::memory_order_acquire) == 0) {
+                memcpy(current, snapshot, (size_t)width * height * 3);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (writers.load(std::memory_order_relaxed) == 0 &&
+                    version.load(std::memory_order_relaxed) == seen) {
+                    takenVersion = seen;
+                    return SNAPSHOT_TAKEN;
+                }
+            }
+            tornSnapshots++;
+        }
+        return SNAPSHOT_TORN;
+    }
+
+    // Tiles of current that differ from sent (all with keyframe) as one
+    // WebSocket frame; returns its start inside message, length in size
+    const uint8_t* encode(bool keyframe, size_t& size) {
+        uint8_t* payload = message + 10;
+        payload[0] = 1;
+        payload[1] = (uint8_t)width;
+        payload[2] = (uint8_t)(width >> 8);
+        payload[3] = (uint8_t)height;
+        payload[4] = (uint8_t)(height >> 8);
+        payload[5] = (uint8_t)PREVIEW_TILE;
+        uint8_t* q = payload + 8;
+        int tiles = 0;
+        for (int ty = 0; ty < tilesY; ty++) {
+            for (int tx = 0; tx < tilesX; tx++) {
+                int x = tx * PREVIEW_TILE;
+                int y = ty * PREVIEW_TILE;
+                int tw = width - x < PREVIEW_TILE ? width - x : PREVIEW_TILE;
+                int th = height - y < PREVIEW_TILE ? height - y : PREVIEW_TILE;
+                bool changed = keyframe;
+                for (int row = 0; row < th && !changed; row++) {
+                    size_t offset = ((size_t)(y + row) * width + x) * 3;
+                    changed = memcmp(current + offset, sent + offset, (size_t)tw * 3) != 0;
+                }
+                if (changed) {
+                    q += encodeTile(current, width, x, y, tw, th, q);
+                    tiles++;
+                }
+            }
+        }
+        payload[6] = (uint8_t)tiles;
+        payload[7] = (uint8_t)(tiles >> 8);
+        size_t length = (size_t)(q - payload);
+        tilesSent += (unsigned long)tiles;
+
+        // Header right before the payload
+        uint8_t* frame;
+        if (length < 126) {
+            frame = payload - 2;
+            frame[1] = (uint8_t)length;
+        } else if (length < 65536) {
+            frame = payload - 4;
+            frame[1] = 126;
+            frame[2] = (uint8_t)(length >> 8);
+            frame[3] = (uint8_t)length;
+        } else {
+            frame = payload - 10;
+            frame[1] = 127;
+            for (int i = 0; i < 8; i++) {
+                frame[2 + i] = (uint8_t)(length >> (56 - i * 8));
+            }
+        }
+        frame[0] = 0x82;  // FIN, binary
+        size = (size_t)(payload + length - frame);
+        return tiles > 0 ? frame : nullptr;
+    }
+
+    bool append(Client& client, const void* data, size_t size) {
+        if (client.outTail + size > bufferSize && client.outHead > 0) {
+            memmove(client.out, client.out + client.outHead, client.outTail - client.outHead);
+            client.outTail -= client.outHead;
+            client.outHead = 0;
+        }
+        if (client.outTail + size > bufferSize) {
+            return false;
+        }
+        memcpy(client.out + client.outTail, data, size);
+        client.outTail += size;
+        return true;
+    }
+
+    void appendText(Client& client, const char* text) { append(client, text, strlen(text)); }
+
+    void closeClient(Client& client) {
+        close(client.fd);
+        client.fd = -1;
+        client.state = CLIENT_FREE;
+    }
+
+    void flush(Client& client) {
+        while (client.outHead < client.outTail) {
+            ssize_t n = send(client.fd, client.out + client.outHead, client.outTail - client.outHead,
+                             MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n <= 0) {
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    return;
+                }
+                closeClient(client);
+                return;
+            }
+            client.outHead += (size_t)n;
+            bytesSent += (unsigned long)n;
+        }
+        client.outHead = client.outTail = 0;
+        if (client.state == CLIENT_CLOSING) {
+            closeClient(client);
+        }
+    }
+
+    // Value of header name in a complete request, copied into value
+    static bool header(const char* request, const char* name, char* value, size_t size) {
+        size_t nameLength = strlen(name);
+        for (const char* line = request; *line; line = nextLine(line)) {
+            if (strncasecmp(line, name, nameLength) == 0 && line[nameLength] == ':') {
+                const char* p = line + nameLength + 1;
+                while (*p == ' ') {
+                    p++;
+                }
+                size_t length = 0;
+                while (p[length] && p[length] != '\r' && p[length] != '\n' && length + 1 < size) {
+                    length++;
+                }
+                memcpy(value, p, length);
+                value[length] = '\0';
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void answer(Client& client) {
+        char key[64];
+        char accept[32];
+        if (strncmp(client.request, "GET /ws ", 8) == 0 && header(client.request, "Sec-WebSocket-Key", key, sizeof(key)) &&
+            websocketAccept(key, accept)) {
+            appendText(client, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                               "Sec-WebSocket-Accept: ");
+            appendText(client, accept);
+            appendText(client, "\r\n\r\n");
+            client.state = CLIENT_WEBSOCKET;
+            client.needsKeyframe = true;
+            nextFrameNs = 0;
+            websockets++;
+        } else if (strncmp(client.request, "GET / ", 6) == 0) {
+            char digits[24];
+            int count = 0;
+            for (size_t value = sizeof(PREVIEW_PAGE) - 1; value > 0; value /= 10) {
+                digits[count++] = (char)('0' + value % 10);
+            }
+            appendText(client, "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nConnection: close\r\nContent-Length: ");
+            while (count > 0) {
+                append(client, &digits[--count], 1);
+            }
+            appendText(client, "\r\n\r\n");
+            append(client, PREVIEW_PAGE, sizeof(PREVIEW_PAGE) - 1);
+            client.state = CLIENT_CLOSING;
+        } else {
+            appendText(client, "HTTP/1.1 404 Not Found\r\nConnection: close\r\nContent-Length: 0\r\n\r\n");
+            client.state = CLIENT_CLOSING;
+        }
+        flush(client);
+    }
+
+    void receive(Client& client) {
+        char* buffer = client.request + client.requestLength;
+        size_t room = sizeof(client.request) - 1 - client.requestLength;
+        if (client.state != CLIENT_HTTP) {
+            // WebSocket input is only watched for a close frame
+            uint8_t discard[256];
+            ssize_t n = recv(client.fd, discard, sizeof(discard), MSG_DONTWAIT);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) ||
+                (n > 0 && client.state == CLIENT_WEBSOCKET && (discard[0] & 0x0F) == 0x8)) {
+                closeClient(client);
+            }
+            return;
+        }
+        ssize_t n = room > 0 ? recv(client.fd, buffer, room, MSG_DONTWAIT) : 0;
+        if (n <= 0) {
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                closeClient(client);
+            }
+            return;
+        }
+        client.requestLength += (size_t)n;
+        client.request[client.requestLength] = '\0';
+        if (strstr(client.request, "\r\n\r\n")) {
+            answer(client);
+        }
+    }
+
+    void acceptClient() {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd < 0) {
+            return;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &PREVIEW_SOCKET_BUFFER, sizeof(PREVIEW_SOCKET_BUFFER));
+        for (int i = 0; i < PREVIEW_MAX_CLIENTS; i++) {
+            Client& client = clients[i];
+            if (client.state == CLIENT_FREE) {
+                client.fd = fd;
+                client.state = CLIENT_HTTP;
+                client.requestLength = 0;
+                client.outHead = client.outTail = 0;
+                client.needsKeyframe = false;
+                return;
+            }
+        }
+        close(fd);  // Full
+    }
+
+    // One frame slot: deltas to clients in sync, full frames to the others
+    SnapshotResult sendFrame() {
+        SnapshotResult snapshot = takeSnapshot();
+        if (snapshot == SNAPSHOT_TAKEN) {
+            size_t size;
+            const uint8_t* frame = encode(false, size);
+            if (frame) {
+                framesSent++;
+                for (int i = 0; i < PREVIEW_MAX_CLIENTS; i++) {
+                    Client& client = clients[i];
+                    if (client.state == CLIENT_WEBSOCKET && !client.needsKeyframe && !append(client, frame, size)) {
+                        client.needsKeyframe = true;  // Too slow: resync once drained
+                        overflows++;
+                    }
+                }
+            }
+            memcpy(sent, current, (size_t)width * height * 3);
+        }
+        const uint8_t* keyframe = nullptr;
+        size_t keyframeSize = 0;
+        for (int i = 0; i < PREVIEW_MAX_CLIENTS; i++) {
+            Client& client = clients[i];
+            if (client.state != CLIENT_WEBSOCKET || !client.needsKeyframe || client.outHead != client.outTail) {
+                continue;
+            }
+            if (!keyframe) {
+                keyframe = encode(true, keyframeSize);
+                keyframes++;
+            }
+            client.needsKeyframe = !append(client, keyframe, keyframeSize);
+        }
+        for (int i = 0; i < PREVIEW_MAX_CLIENTS; i++) {
+            if (clients[i].state == CLIENT_WEBSOCKET && clients[i].outHead != clients[i].outTail) {
+                flush(clients[i]);
+            }
+        }
+        return snapshot;
+    }
+
+    static void* serverThread(void* arg) {
+        PreviewServer* self = (PreviewServer*)arg;
+        struct pollfd fds[PREVIEW_MAX_CLIENTS + 1];
+        while (!self->stopping) {
+            int count = 0;
+            bool watching = false;
+            fds[count++] = { self->listenFd, POLLIN, 0 };
+            for (int i = 0; i < PREVIEW_MAX_CLIENTS; i++) {
+                Client& client = self->clients[i];
+                if (client.state != CLIENT_FREE) {
+                    short events = (short)(POLLIN | (client.outHead != client.outTail ? POLLOUT : 0));
+                    fds[count++] = { client.fd, events, 0 };
+                    watching = watching || client.state == CLIENT_WEBSOCKET;
+                }
+            }
+            int timeoutMs = PREVIEW_IDLE_POLL_MS;
+            if (watching) {
+                uint64_t nowNs = monotonicNs();
+                uint64_t waitMs = self->nextFrameNs > nowNs ? (self->nextFrameNs - nowNs + 999999) / 1000000 : 0;
+                timeoutMs = waitMs < (uint64_t)timeoutMs ? (int)waitMs : timeoutMs;
+            }
+            int ready = poll(fds, (nfds_t)count, timeoutMs);
+            if (self->stopping) {
+                break;
+            }
+            if (ready > 0) {
+                for (int f = 1; f < count; f++) {
+                    for (int i = 0; i < PREVIEW_MAX_CLIENTS; i++) {
+                        Client& client = self->clients[i];
+                        if (client.state == CLIENT_FREE || client.fd != fds[f].fd) {
+                            continue;
+                        }
+                        if (fds[f].revents & (POLLIN | POLLHUP | POLLERR)) {
+                            self->receive(client);
+                        }
+                        if (client.state != CLIENT_FREE && (fds[f].revents & POLLOUT)) {
+                            self->flush(client);
+                        }
+                    }
+                }
+                if (fds[0].revents & POLLIN) {
+                    self->acceptClient();
+                }
+            }
+            uint64_t nowNs = monotonicNs();
+            if (watching && nowNs >= self->nextFrameNs) {
+                // Only a torn snapshot is retried soon; a newer offer waits for its slot
+                self->nextFrameNs = self->sendFrame() == SNAPSHOT_TORN ? nowNs + self->periodNs / 8
+                                                                        : nowNs + self->periodNs;
+            }
+            struct timespec cpu;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+            self->cpuNs = (uint64_t)cpu.tv_sec * 1000000000u + (uint64_t)cpu.tv_nsec;
+        }
+        return nullptr;
+    }
+
+public:
+    const char* error;
+    unsigned long offers;          // Render side, may be one behind
+    unsigned long framesSent;      // Delta frames with at least one tile
+    unsigned long keyframes;
+    unsigned long tilesSent;
+    unsigned long bytesSent;
+    unsigned long websockets;      // Connections upgraded
+    unsigned long overflows;       // Deltas dropped for slow clients
+    unsigned long tornSnapshots;   // Copies retried because of a write
+    uint64_t cpuNs;                // Server thread CPU time
+
+    // Canvas of canvasWidth x canvasHeight, at most maxFps updates per second
+    PreviewServer(int canvasWidth, int canvasHeight, int maxFps)
+        : width(canvasWidth), height(canvasHeight), tilesX((canvasWidth + PREVIEW_TILE - 1) / PREVIEW_TILE),
+          tilesY((canvasHeight + PREVIEW_TILE - 1) / PREVIEW_TILE),
+          periodNs(1000000000u / (uint64_t)(maxFps > 0 ? maxFps : 1)),
+          snapshot(new uint8_t[(size_t)canvasWidth * canvasHeight * 3]),
+          current(new uint8_t[(size_t)canvasWidth * canvasHeight * 3]),
+          sent(new uint8_t[(size_t)canvasWidth * canvasHeight * 3]), writers(0), version(0), takenVersion(0),
+          listenFd(-1), threadStarted(false), stopping(false), nextFrameNs(0), error(nullptr), offers(0),
+          framesSent(0), keyframes(0), tilesSent(0), bytesSent(0), websockets(0), overflows(0), tornSnapshots(0),
+          cpuNs(0) {
+        size_t pixels = (size_t)width * height * 3;
+        memset(snapshot, 0, pixels);
+        memset(current, 0, pixels);
+        memset(sent, 0, pixels);
+        messageCapacity = 10 + 8 + pixels + (size_t)tilesX * tilesY * 3;
+        message = new uint8_t[messageCapacity];
+        bufferSize = messageCapacity > PREVIEW_CLIENT_BUFFER ? messageCapacity : PREVIEW_CLIENT_BUFFER;
+        for (int i = 0; i < PREVIEW_MAX_CLIENTS; i++) {
+            clients[i].fd = -1;
+            clients[i].state = CLIENT_FREE;
+            clients[i].out = new uint8_t[bufferSize];
+        }
+    }
+
+    ~PreviewServer() {
+        stop();
+        delete[] snapshot;
+        delete[] current;
+        delete[] sent;
+        delete[] message;
+        for (int i = 0; i < PREVIEW_MAX_CLIENTS; i++) {
+            delete[] clients[i].out;
+        }
+    }
+
+    // Render side, at buffer swap: rows of canvas go to the snapshot at row
+    // top (a chain's own canvas at chain * panelRows); never waits
+    void offer(const Canvas& canvas, int top = 0) {
+        writers.fetch_add(1, std::memory_order_acq_rel);
+        int cols = canvas.width() < width ? canvas.width() : width;
+        for (int y = 0; y < canvas.height() && top + y < height; y++) {
+            memcpy(snapshot + (size_t)(top + y) * width * 3, canvas.row(y), (size_t)cols * 3);
+        }
+        version.fetch_add(1, std::memory_order_release);
+        writers.fetch_sub(1, std::memory_order_release);
+        offers++;
+    }
+
+    // Stats socket source; counters may be one update behind
+    void report(StatsReport& out, const char* name) const {
+        out.add(name, "offers", offers);
+        out.add(name, "frames", framesSent);
+        out.add(name, "keyframes", keyframes);
+        out.add(name, "tiles", tilesSent);
+        out.add(name, "bytes", bytesSent);
+        out.add(name, "websockets", websockets);
+        out.add(name, "overflows", overflows);
+        out.add(name, "cpu_ns", (unsigned long)cpuNs);
+    }
+
+    // Listen on address:port (port 0 picks a free one, see port()) and
+    // serve from a thread
+    bool start(const char* address, uint16_t port) {
+        struct sockaddr_in bindAddress;
+        memset(&bindAddress, 0, sizeof(bindAddress));
+        bindAddress.sin_family = AF_INET;
+        bindAddress.sin_port = htons(port);
+        if (inet_pton(AF_INET, address, &bindAddress.sin_addr) != 1) {
+            error = "invalid address";
+            return false;
+        }
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) {
+            error = "cannot create socket";
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (bind(listenFd, (const struct sockaddr*)&bindAddress, sizeof(bindAddress)) != 0 ||
+            listen(listenFd, 4) != 0) {
+            error = "cannot listen on port";
+            close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        stopping = false;
+        threadStarted = pthread_create(&thread, nullptr, serverThread, this) == 0;
+        if (!threadStarted) {
+            error = "cannot start thread";
+        }
+        return threadStarted;
+    }
+
+    uint16_t port() const {
+        struct sockaddr_in bound;
+        socklen_t length = sizeof(bound);
+        if (listenFd < 0 || getsockname(listenFd, (struct sockaddr*)&bound, &length) != 0) {
+            return 0;
+        }
+        return ntohs(bound.sin_port);
+    }
+
+    void stop() {
+        if (listenFd < 0) {
+            return;
+        }
+        stopping = true;
+        shutdown(listenFd, SHUT_RDWR);  // Wakes the poll()
+        if (threadStarted) {
+            pthread_join(thread, nullptr);
+            threadStarted = false;
+        }
+        for (int i = 0; i < PREVIEW_MAX_CLIENTS; i++) {
+            if (clients[i].state != CLIENT_FREE) {
+                closeClient(clients[i]);
+            }
+        }
+        close(listenFd);
+        listenFd = -1;
+    }
+};
+
+#endif // PREVIEW_SERVER_H
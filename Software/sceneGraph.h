@@ -0,0 +1,412 @@
+/*
+ * Retained-mode scene graph for signage content
+ *
+ * A SceneGraph holds widget nodes (clock, ticker, image, text) over a canvas
+ * that is kept between frames. Each node reports when its content changes;
+ * render() then clears and redraws only the damaged rectangles - every node
+ * overlapping one is redrawn clipped to it, so overlaps stay correct - and
+ * returns the touched rows as RowDamage. BitplaneFrame::update() converts
+ * just those row addresses, so a clock ticking once per second costs a
+ * handful of rows per second and nothing in between.
+ *
+ *   SceneGraph scene(config);
+ *   scene.add(&clock);
+ *   scene.add(&ticker);
+ *   scene.render(canvas, nowMs, damage);
+ *   frame.update(canvas, gamma, damage);
+ *
+ * Nodes are drawn in the order they were added, later ones on top.
+ */
+
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <stdint.h>
+#include <string.h>
+#include "allocGuard.h"
+#include "hub75.h"
+
+const int SCENE_MAX_NODES = 32;
+const int SCENE_MAX_DAMAGE = 8;  // Rectangles per render before they are merged
+const int SCENE_TEXT_SIZE = 64;
+
+// ============================================================================
+// GEOMETRY
+// ============================================================================
+
+struct Rect {
+    int x;
+    int y;
+    int w;
+    int h;
+
+    bool empty() const { return w <= 0 || h <= 0; }
+
+    bool overlaps(const Rect& other) const {
+        return !empty() && !other.empty() && x < other.x + other.w && other.x < x + w &&
+               y < other.y + other.h && other.y < y + h;
+    }
+
+    Rect intersect(const Rect& other) const {
+        int left = x > other.x ? x : other.x;
+        int top = y > other.y ? y : other.y;
+        int right = x + w < other.x + other.w ? x + w : other.x + other.w;
+        int bottom = y + h < other.y + other.h ? y + h : other.y + other.h;
+        Rect result = { left, top, right - left, bottom - top };
+        return result;
+    }
+
+    Rect unite(const Rect& other) const {
+        if (empty()) {
+            return other;
+        }
+        if (other.empty()) {
+            return *this;
+        }
+        int left = x < other.x ? x : other.x;
+        int top = y < other.y ? y : other.y;
+        int right = x + w > other.x + other.w ? x + w : other.x + other.w;
+        int bottom = y + h > other.y + other.h ? y + h : other.y + other.h;
+        Rect result = { left, top, right - left, bottom - top };
+        return result;
+    }
+};
+
+// ============================================================================
+// FONT - 3x5 pixels, ASCII 32..90 (lower case is drawn as upper case)
+// ============================================================================
+
+const int FONT_WIDTH = 3;
+const int FONT_HEIGHT = 5;
+const int FONT_ADVANCE = 4;
+
+// Five rows of three bits, top row in bits 14..12, left column first
+const uint16_t FONT_3X5[59] = {
+    0x0000, 0x2482, 0x0000, 0x0000, 0x0000, 0x52A5, 0x0000, 0x0000,  //   ! " # $ % & '
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x01C0, 0x0002, 0x12A4,  // ( ) * + , - . /
+    0x7B6F, 0x2C97, 0x73E7, 0x73CF, 0x5BC9, 0x79CF, 0x79EF, 0x7292,  // 0 1 2 3 4 5 6 7
+    0x7BEF, 0x7BCF, 0x0410, 0x0000, 0x0000, 0x0000, 0x0000, 0x72C2,  // 8 9 : ; < = > ?
+    0x0000, 0x2BED, 0x6BAE, 0x3923, 0x6B6E, 0x79A7, 0x79A4, 0x396B,  // @ A B C D E F G
+    0x5BED, 0x7497, 0x126A, 0x5BAD, 0x4927, 0x5FED, 0x6B6D, 0x2B6A,  // H I J K L M N O
+    0x6BA4, 0x2B73, 0x6BAD, 0x388E, 0x7492, 0x5B6F, 0x5B6A, 0x5BFD,  // P Q R S T U V W
+    0x5AAD, 0x5A92, 0x72A7                                           // X Y Z
+};
+
+inline uint16_t fontGlyph(char c) {
+    if (c >= 'a' && c <= 'z') {
+        c = (char)(c - 'a' + 'A');
+    }
+    return c >= 32 && c <= 90 ? FONT_3X5[c - 32] : 0;
+}
+
+inline int textWidth(const char* text, int scale) {
+    int length = (int)strlen(text);
+    return length > 0 ? (length * FONT_ADVANCE - 1) * scale : 0;
+}
+
+// Text with its top-left corner at (x, y), only pixels inside clip
+inline void drawString(Canvas& canvas, const Rect& clip, int x, int y, const char* text, int scale,
+                       const uint8_t* color) {
+    for (; *text; text++, x += FONT_ADVANCE * scale) {
+        if (x >= clip.x + clip.w) {
+            return;
+        }
+        if (x + FONT_WIDTH * scale <= clip.x) {
+            continue;
+        }
+        uint16_t glyph = fontGlyph(*text);
+        for (int row = 0; row < FONT_HEIGHT; row++) {
+            for (int col = 0; col < FONT_WIDTH; col++) {
+                if (!(glyph & (1u << (14 - row * 3 - col)))) {
+                    continue;
+                }
+                Rect dot = { x + col * scale, y + row * scale, scale, scale };
+                Rect visible = dot.intersect(clip);
+                canvas.fillRect(visible.x, visible.y, visible.w, visible.h, color[0], color[1], color[2]);
+            }
+        }
+    }
+}
+
+// ============================================================================
+// NODES
+// ============================================================================
+
+class SceneNode {
+private:
+    Rect drawnArea;  // Area at the last draw, damaged when the node moves
+    bool invalid;
+
+    friend class SceneGraph;
+
+protected:
+    Rect bounds;
+
+public:
+    explicit SceneNode(const Rect& area) : invalid(true), bounds(area) {
+        drawnArea = area;
+    }
+    virtual ~SceneNode() {}
+
+    // Bring the content to time nowMs; true if what draw() shows changed
+    virtual bool advance(uint32_t nowMs) {
+        (void)nowMs;
+        return false;
+    }
+
+    // Draw the part of the node inside clip, which is already cleared to the
+    // background and lies within the node's bounds
+    virtual void draw(Canvas& canvas, const Rect& clip) const = 0;
+
+    void invalidate() { invalid = true; }
+
+    void moveTo(int x, int y) {
+        bounds.x = x;
+        bounds.y = y;
+        invalid = true;
+    }
+
+    const Rect& area() const { return bounds; }
+};
+
+// Static text, redrawn only when it is replaced
+class TextNode : public SceneNode {
+private:
+    char text[SCENE_TEXT_SIZE];
+    int scale;
+    uint8_t color[3];
+
+public:
+    TextNode(const Rect& area, const char* content, int textScale, uint8_t r, uint8_t g, uint8_t b)
+        : SceneNode(area), scale(textScale) {
+        color[0] = r;
+        color[1] = g;
+        color[2] = b;
+        text[0] = '\0';
+        setText(content);
+    }
+
+    void setText(const char* content) {
+        if (strncmp(text, content, sizeof(text) - 1) == 0 && text[0] != '\0') {
+            return;
+        }
+        strncpy(text, content, sizeof(text) - 1);
+        text[sizeof(text) - 1] = '\0';
+        invalidate();
+    }
+
+    void draw(Canvas& canvas, const Rect& clip) const override {
+        drawString(canvas, clip, bounds.x, bounds.y, text, scale, color);
+    }
+};
+
+// HH:MM:SS of local time; changes once per second
+class ClockNode : public SceneNode {
+private:
+    int64_t epochMs;       // Unix time at nowMs == 0
+    int32_t utcOffset;     // Seconds east of UTC
+    int64_t shownSecond;
+    char text[9];
+    int scale;
+    uint8_t color[3];
+
+public:
+    ClockNode(const Rect& area, int64_t unixMsAtZero, int32_t utcOffsetSeconds, int textScale,
+              uint8_t r, uint8_t g, uint8_t b)
+        : SceneNode(area), epochMs(unixMsAtZero), utcOffset(utcOffsetSeconds), shownSecond(-1), scale(textScale) {
+        color[0] = r;
+        color[1] = g;
+        color[2] = b;
+        text[0] = '\0';
+    }
+
+    bool advance(uint32_t nowMs) override {
+        int64_t second = (epochMs + nowMs) / 1000 + utcOffset;
+        if (second == shownSecond) {
+            return false;
+        }
+        shownSecond = second;
+        int daySecond = (int)(second % 86400);
+        int fields[3] = { daySecond / 3600, daySecond / 60 % 60, daySecond % 60 };
+        for (int i = 0; i < 3; i++) {
+            text[i * 3] = (char)('0' + fields[i] / 10);
+            text[i * 3 + 1] = (char)('0' + fields[i] % 10);
+            text[i * 3 + 2] = i < 2 ? ':' : '\0';
+        }
+        return true;
+    }
+
+    void draw(Canvas& canvas, const Rect& clip) const override {
+        drawString(canvas, clip, bounds.x, bounds.y, text, scale, color);
+    }
+};
+
+// Text scrolling right to left through its bounds at a fixed speed
+class TickerNode : public SceneNode {
+private:
+    char text[SCENE_TEXT_SIZE];
+    int pixelsPerSecond;
+    int offset;            // Pixels scrolled, -1 before the first frame
+    uint8_t color[3];
+
+public:
+    TickerNode(const Rect& area, const char* content, int speed, uint8_t r, uint8_t g, uint8_t b)
+        : SceneNode(area), pixelsPerSecond(speed), offset(-1) {
+        color[0] = r;
+        color[1] = g;
+        color[2] = b;
+        strncpy(text, content, sizeof(text) - 1);
+        text[sizeof(text) - 1] = '\0';
+    }
+
+    bool advance(uint32_t nowMs) override {
+        int cycle = bounds.w + textWidth(text, 1);
+        int position = (int)((uint64_t)nowMs * (uint32_t)pixelsPerSecond / 1000 % (uint32_t)cycle);
+        if (position == offset) {
+            return false;
+        }
+        offset = position;
+        return true;
+    }
+
+    void draw(Canvas& canvas, const Rect& clip) const override {
+        int y = bounds.y + (bounds.h - FONT_HEIGHT) / 2;
+        drawString(canvas, clip, bounds.x + bounds.w - offset, y, text, 1, color);
+    }
+};
+
+// RGB image (row-major, 3 bytes per pixel, bounds.w x bounds.h) owned by the caller
+class ImageNode : public SceneNode {
+private:
+    const uint8_t* pixels;
+
+public:
+    ImageNode(const Rect& area, const uint8_t* rgb) : SceneNode(area), pixels(rgb) {}
+
+    // New content (or the same buffer rewritten)
+    void setImage(const uint8_t* rgb) {
+        pixels = rgb;
+        invalidate();
+    }
+
+    void draw(Canvas& canvas, const Rect& clip) const override {
+        if (!pixels) {
+            return;
+        }
+        for (int y = clip.y; y < clip.y + clip.h; y++) {
+            const uint8_t* source = pixels + ((size_t)(y - bounds.y) * bounds.w + (clip.x - bounds.x)) * 3;
+            memcpy(canvas.row(y) + (size_t)clip.x * 3, source, (size_t)clip.w * 3);
+        }
+    }
+};
+
+// ============================================================================
+// SCENE
+// ============================================================================
+
+class SceneGraph {
+private:
+    MatrixConfig config;
+    SceneNode* nodes[SCENE_MAX_NODES];
+    int nodeCount;
+    Rect damage[SCENE_MAX_DAMAGE];
+    int damageCount;
+    uint8_t background[3];
+    bool everything;
+
+    void addDamage(const Rect& area) {
+        Rect screen = { 0, 0, config.width(), config.height() };
+        Rect clipped = area.intersect(screen);
+        if (clipped.empty()) {
+            return;
+        }
+        for (int i = 0; i < damageCount; i++) {
+            if (damage[i].overlaps(clipped)) {
+                damage[i] = damage[i].unite(clipped);
+                return;
+            }
+        }
+        if (damageCount == SCENE_MAX_DAMAGE) {
+            damage[damageCount - 1] = damage[damageCount - 1].unite(clipped);
+            return;
+        }
+        damage[damageCount++] = clipped;
+    }
+
+public:
+    unsigned long renders;       // render() calls that drew something
+    unsigned long nodesDrawn;    // Node draws, one per node and damaged rectangle
+    unsigned long pixelsDrawn;   // Pixels cleared and redrawn
+
+    explicit SceneGraph(const MatrixConfig& cfg)
+        : config(cfg), nodeCount(0), damageCount(0), everything(true), renders(0), nodesDrawn(0), pixelsDrawn(0) {
+        background[0] = background[1] = background[2] = 0;
+    }
+
+    // Nodes are owned by the caller and drawn in the order added
+    bool add(SceneNode* node) {
+        if (nodeCount == SCENE_MAX_NODES) {
+            return false;
+        }
+        nodes[nodeCount++] = node;
+        node->invalidate();
+        return true;
+    }
+
+    void setBackground(uint8_t r, uint8_t g, uint8_t b) {
+        background[0] = r;
+        background[1] = g;
+        background[2] = b;
+        everything = true;
+    }
+
+    // Redraw everything on the next render (new canvas, lost content)
+    void invalidateAll() { everything = true; }
+
+    // Redraw what changed up to nowMs into canvas (config.width() x
+    // config.height(), kept between calls) and add the touched rows to
+    // rowDamage; false if nothing changed
+    bool render(Canvas& canvas, uint32_t nowMs, RowDamage& rowDamage) {
+        AllocScope scope(ALLOC_SCOPE_RENDER);
+        damageCount = 0;
+        if (everything) {
+            Rect screen = { 0, 0, config.width(), config.height() };
+            addDamage(screen);
+            everything = false;
+        }
+        for (int i = 0; i < nodeCount; i++) {
+            SceneNode* node = nodes[i];
+            bool changed = node->advance(nowMs);
+            if (changed || node->invalid) {
+                addDamage(node->drawnArea);
+                addDamage(node->bounds);
+                node->drawnArea = node->bounds;
+                node->invalid = false;
+            }
+        }
+        if (damageCount == 0) {
+            return false;
+        }
+
+        for (int d = 0; d < damageCount; d++) {
+            const Rect& area = damage[d];
+            canvas.fillRect(area.x, area.y, area.w, area.h, background[0], background[1], background[2]);
+            for (int i = 0; i < nodeCount; i++) {
+                Rect clip = nodes[i]->bounds.intersect(area);
+                if (!clip.empty()) {
+                    nodes[i]->draw(canvas, clip);
+                    nodesDrawn++;
+                }
+            }
+            pixelsDrawn += (unsigned long)area.w * area.h;
+            rowDamage.markRows(config, area.y, area.h);
+        }
+        renders++;
+        return true;
+    }
+
+    int damageRects() const { return damageCount; }
+    const Rect& damageRect(int i) const { return damage[i]; }
+};
+
+#endif // SCENE_GRAPH_H
@@ -0,0 +1,463 @@
+/*
+ * Audio spectrum visualizer
+ *
+ * PcmReader          - 16-bit PCM from a WAV file or a raw pipe
+ *                      (arecord -f cd -t raw | ...), downmixed to mono
+ * RealFft            - real FFT of a power-of-two block: a half-size
+ *                      complex radix-2 FFT in split re/im arrays plus the
+ *                      real split step; butterflies are 4-wide with GCC
+ *                      vector extensions (-DHUB75_NO_SIMD for scalar)
+ * SpectrumVisualizer - one frame per hop of audio: Hann window, FFT,
+ *                      log-spaced bands, one bar per few canvas columns,
+ *                      fall-off and peak-hold, drawn straight into a canvas
+ *
+ * Frames are paced by the audio, not by a timer: every hop of
+ * rate / fps samples produces one frame, and frameTimeMs() is the audio
+ * time of its last sample. A pipe is paced by whoever writes it; a file is
+ * played by waiting until each frame's audio time.
+ */
+
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "hub75.h"
+
+const int SPECTRUM_FFT_SIZE = 1024;
+const int SPECTRUM_MAX_BANDS = 256;
+const int PCM_MAX_CHANNELS = 8;
+const int PCM_CHUNK_FRAMES = 256;
+const float SPECTRUM_LOW_HZ = 40.0f;
+const float SPECTRUM_HIGH_HZ = 16000.0f;
+const float SPECTRUM_FLOOR_DB = -70.0f;         // Bottom of the bars
+const float SPECTRUM_BAR_FALL = 1.5f;           // Bar heights per second
+const float SPECTRUM_PEAK_FALL = 0.5f;
+const uint32_t SPECTRUM_PEAK_HOLD_MS = 600;
+
+// ============================================================================
+// PCM READER
+// ============================================================================
+
+class PcmReader {
+private:
+    int fd;
+    bool ownsFd;
+    int channels;
+    uint64_t bytesLeft;     // Of the WAV data chunk; unlimited for raw input
+    int16_t chunk[PCM_CHUNK_FRAMES * PCM_MAX_CHANNELS];
+
+    PcmReader(const PcmReader&);
+    PcmReader& operator=(const PcmReader&);
+
+    // Whole count bytes, or fewer only at the end of input
+    size_t readFully(void* buffer, size_t count) {
+        size_t done = 0;
+        while (done < count) {
+            ssize_t n = ::read(fd, (uint8_t*)buffer + done, count - done);
+            if (n <= 0) {
+                break;
+            }
+            done += (size_t)n;
+        }
+        return done;
+    }
+
+    static uint32_t le32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+    static int le16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+
+public:
+    int sampleRate;
+    const char* error;
+
+    PcmReader() : fd(-1), ownsFd(false), channels(0), bytesLeft(0), sampleRate(0), error(nullptr) {}
+
+    ~PcmReader() { close(); }
+
+    void close() {
+        if (ownsFd && fd >= 0) {
+            ::close(fd);
+        }
+        fd = -1;
+    }
+
+    // Signed 16-bit little-endian frames from an already open descriptor
+    bool openRaw(int descriptor, int rate, int channelCount) {
+        close();
+        if (channelCount < 1 || channelCount > PCM_MAX_CHANNELS || rate <= 0) {
+            error = "unsupported format";
+            return false;
+        }
+        fd = descriptor;
+        ownsFd = false;
+        sampleRate = rate;
+        channels = channelCount;
+        bytesLeft = UINT64_MAX;
+        return true;
+    }
+
+    // 16-bit PCM WAV; other chunks are skipped
+    bool openWav(const char* path) {
+        close();
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        ownsFd = true;
+        uint8_t header[12];
+        if (fd < 0 || readFully(header, 12) != 12 || memcmp(header, "RIFF", 4) != 0 ||
+            memcmp(header + 8, "WAVE", 4) != 0) {
+            error = "not a WAV file";
+            return false;
+        }
+        bool haveFormat = false;
+        for (;;) {
+            uint8_t chunkHeader[8];
+            if (readFully(chunkHeader, 8) != 8) {
+                error = "no data chunk";
+                return false;
+            }
+            uint32_t size = le32(chunkHeader + 4);
+            if (memcmp(chunkHeader, "fmt ", 4) == 0 && size >= 16 && size <= 64) {
+                uint8_t format[64];
+                if (readFully(format, size + (size & 1)) != size + (size & 1)) {
+                    error = "truncated format";
+                    return false;
+                }
+                int tag = le16(format);
+                channels = le16(format + 2);
+                sampleRate = (int)le32(format + 4);
+                int bits = le16(format + 14);
+                if ((tag != 1 && tag != 0xFFFE) || bits != 16 || channels < 1 || channels > PCM_MAX_CHANNELS ||
+                    sampleRate <= 0) {
+                    error = "only 16-bit PCM is supported";
+                    return false;
+                }
+                haveFormat = true;
+            } else if (memcmp(chunkHeader, "data", 4) == 0) {
+                if (!haveFormat) {
+                    error = "data before format";
+                    return false;
+                }
+                bytesLeft = size;
+                return true;
+            } else if (lseek(fd, size + (size & 1), SEEK_CUR) < 0) {
+                error = "cannot skip chunk";
+                return false;
+            }
+        }
+    }
+
+    // Up to frames mono samples in [-1, 1); fewer only at the end
+    int read(float* mono, int frames) {
+        int total = 0;
+        const size_t frameBytes = (size_t)channels * 2;
+        const float scale = 1.0f / (32768.0f * channels);
+        while (total < frames) {
+            int count = frames - total < PCM_CHUNK_FRAMES ? frames - total : PCM_CHUNK_FRAMES;
+            size_t bytes = (size_t)count * frameBytes;
+            if (bytes > bytesLeft) {
+                bytes = (size_t)(bytesLeft / frameBytes * frameBytes);
+            }
+            size_t got = bytes > 0 ? readFully(chunk, bytes) : 0;
+            int whole = (int)(got / frameBytes);
+            bytesLeft -= bytesLeft == UINT64_MAX ? 0 : got;
+            for (int i = 0; i < whole; i++) {
+                int sum = 0;
+                for (int c = 0; c < channels; c++) {
+                    int16_t sample;
+                    memcpy(&sample, (const uint8_t*)chunk + ((size_t)i * channels + c) * 2, 2);  // Little-endian host
+                    sum += sample;
+                }
+                mono[total + i] = (float)sum * scale;
+            }
+            total += whole;
+            if (whole < count) {
+                break;
+            }
+        }
+        return total;
+    }
+};
+
+// ============================================================================
+// REAL FFT
+// ============================================================================
+
+#ifndef HUB75_NO_SIMD
+typedef float FftVector __attribute__((vector_size(16)));
+
+inline FftVector fftLoad(const float* p) {
+    FftVector v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline void fftStore(float* p, FftVector v) {
+    memcpy(p, &v, sizeof(v));
+}
+#endif
+
+class RealFft {
+private:
+    int size;               // Real samples
+    int half;               // Complex points
+    float* re;
+    float* im;
+    float* twiddleRe;       // Stage by stage: stage with span s holds s entries
+    float* twiddleIm;
+    float* splitRe;         // exp(-2 pi i k / size) for the real split
+    float* splitIm;
+    uint16_t* reversed;
+
+    RealFft(const RealFft&);
+    RealFft& operator=(const RealFft&);
+
+    void transform() {
+        for (int i = 0; i < half; i++) {
+            int j = reversed[i];
+            if (j > i) {
+                float t = re[i];
+                re[i] = re[j];
+                re[j] = t;
+                t = im[i];
+                im[i] = im[j];
+                im[j] = t;
+            }
+        }
+        const float* wRe = twiddleRe;
+        const float* wIm = twiddleIm;
+        for (int span = 1; span < half; wRe += span, wIm += span, span *= 2) {
+            for (int start = 0; start < half; start += 2 * span) {
+                float* aRe = re + start;
+                float* aIm = im + start;
+                float* bRe = aRe + span;
+                float* bIm = aIm + span;
+                int j = 0;
+#ifndef HUB75_NO_SIMD
+                for (; j + 4 <= span; j += 4) {
+                    FftVector cRe = fftLoad(wRe + j), cIm = fftLoad(wIm + j);
+                    FftVector xRe = fftLoad(bRe + j), xIm = fftLoad(bIm + j);
+                    FftVector tRe = xRe * cRe - xIm * cIm;
+                    FftVector tIm = xRe * cIm + xIm * cRe;
+                    FftVector uRe = fftLoad(aRe + j), uIm = fftLoad(aIm + j);
+                    fftStore(aRe + j, uRe + tRe);
+                    fftStore(aIm + j, uIm + tIm);
+                    fftStore(bRe + j, uRe - tRe);
+                    fftStore(bIm + j, uIm - tIm);
+                }
+#endif
+                for (; j < span; j++) {
+                    float tRe = bRe[j] * wRe[j] - bIm[j] * wIm[j];
+                    float tIm = bRe[j] * wIm[j] + bIm[j] * wRe[j];
+                    bRe[j] = aRe[j] - tRe;
+                    bIm[j] = aIm[j] - tIm;
+                    aRe[j] += tRe;
+                    aIm[j] += tIm;
+                }
+            }
+        }
+    }
+
+public:
+    explicit RealFft(int samples)
+        : size(samples), half(samples / 2), re(new float[(size_t)samples / 2]), im(new float[(size_t)samples / 2]),
+          twiddleRe(new float[(size_t)samples / 2]), twiddleIm(new float[(size_t)samples / 2]),
+          splitRe(new float[(size_t)samples / 2]), splitIm(new float[(size_t)samples / 2]),
+          reversed(new uint16_t[(size_t)samples / 2]) {
+        int bits = 0;
+        while ((1 << bits) < half) {
+            bits++;
+        }
+        for (int i = 0; i < half; i++) {
+            int r = 0;
+            for (int b = 0; b < bits; b++) {
+                r |= ((i >> b) & 1) << (bits - 1 - b);
+            }
+            reversed[i] = (uint16_t)r;
+        }
+        float* wRe = twiddleRe;
+        float* wIm = twiddleIm;
+        for (int span = 1; span < half; wRe += span, wIm += span, span *= 2) {
+            for (int j = 0; j < span; j++) {
+                double angle = -M_PI * j / span;
+                wRe[j] = (float)cos(angle);
+                wIm[j] = (float)sin(angle);
+            }
+        }
+        for (int k = 0; k < half; k++) {
+            double angle = -2.0 * M_PI * k / size;
+            splitRe[k] = (float)cos(angle);
+            splitIm[k] = (float)sin(angle);
+        }
+    }
+
+    ~RealFft() {
+        delete[] re;
+        delete[] im;
+        delete[] twiddleRe;
+        delete[] twiddleIm;
+        delete[] splitRe;
+        delete[] splitIm;
+        delete[] reversed;
+    }
+
+    int samples() const { return size; }
+
+    // Power |X[k]|^2 of bins 0 .. size/2 - 1 of size real samples
+    void power(const float* input, float* out) {
+        for (int i = 0; i < half; i++) {
+            re[i] = input[2 * i];
+            im[i] = input[2 * i + 1];
+        }
+        transform();
+
+        // X[k] = (Z[k] + conj Z[h-k]) / 2 + W^k (Z[k] - conj Z[h-k]) / 2i
+        for (int k = 0; k < half; k++) {
+            int m = k == 0 ? 0 : half - k;
+            float evenRe = 0.5f * (re[k] + re[m]);
+            float evenIm = 0.5f * (im[k] - im[m]);
+            float oddRe = 0.5f * (im[k] + im[m]);
+            float oddIm = -0.5f * (re[k] - re[m]);
+            float xRe = evenRe + splitRe[k] * oddRe - splitIm[k] * oddIm;
+            float xIm = evenIm + splitRe[k] * oddIm + splitIm[k] * oddRe;
+            out[k] = xRe * xRe + xIm * xIm;
+        }
+    }
+};
+
+// ============================================================================
+// SPECTRUM VISUALIZER
+// ============================================================================
+
+class SpectrumVisualizer {
+private:
+    RealFft fft;
+    int rate;
+    int hop;                // Samples per frame
+    float frameSeconds;
+    int bandCount;
+    int barWidth;
+    int bandStart[SPECTRUM_MAX_BANDS + 1];  // FFT bin ranges
+    float bars[SPECTRUM_MAX_BANDS];         // 0..1
+    float peaks[SPECTRUM_MAX_BANDS];
+    uint32_t peakAgeMs[SPECTRUM_MAX_BANDS];
+    float history[SPECTRUM_FFT_SIZE];       // Last FFT-size samples
+    float window[SPECTRUM_FFT_SIZE];
+    float windowed[SPECTRUM_FFT_SIZE];
+    float powers[SPECTRUM_FFT_SIZE / 2];
+    float fullScale;                        // Power of a full-scale sine's bin
+    uint64_t samplesIn;
+
+    SpectrumVisualizer(const SpectrumVisualizer&);
+    SpectrumVisualizer& operator=(const SpectrumVisualizer&);
+
+public:
+    unsigned long frames;
+
+    // One bar every barPixels columns of a canvas width wide, fps frames a second
+    SpectrumVisualizer(int sampleRate, int fps, int width, int barPixels)
+        : fft(SPECTRUM_FFT_SIZE), rate(sampleRate), hop(fps > 0 && sampleRate / fps > 0 ? sampleRate / fps : 1),
+          barWidth(barPixels), samplesIn(0), frames(0) {
+        frameSeconds = (float)hop / (float)rate;
+        bandCount = width / barPixels;
+        bandCount = bandCount < SPECTRUM_MAX_BANDS ? bandCount : SPECTRUM_MAX_BANDS;
+        float high = SPECTRUM_HIGH_HZ < rate * 0.5f ? SPECTRUM_HIGH_HZ : rate * 0.5f;
+        float binHz = (float)rate / SPECTRUM_FFT_SIZE;
+        for (int b = 0; b <= bandCount; b++) {
+            float hz = SPECTRUM_LOW_HZ * powf(high / SPECTRUM_LOW_HZ, (float)b / bandCount);
+            int bin = (int)(hz / binHz + 0.5f);
+            bin = b > 0 && bin <= bandStart[b - 1] ? bandStart[b - 1] + 1 : bin;  // At least one bin each
+            bin = bin < 1 ? 1 : bin;
+            bandStart[b] = bin < SPECTRUM_FFT_SIZE / 2 ? bin : SPECTRUM_FFT_SIZE / 2;
+        }
+        for (int i = 0; i < SPECTRUM_FFT_SIZE; i++) {
+            window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / SPECTRUM_FFT_SIZE);
+            history[i] = 0.0f;
+        }
+        for (int b = 0; b < bandCount; b++) {
+            bars[b] = 0.0f;
+            peaks[b] = 0.0f;
+            peakAgeMs[b] = 0;
+        }
+        fullScale = (SPECTRUM_FFT_SIZE / 4.0f) * (SPECTRUM_FFT_SIZE / 4.0f);
+    }
+
+    int hopSamples() const { return hop; }
+    int bands() const { return bandCount; }
+    float bar(int band) const { return bars[band]; }
+    float peak(int band) const { return peaks[band]; }
+
+    // Band whose range holds hz, -1 outside the shown range
+    int bandOf(float hz) const {
+        int bin = (int)(hz * SPECTRUM_FFT_SIZE / rate + 0.5f);
+        for (int b = 0; b < bandCount; b++) {
+            if (bin >= bandStart[b] && bin < bandStart[b + 1]) {
+                return b;
+            }
+        }
+        return -1;
+    }
+
+    // Audio time of the last analysed sample
+    uint32_t frameTimeMs() const { return (uint32_t)(samplesIn * 1000 / (uint64_t)rate); }
+
+    // Feed hopSamples() new samples and update the bars; of a hop longer
+    // than the FFT only the last FFT-size samples are analysed
+    void analyze(const float* samples) {
+        if (hop < SPECTRUM_FFT_SIZE) {
+            memmove(history, history + hop, sizeof(float) * (SPECTRUM_FFT_SIZE - hop));
+            memcpy(history + SPECTRUM_FFT_SIZE - hop, samples, sizeof(float) * hop);
+        } else {
+            memcpy(history, samples + hop - SPECTRUM_FFT_SIZE, sizeof(float) * SPECTRUM_FFT_SIZE);
+        }
+        samplesIn += (uint64_t)hop;
+        for (int i = 0; i < SPECTRUM_FFT_SIZE; i++) {
+            windowed[i] = history[i] * window[i];
+        }
+        fft.power(windowed, powers);
+
+        const float fall = SPECTRUM_BAR_FALL * frameSeconds;
+        const float peakFall = SPECTRUM_PEAK_FALL * frameSeconds;
+        const uint32_t stepMs = (uint32_t)(frameSeconds * 1000.0f + 0.5f);
+        for (int b = 0; b < bandCount; b++) {
+            float loudest = 0.0f;
+            for (int k = bandStart[b]; k < bandStart[b + 1]; k++) {
+                loudest = powers[k] > loudest ? powers[k] : loudest;  // A tone is full height in any band
+            }
+            float db = 10.0f * log10f(loudest / fullScale + 1e-12f);
+            float level = 1.0f - db / SPECTRUM_FLOOR_DB;
+            level = level < 0.0f ? 0.0f : level > 1.0f ? 1.0f : level;
+
+            bars[b] = level > bars[b] - fall ? level : bars[b] - fall;
+            if (bars[b] >= peaks[b]) {
+                peaks[b] = bars[b];
+                peakAgeMs[b] = 0;
+            } else if ((peakAgeMs[b] += stepMs) > SPECTRUM_PEAK_HOLD_MS) {
+                peaks[b] = peaks[b] - peakFall > bars[b] ? peaks[b] - peakFall : bars[b];
+            }
+        }
+        frames++;
+    }
+
+    // Bars green to red from the bottom, white peak markers
+    void render(Canvas& canvas) const {
+        const int height = canvas.height();
+        canvas.fillRect(0, 0, canvas.width(), height, 0, 0, 0);
+        for (int b = 0; b < bandCount; b++) {
+            int x = b * barWidth;
+            int w = barWidth > 1 ? barWidth - 1 : 1;
+            int top = height - (int)(bars[b] * height + 0.5f);
+            for (int y = top; y < height; y++) {
+                int up = (height - 1 - y) * 511 / (height > 1 ? height - 1 : 1);
+                canvas.fillRect(x, y, w, 1, (uint8_t)(up < 256 ? up : 255), (uint8_t)(up < 256 ? 255 : 511 - up), 0);
+            }
+            int peakY = height - 1 - (int)(peaks[b] * (height - 1) + 0.5f);
+            if (peaks[b] > 0.0f) {
+                canvas.fillRect(x, peakY, w, 1, 255, 255, 255);
+            }
+        }
+    }
+};
+
+#endif // SPECTRUM_H
@@ -0,0 +1,390 @@
+/*
+ * Local stats socket
+ *
+ * A Unix stream socket that answers every connection with a text snapshot
+ * of the registered counters, one "name.key value" line each, and closes:
+ *
+ *     socat - UNIX-CONNECT:/tmp/hub75.stats
+ *
+ * The server runs on its own thread blocked in accept(), so the render and
+ * tick loops never make a syscall for it. Sources are objects with a
+ * report(StatsReport&, name) member; they read relaxed atomics or values
+ * that are fine to see slightly stale, never locks of the hot paths.
+ *
+ * Queries: sources registered with addQuery() answer a request line
+ * instead, streamed in chunks so answers can be any size:
+ *
+ *     echo "history seconds 600" | socat - UNIX-CONNECT:/tmp/led.stats
+ *
+ * With queries registered the server waits up to STATS_QUERY_WAIT_MS for a
+ * request; a client that sends nothing (or shuts down its write side, as
+ * statsQuery() does) gets the snapshot.
+ *
+ * One thread serves every client in turn, so a client that stops reading
+ * may hold it for at most STATS_SEND_TIMEOUT_MS per write before it is
+ * dropped (counted as stats.dropped).
+ */
+
+#ifndef STATS_SOCKET_H
+#define STATS_SOCKET_H
+
+#include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+const int STATS_NAME_SIZE = 48;
+const int STATS_MAX_SOURCES = 16;
+const size_t STATS_REPORT_SIZE = 8192;
+const int STATS_MAX_QUERIES = 4;
+const int STATS_QUERY_WAIT_MS = 20;
+const size_t STATS_REQUEST_SIZE = 128;
+const int STATS_SEND_TIMEOUT_MS = 200;
+
+// "base.index", e.g. one name per worker
+inline void statsName(char* out, const char* base, int index) {
+    size_t length = strlen(base);
+    if (length > (size_t)STATS_NAME_SIZE - 5) {
+        length = (size_t)STATS_NAME_SIZE - 5;
+    }
+    memcpy(out, base, length);
+    out[length++] = '.';
+    if (index >= 10) {
+        out[length++] = (char)('0' + index / 10 % 10);
+    }
+    out[length++] = (char)('0' + index % 10);
+    out[length] = '\0';
+}
+
+class StatsReport {
+private:
+    char text[STATS_REPORT_SIZE];
+    size_t length;
+
+    void append(const char* s) {
+        while (*s && length < sizeof(text)) {
+            text[length++] = *s++;
+        }
+    }
+
+public:
+    StatsReport() : length(0) {}
+
+    void clear() { length = 0; }
+
+    void add(const char* name, const char* key, unsigned long value) {
+        char digits[24];
+        int count = 0;
+        do {
+            digits[count++] = (char)('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        // Drop lines that do not fit whole
+        if (length + strlen(name) + strlen(key) + (size_t)count + 3 > sizeof(text)) {
+            return;
+        }
+        append(name);
+        append(".");
+        append(key);
+        append(" ");
+        while (count > 0) {
+            text[length++] = digits[--count];
+        }
+        text[length++] = '\n';
+    }
+
+    const char* data() const { return text; }
+    size_t size() const { return length; }
+};
+
+// Answer of a query, sent to the client whenever the buffer fills
+class StatsStream {
+private:
+    int fd;
+    char buffer[4096];
+    size_t length;
+    bool failed;
+
+public:
+    explicit StatsStream(int client) : fd(client), length(0), failed(false) {}
+    ~StatsStream() { flush(); }
+
+    void flush() {
+        size_t sent = 0;
+        while (!failed && sent < length) {
+            ssize_t n = send(fd, buffer + sent, length - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                failed = true;
+                break;
+            }
+            sent += (size_t)n;
+        }
+        length = 0;
+    }
+
+    void append(char c) {
+        if (length == sizeof(buffer)) {
+            flush();
+        }
+        buffer[length++] = c;
+    }
+
+    void append(const char* text) {
+        while (*text) {
+            append(*text++);
+        }
+    }
+
+    void appendUnsigned(unsigned long value) {
+        char digits[24];
+        int count = 0;
+        do {
+            digits[count++] = (char)('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (count > 0) {
+            append(digits[--count]);
+        }
+    }
+
+    // Client gone; producers may stop early
+    bool closed() const { return failed; }
+};
+
+class StatsServer {
+private:
+    struct Source {
+        const char* name;
+        const void* object;
+        void (*report)(const void* object, StatsReport& out, const char* name);
+    };
+
+    struct Query {
+        const char* name;
+        const void* object;
+        void (*answer)(const void* object, StatsStream& out, const char* argument);
+    };
+
+    template <class T>
+    static void reportSource(const void* object, StatsReport& out, const char* name) {
+        ((const T*)object)->report(out, name);
+    }
+
+    template <class T>
+    static void answerQuery(const void* object, StatsStream& out, const char* argument) {
+        ((const T*)object)->query(out, argument);
+    }
+
+    // Request line "name argument", if the client sent one in time;
+    // sendFailed when the client stopped reading the answer
+    bool answered(int client, bool& sendFailed) {
+        if (queryCount == 0) {
+            return false;
+        }
+        struct pollfd wait = { client, POLLIN, 0 };
+        if (poll(&wait, 1, STATS_QUERY_WAIT_MS) <= 0) {
+            return false;
+        }
+        char request[STATS_REQUEST_SIZE];
+        ssize_t n = recv(client, request, sizeof(request) - 1, 0);
+        if (n <= 0) {
+            return false;
+        }
+        request[n] = '\0';
+        for (char* p = request; *p; p++) {
+            if (*p == '\r' || *p == '\n') {
+                *p = '\0';
+                break;
+            }
+        }
+        char* argument = request;
+        while (*argument && *argument != ' ') {
+            argument++;
+        }
+        if (*argument) {
+            *argument++ = '\0';
+        }
+        for (int i = 0; i < queryCount; i++) {
+            if (strcmp(queries[i].name, request) == 0) {
+                StatsStream out(client);
+                queries[i].answer(queries[i].object, out, argument);
+                out.flush();
+                sendFailed = out.closed();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void* serverThread(void* arg) {
+        StatsServer* self = (StatsServer*)arg;
+        for (;;) {
+            int client = accept4(self->listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0) {
+                if (self->stopping) {
+                    return nullptr;
+                }
+                continue;
+            }
+            struct timeval timeout = { STATS_SEND_TIMEOUT_MS / 1000, (STATS_SEND_TIMEOUT_MS % 1000) * 1000 };
+            setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            bool sendFailed = false;
+            if (self->answered(client, sendFailed)) {
+                self->requests++;
+                self->dropped += sendFailed;
+                close(client);
+                continue;
+            }
+            StatsReport& report = self->report;
+            report.clear();
+            for (int i = 0; i < self->sourceCount; i++) {
+                self->sources[i].report(self->sources[i].object, report, self->sources[i].name);
+            }
+            self->requests++;
+            report.add("stats", "requests", self->requests);
+            report.add("stats", "dropped", self->dropped);
+            size_t sent = 0;
+            while (sent < report.size()) {
+                ssize_t n = send(client, report.data() + sent, report.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0) {
+                    self->dropped++;
+                    break;
+                }
+                sent += (size_t)n;
+            }
+            close(client);
+        }
+    }
+
+    Source sources[STATS_MAX_SOURCES];
+    int sourceCount;
+    Query queries[STATS_MAX_QUERIES];
+    int queryCount;
+    StatsReport report;
+    int listenFd;
+    struct sockaddr_un address;
+    pthread_t thread;
+    bool threadStarted;
+    volatile bool stopping;
+    unsigned long requests;
+    unsigned long dropped;          // Clients that stopped reading
+
+    StatsServer(const StatsServer&);
+    StatsServer& operator=(const StatsServer&);
+
+public:
+    StatsServer() : sourceCount(0), queryCount(0), listenFd(-1), threadStarted(false), stopping(false), requests(0),
+                    dropped(0) {}
+
+    ~StatsServer() { stop(); }
+
+    // Register before start(); object must outlive the server
+    template <class T>
+    bool add(const T& object, const char* name) {
+        if (sourceCount >= STATS_MAX_SOURCES) {
+            return false;
+        }
+        sources[sourceCount].name = name;
+        sources[sourceCount].object = &object;
+        sources[sourceCount].report = reportSource<T>;
+        sourceCount++;
+        return true;
+    }
+
+    // Register before start(); object.query(StatsStream&, argument) answers
+    // requests starting with name
+    template <class T>
+    bool addQuery(const T& object, const char* name) {
+        if (queryCount >= STATS_MAX_QUERIES) {
+            return false;
+        }
+        queries[queryCount].name = name;
+        queries[queryCount].object = &object;
+        queries[queryCount].answer = answerQuery<T>;
+        queryCount++;
+        return true;
+    }
+
+    // Bind path (a stale socket file is replaced) and serve from a thread
+    bool start(const char* path) {
+        if (strlen(path) >= sizeof(address.sun_path)) {
+            return false;
+        }
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, path);
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) {
+            return false;
+        }
+        unlink(path);
+        if (bind(listenFd, (const struct sockaddr*)&address, sizeof(address)) != 0 || listen(listenFd, 4) != 0) {
+            close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        stopping = false;
+        threadStarted = pthread_create(&thread, nullptr, serverThread, this) == 0;
+        return threadStarted;
+    }
+
+    void stop() {
+        if (listenFd < 0) {
+            return;
+        }
+        stopping = true;
+        shutdown(listenFd, SHUT_RDWR);  // Wakes the blocked accept()
+        if (threadStarted) {
+            pthread_join(thread, nullptr);
+            threadStarted = false;
+        }
+        close(listenFd);
+        listenFd = -1;
+        unlink(address.sun_path);
+    }
+};
+
+// Client side: send request (a line, or nullptr for the snapshot) and read
+// the answer into buffer (NUL terminated, truncated to size), false on error
+inline bool statsRequest(const char* path, const char* request, char* buffer, size_t size, size_t& length) {
+    struct sockaddr_un address;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        return false;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    if (connect(fd, (const struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return false;
+    }
+    if (request && send(fd, request, strlen(request), MSG_NOSIGNAL) != (ssize_t)strlen(request)) {
+        close(fd);
+        return false;
+    }
+    shutdown(fd, SHUT_WR);
+    length = 0;
+    ssize_t n;
+    while (length + 1 < size && (n = read(fd, buffer + length, size - 1 - length)) > 0) {
+        length += (size_t)n;
+    }
+    buffer[length] = '\0';
+    close(fd);
+    return true;
+}
+
+// Client side: read one snapshot
+inline bool statsQuery(const char* path, char* buffer, size_t size, size_t& length) {
+    return statsRequest(path, nullptr, buffer, size, length);
+}
+
+#endif // STATS_SOCKET_H
@@ -0,0 +1,752 @@
+/*
+ * Video playback as a pipeline of decode, scale and convert stages
+ *
+ *   decode thread    Source::decode() into a YUV 4:2:0 picture
+ *   scale thread     area-average down to the canvas, BT.601 to RGB
+ *   convert thread   BitplaneFrame::build()
+ *   scan thread      frameAt(nowMs) before every refresh, by timestamp
+ *
+ * Each stage runs on its own thread (optionally pinned to a core) and hands
+ * buffers on through bounded single-producer single-consumer queues; every
+ * consumer sends the buffer back through a second queue when it is done, so
+ * the pictures, canvases and bitplane frames allocated at start are
+ * recycled for the whole clip. A stage that finds its input empty or its
+ * free queue exhausted yields and then naps; nothing ever blocks the scan
+ * thread, it keeps the last frame until the next one is due.
+ *
+ * Every buffer carries its stage timestamps, so each stage's service time
+ * (its throughput limit) and queueing delay, and the end-to-end latency,
+ * are measured on the real clip.
+ *
+ * Sources provide width(), height(), decode(VideoPicture&) (false at the
+ * end of the clip) and rewind(). LibavSource needs -DHUB75_LIBAV and
+ * -lavformat -lavcodec -lavutil; SyntheticVideoSource needs nothing.
+ */
+
+#ifndef VIDEO_PIPELINE_H
+#define VIDEO_PIPELINE_H
+
+#include <atomic>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "allocGuard.h"
+#include "hub75.h"
+#include "leanIo.h"
+#include "statsSocket.h"
+
+#ifdef HUB75_LIBAV
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+#endif
+
+const int VIDEO_QUEUE_SIZE = 4;        // Power of two, at least every pool below
+const int VIDEO_PICTURES = 3;
+const int VIDEO_CANVASES = 3;
+const int VIDEO_FRAMES = 4;            // Shown, due next, being built, spare
+const int VIDEO_IDLE_SPINS = 64;       // Yields before napping
+const uint32_t VIDEO_IDLE_NAP_US = 200;
+
+enum VideoStamp {
+    STAMP_DECODE_START,
+    STAMP_DECODED,
+    STAMP_SCALE_START,
+    STAMP_SCALED,
+    STAMP_CONVERT_START,
+    STAMP_CONVERTED,
+    STAMP_SHOWN,
+    VIDEO_STAMPS
+};
+
+// ============================================================================
+// SPSC QUEUE - bounded, lock-free, one producer and one consumer thread
+// ============================================================================
+
+template <class T, int N>
+class SpscQueue {
+private:
+    static_assert((N & (N - 1)) == 0, "queue size must be a power of two");
+
+    T* slots[N];
+    alignas(64) std::atomic<uint32_t> head;  // Next to pop, written by the consumer
+    alignas(64) std::atomic<uint32_t> tail;  // Next to push, written by the producer
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    bool push(T* item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == (uint32_t)N) {
+            return false;
+        }
+        slots[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    T* peek() const {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return slots[h & (N - 1)];
+    }
+
+    T* pop() {
+        T* item = peek();
+        if (item) {
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        return item;
+    }
+};
+
+// ============================================================================
+// BUFFERS
+// ============================================================================
+
+struct VideoPicture {
+    int width;
+    int height;
+    uint8_t* planes[3];     // Y, U, V; chroma at half resolution
+    int strides[3];
+    uint32_t ptsMs;
+    uint64_t stamps[VIDEO_STAMPS];
+
+    VideoPicture(int w, int h) : width(w), height(h), ptsMs(0) {
+        strides[0] = (w + 15) & ~15;
+        strides[1] = strides[2] = ((w + 1) / 2 + 15) & ~15;
+        planes[0] = new uint8_t[(size_t)strides[0] * h];
+        planes[1] = new uint8_t[(size_t)strides[1] * ((h + 1) / 2)];
+        planes[2] = new uint8_t[(size_t)strides[2] * ((h + 1) / 2)];
+    }
+
+    ~VideoPicture() {
+        for (int i = 0; i < 3; i++) {
+            delete[] planes[i];
+        }
+    }
+};
+
+struct VideoCanvas {
+    Canvas canvas;
+    uint32_t ptsMs;
+    uint64_t stamps[VIDEO_STAMPS];
+
+    VideoCanvas(int w, int h) : canvas(w, h), ptsMs(0) {}
+};
+
+struct VideoBitplanes {
+    BitplaneFrame frame;
+    uint32_t ptsMs;
+    uint64_t stamps[VIDEO_STAMPS];
+
+    explicit VideoBitplanes(const MatrixConfig& config) : frame(config), ptsMs(0) { frame.plan(); }
+};
+
+// Per-stage timing; written by the stage's thread, read from anywhere
+struct VideoStageStats {
+    std::atomic<unsigned long> frames;
+    std::atomic<uint64_t> serviceNs;    // Time spent working
+    std::atomic<uint64_t> worstNs;
+    std::atomic<uint64_t> waitNs;       // Time the output waited for the next stage
+
+    VideoStageStats() : frames(0), serviceNs(0), worstNs(0), waitNs(0) {}
+
+    void add(uint64_t service, uint64_t wait) {
+        frames.store(frames.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        serviceNs.store(serviceNs.load(std::memory_order_relaxed) + service, std::memory_order_relaxed);
+        waitNs.store(waitNs.load(std::memory_order_relaxed) + wait, std::memory_order_relaxed);
+        if (service > worstNs.load(std::memory_order_relaxed)) {
+            worstNs.store(service, std::memory_order_relaxed);
+        }
+    }
+
+    // Frames per second this stage could sustain on its own
+    double throughput() const {
+        uint64_t busy = serviceNs.load(std::memory_order_relaxed);
+        return busy > 0 ? frames.load(std::memory_order_relaxed) * 1e9 / (double)busy : 0.0;
+    }
+
+    double meanUs() const {
+        unsigned long count = frames.load(std::memory_order_relaxed);
+        return count > 0 ? serviceNs.load(std::memory_order_relaxed) / 1e3 / count : 0.0;
+    }
+
+    void report(StatsReport& out, const char* name) const {
+        out.add(name, "frames", frames.load(std::memory_order_relaxed));
+        out.add(name, "service_ns", (unsigned long)serviceNs.load(std::memory_order_relaxed));
+        out.add(name, "worst_ns", (unsigned long)worstNs.load(std::memory_order_relaxed));
+        out.add(name, "wait_ns", (unsigned long)waitNs.load(std::memory_order_relaxed));
+    }
+};
+
+// ============================================================================
+// SCALER - YUV 4:2:0 to an RGB canvas, area average
+// ============================================================================
+
+class VideoScaler {
+private:
+    int sourceWidth, sourceHeight;
+    int width, height;
+    int* columnStart;       // [width + 1] source column spans
+    int* rowStart;          // [height + 1] source row spans
+
+    VideoScaler(const VideoScaler&);
+    VideoScaler& operator=(const VideoScaler&);
+
+    static uint8_t clamp(int value) { return (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value); }
+
+public:
+    VideoScaler(int srcWidth, int srcHeight, int dstWidth, int dstHeight)
+        : sourceWidth(srcWidth), sourceHeight(srcHeight), width(dstWidth), height(dstHeight),
+          columnStart(new int[(size_t)dstWidth + 1]), rowStart(new int[(size_t)dstHeight + 1]) {
+        for (int x = 0; x <= dstWidth; x++) {
+            columnStart[x] = (int)((int64_t)x * srcWidth / dstWidth);
+        }
+        for (int y = 0; y <= dstHeight; y++) {
+            rowStart[y] = (int)((int64_t)y * srcHeight / dstHeight);
+        }
+    }
+
+    ~VideoScaler() {
+        delete[] columnStart;
+        delete[] rowStart;
+    }
+
+    void scale(const VideoPicture& picture, Canvas& canvas) const {
+        for (int y = 0; y < height; y++) {
+            int y0 = rowStart[y];
+            int y1 = rowStart[y + 1] > y0 ? rowStart[y + 1] : y0 + 1;
+            for (int x = 0; x < width; x++) {
+                int x0 = columnStart[x];
+                int x1 = columnStart[x + 1] > x0 ? columnStart[x + 1] : x0 + 1;
+                uint32_t luma = 0;
+                for (int sy = y0; sy < y1; sy++) {
+                    const uint8_t* row = picture.planes[0] + (size_t)sy * picture.strides[0];
+                    for (int sx = x0; sx < x1; sx++) {
+                        luma += row[sx];
+                    }
+                }
+                int lumaCount = (y1 - y0) * (x1 - x0);
+
+                // Chroma over the covering half-resolution span
+                int cx0 = x0 / 2, cx1 = (x1 + 1) / 2, cy0 = y0 / 2, cy1 = (y1 + 1) / 2;
+                uint32_t u = 0, v = 0;
+                for (int cy = cy0; cy < cy1; cy++) {
+                    const uint8_t* uRow = picture.planes[1] + (size_t)cy * picture.strides[1];
+                    const uint8_t* vRow = picture.planes[2] + (size_t)cy * picture.strides[2];
+                    for (int cx = cx0; cx < cx1; cx++) {
+                        u += uRow[cx];
+                        v += vRow[cx];
+                    }
+                }
+                int chromaCount = (cy1 - cy0) * (cx1 - cx0);
+
+                // BT.601, limited range
+                int c = (int)(luma / lumaCount) - 16;
+                int d = (int)(u / chromaCount) - 128;
+                int e = (int)(v / chromaCount) - 128;
+                canvas.setPixel(x, y, clamp((298 * c + 409 * e + 128) >> 8),
+                                clamp((298 * c - 100 * d - 208 * e + 128) >> 8), clamp((298 * c + 516 * d + 128) >> 8));
+            }
+        }
+    }
+};
+
+// ============================================================================
+// SOURCES
+// ============================================================================
+
+// Moving test pattern for benchmarks and for builds without libav
+class SyntheticVideoSource {
+private:
+    int w, h;
+    int frameCount;
+    int frameMs;
+    int index;
+
+public:
+    SyntheticVideoSource(int width, int height, int frames, int fps)
+        : w(width), h(height), frameCount(frames), frameMs(1000 / fps), index(0) {}
+
+    int width() const { return w; }
+    int height() const { return h; }
+
+    bool decode(VideoPicture& picture) {
+        if (index >= frameCount) {
+            return false;
+        }
+        int boxX = index * 7 % (w - w / 4);
+        int boxY = h / 4 + index * 3 % (h / 2);
+        for (int y = 0; y < h; y++) {
+            uint8_t* row = picture.planes[0] + (size_t)y * picture.strides[0];
+            for (int x = 0; x < w; x++) {
+                bool box = x >= boxX && x < boxX + w / 4 && y >= boxY && y < boxY + h / 4;
+                row[x] = box ? 235 : (uint8_t)(16 + ((x + index * 4) & 127));
+            }
+        }
+        for (int y = 0; y < (h + 1) / 2; y++) {
+            uint8_t* u = picture.planes[1] + (size_t)y * picture.strides[1];
+            uint8_t* v = picture.planes[2] + (size_t)y * picture.strides[2];
+            for (int x = 0; x < (w + 1) / 2; x++) {
+                u[x] = (uint8_t)(128 + ((y * 2 - h / 2) * 96 / h));
+                v[x] = (uint8_t)(128 + ((x * 2 - w / 2) * 96 / w));
+            }
+        }
+        picture.ptsMs = (uint32_t)(index * frameMs);
+        index++;
+        return true;
+    }
+
+    bool rewind() {
+        index = 0;
+        return true;
+    }
+};
+
+#ifdef HUB75_LIBAV
+
+// Software decode of the best video stream of a file; 4:2:0 only
+class LibavSource {
+private:
+    AVFormatContext* format;
+    AVCodecContext* codec;
+    AVPacket* packet;
+    AVFrame* frame;
+    int stream;
+    double msPerTick;
+    bool draining;
+
+    LibavSource(const LibavSource&);
+    LibavSource& operator=(const LibavSource&);
+
+public:
+    const char* error;
+
+    LibavSource() : format(nullptr), codec(nullptr), packet(nullptr), frame(nullptr), stream(-1), msPerTick(0),
+                    draining(false), error(nullptr) {}
+
+    ~LibavSource() {
+        av_frame_free(&frame);
+        av_packet_free(&packet);
+        avcodec_free_context(&codec);
+        avformat_close_input(&format);
+    }
+
+    bool open(const char* path) {
+        if (avformat_open_input(&format, path, nullptr, nullptr) < 0 || avformat_find_stream_info(format, nullptr) < 0) {
+            error = "cannot read file";
+            return false;
+        }
+        const AVCodec* decoder = nullptr;
+        stream = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
+        if (stream < 0 || !decoder) {
+            error = "no video stream";
+            return false;
+        }
+        codec = avcodec_alloc_context3(decoder);
+        if (!codec || avcodec_parameters_to_context(codec, format->streams[stream]->codecpar) < 0) {
+            error = "cannot set up decoder";
+            return false;
+        }
+        codec->thread_count = 1;  // The pipeline is the parallelism; keep decode on its core
+        if (avcodec_open2(codec, decoder, nullptr) < 0) {
+            error = "cannot open decoder";
+            return false;
+        }
+        if (codec->pix_fmt != AV_PIX_FMT_YUV420P && codec->pix_fmt != AV_PIX_FMT_YUVJ420P) {
+            error = "only 4:2:0 video is supported";
+            return false;
+        }
+        packet = av_packet_alloc();
+        frame = av_frame_alloc();
+        msPerTick = av_q2d(format->streams[stream]->time_base) * 1000.0;
+        return packet && frame;
+    }
+
+    int width() const { return codec->width; }
+    int height() const { return codec->height; }
+
+    bool decode(VideoPicture& picture) {
+        for (;;) {
+            int result = avcodec_receive_frame(codec, frame);
+            if (result == 0) {
+                for (int plane = 0; plane < 3; plane++) {
+                    int rows = plane == 0 ? picture.height : (picture.height + 1) / 2;
+                    int bytes = plane == 0 ? picture.width : (picture.width + 1) / 2;
+                    for (int y = 0; y < rows; y++) {
+                        memcpy(picture.planes[plane] + (size_t)y * picture.strides[plane],
+                               frame->data[plane] + (size_t)y * frame->linesize[plane], (size_t)bytes);
+                    }
+                }
+                int64_t pts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : 0;
+                picture.ptsMs = (uint32_t)(pts * msPerTick);
+                av_frame_unref(frame);
+                return true;
+            }
+            if (result != AVERROR(EAGAIN)) {
+                return false;  // AVERROR_EOF once drained, or a decode error
+            }
+            if (draining) {
+                return false;
+            }
+            if (av_read_frame(format, packet) < 0) {
+                avcodec_send_packet(codec, nullptr);
+                draining = true;
+                continue;
+            }
+            if (packet->stream_index == stream) {
+                avcodec_send_packet(codec, packet);
+            }
+            av_packet_unref(packet);
+        }
+    }
+
+    bool rewind() {
+        draining = false;
+        avcodec_flush_buffers(codec);
+        return av_seek_frame(format, stream, 0, AVSEEK_FLAG_BACKWARD) >= 0;
+    }
+};
+
+#endif // HUB75_LIBAV
+
+// ============================================================================
+// VIDEO PIPELINE
+// ============================================================================
+
+template <class Source>
+class VideoPipeline {
+private:
+    Source& source;
+    MatrixConfig config;
+    GammaTable gamma;
+    VideoScaler scaler;
+    bool loop;
+
+    VideoPicture* pictures[VIDEO_PICTURES];
+    VideoCanvas* canvases[VIDEO_CANVASES];
+    VideoBitplanes* frames[VIDEO_FRAMES];
+
+    SpscQueue<VideoPicture, VIDEO_QUEUE_SIZE> freePictures, decodedPictures;
+    SpscQueue<VideoCanvas, VIDEO_QUEUE_SIZE> freeCanvases, scaledCanvases;
+    SpscQueue<VideoBitplanes, VIDEO_QUEUE_SIZE> freeFrames, readyFrames;
+
+    pthread_t threads[3];
+    bool threadStarted[3];
+    std::atomic<bool> stopping;
+    std::atomic<bool> sourceEnded;
+    std::atomic<unsigned long> framesDecoded;
+
+    // Scan thread state
+    VideoBitplanes* shown;
+    bool clockStarted;
+    uint32_t clockOffsetMs;
+
+    VideoPipeline(const VideoPipeline&);
+    VideoPipeline& operator=(const VideoPipeline&);
+
+    // Yield first, then nap; false once stopping
+    bool idle(int& spins) {
+        if (stopping.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        if (++spins < VIDEO_IDLE_SPINS) {
+            sched_yield();
+        } else {
+            sleepUs(VIDEO_IDLE_NAP_US);
+        }
+        return true;
+    }
+
+    static void sleepUs(uint32_t us) {
+        struct timespec ts = { 0, (long)us * 1000 };
+        nanosleep(&ts, nullptr);
+    }
+
+    template <class T, int N>
+    T* take(SpscQueue<T, N>& queue) {
+        int spins = 0;
+        T* item;
+        while (!(item = queue.pop())) {
+            if (!idle(spins)) {
+                return nullptr;
+            }
+        }
+        return item;
+    }
+
+    template <class T, int N>
+    bool give(SpscQueue<T, N>& queue, T* item) {
+        int spins = 0;
+        while (!queue.push(item)) {
+            if (!idle(spins)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void copyStamps(uint64_t* to, const uint64_t* from) { memcpy(to, from, sizeof(uint64_t) * VIDEO_STAMPS); }
+
+    static void pin(int core) {
+        if (core < 0) {
+            return;
+        }
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(core, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+
+    struct StageStart {
+        VideoPipeline* self;
+        int core;
+    };
+    StageStart starts[3];
+
+    static void* decodeThread(void* arg) {
+        StageStart* start = (StageStart*)arg;
+        VideoPipeline* self = start->self;
+        pin(start->core);
+        uint32_t ptsOffset = 0, lastPts = 0, lastDelta = 33;
+        for (;;) {
+            VideoPicture* picture = self->take(self->freePictures);
+            if (!picture) {
+                return nullptr;
+            }
+            picture->stamps[STAMP_DECODE_START] = monotonicNs();
+            bool decoded = self->source.decode(*picture);
+            if (!decoded && self->loop && self->source.rewind()) {
+                ptsOffset = lastPts + lastDelta;
+                decoded = self->source.decode(*picture);
+            }
+            if (!decoded) {
+                self->sourceEnded.store(true, std::memory_order_release);
+                return nullptr;
+            }
+            picture->ptsMs += ptsOffset;
+            if (picture->ptsMs > lastPts) {
+                lastDelta = picture->ptsMs - lastPts;
+            }
+            lastPts = picture->ptsMs;
+            picture->stamps[STAMP_DECODED] = monotonicNs();
+            if (!self->give(self->decodedPictures, picture)) {
+                return nullptr;
+            }
+            self->framesDecoded.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    static void* scaleThread(void* arg) {
+        StageStart* start = (StageStart*)arg;
+        VideoPipeline* self = start->self;
+        pin(start->core);
+        for (;;) {
+            VideoPicture* picture = self->take(self->decodedPictures);
+            VideoCanvas* canvas = picture ? self->take(self->freeCanvases) : nullptr;
+            if (!canvas) {
+                return nullptr;
+            }
+            copyStamps(canvas->stamps, picture->stamps);
+            canvas->ptsMs = picture->ptsMs;
+            canvas->stamps[STAMP_SCALE_START] = monotonicNs();
+            {
+                AllocScope scope(ALLOC_SCOPE_RENDER);
+                self->scaler.scale(*picture, canvas->canvas);
+            }
+            canvas->stamps[STAMP_SCALED] = monotonicNs();
+            self->freePictures.push(picture);
+            self->stages[0].add(canvas->stamps[STAMP_DECODED] - canvas->stamps[STAMP_DECODE_START],
+                                canvas->stamps[STAMP_SCALE_START] - canvas->stamps[STAMP_DECODED]);
+            if (!self->give(self->scaledCanvases, canvas)) {
+                return nullptr;
+            }
+        }
+    }
+
+    static void* convertThread(void* arg) {
+        StageStart* start = (StageStart*)arg;
+        VideoPipeline* self = start->self;
+        pin(start->core);
+        for (;;) {
+            VideoCanvas* canvas = self->take(self->scaledCanvases);
+            VideoBitplanes* frame = canvas ? self->take(self->freeFrames) : nullptr;
+            if (!frame) {
+                return nullptr;
+            }
+            copyStamps(frame->stamps, canvas->stamps);
+            frame->ptsMs = canvas->ptsMs;
+            frame->stamps[STAMP_CONVERT_START] = monotonicNs();
+            frame->frame.build(canvas->canvas, self->gamma);
+            frame->stamps[STAMP_CONVERTED] = monotonicNs();
+            self->freeCanvases.push(canvas);
+            self->stages[1].add(frame->stamps[STAMP_SCALED] - frame->stamps[STAMP_SCALE_START],
+                                frame->stamps[STAMP_CONVERT_START] - frame->stamps[STAMP_SCALED]);
+            if (!self->give(self->readyFrames, frame)) {
+                return nullptr;
+            }
+        }
+    }
+
+    // Stamp a frame leaving the pipeline
+    void arrive(VideoBitplanes* frame) {
+        frame->stamps[STAMP_SHOWN] = monotonicNs();
+        stages[2].add(frame->stamps[STAMP_CONVERTED] - frame->stamps[STAMP_CONVERT_START],
+                      frame->stamps[STAMP_SHOWN] - frame->stamps[STAMP_CONVERTED]);
+    }
+
+    // Put next on screen, recycling the frame it replaces
+    void show(VideoBitplanes* next) {
+        uint64_t latency = next->stamps[STAMP_SHOWN] - next->stamps[STAMP_DECODE_START];
+        latencyNs += latency;
+        worstLatencyNs = latency > worstLatencyNs ? latency : worstLatencyNs;
+        if (shown) {
+            freeFrames.push(shown);
+        }
+        shown = next;
+        framesShown++;
+    }
+
+public:
+    VideoStageStats stages[3];     // Decode, scale, convert
+    unsigned long framesShown;
+    unsigned long framesDropped;   // Converted but overtaken before a refresh
+    uint64_t latencyNs;            // Sum over shown frames, decode start to shown
+    uint64_t worstLatencyNs;
+
+    // source must be open; loop restarts it at the end with continuing timestamps
+    VideoPipeline(Source& src, const MatrixConfig& cfg, double gammaValue, bool looping)
+        : source(src), config(cfg), scaler(src.width(), src.height(), cfg.width(), cfg.height()), loop(looping),
+          stopping(false), sourceEnded(false), framesDecoded(0), shown(nullptr), clockStarted(false), clockOffsetMs(0),
+          framesShown(0), framesDropped(0), latencyNs(0), worstLatencyNs(0) {
+        gamma.build(cfg.planes, gammaValue);
+        for (int i = 0; i < VIDEO_PICTURES; i++) {
+            pictures[i] = new VideoPicture(src.width(), src.height());
+            freePictures.push(pictures[i]);
+        }
+        for (int i = 0; i < VIDEO_CANVASES; i++) {
+            canvases[i] = new VideoCanvas(cfg.width(), cfg.height());
+            freeCanvases.push(canvases[i]);
+        }
+        for (int i = 0; i < VIDEO_FRAMES; i++) {
+            frames[i] = new VideoBitplanes(cfg);
+            freeFrames.push(frames[i]);
+        }
+        for (int i = 0; i < 3; i++) {
+            threadStarted[i] = false;
+        }
+    }
+
+    ~VideoPipeline() {
+        stop();
+        for (int i = 0; i < VIDEO_PICTURES; i++) {
+            delete pictures[i];
+        }
+        for (int i = 0; i < VIDEO_CANVASES; i++) {
+            delete canvases[i];
+        }
+        for (int i = 0; i < VIDEO_FRAMES; i++) {
+            delete frames[i];
+        }
+    }
+
+    // cores: decode, scale and convert core, or null / -1 to leave unpinned
+    bool start(const int* cores = nullptr) {
+        void* (*bodies[3])(void*) = { decodeThread, scaleThread, convertThread };
+        stopping.store(false);
+        for (int i = 0; i < 3; i++) {
+            starts[i].self = this;
+            starts[i].core = cores ? cores[i] : -1;
+            threadStarted[i] = pthread_create(&threads[i], nullptr, bodies[i], &starts[i]) == 0;
+            if (!threadStarted[i]) {
+                stop();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void stop() {
+        stopping.store(true);
+        for (int i = 0; i < 3; i++) {
+            if (threadStarted[i]) {
+                pthread_join(threads[i], nullptr);
+                threadStarted[i] = false;
+            }
+        }
+    }
+
+    // Scan thread, before every refresh: the newest frame due at nowMs
+    // (timestamps count from the first frame), or nullptr before the first
+    const BitplaneFrame* frameAt(uint32_t nowMs) {
+        VideoBitplanes* due = nullptr;
+        VideoBitplanes* next;
+        while ((next = readyFrames.peek())) {
+            if (!clockStarted) {
+                clockStarted = true;
+                clockOffsetMs = nowMs - next->ptsMs;
+            }
+            if ((int32_t)(nowMs - (next->ptsMs + clockOffsetMs)) < 0) {
+                break;
+            }
+            readyFrames.pop();
+            arrive(next);
+            if (due) {
+                freeFrames.push(due);  // Overtaken before it reached the panel
+                framesDropped++;
+            }
+            due = next;
+        }
+        if (due) {
+            show(due);
+        }
+        return shown ? &shown->frame : nullptr;
+    }
+
+    // Offline and benchmarks: the next frame regardless of its timestamp,
+    // nullptr once the source has ended and everything was shown
+    const BitplaneFrame* nextFrame() {
+        int spins = 0;
+        VideoBitplanes* next;
+        while (!(next = readyFrames.pop())) {
+            if (sourceEnded.load(std::memory_order_acquire) &&
+                framesDecoded.load(std::memory_order_acquire) == framesShown + framesDropped) {
+                return nullptr;
+            }
+            if (!idle(spins)) {
+                return nullptr;
+            }
+        }
+        arrive(next);
+        show(next);
+        return &shown->frame;
+    }
+
+    uint32_t shownPtsMs() const { return shown ? shown->ptsMs : 0; }
+
+    void report(StatsReport& out, const char* name) const {
+        static const char* const stageNames[3] = { "decode", "scale", "convert" };
+        char stageName[STATS_NAME_SIZE];
+        for (int i = 0; i < 3; i++) {
+            size_t length = strlen(name);
+            if (length + strlen(stageNames[i]) + 2 > sizeof(stageName)) {
+                return;
+            }
+            memcpy(stageName, name, length);
+            stageName[length] = '.';
+            strcpy(stageName + length + 1, stageNames[i]);
+            stages[i].report(out, stageName);
+        }
+        out.add(name, "frames_shown", framesShown);
+        out.add(name, "frames_dropped", framesDropped);
+        out.add(name, "worst_latency_ns", (unsigned long)worstLatencyNs);
+    }
+};
+
+#endif // VIDEO_PIPELINE_H